@@ -80,6 +80,7 @@ MainWindow::MainWindow(Controller* c, QWidget *parent) :
     _saveBgImgAction(nullptr), _originBgImgAction(nullptr), _scaleBgImgAction(nullptr),
     _alphaBgImgAction(nullptr), _tolBgImgAction(nullptr), _blendBgImgAction(nullptr),
     _units(fuMetric), _unitLabel(nullptr), _undoMemLabel(nullptr), _geomInfoLabel(nullptr),
+    _hydrostaticsLabel(nullptr),
     _fileToolBar(nullptr), _visToolBar(nullptr), _layerToolBar(nullptr), _pointToolBar(nullptr),
     _modToolBar(nullptr), _precisionComboBox(nullptr), _activeLayerComboBox(nullptr),
     _colorView(nullptr)
@@ -100,6 +101,7 @@ MainWindow::MainWindow(Controller* c, QWidget *parent) :
 
     // connect controller signals
     connect(_controller, SIGNAL(updateUndoData()), SLOT(updateUndoData()));
+    connect(_controller, SIGNAL(updateLiveHydrostatics()), SLOT(updateLiveHydrostatics()));
     connect(_controller, SIGNAL(changeActiveLayer()), SLOT(enableActions()));
     connect(_controller, SIGNAL(showControlPointDialog(bool)),
             SLOT(showControlPointDialog(bool)));
@@ -564,10 +566,13 @@ void MainWindow::createStatusBar()
     _undoMemLabel->setFrameStyle(QFrame::Panel | QFrame::Sunken);
     _geomInfoLabel = new QLabel(tr("faces: 0 pts: 0 edges: 0"));
     _geomInfoLabel->setFrameStyle(QFrame::Panel | QFrame::Sunken);
+    _hydrostaticsLabel = new QLabel("");
+    _hydrostaticsLabel->setFrameStyle(QFrame::Panel | QFrame::Sunken);
 
     ui->statusBar->addPermanentWidget(_unitLabel);
     ui->statusBar->addPermanentWidget(_undoMemLabel);
     ui->statusBar->addPermanentWidget(_geomInfoLabel);
+    ui->statusBar->addPermanentWidget(_hydrostaticsLabel);
 }
 
 void MainWindow::createActions()
@@ -1316,6 +1321,20 @@ void MainWindow::updateUndoData()
     _undoMemLabel->setText(tr("undo memory: %1").arg(mem));
 }
 
+void MainWindow::updateLiveHydrostatics()
+{
+    const LiveHydrostatics& live = _controller->getModel()->getLiveHydrostatics();
+    if (live.hasError(feNothingSubmerged) || live.hasError(feMakingWater)) {
+        _hydrostaticsLabel->setText("");
+        return;
+    }
+    const HydrostaticsData& data = live.getData();
+    _hydrostaticsLabel->setText(tr("displ: %1 lcb: %2 awl: %3")
+                                .arg(data.displacement, 0, 'f', 3)
+                                .arg(data.center_of_buoyancy.x(), 0, 'f', 3)
+                                .arg(data.waterplane_area, 0, 'f', 3));
+}
+
 void
 MainWindow::wireFrame()
 {
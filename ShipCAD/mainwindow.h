@@ -211,6 +211,10 @@ private slots:
      */
     void updateUndoData();
 
+    /*! \brief show the hydrostatics while a point is moved
+     */
+    void updateLiveHydrostatics();
+
     /*! \brief check the model
      */
     void checkModel();
@@ -443,6 +447,7 @@ private:
     QLabel* _unitLabel;
     QLabel* _undoMemLabel;
     QLabel* _geomInfoLabel;
+    QLabel* _hydrostaticsLabel;
     // toolbars
     QToolBar* _fileToolBar;
     QToolBar* _visToolBar;
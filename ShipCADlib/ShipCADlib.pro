@@ -49,7 +49,15 @@ SOURCES += shipcadlib.cpp \
     developedpatch.cpp \
     dialogdata.cpp \
     drawfaces.cpp \
-    iges.cpp
+    iges.cpp \
+    parallel.cpp \
+    subdivstencils.cpp \
+    picktree.cpp \
+    intervalindex.cpp \
+    pointhash.cpp \
+    pointgrid.cpp \
+    hydrostaticmesh.cpp \
+    hydrostaticscache.cpp
 
 HEADERS += shipcadlib.h \
     dialogdata.h \
@@ -70,6 +78,13 @@ HEADERS += shipcadlib.h \
     subdivpoint.h \
     subdivcontrolcurve.h \
     subdivlayer.h \
+    subdivstencils.h \
+    picktree.h \
+    intervalindex.h \
+    pointhash.h \
+    pointgrid.h \
+    hydrostaticmesh.h \
+    hydrostaticscache.h \
     version.h \
     shader.h \
     projsettings.h \
@@ -88,9 +103,11 @@ HEADERS += shipcadlib.h \
     grid.h \
     developedpatch.h \
     mempool.h \
+    adjacency.h \
     orderedmap.h \
     predicate.h \
     tempvar.h \
+    parallel.h \
     drawfaces.h \
     iges.h
 
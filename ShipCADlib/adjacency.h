@@ -0,0 +1,232 @@
+/*##############################################################################################
+ *    ShipCAD                                                                                  *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>                                   *
+ *    Original Copyright header below                                                          *
+ *                                                                                             *
+ *    This code is distributed as part of the FREE!ship project. FREE!ship is an               *
+ *    open source surface-modelling program based on subdivision surfaces and intended for     *
+ *    designing ships.                                                                         *
+ *                                                                                             *
+ *    Copyright © 2005, by Martijn van Engeland                                                *
+ *    e-mail                  : Info@FREEship.org                                              *
+ *    FREE!ship project page  : https://sourceforge.net/projects/freeship                      *
+ *    FREE!ship homepage      : www.FREEship.org                                               *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef ADJACENCY_H_
+#define ADJACENCY_H_
+
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <stdint.h>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief flat storage for the adjacency lists of one subdivided level
+ *
+ * The lists of a level are slices of one array, one after the other
+ * like the rows of a compressed sparse row matrix, instead of a heap
+ * block per list. The slices are handed out in order with take, and
+ * live until the block is cleared or destroyed.
+ */
+template <class T> class AdjacencyBlock
+{
+public:
+    AdjacencyBlock() : _used(0) {}
+
+    /*! \brief make room for the lists of a level, dropping the old ones
+     *
+     * \param n number of entries in all the lists together
+     */
+    void allocate(size_t n)
+        {
+            std::vector<T>(n).swap(_data);
+            _used = 0;
+        }
+    /*! \brief take the next slice
+     *
+     * \param n number of entries in the slice
+     * \return the slice, or 0 if the block is full
+     */
+    T* take(size_t n)
+        {
+            if (_used + n > _data.size())
+                return nullptr;
+            T* result = _data.data() + _used;
+            _used += n;
+            return result;
+        }
+    /*! \brief free the storage
+     */
+    void clear()
+        {
+            std::vector<T>().swap(_data);
+            _used = 0;
+        }
+    size_t bytes() const { return _data.capacity() * sizeof(T); }
+    /*! \brief exchange storage with another block, the slices stay valid
+     */
+    void swap(AdjacencyBlock& other)
+        {
+            _data.swap(other._data);
+            std::swap(_used, other._used);
+        }
+
+private:
+    std::vector<T> _data;
+    size_t _used;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief list of the elements next to an element
+ *
+ * Has the parts of the std::vector interface the subdivision elements
+ * use. Subdivided elements keep their list in a slice of the
+ * AdjacencyBlock of their level, control elements and lists that
+ * outgrow their slice use memory of their own.
+ */
+template <class T> class AdjacencyList
+{
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    AdjacencyList() : _data(nullptr), _size(0), _capacity(0), _owned(0) {}
+    ~AdjacencyList()
+        {
+            if (_owned)
+                delete [] _data;
+        }
+
+    /*! \brief keep the list in a slice of the level's block
+     *
+     * The list is emptied. If the slice is 0 the list
+     * allocates its own memory when needed.
+     *
+     * \param slice the slice
+     * \param capacity number of entries in the slice
+     */
+    void use(T* slice, size_t capacity)
+        {
+            if (_owned)
+                delete [] _data;
+            _data = slice;
+            _size = 0;
+            _capacity = slice != nullptr ? static_cast<uint32_t>(capacity) : 0;
+            _owned = 0;
+        }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    size_t capacity() const { return _capacity; }
+
+    T& operator[](size_t index) { return _data[index]; }
+    const T& operator[](size_t index) const { return _data[index]; }
+    T& front() { return _data[0]; }
+    const T& front() const { return _data[0]; }
+    T& back() { return _data[_size - 1]; }
+    const T& back() const { return _data[_size - 1]; }
+
+    iterator begin() { return _data; }
+    iterator end() { return _data + _size; }
+    const_iterator begin() const { return _data; }
+    const_iterator end() const { return _data + _size; }
+
+    void clear() { _size = 0; }
+    void reserve(size_t n)
+        {
+            if (n > _capacity)
+                grow(n);
+        }
+    void push_back(const T& value)
+        {
+            if (_size == _capacity)
+                grow(_capacity < 2 ? 4 : 2 * _capacity);
+            _data[_size++] = value;
+        }
+    iterator insert(iterator pos, const T& value)
+        {
+            size_t index = pos - _data;
+            if (_size == _capacity)
+                grow(_capacity < 2 ? 4 : 2 * _capacity);
+            memmove(_data + index + 1, _data + index, (_size - index) * sizeof(T));
+            _data[index] = value;
+            ++_size;
+            return _data + index;
+        }
+    iterator erase(iterator pos)
+        {
+            memmove(pos, pos + 1, (end() - pos - 1) * sizeof(T));
+            --_size;
+            return pos;
+        }
+    void assign(const T* first, const T* last)
+        {
+            _size = 0;
+            reserve(last - first);
+            for (const T* i=first; i!=last; ++i)
+                _data[_size++] = *i;
+        }
+    void assign(const std::vector<T>& values)
+        {
+            assign(values.data(), values.data() + values.size());
+        }
+    void swap(AdjacencyList& other)
+        {
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            uint32_t capacity = _capacity;
+            _capacity = other._capacity;
+            other._capacity = capacity;
+            uint32_t owned = _owned;
+            _owned = other._owned;
+            other._owned = owned;
+        }
+
+private:
+    AdjacencyList(const AdjacencyList&);
+    AdjacencyList& operator=(const AdjacencyList&);
+
+    // move to memory of our own with room for n entries
+    void grow(size_t n)
+        {
+            T* data = new T[n];
+            if (_size > 0)
+                memcpy(data, _data, _size * sizeof(T));
+            if (_owned)
+                delete [] _data;
+            _data = data;
+            _capacity = static_cast<uint32_t>(n);
+            _owned = 1;
+        }
+
+    T* _data;
+    uint32_t _size;
+    uint32_t _capacity : 31;
+    uint32_t _owned : 1;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};                              /* end namespace */
+
+#endif
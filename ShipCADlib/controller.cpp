@@ -466,7 +466,7 @@ void Controller::rotateFaces()
         }
     }
 
-    getModel()->setBuild(false);
+    getModel()->controlPointsMoved();
     getModel()->setFileChanged(true);
     emit modifiedModel();
 }
@@ -527,7 +527,7 @@ void Controller::scaleFaces()
                     data.rotation_vector * points[i]->getCoordinate());
         }
     }
-    getModel()->setBuild(false);
+    getModel()->controlPointsMoved();
     getModel()->setFileChanged(true);
     emit modifiedModel();
 }
@@ -569,7 +569,7 @@ void Controller::moveFaces()
     if (points.size() == getSurface()->numberOfControlPoints())
          adjust_markers = adjustMarkersDialog();
     getModel()->moveFaces(points, data.rotation_vector, adjust_markers);
-    getModel()->setBuild(false);
+    getModel()->controlPointsMoved();
     getModel()->setFileChanged(true);
     emit modifiedModel();
 }
@@ -1500,7 +1500,12 @@ void Controller::movePoint(QVector3D changedCoords)
         updated.setZ(changedCoords.z());
     pt->setCoordinate(updated);
     getModel()->setFileChanged(true);
+    // only the faces around the point are integrated again
+    LiveHydrostatics& live = getModel()->getLiveHydrostatics();
+    live.setDraft(getModel()->getProjectSettings().getDraft());
+    live.update();
     emit updateControlPointValue(pt);
+    emit updateLiveHydrostatics();
     emit modifiedModel();
 }
 
@@ -1548,7 +1553,7 @@ void Controller::projectStraightLinePoint()
         }
         if (nchanged > 0) {
             uo->accept();
-            getModel()->setBuild(false);
+            getModel()->controlPointsMoved();
             getModel()->setFileChanged(true);
             emit modifiedModel();
         } else {
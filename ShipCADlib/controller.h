@@ -124,6 +124,10 @@ signals:
      */
     void updateControlPointValue(ShipCAD::SubdivisionControlPoint* pt);
 
+    /*! \brief the live hydrostatics were updated for a moved point
+     */
+    void updateLiveHydrostatics();
+
     /*! \brief execute the Insert Plane Control Points dialog
      */
     void exeInsertPlanePointsDialog(ShipCAD::InsertPlaneDialogData& data);
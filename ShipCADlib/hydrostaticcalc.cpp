@@ -30,6 +30,8 @@
 #include <cmath>
 #include <algorithm>
 #include "hydrostaticcalc.h"
+#include "hydrostaticmesh.h"
+#include "hydrostaticscache.h"
 #include "shipcadmodel.h"
 #include "projsettings.h"
 #include "utility.h"
@@ -38,10 +40,15 @@
 #include "subdivlayer.h"
 #include "subdivface.h"
 #include "subdivpoint.h"
+#include "intervalindex.h"
+#include "parallel.h"
 
 using namespace std;
 using namespace ShipCAD;
 
+// each cross curves balance is many volume calculations
+static const size_t k_crosscurves_grain = 1;
+
 void HydrostaticsData::clear()
 {
 	model_min = model_max = wl_min = wl_max = sub_min = sub_max = ZERO;
@@ -73,7 +80,8 @@ void CrosscurvesData::clear()
 HydrostaticCalc::HydrostaticCalc(ShipCADModel* owner)
 	: _owner(owner), _heeling_angle(0.0), _trim(0.0),
       _draft(0.0), _calculated(false), _hydrostatic_type(fhShort),
-      _mainframe(new Intersection(owner))
+      _mainframe(new Intersection(owner)), _center_of_gravity(ZERO),
+      _volume_evaluations(0), _trim_iterations(0), _sac_resolution(0)
 {
     // does nothing
 }
@@ -115,23 +123,35 @@ QString HydrostaticCalc::getErrorString() const
     return result;
 }
 
+// the waterline plane at a draft above the lowest point
+static Plane WaterlinePlane(float length, float lowest_value, float draft, float trim,
+                            float heeling_angle)
+{
+	QVector3D p1(0.0, 0.0, lowest_value + (draft - 0.5 * trim));
+	QVector3D p2(length, 0.0,
+				 lowest_value + (draft + 0.5 * trim));
+	QVector3D p3(length,
+				 cos(DegToRad(-heeling_angle)),
+                 lowest_value + (draft + 0.5 * trim) - sin(DegToRad(-heeling_angle)));
+	return Plane(p1, p2, p3);
+}
+
+// trim angle in degrees for a trim distance
+static float TrimAngle(float length, float trim, float heeling_angle)
+{
+	return RadToDeg(atan((-trim * cos(DegToRad(heeling_angle))) / length));
+}
+
 float HydrostaticCalc::getTrimAngle() const
 {
-	float result = RadToDeg(atan((-_trim * cos(DegToRad(_heeling_angle)))
-								 / _owner->getProjectSettings().getLength()));
-	return result;
+	return TrimAngle(_owner->getProjectSettings().getLength(), _trim, _heeling_angle);
 }
 
 Plane HydrostaticCalc::getWlPlane() const
 {
-	float lowest_value = _owner->findLowestHydrostaticsPoint();
-	QVector3D p1(0.0, 0.0, lowest_value + (_draft - 0.5 * _trim));
-	QVector3D p2(_owner->getProjectSettings().getLength(), 0.0,
-				 lowest_value + (_draft + 0.5 * _trim));
-	QVector3D p3(_owner->getProjectSettings().getLength(),
-				 cos(DegToRad(-_heeling_angle)),
-                 lowest_value + (_draft + 0.5 * _trim) - sin(DegToRad(-_heeling_angle)));
-	return Plane(p1, p2, p3);
+	return WaterlinePlane(_owner->getProjectSettings().getLength(),
+						  _owner->findLowestHydrostaticsPoint(), _draft, _trim,
+						  _heeling_angle);
 }
 
 void HydrostaticCalc::setCalculated(bool calc)
@@ -168,6 +188,22 @@ void HydrostaticCalc::setHydrostaticType(hydrostatic_type_t ty)
 	}
 }
 
+void HydrostaticCalc::setCenterOfGravity(const QVector3D& cog)
+{
+	if (cog != _center_of_gravity) {
+		_center_of_gravity = cog;
+		setCalculated(false);
+	}
+}
+
+void HydrostaticCalc::setSACResolution(size_t bins)
+{
+	if (bins != _sac_resolution) {
+		_sac_resolution = bins;
+		setCalculated(false);
+	}
+}
+
 void HydrostaticCalc::setTrim(float trim)
 {
 	if (trim != _trim) {
@@ -464,7 +500,7 @@ static Plane CalculateWaterlinePlane(float desired_draft, MinMaxData& mmd)
 }
 
 // used in balance
-static void CalculateMinMaxData(MinMaxData& mmd, ShipCADModel* owner,
+static void CalculateMinMaxData(MinMaxData& mmd, const HydrostaticMesh& mesh,
 								Plane& wlplane, float CosTrim, float SinTrim,
 								float CosHeel, float SinHeel)
 {
@@ -490,74 +526,65 @@ static void CalculateMinMaxData(MinMaxData& mmd, ShipCADModel* owner,
 	float min = 0;
 	float max = 0;
 	float distance;
-    SubdivisionSurface* surf = owner->getSurface();
-    for (size_t i=0; i<surf->numberOfLayers(); i++) {
-        if (surf->getLayer(i)->useInHydrostatics()) {
-            SubdivisionLayer* layer = surf->getLayer(i);
-			for (size_t j=0; j<layer->numberOfFaces(); j++) {
-				SubdivisionControlFace* face = layer->getFace(j);
-				for (size_t k=0; k<face->numberOfChildren(); k++) {
-					SubdivisionFace* child = face->getChild(k);
-					for (size_t l=0; l<child->numberOfPoints(); l++) {
-						QVector3D p = child->getPoint(l)->getCoordinate();
-						distance = wlplane.a() * p1.x() + wlplane.b() * p1.y()
-							+ wlplane.c() * p1.z() + wlplane.d();
-						if (first) {
-							min = distance;
-							max = min;
-							mmd.lowest_point = p1;
-							mmd.lowest_z = p1.z();
-						} else {
-							if (distance < min) {
-								min = distance;
-								mmd.lowest_point = p1;
-							} else if (distance > max) {
-								max = distance;
-							}
-							if (p1.z() < mmd.lowest_z)
-								mmd.lowest_z = p1.z();
-						}
-						p1.setY(-p1.y());
-						distance = wlplane.a() * p1.x() + wlplane.b() * p1.y()
-							+ wlplane.c() * p1.z() + wlplane.d();
-						if (distance < min) {
-							min = distance;
-							mmd.lowest_point = p1;
-						} else if (distance > max)
-							max = distance;
-						// check if this point is a leak point
-						if (fabs(p.y()) > 1e-4 && child->getPoint(l)->isBoundaryVertex()) {
-							p1 = p;
-							if (firstleak) {
-								firstleak = false;
-								mmd.lowest_leak = p1;
-							} else {
-								distance = wlplane.a() * p1.x()
-									+ wlplane.b() * p1.y()
-									+ wlplane.c() * p1.z() + wlplane.d();
-								float tmp = wlplane.a() * mmd.lowest_leak.x()
-									+ wlplane.b() * mmd.lowest_leak.y()
-									+ wlplane.c() * mmd.lowest_leak.z()
-									+ wlplane.d();
-								if (distance < tmp)
-									mmd.lowest_leak = p1;
-							}
-							p1.setY(-p1.y());
-							distance = wlplane.a() * p1.x()
-								+ wlplane.b() * p1.y()
-								+ wlplane.c() * p1.z() + wlplane.d();
-							float tmp = wlplane.a() * mmd.lowest_leak.x()
-								+ wlplane.b() * mmd.lowest_leak.y()
-								+ wlplane.c() * mmd.lowest_leak.z()
-								+ wlplane.d();
-							if (distance < tmp)
-								mmd.lowest_leak = p1;
-						}
-					}
-				}
+	for (size_t i=0; i<mesh.numberOfPoints(); i++) {
+		QVector3D p = mesh.getPoint(i);
+		p1 = p;
+		distance = wlplane.a() * p1.x() + wlplane.b() * p1.y()
+			+ wlplane.c() * p1.z() + wlplane.d();
+		if (first) {
+			first = false;
+			min = distance;
+			max = min;
+			mmd.lowest_point = p1;
+			mmd.lowest_z = p1.z();
+		} else {
+			if (distance < min) {
+				min = distance;
+				mmd.lowest_point = p1;
+			} else if (distance > max) {
+				max = distance;
+			}
+			if (p1.z() < mmd.lowest_z)
+				mmd.lowest_z = p1.z();
+		}
+		p1.setY(-p1.y());
+		distance = wlplane.a() * p1.x() + wlplane.b() * p1.y()
+			+ wlplane.c() * p1.z() + wlplane.d();
+		if (distance < min) {
+			min = distance;
+			mmd.lowest_point = p1;
+		} else if (distance > max)
+			max = distance;
+		// check if this point is a leak point
+		if (mesh.isLeakPoint(i)) {
+			p1 = p;
+			if (firstleak) {
+				firstleak = false;
+				mmd.lowest_leak = p1;
+			} else {
+				distance = wlplane.a() * p1.x()
+					+ wlplane.b() * p1.y()
+					+ wlplane.c() * p1.z() + wlplane.d();
+				float tmp = wlplane.a() * mmd.lowest_leak.x()
+					+ wlplane.b() * mmd.lowest_leak.y()
+					+ wlplane.c() * mmd.lowest_leak.z()
+					+ wlplane.d();
+				if (distance < tmp)
+					mmd.lowest_leak = p1;
 			}
+			p1.setY(-p1.y());
+			distance = wlplane.a() * p1.x()
+				+ wlplane.b() * p1.y()
+				+ wlplane.c() * p1.z() + wlplane.d();
+			float tmp = wlplane.a() * mmd.lowest_leak.x()
+				+ wlplane.b() * mmd.lowest_leak.y()
+				+ wlplane.c() * mmd.lowest_leak.z()
+				+ wlplane.d();
+			if (distance < tmp)
+				mmd.lowest_leak = p1;
 		}
 	}
+	mmd.max_draft = max - min;
 	if (!firstleak) {
 		// leak points have been found, check if this restricts the max draft
 		distance = wlplane.a() * mmd.lowest_leak.x()
@@ -568,6 +595,7 @@ static void CalculateMinMaxData(MinMaxData& mmd, ShipCADModel* owner,
 			max = distance;
 		mmd.max_draft = max - min - 1e-4;
 	}
+	mmd.calculated = true;
 }
 
 struct DraftData
@@ -576,104 +604,194 @@ struct DraftData
 	float displ;
 };
 
-bool HydrostaticCalc::balance(float displacement, bool freetotrim,
-                              CrosscurvesData& output)
+// rotate a point at heel=0 and trim=0 position to given trim and heel,
+// heights measured from the keel
+static QVector3D RotatePointTo(QVector3D p, float keel, float CosTrim, float SinTrim,
+                               float CosHeel, float SinHeel)
 {
-    if (displacement == 0)
-        return true;
+    p.setZ(p.z() - keel);
+    return QVector3D(p.x() * CosTrim + p.y() * SinHeel * SinTrim + p.z() * CosHeel * SinTrim,
+                     p.y() * CosHeel - p.z() * SinHeel,
+                     -p.x() * SinTrim + p.y() * SinHeel * CosTrim + p.z() * CosHeel * CosTrim);
+}
 
-    if (!_owner->isBuild())
-        _owner->rebuildModel(true);
+// distances of all the points to a plane, and of the points mirrored in
+// the centreplane. A plain loop over the coordinate arrays, so the
+// compiler can vectorize it. Computed as Plane::distance does, so the
+// results are the same as for each point on its own.
+static void PlaneDistances(const Plane& plane, const HydrostaticMesh& mesh,
+                           size_t begin, size_t end,
+                           vector<float>& port, vector<float>& starboard)
+{
+    const vector<float>& x = mesh.getX();
+    const vector<float>& y = mesh.getY();
+    const vector<float>& z = mesh.getZ();
+    float a = plane.a();
+    float b = plane.b();
+    float c = plane.c();
+    float d = plane.d();
+    for (size_t i=begin; i<end; i++) {
+        port[i] = a * x[i] + b * y[i] + c * z[i] + d;
+        starboard[i] = a * x[i] - b * y[i] + c * z[i] + d;
+    }
+}
 
-    bool result = false;
-	int max_iterations = 25;
-    float max_error = 5e-4f;
-    float max_trim_error = 1e-4f;
-    int trim_iteration = 0;
-	int displ_iteration;
-	float cos_heel;
-	float sin_heel;
-	float cos_trim;
-	float sin_trim;
-    float error = 0;
-    float trim_error = 0;
-    float error_difference = 0;
-	float prev_error;
-	Plane wlplane;
-	MinMaxData mmd;
-	DraftData min_draft;
-	DraftData max_draft;
-	DraftData curr_draft;
-	_data.clear();
-	mmd.calculated = false;
-    output.clear();
+static void PlaneDistances(const Plane& plane, const HydrostaticMesh& mesh,
+                           vector<float>& port, vector<float>& starboard)
+{
+    port.resize(mesh.numberOfPoints());
+    starboard.resize(mesh.numberOfPoints());
+    PlaneDistances(plane, mesh, 0, mesh.numberOfPoints(), port, starboard);
+}
 
-    do {
-		trim_iteration++;
-		cos_heel = cos(DegToRad(-_heeling_angle));
-		sin_heel = sin(DegToRad(-_heeling_angle));
-        cos_trim = cos(DegToRad(getTrimAngle()));
-        sin_trim = sin(DegToRad(getTrimAngle()));
-		if (!mmd.calculated)
-			CalculateMinMaxData(mmd, _owner, wlplane, cos_trim, sin_trim,
-								cos_heel, sin_heel);
-		min_draft.draft = 0;
-		min_draft.displ = 0;
-		max_draft.draft = mmd.max_draft;
-		wlplane = CalculateWaterlinePlane(max_draft.draft, mmd);
-		calculateVolume(wlplane);
-		max_draft.displ = _data.displacement;
-        if (displacement > 1.005 * max_draft.displ)
-			addError(feNotEnoughBuoyancy);
-		else {
-			displ_iteration = 0;
-			prev_error = 0;
-			do {
-				displ_iteration++;
-                curr_draft.draft = DisplInterpolate(displacement,
-													min_draft.displ,
-													min_draft.draft,
-													max_draft.displ,
-													max_draft.draft);
-				wlplane = CalculateWaterlinePlane(curr_draft.draft, mmd);
-				calculateVolume(wlplane);
-				curr_draft.displ = _data.displacement;
-                if (displacement < 0.1)
-                    error = fabs(displacement - curr_draft.displ);
-				else
-                    error = fabs((displacement - curr_draft.displ) / displacement);
-				if (error > max_error) {
-                    if (curr_draft.displ < displacement)
-						min_draft = curr_draft;
-					else
-						max_draft = curr_draft;
-				}
-				error_difference = fabs(error - prev_error);
-				prev_error = error;
-			} while ((error >= max_error)
-					 && (displ_iteration <= max_iterations)
-					 && (error_difference >= 1e-5));
-		}
-		if (freetotrim) {
-			// TODO
-		} else
-			trim_error = 0;
-	} while ((trim_iteration <= max_iterations)
-			 && (trim_error <= max_trim_error));
-	result = (trim_iteration > max_iterations) && (error <= max_error)
-		&& (error_difference < 1e-5);
-	if (result) {
-        output.waterline_plane = _data.waterline_plane;
-        output.absolute_draft = _data.absolute_draft;
-        output.volume = _data.volume;
-        output.displacement = _data.displacement;
-        output.center_of_buoyancy = _data.center_of_buoyancy;
-		if (fabs(_heeling_angle) < 1e-5)
-            output.center_of_buoyancy.setY(0.0);
-	}
-	return result;
+// the part of a polygon aft of a station (ahead when forward is set)
+static void ClipToStation(const vector<QVector3D>& in, float x, bool forward,
+                          vector<QVector3D>& out)
+{
+    out.clear();
+    if (in.size() == 0)
+        return;
+    float sign = forward ? -1 : 1;
+    QVector3D p1 = in.back();
+    float side1 = sign * (p1.x() - x);
+    for (size_t i=0; i<in.size(); i++) {
+        const QVector3D& p2 = in[i];
+        float side2 = sign * (p2.x() - x);
+        if ((side1 < 0 && side2 > 0) || (side1 > 0 && side2 < 0)) {
+            QVector3D p = p1 + (side1 / (side1 - side2)) * (p2 - p1);
+            p.setX(x);
+            out.push_back(p);
+        }
+        if (side2 <= 0)
+            out.push_back(p2);
+        p1 = p2;
+        side1 = side2;
+    }
 }
 
+// the most submerged triangles integrated together, and how many of
+// them go through the loop over their terms at a time
+static const size_t k_triangle_batch = 256;
+static const size_t k_triangle_block = 8;
+
+// Submerged triangles of a batch of faces, and the terms each adds to
+// the sums of VolumeCalc. Each coordinate and term is an array of its
+// own, so the terms of the whole batch are found in one loop over the
+// arrays that the compiler can vectorize.
+struct TriangleBatch
+{
+    size_t size;
+    float x1[k_triangle_batch];
+    float y1[k_triangle_batch];
+    float z1[k_triangle_batch];
+    float x2[k_triangle_batch];
+    float y2[k_triangle_batch];
+    float z2[k_triangle_batch];
+    float x3[k_triangle_batch];
+    float y3[k_triangle_batch];
+    float z3[k_triangle_batch];
+    // volume under the triangle, and its moment
+    float volume[k_triangle_batch];
+    float mx[k_triangle_batch];
+    float my[k_triangle_batch];
+    float mz[k_triangle_batch];
+    // square of the wetted area, the root is left to the sums so that
+    // the loop has no branches for errno
+    float wetted_squared[k_triangle_batch];
+    // the triangle projected on the waterplane, its area and the moments
+    // of that along the waterplane
+    double area[k_triangle_batch];
+    double moment[k_triangle_batch];
+    double inertia[k_triangle_batch];
+
+    TriangleBatch() : size(0) {}
+
+    bool full() const { return size == k_triangle_batch; }
+
+    void add(const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+    {
+        x1[size] = p1.x();
+        y1[size] = p1.y();
+        z1[size] = p1.z();
+        x2[size] = p2.x();
+        y2[size] = p2.y();
+        z2[size] = p2.z();
+        x3[size] = p3.x();
+        y3[size] = p3.y();
+        z3[size] = p3.z();
+        size++;
+    }
+
+    // The terms of all the triangles, with the same operations in the
+    // same order as QVector3D does them, so each term is the same as
+    // for the triangle on its own. The volume and its moment are about
+    // the origin in the waterplane, normal is that of the waterplane
+    // and axis is along the waterplane.
+    void terms(const QVector3D& origin, const QVector3D& normal, float normal_length,
+               const QVector3D& axis)
+    {
+        float ox = origin.x();
+        float oy = origin.y();
+        float oz = origin.z();
+        float nx = normal.x();
+        float ny = normal.y();
+        float nz = normal.z();
+        float ux = axis.x();
+        float uy = axis.y();
+        float uz = axis.z();
+        // the loop has a fixed count, so it is vectorized at -O2 as
+        // well, the triangles after the last are zero
+        for (size_t i=size; i%k_triangle_block!=0; i++) {
+            x1[i] = y1[i] = z1[i] = 0;
+            x2[i] = y2[i] = z2[i] = 0;
+            x3[i] = y3[i] = z3[i] = 0;
+        }
+        for (size_t block=0; block<size; block+=k_triangle_block) {
+            for (size_t j=0; j<k_triangle_block; j++) {
+                size_t i = block + j;
+                float px1 = x1[i] - ox;
+                float py1 = y1[i] - oy;
+                float pz1 = z1[i] - oz;
+                float px2 = x2[i] - ox;
+                float py2 = y2[i] - oy;
+                float pz2 = z2[i] - oz;
+                float px3 = x3[i] - ox;
+                float py3 = y3[i] - oy;
+                float pz3 = z3[i] - oz;
+                float v = (px1 * (py2 * pz3 - pz2 * py3) + py1 * (pz2 * px3 - px2 * pz3)
+                           + pz1 * (px2 * py3 - py2 * px3)) / 6.0f;
+                float m = .75 * v;
+                volume[i] = v;
+                mx[i] = (px1 + px2 + px3) / 3.0f * m;
+                my[i] = (py1 + py2 + py3) / 3.0f * m;
+                mz[i] = (pz1 + pz2 + pz3) / 3.0f * m;
+                float ax = 0.5 * ((py1 - py2) * (pz1 + pz2) + (py2 - py3) * (pz2 + pz3)
+                                  + (py3 - py1) * (pz3 + pz1));
+                float ay = 0.5 * ((pz1 - pz2) * (px1 + px2) + (pz2 - pz3) * (px2 + px3)
+                                  + (pz3 - pz1) * (px3 + px1));
+                float az = 0.5 * ((px1 - px2) * (py1 + py2) + (px2 - px3) * (py2 + py3)
+                                  + (px3 - px1) * (py3 + py1));
+                wetted_squared[i] = ax * ax + ay * ay + az * az;
+                float ex1 = px2 - px1;
+                float ey1 = py2 - py1;
+                float ez1 = pz2 - pz1;
+                float ex2 = px3 - px1;
+                float ey2 = py3 - py1;
+                float ez2 = pz3 - pz1;
+                double a = 0.5 * ((ey1 * ez2 - ez1 * ey2) * nx + (ez1 * ex2 - ex1 * ez2) * ny
+                                  + (ex1 * ey2 - ey1 * ex2) * nz) / normal_length;
+                double u1 = (px1 + ox) * ux + (py1 + oy) * uy + (pz1 + oz) * uz;
+                double u2 = (px2 + ox) * ux + (py2 + oy) * uy + (pz2 + oz) * uz;
+                double u3 = (px3 + ox) * ux + (py3 + oy) * uy + (pz3 + oz) * uz;
+                double su = u1 + u2 + u3;
+                area[i] = a;
+                moment[i] = a * su / 3;
+                inertia[i] = a * (u1 * u1 + u2 * u2 + u3 * u3 + su * su) / 12;
+            }
+        }
+    }
+};
+
 /*! \brief calculate the volume of underwater body
  */
 struct VolumeCalc
@@ -686,32 +804,73 @@ struct VolumeCalc
     float SinHeel;
     bool first_submerged_point;
     bool first_point;
-    HydrostaticCalc* hydro_calc;
+    ShipCADModel* owner;
+    const HydrostaticMesh& mesh;
     HydrostaticsData& data;
+    vector<hydrostatics_error_t>& errors;
+    // the waterplane from the submerged hull, for balancing
+    QVector3D wl_axis;
+    double wl_area;
+    double wl_moment;
+    double wl_inertia;
+    QVector3D buoyancy;
+    // points of the face being clipped, and of its mirror image
+    vector<QVector3D> points;
+    vector<QVector3D> mirrored_points;
+    bool submerged;
+    // distance of each point of the mesh to the waterline
+    vector<float> port_side;
+    vector<float> starboard_side;
+    // volume in bins along the hull, for the sectional area curve
+    vector<double> sac_bins;
+    float sac_start;
+    float sac_width;
+    QVector3D sac_axis;
+    vector<QVector3D> slab;
+    vector<QVector3D> slab_clipped;
+    // the submerged triangles not yet in the sums
+    TriangleBatch batch;
+    QVector3D wl_normal;
+    float wl_normal_length;
 
-	VolumeCalc(const Plane& wl, HydrostaticCalc* hc)
+	VolumeCalc(const Plane& wl, ShipCADModel* o, const HydrostaticMesh& m,
+               float heeling_angle, float trim_angle,
+			   HydrostaticsData& d, vector<hydrostatics_error_t>& e)
 		: first_submerged_point(true), first_point(true),
-		  hydro_calc(hc), data(hc->getData())
+		  owner(o), mesh(m), data(d), errors(e), wl_area(0), wl_moment(0), wl_inertia(0),
+		  sac_start(0), sac_width(0)
 		{
 			data.waterline_plane = wl;
-			CosHeel = cos(DegToRad(-hc->getHeelingAngle()));
-			SinHeel = sin(DegToRad(-hc->getHeelingAngle()));
-			CosTrim = cos(DegToRad(-hc->getTrimAngle()));
-			SinTrim = sin(DegToRad(-hc->getTrimAngle()));
-            keel = QVector3D(0, 0, hc->getOwner()->findLowestHydrostaticsPoint());
+            // longitudinal direction in the waterplane
+            QVector3D normal(wl.a(), wl.b(), wl.c());
+            normal.normalize();
+            wl_axis = QVector3D(1, 0, 0) - normal.x() * normal;
+            wl_axis.normalize();
+            // across the hull in the waterplane, square to the stations
+            sac_axis = QVector3D(0, normal.z(), -normal.y());
+            sac_axis.normalize();
+            wl_normal = QVector3D(wl.a(), wl.b(), wl.c());
+            wl_normal_length = wl_normal.length();
+			CosHeel = cos(DegToRad(-heeling_angle));
+			SinHeel = sin(DegToRad(-heeling_angle));
+			CosTrim = cos(DegToRad(-trim_angle));
+			SinTrim = sin(DegToRad(-trim_angle));
+            keel = QVector3D(0, 0, mesh.getLowestPoint());
             // in order to calculate the volume enclosed by the underwatership correctly
             // the origin(0,0,0) is projected onto the waterline plane
 			new_origin = data.waterline_plane.projectPointOnPlane(ZERO);
 			data.absolute_draft = 1000;
 		}
+
+    bool hasError(hydrostatics_error_t error) const
+    {
+        return find(errors.begin(), errors.end(), error) != errors.end();
+    }
 	
     // rotate a point at heel=0 and trim=0 position to given trim and heel
     QVector3D RotatePoint(QVector3D p)
     {
-        p.setZ(p.z() - keel.z());
-        return QVector3D(p.x() * CosTrim + p.y() * SinHeel * SinTrim + p.z() * CosHeel * SinTrim,
-                         p.y() * CosHeel - p.z() * SinHeel,
-                         -p.x() * SinTrim + p.y() * SinHeel * CosTrim + p.z() * CosHeel * CosTrim);
+        return RotatePointTo(p, keel.z(), CosTrim, SinTrim, CosHeel, SinHeel);
     }
 
     void CheckSubmergedBody(QVector3D p, float side)
@@ -737,147 +896,215 @@ struct VolumeCalc
         }
     }
 
-    void ProcessTriangle(QVector3D p1, QVector3D p2, QVector3D p3)
+    // divide the length from start to end into bins, the volume in each
+    // is found with the total volume
+    void SetSACBins(size_t bins, float start, float end)
     {
-        QVector3D volume_moment;
-        // reposition points with respect to the new projected origin
-        p1 -= new_origin;
-        p2 -= new_origin;
-        p3 -= new_origin;
-        QVector3D center = (p1 + p2 + p3) / 3.0f;
-        float volume = QVector3D::dotProduct(p1, QVector3D::crossProduct(p2, p3)) / 6.0f;
-        if (volume != 0) {
-            volume_moment = .75 * volume * center;
-            data.volume += volume;
-            data.center_of_buoyancy += volume_moment;
+        sac_bins.clear();
+        if (bins == 0 || end <= start)
+            return;
+        sac_bins.assign(bins, 0.0);
+        sac_start = start;
+        sac_width = (end - start) / bins;
+    }
+
+    // Add the part of a triangle in each bin to the volume of the bin.
+    // The field (e.p)e, with e across the hull in the waterplane, has a
+    // divergence of 1 and no flux through the waterplane or a station,
+    // so the volume between two stations is its flux through the hull
+    // between them, whatever the heel and trim.
+    void AddToSACBins(const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+    {
+        int last_bin = static_cast<int>(sac_bins.size()) - 1;
+        float lo = min(p1.x(), min(p2.x(), p3.x()));
+        float hi = max(p1.x(), max(p2.x(), p3.x()));
+        int first = static_cast<int>(floor((lo - sac_start) / sac_width));
+        int last = static_cast<int>(floor((hi - sac_start) / sac_width));
+        first = max(0, min(first, last_bin));
+        last = max(0, min(last, last_bin));
+        for (int i=first; i<=last; i++) {
+            slab.clear();
+            slab.push_back(p1);
+            slab.push_back(p2);
+            slab.push_back(p3);
+            // the end bins take anything beyond them
+            if (i > 0) {
+                ClipToStation(slab, sac_start + i * sac_width, true, slab_clipped);
+                slab.swap(slab_clipped);
+            }
+            if (i < last_bin) {
+                ClipToStation(slab, sac_start + (i + 1) * sac_width, false, slab_clipped);
+                slab.swap(slab_clipped);
+            }
+            double volume = 0;
+            for (size_t l=2; l<slab.size(); l++) {
+                QVector3D normal = QVector3D::crossProduct(slab[l-1] - slab[0], slab[l] - slab[0]);
+                float u = QVector3D::dotProduct(slab[0] + slab[l-1] + slab[l], sac_axis);
+                volume += QVector3D::dotProduct(normal, sac_axis) * u / 6.0;
+            }
+            sac_bins[i] += volume;
         }
-        float ax = 0.5 * ((p1.y() - p2.y()) * (p1.z() + p2.z()) + (p2.y() - p3.y()) * (p2.z() + p3.z())
-                          + (p3.y() - p1.y()) * (p3.z() + p1.z()));
-        float ay = 0.5 * ((p1.z() - p2.z()) * (p1.x() + p2.x()) + (p2.z() - p3.z()) * (p2.x() + p3.x())
-                          + (p3.z() - p1.z()) * (p3.x() + p1.x()));
-        float az = 0.5 * ((p1.x() - p2.x()) * (p1.y() + p2.y()) + (p2.x() - p3.x()) * (p2.y() + p3.y())
-                          + (p3.x() - p1.x()) * (p3.y() + p1.y()));
-        data.wetted_surface += sqrt(ax * ax + ay * ay + az * az);
+    }
+
+    // the sectional areas from the bins, at the middle of each
+    void SectionalAreas(vector<QVector2D>& sac) const
+    {
+        for (size_t i=0; i<sac_bins.size(); i++) {
+            float area = sac_bins[i] / sac_width;
+            if (area != 0)
+                sac.push_back(QVector2D(sac_start + (i + .5f) * sac_width, area));
+        }
+    }
+
+    // Add the terms of the triangles in the batch to the sums, one
+    // triangle at a time in the order they were clipped: by face, a
+    // face before its mirror image, and in fan order within each. That
+    // is the order the faces were integrated in one at a time, so the
+    // sums are the same to the last bit, whatever the size of a batch.
+    void IntegrateBatch()
+    {
+        batch.terms(new_origin, wl_normal, wl_normal_length, wl_axis);
+        for (size_t i=0; i<batch.size; i++) {
+            if (sac_bins.size() > 0)
+                AddToSACBins(QVector3D(batch.x1[i], batch.y1[i], batch.z1[i]),
+                             QVector3D(batch.x2[i], batch.y2[i], batch.z2[i]),
+                             QVector3D(batch.x3[i], batch.y3[i], batch.z3[i]));
+            if (batch.volume[i] != 0) {
+                data.volume += batch.volume[i];
+                data.center_of_buoyancy += QVector3D(batch.mx[i], batch.my[i], batch.mz[i]);
+            }
+            data.wetted_surface += sqrt(batch.wetted_squared[i]);
+            // the waterplane closes the submerged hull, its area and moments
+            // are those of the hull projected on it with the sign reversed
+            wl_area -= batch.area[i];
+            wl_moment -= batch.moment[i];
+            wl_inertia -= batch.inertia[i];
+        }
+        batch.size = 0;
+    }
+
+    void AddTriangle(const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+    {
+        if (batch.full())
+            IntegrateBatch();
+        batch.add(p1, p2, p3);
+    }
+
+    // the part of an edge on or under the waterline, where it crosses
+    // the waterline and its end point, true if that is submerged
+    bool ClipEdge(const QVector3D& p1, const QVector3D& p2, float side1, float side2,
+                  vector<QVector3D>& clipped)
+    {
+        if ((side1 < -1e-5 && side2 > 1e-5) || (side1 > 1e-5 && side2 < -1e-5)) {
+            // the current linesegment between p1-p2 intersects the waterline plane
+            float parameter = -side1 / (side2 - side1);
+            QVector3D p = p1 + parameter * (p2 - p1);
+            CheckSubmergedBody(p, 0);
+            clipped.push_back(p);
+        }
+        if (side2 <= 1e-5) {
+            if (side2 < data.absolute_draft)
+                data.absolute_draft = side2;
+            // p2 lies also on or under the waterlineplane
+            CheckSubmergedBody(p2, side2);
+            clipped.push_back(p2);
+        }
+        return side2 < -1e-5;
+    }
+
+    // clip a face and its mirror image to the waterline in one pass
+    // over its points, and fan the submerged parts into triangles
+    void ClipFace(size_t face)
+    {
+        size_t first = mesh.firstPoint(face);
+        size_t count = mesh.numberOfPoints(face);
+        bool mirror = mesh.isSymmetric(face);
+        const vector<float>& x = mesh.getX();
+        const vector<float>& y = mesh.getY();
+        const vector<float>& z = mesh.getZ();
+        // nothing to do for a face above the water
+        size_t above = 0;
+        while (above < count && port_side[first + above] > 1e-5
+               && (!mirror || starboard_side[first + above] > 1e-5))
+            above++;
+        if (above == count)
+            return;
+        points.clear();
+        mirrored_points.clear();
+        // the first submerged leak point on each side
+        size_t port_leak = count;
+        size_t starboard_leak = count;
+        size_t last = first + count - 1;
+        QVector3D p1(x[last], y[last], z[last]);
+        QVector3D m1(x[last], -y[last], z[last]);
+        float side1 = port_side[last];
+        float mside1 = starboard_side[last];
+        for (size_t l=0; l<count; l++) {
+            size_t index = first + l;
+            QVector3D p2(x[index], y[index], z[index]);
+            float side2 = port_side[index];
+            if (ClipEdge(p1, p2, side1, side2, points) && port_leak == count
+                && mesh.isLeakPoint(index))
+                port_leak = l;
+            p1 = p2;
+            side1 = side2;
+            if (mirror) {
+                QVector3D m2(x[index], -y[index], z[index]);
+                float mside2 = starboard_side[index];
+                if (ClipEdge(m1, m2, mside1, mside2, mirrored_points)
+                    && starboard_leak == count && mesh.isLeakPoint(index))
+                    starboard_leak = l;
+                m1 = m2;
+                mside1 = mside2;
+            }
+        }
+        // the model is making water, the leak is the first found on the
+        // port side, then on the starboard side
+        size_t leak = port_leak < count ? port_leak : starboard_leak;
+        if (leak < count && !hasError(feMakingWater)) {
+            errors.push_back(feMakingWater);
+            data.leak = mesh.getPoint(first + leak);
+        }
+
+        if (points.size() > 2)
+            submerged = true;
+        for (size_t l=3; l<=points.size(); l++)
+            AddTriangle(points[0], points[l-2], points[l-1]);
+        // the mirror image is turned the other way
+        for (size_t l=3; l<=mirrored_points.size(); l++)
+            AddTriangle(mirrored_points[0], mirrored_points[l-1], mirrored_points[l-2]);
+    }
+
+    // the faces from begin up to end, the distances of their points
+    // have to be in port_side and starboard_side
+    void ProcessFaces(size_t begin, size_t end)
+    {
+        for (size_t i=begin; i<end; i++)
+            ClipFace(i);
+        IntegrateBatch();
     }
 
     void run() {
-		QVector3D p, p1, p2, p3;
-		bool submerged = false;
-        float side1, side2, parameter;
-        vector<QVector3D> points;
-        for (size_t i=0; i<hydro_calc->getOwner()->getSurface()->numberOfLayers(); i++) {
-            SubdivisionLayer* layer = hydro_calc->getOwner()->getSurface()->getLayer(i);
-            if (!layer->useInHydrostatics()) continue;
-            for (size_t j=0; j<layer->numberOfFaces(); j++) {
-                SubdivisionControlFace* face = layer->getFace(j);
-                for (size_t k=0; k<face->numberOfChildren(); k++) {
-                    SubdivisionFace* child = face->getChild(k);
-                    // calculate the portside of the model
-                    points.clear();
-                    p1 = child->getPoint(child->numberOfPoints()-1)->getCoordinate();
-                    // calculate on which side of the waterplane this point is
-                    side1 = data.waterline_plane.distance(p1);
-                    for (size_t l=0; l<child->numberOfPoints(); l++) {
-                        p2 = child->getPoint(l)->getCoordinate();
-                        side2 = data.waterline_plane.distance(p2);
-                        if ((side1 < -1e-5 && side2 > 1e-5) || (side1 > 1e-5 && side2 < -1e-5)) {
-                            // the current linesegment between p1-p2 intersects the waterline plane
-                            if (side1 == side2)
-                                parameter = .5 * (side1 + side2);
-                            else
-                                parameter = -side1 / (side2 - side1);
-                            p = p1 + parameter * (p2 - p1);
-                            CheckSubmergedBody(p, 0);
-                            points.push_back(p);
-                        }
-                        if (side2 <= 1e-5) {
-                            if (side2 < data.absolute_draft)
-                                data.absolute_draft = side2;
-                            // p2 lies also on or under the waterlineplane
-                            if (side2 < -1e-5) {
-                                // point is submerged, check if the model is making water
-                                if (child->getPoint(l)->isBoundaryVertex() && fabs(child->getPoint(l)->getCoordinate().y()) > 1e-4) {
-                                    if (!hydro_calc->hasError(feMakingWater)) {
-                                        hydro_calc->addError(feMakingWater);
-                                        data.leak = child->getPoint(l)->getCoordinate();
-                                    }
-                                }
-                            }
-                            CheckSubmergedBody(p2, side2);
-                            points.push_back(p2);
-                        }
-                        p1 = p2;
-                        side1 = side2;
-                    } // end of child face point loop
-
-                    // calculate volume aft of this face
-                    if (points.size() > 2)
-                        submerged = true;
-                    for (size_t l=3; l<=points.size(); l++)
-                        ProcessTriangle(points[0], points[l-2], points[l-1]);
-                    if (layer->isSymmetric()) {
-                        // calculate the starboard side of the model
-                        points.clear();
-                        p1 = child->getPoint(child->numberOfPoints()-1)->getCoordinate();
-                        p1.setY(-p1.y());
-                        // calculate on which side of the waterplane this point is
-                        side1 = data.waterline_plane.distance(p1);
-                        for (size_t l=0; l<child->numberOfPoints(); l++) {
-                            p2 = child->getPoint(l)->getCoordinate();
-                            p2.setY(-p2.y());
-                            side2 = data.waterline_plane.distance(p2);
-                            if ((side1 < -1e-5 && side2 > 1e-5) || (side1 > 1e-5 && side2 < -1e-5)) {
-                                // the current linesegment between p1-p2 intersects the waterline plane
-                                if (side1 == side2)
-                                    parameter = .5 * (side1 + side2);
-                                else
-                                    parameter = -side1 / (side2 - side1);
-                                p = p1 + parameter * (p2 - p1);
-                                CheckSubmergedBody(p, 0);
-                                points.push_back(p);
-                            }
-                            if (side2 <= 1e-5) {
-                                if (side2 < data.absolute_draft)
-                                    data.absolute_draft = side2;
-                                // p2 lies also on or under the waterlineplane
-                                if (side2 < -1e-5) {
-                                    // point is submerged, check if the model is making water
-                                    if (child->getPoint(l)->isBoundaryVertex() && fabs(child->getPoint(l)->getCoordinate().y()) > 1e-4) {
-                                        if (!hydro_calc->hasError(feMakingWater)) {
-                                            hydro_calc->addError(feMakingWater);
-                                            data.leak = child->getPoint(l)->getCoordinate();
-                                        }
-                                    }
-                                }
-                                CheckSubmergedBody(p2, side2);
-                                points.push_back(p2);
-                            }
-                            p1 = p2;
-                            side1 = side2;
-                        } // end of face point loop
-                        // calculate volume aft of this face
-                        for (size_t l=3; l<=points.size(); l++)
-                            ProcessTriangle(points[0], points[l-1], points[l-2]);
-                    } // end of symmetric face if
-                } // end of face loop
-            } // end of subdiv control face loop
-        } // end of layers
+        submerged = false;
+        PlaneDistances(data.waterline_plane, mesh, port_side, starboard_side);
+        ProcessFaces(0, mesh.numberOfFaces());
 
         data.absolute_draft = -data.absolute_draft;
         if (first_point) {
             // no intersection with the watersurface found, the ship is either
             // not submerged or totally submerged
             if (!submerged) {
-                hydro_calc->addError(feNothingSubmerged);
+                errors.push_back(feNothingSubmerged);
                 data.absolute_draft = 0;
             }
         }
-        if (hydro_calc->hasError(feMakingWater)) {
+        if (hasError(feMakingWater)) {
             data.volume = 0;
             data.center_of_buoyancy = ZERO;
+            sac_bins.assign(sac_bins.size(), 0.0);
         }
 
-		ProjectSettings& ps = hydro_calc->getOwner()->getProjectSettings();
+		ProjectSettings& ps = owner->getProjectSettings();
 
 		data.displacement = VolumeToDisplacement(data.volume,
 												 ps.getWaterDensity(),
@@ -888,6 +1115,7 @@ struct VolumeCalc
         if (data.volume != 0) {
             // translate center of buoyancy back to the original origin
             data.center_of_buoyancy = new_origin + data.center_of_buoyancy / data.volume;
+            buoyancy = data.center_of_buoyancy;
             data.center_of_buoyancy = RotatePoint(data.center_of_buoyancy);
             if (data.length_waterline != 0) {
                 data.lcb_perc = 100 * (data.center_of_buoyancy.x() - ps.getMainframeLocation()) / data.length_waterline;
@@ -898,6 +1126,221 @@ struct VolumeCalc
     }
 };
 
+// what a balance needs from a volume calculation besides the volume
+struct BalanceProperties
+{
+    float waterplane_area;
+    float waterplane_inertia;   // longitudinal, about the center of floatation
+    QVector3D axis;             // longitudinal direction in the waterplane
+    QVector3D buoyancy;         // center of buoyancy, not turned to trim and heel
+};
+
+// the volume below a waterline plane, as HydrostaticCalc::calculateVolume
+static void CalculateVolume(ShipCADModel* owner, const HydrostaticMesh& mesh,
+                            float heeling_angle, float trim_angle,
+                            const Plane& waterline_plane, HydrostaticsData& data,
+                            vector<hydrostatics_error_t>& errors, BalanceProperties& props)
+{
+    data.clear();
+    errors.clear();
+    VolumeCalc vc(waterline_plane, owner, mesh, heeling_angle, trim_angle, data, errors);
+    vc.run();
+    props.waterplane_area = vc.wl_area;
+    props.waterplane_inertia = 0;
+    if (vc.wl_area > 0)
+        props.waterplane_inertia = vc.wl_inertia - vc.wl_moment * vc.wl_moment / vc.wl_area;
+    props.axis = vc.wl_axis;
+    props.buoyancy = vc.buoyancy;
+}
+
+// Find the waterline plane where the hull has a displacement, at a
+// heeling angle and trim. The model is only read, the volume
+// calculated last is left in data and errors, so balances with their
+// own data and errors can run at the same time.
+//
+// The draft is found by Newton's method, the waterplane area is the
+// rate of change of the volume with draft. A step outside the drafts
+// known to be too deep and too shallow interpolates between them
+// instead. When free to trim, the trim angle is changed until the
+// center of buoyancy is above the center of gravity, first from the
+// longitudinal metacentric radius and then from the last two trims.
+static bool BalanceWaterline(ShipCADModel* owner, const HydrostaticMesh& mesh,
+                             float heeling_angle, float& trim,
+                             float displacement, bool freetotrim,
+                             const QVector3D& center_of_gravity,
+                             HydrostaticsData& data, vector<hydrostatics_error_t>& errors,
+                             CrosscurvesData& output, int& volume_evaluations,
+                             int& trim_iterations)
+{
+    bool result = false;
+	int max_iterations = 25;
+    float max_error = 5e-4f;
+    float max_trim_error = 1e-4f;
+    float max_trim_step = 10.0f;
+	float cos_heel = cos(DegToRad(-heeling_angle));
+	float sin_heel = sin(DegToRad(-heeling_angle));
+	float cos_trim;
+	float sin_trim;
+    float error = 0;
+    float prev_trim_angle = 0;
+    float prev_trim_error = 0;
+	Plane wlplane;
+	MinMaxData mmd;
+	DraftData min_draft;
+	DraftData max_draft;
+	DraftData curr_draft;
+    BalanceProperties props;
+	data.clear();
+    errors.clear();
+    output.clear();
+    volume_evaluations = 0;
+    trim_iterations = 0;
+
+    if (displacement == 0)
+        return true;
+
+    ProjectSettings& ps = owner->getProjectSettings();
+    float length = ps.getLength();
+    float trim_angle = TrimAngle(length, trim, heeling_angle);
+    do {
+		trim_iterations++;
+        // the trim angle is negative bow down, as for the volume
+        cos_trim = cos(DegToRad(-trim_angle));
+        sin_trim = sin(DegToRad(-trim_angle));
+        CalculateMinMaxData(mmd, mesh, wlplane, cos_trim, sin_trim,
+                            cos_heel, sin_heel);
+		min_draft.draft = 0;
+		min_draft.displ = 0;
+		max_draft.draft = mmd.max_draft;
+		wlplane = CalculateWaterlinePlane(max_draft.draft, mmd);
+		CalculateVolume(owner, mesh, heeling_angle, trim_angle, wlplane, data, errors, props);
+        volume_evaluations++;
+		max_draft.displ = data.displacement;
+        if (displacement > 1.005 * max_draft.displ) {
+			errors.push_back(feNotEnoughBuoyancy);
+            break;
+        }
+        curr_draft.draft = DisplInterpolate(displacement, min_draft.displ, min_draft.draft,
+                                            max_draft.displ, max_draft.draft);
+        bool found = false;
+        for (int i=0; i<max_iterations && !found; i++) {
+            wlplane = CalculateWaterlinePlane(curr_draft.draft, mmd);
+            CalculateVolume(owner, mesh, heeling_angle, trim_angle, wlplane, data, errors, props);
+            volume_evaluations++;
+            curr_draft.displ = data.displacement;
+            if (displacement < 0.1)
+                error = fabs(displacement - curr_draft.displ);
+            else
+                error = fabs((displacement - curr_draft.displ) / displacement);
+            if (error <= max_error) {
+                found = true;
+                break;
+            }
+            if (curr_draft.displ < displacement)
+                min_draft = curr_draft;
+            else
+                max_draft = curr_draft;
+            float slope = VolumeToDisplacement(props.waterplane_area, ps.getWaterDensity(),
+                                               ps.getAppendageCoefficient(), ps.getUnits());
+            float next = -1;
+            if (slope > 0)
+                next = curr_draft.draft + (displacement - curr_draft.displ) / slope;
+            if (!(next > min_draft.draft && next < max_draft.draft))
+                next = DisplInterpolate(displacement, min_draft.displ, min_draft.draft,
+                                        max_draft.displ, max_draft.draft);
+            if (fabs(next - curr_draft.draft) < 1e-6)
+                break;
+            curr_draft.draft = next;
+        }
+        if (!found)
+            break;
+        if (!freetotrim) {
+            result = true;
+            break;
+        }
+        // distance of the center of buoyancy ahead of the center of gravity
+        float trim_error = QVector3D::dotProduct(props.buoyancy - center_of_gravity, props.axis);
+        if (fabs(trim_error) <= max_trim_error * length) {
+            result = true;
+            break;
+        }
+        float step;
+        if (trim_iterations > 1 && trim_error != prev_trim_error)
+            step = -trim_error * (trim_angle - prev_trim_angle) / (trim_error - prev_trim_error);
+        else if (data.volume > 0 && props.waterplane_inertia > 0)
+            step = RadToDeg(trim_error / (props.waterplane_inertia / data.volume));
+        else
+            break;
+        if (step > max_trim_step)
+            step = max_trim_step;
+        else if (step < -max_trim_step)
+            step = -max_trim_step;
+        prev_trim_angle = trim_angle;
+        prev_trim_error = trim_error;
+        trim_angle += step;
+	} while (trim_iterations <= max_iterations);
+	if (result) {
+        output.waterline_plane = data.waterline_plane;
+        output.absolute_draft = data.absolute_draft;
+        output.volume = data.volume;
+        output.displacement = data.displacement;
+        output.center_of_buoyancy = data.center_of_buoyancy;
+		if (fabs(heeling_angle) < 1e-5)
+            output.center_of_buoyancy.setY(0.0);
+        // the center of buoyancy is turned with the heel, measured
+        // from the keel, so across the ship it is the lever arm
+        output.kn_sin_phi = output.center_of_buoyancy.y();
+        if (freetotrim)
+            trim = -tan(DegToRad(trim_angle)) * length / cos(DegToRad(heeling_angle));
+	}
+	return result;
+}
+
+bool HydrostaticCalc::balance(float displacement, bool freetotrim,
+                              CrosscurvesData& output)
+{
+    if (displacement == 0)
+        return true;
+
+    if (!_owner->isBuild())
+        _owner->rebuildModel(true);
+
+    setCalculated(false);
+    const HydrostaticMesh& mesh = _owner->getHydrostaticMesh();
+    HydrostaticsCache& cache = _owner->getHydrostaticsCache();
+    HydrostaticsBalanceKey key;
+    key.revision = mesh.getRevision();
+    key.settings = HydrostaticsSettings(_owner->getProjectSettings());
+    key.displacement = displacement;
+    key.heeling_angle = _heeling_angle;
+    key.trim = _trim;
+    key.free_to_trim = freetotrim;
+    if (freetotrim)
+        key.center_of_gravity = _center_of_gravity;
+    HydrostaticsBalanceResult found;
+    if (cache.findBalance(key, found)) {
+        _trim = found.trim;
+        _data = found.data;
+        _errors = found.errors;
+        output = found.output;
+        _volume_evaluations = 0;
+        _trim_iterations = 0;
+        setCalculated(true);
+        return found.balanced;
+    }
+    found.balanced = BalanceWaterline(_owner, mesh, _heeling_angle, _trim,
+                                      displacement, freetotrim,
+                                      _center_of_gravity, _data, _errors, output,
+                                      _volume_evaluations, _trim_iterations);
+    found.trim = _trim;
+    found.output = output;
+    found.data = _data;
+    found.errors = _errors;
+    cache.addBalance(key, found);
+    setCalculated(true);
+    return found.balanced;
+}
+
 // used in calculate
 struct StationAreaCalculation
 {
@@ -927,33 +1370,48 @@ void HydrostaticCalc::calculate()
     if (!_owner->isBuild())
         _owner->rebuildModel(true);
 
+    // the same calculation on the same faces was done before
+    const HydrostaticMesh& mesh = _owner->getHydrostaticMesh();
+    HydrostaticsCache& cache = _owner->getHydrostaticsCache();
+    HydrostaticsCalculationKey key;
+    key.revision = mesh.getRevision();
+    key.settings = HydrostaticsSettings(_owner->getProjectSettings());
+    key.draft = _draft;
+    key.trim = _trim;
+    key.heeling_angle = _heeling_angle;
+    key.calculations = _calculations;
+    sort(key.calculations.begin(), key.calculations.end());
+    key.calculations.erase(unique(key.calculations.begin(), key.calculations.end()),
+                           key.calculations.end());
+    key.sac_resolution = _sac_resolution;
+    if (_sac_resolution == 0 && (hasCalculation(hcSAC) || hasCalculation(hcAll))) {
+        for (size_t i=0; i<_owner->getStations().size(); i++)
+            key.stations.push_back(-_owner->getStations().get(i)->getPlane().d());
+    }
+    if (cache.findCalculation(key, _data, _errors)) {
+        setCalculated(true);
+        return;
+    }
+
     // calculate overall extents of the hull alone
-    for (size_t i=0; i<_owner->getSurface()->numberOfLayers(); i++) {
-        SubdivisionLayer* layer = _owner->getSurface()->getLayer(i);
-        if (layer->useInHydrostatics()) {
-            for (size_t j=0; j<layer->numberOfFaces(); j++) {
-                SubdivisionControlFace* face = layer->getFace(j);
-                for (size_t k=0; k<face->numberOfChildren(); k++) {
-                    SubdivisionFace* child = face->getChild(k);
-                    for (size_t l=0; l<child->numberOfPoints(); l++) {
-                        p2 = child->getPoint(l)->getCoordinate();
-                        if (first_point) {
-                            _data.model_min = p2;
-                            _data.model_max = p2;
-                            first_point = false;
-                        } else {
-                            MinMax(p2, _data.model_min, _data.model_max);
-                        }
-                    }
-                }
-            }
+    for (size_t i=0; i<mesh.numberOfPoints(); i++) {
+        p2 = mesh.getPoint(i);
+        if (first_point) {
+            _data.model_min = p2;
+            _data.model_max = p2;
+            first_point = false;
+        } else {
+            MinMax(p2, _data.model_min, _data.model_max);
         }
     }
 
     // setup volume calculation using our waterline plane
-	VolumeCalc vc(getWlPlane(), this);
-	vc.run();
-	
+    VolumeCalc vc(getWlPlane(), _owner, mesh, _heeling_angle, getTrimAngle(), _data, _errors);
+    // the sectional areas can be found in the same pass
+    if (_sac_resolution > 0 && (hasCalculation(hcSAC) || hasCalculation(hcAll)))
+        vc.SetSACBins(_sac_resolution, _data.model_min.x(), _data.model_max.x());
+    vc.run();
+
     ProjectSettings& ps = _owner->getProjectSettings();
 
     float submerged_length = _data.sub_max.x() - _data.sub_min.x();
@@ -1037,7 +1495,9 @@ void HydrostaticCalc::calculate()
 
     // calculate sectional areas
     if (hasCalculation(hcSAC) || hasCalculation(hcAll)) {
-        if (_owner->getStations().size()) {
+        if (_sac_resolution > 0) {
+            vc.SectionalAreas(_data.sac);
+        } else if (_owner->getStations().size()) {
             StationAreaCalculation sac(_data, _owner);
             for_each(_owner->getStations().begin(), _owner->getStations().end(), sac);
         }
@@ -1051,6 +1511,7 @@ void HydrostaticCalc::calculate()
     }
 
     // all done!
+    cache.addCalculation(key, _data, _errors);
     setCalculated(true);
 }
 
@@ -1062,8 +1523,677 @@ void HydrostaticCalc::calculateVolume(const Plane& waterline_plane)
     if (!_owner->isBuild())
         _owner->rebuildModel(true);
 
-	VolumeCalc vc(waterline_plane, this);
+	VolumeCalc vc(waterline_plane, _owner, _owner->getHydrostaticMesh(), _heeling_angle,
+                  getTrimAngle(), _data, _errors);
 	vc.run();
 
 	setCalculated(true);
 }
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+// a triangle of the hull in the waterplane frame, x and y along the
+// waterplane and z the height above the origin
+struct CurveTriangle
+{
+    QVector3D p[3];
+    float zmin;
+    float zmax;
+};
+
+// orders triangles on their highest point
+struct CurveTriangleTopLess
+{
+    bool operator()(const CurveTriangle& a, const CurveTriangle& b) const
+        { return a.zmax < b.zmax; }
+};
+
+// a point of the hull, for the extents of the submerged body
+struct CurvePoint
+{
+    float height;
+    QVector3D rotated;          // at trim and heel, as the results are given
+};
+
+// orders points on their height
+struct CurvePointLess
+{
+    bool operator()(const CurvePoint& a, const CurvePoint& b) const
+        { return a.height < b.height; }
+};
+
+// a boundary point off the centerplane, the hull makes water if it is submerged
+struct CurveLeak
+{
+    float height;
+    QVector3D coordinate;
+};
+
+// Integrals over triangles in the waterplane frame. The volume below
+// a waterline at height t is the flux of (z-t) along z through the
+// hull, the waterplane adds nothing to it. Its moments follow the same
+// way, all are polynomials in t of these sums. The waterplane itself
+// is the hull projected on it, with the sign reversed. In double, they
+// are running totals over all the triangles.
+struct CurveSums
+{
+    double area_z;              // area projected on the waterplane
+    double x;                   // first moments of the projected area
+    double y;
+    double z;
+    double xx;                  // second moments of the projected area
+    double yy;
+    double xz;
+    double yz;
+    double zz;
+    double wetted;              // area of the triangles
+
+    CurveSums()
+        : area_z(0), x(0), y(0), z(0), xx(0), yy(0), xz(0), yz(0), zz(0), wetted(0)
+        {}
+
+    void add(const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+    {
+        QVector3D normal = 0.5f * QVector3D::crossProduct(p2 - p1, p3 - p1);
+        double a = normal.z();
+        double x1 = p1.x(), x2 = p2.x(), x3 = p3.x();
+        double y1 = p1.y(), y2 = p2.y(), y3 = p3.y();
+        double z1 = p1.z(), z2 = p2.z(), z3 = p3.z();
+        double sx = x1 + x2 + x3;
+        double sy = y1 + y2 + y3;
+        double sz = z1 + z2 + z3;
+        area_z += a;
+        x += a * sx / 3;
+        y += a * sy / 3;
+        z += a * sz / 3;
+        // the mean of f*g over a triangle, for f and g linear, is
+        // (f1*g1 + f2*g2 + f3*g3 + (f1+f2+f3)*(g1+g2+g3)) / 12
+        xx += a * (x1 * x1 + x2 * x2 + x3 * x3 + sx * sx) / 12;
+        yy += a * (y1 * y1 + y2 * y2 + y3 * y3 + sy * sy) / 12;
+        xz += a * (x1 * z1 + x2 * z2 + x3 * z3 + sx * sz) / 12;
+        yz += a * (y1 * z1 + y2 * z2 + y3 * z3 + sy * sz) / 12;
+        zz += a * (z1 * z1 + z2 * z2 + z3 * z3 + sz * sz) / 12;
+        wetted += normal.length();
+    }
+};
+
+// the part of a triangle on or below a height, as VolumeCalc clips the
+// faces, where the edges cross the waterline is added to crossings
+static void ClipTriangle(const CurveTriangle& triangle, float height,
+                         vector<QVector3D>& points, vector<QVector3D>& crossings)
+{
+    points.clear();
+    QVector3D p1 = triangle.p[2];
+    float side1 = p1.z() - height;
+    for (size_t l=0; l<3; l++) {
+        QVector3D p2 = triangle.p[l];
+        float side2 = p2.z() - height;
+        if ((side1 < -1e-5 && side2 > 1e-5) || (side1 > 1e-5 && side2 < -1e-5)) {
+            QVector3D p = p1 + (-side1 / (side2 - side1)) * (p2 - p1);
+            p.setZ(height);
+            crossings.push_back(p);
+            points.push_back(p);
+        }
+        if (side2 <= 1e-5)
+            points.push_back(p2);
+        p1 = p2;
+        side1 = side2;
+    }
+}
+
+HydrostaticCurves::HydrostaticCurves(ShipCADModel* owner)
+    : _owner(owner), _heeling_angle(0.0), _trim(0.0)
+{
+    // does nothing
+}
+
+void HydrostaticCurves::clear()
+{
+    _heeling_angle = 0.0;
+    _trim = 0.0;
+    _drafts.clear();
+    _table.clear();
+    _errors.clear();
+}
+
+void HydrostaticCurves::setHeelingAngle(float angle)
+{
+    if (angle != _heeling_angle) {
+        _heeling_angle = angle;
+        _drafts.clear();
+        _table.clear();
+        _errors.clear();
+    }
+}
+
+void HydrostaticCurves::setTrim(float trim)
+{
+    if (trim != _trim) {
+        _trim = trim;
+        _drafts.clear();
+        _table.clear();
+        _errors.clear();
+    }
+}
+
+bool HydrostaticCurves::hasError(size_t index, hydrostatics_error_t error) const
+{
+    const vector<hydrostatics_error_t>& errors = _errors.at(index);
+    return find(errors.begin(), errors.end(), error) != errors.end();
+}
+
+void HydrostaticCurves::calculate(const vector<float>& drafts)
+{
+    _drafts = drafts;
+    _table.resize(drafts.size());
+    _errors.assign(drafts.size(), vector<hydrostatics_error_t>());
+
+    if (!_owner->isBuild())
+        _owner->rebuildModel(true);
+
+    ProjectSettings& ps = _owner->getProjectSettings();
+    const HydrostaticMesh& mesh = _owner->getHydrostaticMesh();
+    float lowest = mesh.getLowestPoint();
+    float cos_heel = cos(DegToRad(-_heeling_angle));
+    float sin_heel = sin(DegToRad(-_heeling_angle));
+    float trim_angle = TrimAngle(ps.getLength(), _trim, _heeling_angle);
+    float cos_trim = cos(DegToRad(-trim_angle));
+    float sin_trim = sin(DegToRad(-trim_angle));
+
+    // the waterplanes at all drafts are parallel, z is the height along their normal
+    Plane base = WaterlinePlane(ps.getLength(), lowest, 0, _trim, _heeling_angle);
+    QVector3D ez(base.a(), base.b(), base.c());
+    QVector3D ex = QVector3D(1, 0, 0) - ez.x() * ez;
+    ex.normalize();
+    QVector3D ey = QVector3D::crossProduct(ez, ex);
+
+    // cut the hull into triangles, as VolumeCalc does with the submerged part of each face
+    vector<CurveTriangle> triangles;
+    vector<CurvePoint> points;
+    vector<CurveLeak> leaks;
+    vector<QVector3D> face;
+    QVector3D model_min, model_max;
+    bool first_point = true;
+    for (size_t i=0; i<mesh.numberOfFaces(); i++) {
+        size_t sides = mesh.isSymmetric(i) ? 2 : 1;
+        size_t first = mesh.firstPoint(i);
+        for (size_t side=0; side<sides; side++) {
+            face.clear();
+            for (size_t l=0; l<mesh.numberOfPoints(i); l++) {
+                QVector3D p = mesh.getPoint(first + l);
+                if (side == 0) {
+                    if (first_point) {
+                        model_min = model_max = p;
+                        first_point = false;
+                    } else {
+                        MinMax(p, model_min, model_max);
+                    }
+                }
+                QVector3D q = p;
+                if (side == 1)
+                    q.setY(-q.y());
+                face.push_back(QVector3D(QVector3D::dotProduct(q, ex),
+                                         QVector3D::dotProduct(q, ey),
+                                         QVector3D::dotProduct(q, ez)));
+                CurvePoint cp;
+                cp.height = face.back().z();
+                cp.rotated = RotatePointTo(q, lowest, cos_trim, sin_trim, cos_heel, sin_heel);
+                points.push_back(cp);
+                if (mesh.isLeakPoint(first + l)) {
+                    CurveLeak leak;
+                    leak.height = face.back().z();
+                    leak.coordinate = p;
+                    leaks.push_back(leak);
+                }
+            }
+            // the starboard side is wound the other way
+            for (size_t l=3; l<=face.size(); l++) {
+                CurveTriangle triangle;
+                triangle.p[0] = face[0];
+                triangle.p[1] = (side == 0) ? face[l-2] : face[l-1];
+                triangle.p[2] = (side == 0) ? face[l-1] : face[l-2];
+                triangle.zmin = min(face[0].z(), min(face[l-2].z(), face[l-1].z()));
+                triangle.zmax = max(face[0].z(), max(face[l-2].z(), face[l-1].z()));
+                triangles.push_back(triangle);
+            }
+        }
+    }
+
+    // running totals of the triangles in order of their highest point,
+    // those cut by a waterline are found through their height range
+    sort(triangles.begin(), triangles.end(), CurveTriangleTopLess());
+    vector<float> tops(triangles.size());
+    vector<float> bottoms(triangles.size());
+    vector<CurveSums> totals(triangles.size() + 1);
+    for (size_t i=0; i<triangles.size(); i++) {
+        tops[i] = triangles[i].zmax;
+        bottoms[i] = triangles[i].zmin;
+        totals[i+1] = totals[i];
+        totals[i+1].add(triangles[i].p[0], triangles[i].p[1], triangles[i].p[2]);
+    }
+    IntervalIndex cut;
+    cut.build(bottoms, tops);
+
+    // extents of the points up to each height
+    sort(points.begin(), points.end(), CurvePointLess());
+    vector<float> heights(points.size());
+    vector<QVector3D> points_min(points.size());
+    vector<QVector3D> points_max(points.size());
+    for (size_t i=0; i<points.size(); i++) {
+        heights[i] = points[i].height;
+        if (i == 0) {
+            points_min[i] = points_max[i] = points[i].rotated;
+        } else {
+            points_min[i] = points_min[i-1];
+            points_max[i] = points_max[i-1];
+            MinMax(points[i].rotated, points_min[i], points_max[i]);
+        }
+    }
+    float lowest_leak = 0;
+    for (size_t i=0; i<leaks.size(); i++)
+        if (i == 0 || leaks[i].height < lowest_leak)
+            lowest_leak = leaks[i].height;
+
+    vector<size_t> items;
+    vector<QVector3D> clipped;
+    vector<QVector3D> crossings;
+    for (size_t r=0; r<drafts.size(); r++) {
+        HydrostaticsData& data = _table[r];
+        vector<hydrostatics_error_t>& errors = _errors[r];
+        data.clear();
+        data.model_min = model_min;
+        data.model_max = model_max;
+        data.waterline_plane = WaterlinePlane(ps.getLength(), lowest, drafts[r], _trim,
+                                              _heeling_angle);
+        float t = -data.waterline_plane.d();
+
+        // triangles entirely below the waterline from the totals, the others clipped
+        size_t below = upper_bound(tops.begin(), tops.end(), t + 1e-5f) - tops.begin();
+        CurveSums sums = totals[below];
+        bool submerged = below > 0;
+        crossings.clear();
+        cut.query(t + 1e-5f, t + 1e-5f, items);
+        for (size_t i=0; i<items.size(); i++) {
+            if (items[i] < below)
+                continue;
+            ClipTriangle(triangles[items[i]], t, clipped, crossings);
+            if (clipped.size() > 2)
+                submerged = true;
+            for (size_t l=3; l<=clipped.size(); l++)
+                sums.add(clipped[0], clipped[l-2], clipped[l-1]);
+        }
+
+        // extents of the submerged body and the waterline
+        size_t wet = upper_bound(heights.begin(), heights.end(), t + 1e-5f) - heights.begin();
+        bool first_submerged_point = true;
+        bool first_wl_point = true;
+        if (wet > 0) {
+            data.sub_min = points_min[wet-1];
+            data.sub_max = points_max[wet-1];
+            first_submerged_point = false;
+            data.absolute_draft = t - heights[0];
+        }
+        for (size_t i=lower_bound(heights.begin(), heights.end(), t - 2e-5f) - heights.begin();
+             i<wet; i++) {
+            float side = heights[i] - t;
+            if (side > -1e-5 && side < 1e-5) {
+                if (first_wl_point) {
+                    data.wl_min = data.wl_max = points[i].rotated;
+                    first_wl_point = false;
+                } else {
+                    MinMax(points[i].rotated, data.wl_min, data.wl_max);
+                }
+            }
+        }
+        for (size_t i=0; i<crossings.size(); i++) {
+            QVector3D p = crossings[i].x() * ex + crossings[i].y() * ey + crossings[i].z() * ez;
+            p = RotatePointTo(p, lowest, cos_trim, sin_trim, cos_heel, sin_heel);
+            if (first_submerged_point) {
+                data.sub_min = data.sub_max = p;
+                first_submerged_point = false;
+            } else {
+                MinMax(p, data.sub_min, data.sub_max);
+            }
+            if (first_wl_point) {
+                data.wl_min = data.wl_max = p;
+                first_wl_point = false;
+            } else {
+                MinMax(p, data.wl_min, data.wl_max);
+            }
+        }
+
+        if (first_wl_point && !submerged) {
+            errors.push_back(feNothingSubmerged);
+            data.absolute_draft = 0;
+        }
+        if (!leaks.empty() && lowest_leak - t < -1e-5) {
+            // the first leak point in the order VolumeCalc finds them
+            for (size_t i=0; i<leaks.size(); i++) {
+                if (leaks[i].height - t < -1e-5) {
+                    errors.push_back(feMakingWater);
+                    data.leak = leaks[i].coordinate;
+                    break;
+                }
+            }
+        }
+
+        double volume = sums.z - t * sums.area_z;
+        double moment_x = sums.xz - t * sums.x;
+        double moment_y = sums.yz - t * sums.y;
+        double moment_z = 0.5 * (sums.zz - 2 * t * sums.z + t * t * sums.area_z) + t * volume;
+        data.wetted_surface = sums.wetted;
+        if (find(errors.begin(), errors.end(), feMakingWater) != errors.end())
+            volume = 0;
+        data.volume = volume;
+        data.displacement = VolumeToDisplacement(data.volume,
+                                                 ps.getWaterDensity(),
+                                                 ps.getAppendageCoefficient(),
+                                                 ps.getUnits());
+        data.length_waterline = data.wl_max.x() - data.wl_min.x();
+        data.beam_waterline = data.wl_max.y() - data.wl_min.y();
+        if (data.volume != 0) {
+            QVector3D center = (moment_x / volume) * ex + (moment_y / volume) * ey
+                + (moment_z / volume) * ez;
+            data.center_of_buoyancy = RotatePointTo(center, lowest, cos_trim, sin_trim,
+                                                    cos_heel, sin_heel);
+            if (data.length_waterline != 0)
+                data.lcb_perc = 100 * (data.center_of_buoyancy.x() - ps.getMainframeLocation())
+                    / data.length_waterline;
+            data.volume *= ps.getAppendageCoefficient();
+        }
+
+        // the waterplane closes the submerged hull
+        double area = -sums.area_z;
+        if (data.volume > 0 && errors.size() == 0 && area != 0) {
+            double cx = -sums.x / area;
+            double cy = -sums.y / area;
+            data.waterplane_area = area;
+            data.waterplane_cog = cx * ex + cy * ey + t * ez;
+            data.waterplane_mom_inertia = QVector2D(-sums.yy - cy * cy * area,
+                                                    -sums.xx - cx * cx * area);
+            if (ps.getBeam() * ps.getLength() != 0)
+                data.waterplane_coeff = data.waterplane_area / (ps.getBeam() * ps.getLength());
+            data.km_transverse = data.center_of_buoyancy.z()
+                + data.waterplane_mom_inertia.x() / data.volume;
+            data.km_longitudinal = data.center_of_buoyancy.z()
+                + data.waterplane_mom_inertia.y() / data.volume;
+        }
+
+        // block coefficients, as HydrostaticCalc::calculate
+        float draft = drafts[r];
+        float submerged_length = data.sub_max.x() - data.sub_min.x();
+        float submerged_width = data.sub_max.y() - data.sub_min.y();
+        if (draft != 0) {
+            if (data.waterplane_area * draft != 0)
+                data.vert_prism_coefficient = data.volume / (data.waterplane_area * draft);
+            if (ps.getHydrostaticCoefficients() == fcActualData) {
+                if (submerged_width * submerged_length * draft != 0)
+                    data.block_coefficient = data.volume / (submerged_width * submerged_length * draft);
+            } else if (ps.getLength() * ps.getBeam() * draft != 0) {
+                data.block_coefficient = data.volume / (ps.getLength() * ps.getBeam() * draft);
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+CrossCurves::CrossCurves(ShipCADModel* owner)
+    : _owner(owner), _calculated(false)
+{
+    // does nothing
+}
+
+void CrossCurves::clear()
+{
+    _displacements.clear();
+    _heeling_angles.clear();
+    _calculated = false;
+    _table.clear();
+    _balanced.clear();
+}
+
+void CrossCurves::setDisplacements(const vector<float>& displacements)
+{
+    _displacements = displacements;
+    _calculated = false;
+}
+
+void CrossCurves::setHeelingAngles(const vector<float>& angles)
+{
+    _heeling_angles = angles;
+    _calculated = false;
+}
+
+size_t CrossCurves::index(size_t displacement, size_t heel) const
+{
+    if (!_calculated || displacement >= _displacements.size() || heel >= _heeling_angles.size())
+        throw out_of_range("CrossCurves index out of range");
+    return displacement * _heeling_angles.size() + heel;
+}
+
+CrosscurvesData& CrossCurves::getData(size_t displacement, size_t heel)
+{
+    return _table[index(displacement, heel)];
+}
+
+bool CrossCurves::isBalanced(size_t displacement, size_t heel) const
+{
+    return _balanced[index(displacement, heel)] != 0;
+}
+
+void CrossCurves::calculate()
+{
+    if (!_owner->isBuild())
+        _owner->rebuildModel(true);
+
+    size_t nheel = _heeling_angles.size();
+    _table.resize(_displacements.size() * nheel);
+    _balanced.assign(_table.size(), 0);
+    // made here, the threads only read it
+    const HydrostaticMesh& mesh = _owner->getHydrostaticMesh();
+    HydrostaticsCache& cache = _owner->getHydrostaticsCache();
+    HydrostaticsBalanceKey key;
+    key.revision = mesh.getRevision();
+    key.settings = HydrostaticsSettings(_owner->getProjectSettings());
+    // each thread balances with its own volume results
+    ParallelFor(_table.size(), k_crosscurves_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    HydrostaticsBalanceKey balance = key;
+                    HydrostaticsBalanceResult result;
+                    int volumes, trims;
+                    for (size_t i=begin; i<end; ++i) {
+                        // the same as HydrostaticCalc::balance with no trim
+                        balance.displacement = _displacements[i / nheel];
+                        balance.heeling_angle = _heeling_angles[i % nheel];
+                        if (!cache.findBalance(balance, result)) {
+                            result.trim = 0;
+                            result.balanced = BalanceWaterline(_owner, mesh, balance.heeling_angle,
+                                                               result.trim, balance.displacement,
+                                                               false, ZERO, result.data,
+                                                               result.errors, result.output,
+                                                               volumes, trims);
+                            cache.addBalance(balance, result);
+                        }
+                        _table[i] = result.output;
+                        _balanced[i] = result.balanced ? 1 : 0;
+                    }
+                }, _owner->getSurface()->isParallelSubdivision());
+    _calculated = true;
+}
+
+void CrossCurves::addData(QStringList& strings, QChar separator)
+{
+    const QString vb = " | ";
+    unit_type_t u = _owner->getProjectSettings().getUnits();
+    if (!_calculated)
+        calculate();
+    QString title = vb + MakeLength(QObject::tr("Displ"), 8);
+    QString units = vb + MakeLength(WeightStr(u), 8);
+    QString line = " |-" + QString(8, '-');
+    for (size_t j=0; j<_heeling_angles.size(); j++) {
+        title += separator + vb + MakeLength("KN " + MakeLength(_heeling_angles[j], 1, 5), 8);
+        units += separator + vb + MakeLength(LengthStr(u), 8);
+        line += "-+-" + QString(8, '-');
+    }
+    strings.push_back(QObject::tr("Cross curves"));
+    strings.push_back(title + vb);
+    strings.push_back(units + vb);
+    strings.push_back(line + "-|");
+    for (size_t i=0; i<_displacements.size(); i++) {
+        QString row = vb + MakeLength(_displacements[i], -1, 8);
+        for (size_t j=0; j<_heeling_angles.size(); j++) {
+            if (isBalanced(i, j))
+                row += separator + vb + MakeLength(getData(i, j).kn_sin_phi, 3, 8);
+            else
+                row += separator + vb + MakeLength("-", 8);
+        }
+        strings.push_back(row + vb);
+    }
+    strings.push_back("");
+    strings.push_back(QObject::tr("KN is measured from the lowest point of the hull, heeling angles in degrees"));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+LiveHydrostatics::LiveHydrostatics(ShipCADModel* owner)
+    : _owner(owner), _draft(0), _trim(0), _heeling_angle(0), _revision(0), _valid(false),
+      _submerged(0), _leaks(0), _faces_integrated(0)
+{
+    clear();
+}
+
+void LiveHydrostatics::clear()
+{
+    _valid = false;
+    _faces.clear();
+    _port_side.clear();
+    _starboard_side.clear();
+    _faces_integrated = 0;
+    _data.clear();
+    _errors.clear();
+}
+
+void LiveHydrostatics::setDraft(float draft)
+{
+    if (draft != _draft) {
+        _draft = draft;
+        _valid = false;
+    }
+}
+
+void LiveHydrostatics::setTrim(float trim)
+{
+    if (trim != _trim) {
+        _trim = trim;
+        _valid = false;
+    }
+}
+
+void LiveHydrostatics::setHeelingAngle(float angle)
+{
+    if (angle != _heeling_angle) {
+        _heeling_angle = angle;
+        _valid = false;
+    }
+}
+
+bool LiveHydrostatics::hasError(hydrostatics_error_t error) const
+{
+    return find(_errors.begin(), _errors.end(), error) != _errors.end();
+}
+
+void LiveHydrostatics::update()
+{
+    // not rebuildModel(true), that would subdivide all faces again
+    if (!_owner->isBuild())
+        _owner->rebuildModel(false);
+    const HydrostaticMesh& mesh = _owner->getHydrostaticMesh();
+    ProjectSettings& ps = _owner->getProjectSettings();
+    Plane wl = WaterlinePlane(ps.getLength(), mesh.getLowestPoint(), _draft, _trim,
+                              _heeling_angle);
+
+    // integrate all faces when the waterline or the faces themselves changed
+    bool all = !_valid || _faces.size() != mesh.numberOfControlFaces()
+        || _port_side.size() != mesh.numberOfPoints()
+        || wl.a() != _waterline_plane.a() || wl.b() != _waterline_plane.b()
+        || wl.c() != _waterline_plane.c() || wl.d() != _waterline_plane.d();
+    if (all) {
+        FaceSums zero;
+        zero.volume = zero.wetted_surface = zero.waterplane_area = 0;
+        zero.moment = ZERO;
+        zero.submerged = zero.leaks = false;
+        _faces.assign(mesh.numberOfControlFaces(), zero);
+        _total = zero;
+        _submerged = _leaks = 0;
+        _port_side.assign(mesh.numberOfPoints(), 0);
+        _starboard_side.assign(mesh.numberOfPoints(), 0);
+    }
+
+    HydrostaticsData data;
+    data.clear();
+    vector<hydrostatics_error_t> errors;
+    VolumeCalc vc(wl, _owner, mesh, _heeling_angle, TrimAngle(ps.getLength(), _trim, _heeling_angle),
+                  data, errors);
+    vc.port_side.swap(_port_side);
+    vc.starboard_side.swap(_starboard_side);
+    _faces_integrated = 0;
+    for (size_t i=0; i<_faces.size(); i++) {
+        if (!all && mesh.getControlFaceRevision(i) <= _revision)
+            continue;
+        size_t first = mesh.firstFace(i);
+        size_t last = mesh.lastFace(i);
+        PlaneDistances(wl, mesh, mesh.firstPoint(first), mesh.firstPoint(last),
+                       vc.port_side, vc.starboard_side);
+        data.volume = 0;
+        data.center_of_buoyancy = ZERO;
+        data.wetted_surface = 0;
+        vc.wl_area = 0;
+        vc.submerged = false;
+        errors.clear();
+        vc.ProcessFaces(first, last);
+        FaceSums sums;
+        sums.volume = data.volume;
+        sums.moment = data.center_of_buoyancy;
+        sums.wetted_surface = data.wetted_surface;
+        sums.waterplane_area = vc.wl_area;
+        sums.submerged = vc.submerged;
+        sums.leaks = vc.hasError(feMakingWater);
+        // correct the totals by the change of this face
+        FaceSums& old = _faces[i];
+        _total.volume += sums.volume - old.volume;
+        _total.moment += sums.moment - old.moment;
+        _total.wetted_surface += sums.wetted_surface - old.wetted_surface;
+        _total.waterplane_area += sums.waterplane_area - old.waterplane_area;
+        _submerged = _submerged + (sums.submerged ? 1 : 0) - (old.submerged ? 1 : 0);
+        _leaks = _leaks + (sums.leaks ? 1 : 0) - (old.leaks ? 1 : 0);
+        old = sums;
+        _faces_integrated++;
+    }
+    vc.port_side.swap(_port_side);
+    vc.starboard_side.swap(_starboard_side);
+    _revision = mesh.getRevision();
+    _waterline_plane = wl;
+    _valid = true;
+
+    // as VolumeCalc::run finishes
+    _data.clear();
+    _errors.clear();
+    _data.waterline_plane = wl;
+    if (_submerged == 0)
+        _errors.push_back(feNothingSubmerged);
+    float volume = _total.volume;
+    if (_leaks > 0) {
+        _errors.push_back(feMakingWater);
+        volume = 0;
+    }
+    _data.displacement = VolumeToDisplacement(volume, ps.getWaterDensity(),
+                                              ps.getAppendageCoefficient(), ps.getUnits());
+    _data.wetted_surface = _total.wetted_surface;
+    _data.waterplane_area = _total.waterplane_area;
+    if (volume != 0) {
+        QVector3D buoyancy = vc.new_origin + _total.moment / volume;
+        _data.center_of_buoyancy = vc.RotatePoint(buoyancy);
+        _data.volume = volume * ps.getAppendageCoefficient();
+    }
+}
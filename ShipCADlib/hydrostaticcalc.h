@@ -191,7 +191,44 @@ public:
      */
     void addData(QStringList& strings, hydrostatics_mode_t mode, QChar separator);
 
+    /*! \brief get the center of gravity, used when balancing free to trim
+     *
+     * \return the center of gravity
+     */
+    const QVector3D& getCenterOfGravity() const {return _center_of_gravity;}
+    void setCenterOfGravity(const QVector3D& cog);
+
+    /*! \brief get the number of sectional areas calculated
+     *
+     * When not zero, the sectional area curve is found while the
+     * volume is calculated, the length of the hull is divided into
+     * this many bins and the area given at the middle of each is the
+     * volume in the bin divided by its length. When zero, the areas
+     * are calculated at the stations of the model.
+     *
+     * \return the number of bins, or 0 to use the stations
+     */
+    size_t getSACResolution() const {return _sac_resolution;}
+    void setSACResolution(size_t bins);
+
+    /*! \brief find the waterline for a displacement at this heeling angle
+     *
+     * When free to trim, the hull is trimmed until the center of
+     * buoyancy is above the center of gravity, and the trim is set to
+     * the one found. Otherwise the trim is kept.
+     *
+     * \param displacement the displacement to balance at
+     * \param freetotrim if true, find the trim too
+     * \param output the waterline found
+     * \return true if the hull could be balanced
+     */
     bool balance(float displacement, bool freetotrim, CrosscurvesData& output);
+    /*! \brief number of volume calculations in the last balance
+     */
+    int getBalanceVolumeEvaluations() const {return _volume_evaluations;}
+    /*! \brief number of trims tried in the last balance
+     */
+    int getBalanceTrimIterations() const {return _trim_iterations;}
     /*! \brief make all calculations specified
      *
      * For each type of calculation specified, this method will fill out _data
@@ -229,7 +266,220 @@ private:
     HydrostaticsData _data;
     std::vector<hydrostatics_calc_t> _calculations;
     Intersection* _mainframe;
-	
+    QVector3D _center_of_gravity;
+    int _volume_evaluations;
+    int _trim_iterations;
+    size_t _sac_resolution;
+
+};
+
+/*! \brief Hydrostatic curves, the hydrostatics at a list of drafts
+ *
+ * The hull is cut into triangles once, sorted on their height above
+ * the waterplane. For each draft the triangles entirely below the
+ * waterline are summed from running totals, only those cut by the
+ * waterline are clipped. Volume, center of buoyancy, wetted surface,
+ * waterplane properties and metacentric heights are calculated, the
+ * values that need intersection curves (midship section, sectional
+ * areas, lateral plane, entrance angle) are left at zero.
+ */
+class HydrostaticCurves
+{
+public:
+
+    explicit HydrostaticCurves(ShipCADModel* owner);
+    ~HydrostaticCurves() {}
+
+    void clear();
+
+    ShipCADModel* getOwner() const {return _owner;}
+
+    float getHeelingAngle() const {return _heeling_angle;}
+    void setHeelingAngle(float angle);
+    float getTrim() const {return _trim;}
+    void setTrim(float trim);
+
+    /*! \brief calculate the hydrostatics at each draft
+     *
+     * The waterline planes are the same as HydrostaticCalc gives for
+     * the drafts, with this heeling angle and trim.
+     *
+     * \param drafts the drafts, above the lowest point of the hull
+     */
+    void calculate(const std::vector<float>& drafts);
+
+    /*! \brief number of drafts in the last calculation
+     */
+    size_t numberOfDrafts() const {return _drafts.size();}
+    float getDraft(size_t index) const {return _drafts.at(index);}
+    /*! \brief the hydrostatics at a draft
+     *
+     * \param index which draft
+     * \return the results at the draft
+     */
+    HydrostaticsData& getData(size_t index) {return _table.at(index);}
+    /*! \brief does the calculation at a draft have this type of error
+     *
+     * \param index which draft
+     * \param error the error to check for
+     * \return true if the calculation has this error
+     */
+    bool hasError(size_t index, hydrostatics_error_t error) const;
+
+private:
+
+    ShipCADModel* _owner;
+    float _heeling_angle;
+    float _trim;
+    std::vector<float> _drafts;
+    std::vector<HydrostaticsData> _table;
+    std::vector<std::vector<hydrostatics_error_t> > _errors;
+};
+
+/*! \brief Cross curves of stability
+ *
+ * KN at each displacement and heeling angle, from balancing the hull
+ * at the displacement with no trim. The balances are independent of
+ * each other and run on the thread pool.
+ */
+class CrossCurves
+{
+public:
+
+    explicit CrossCurves(ShipCADModel* owner);
+    ~CrossCurves() {}
+
+    void clear();
+
+    ShipCADModel* getOwner() const {return _owner;}
+
+    const std::vector<float>& getDisplacements() const {return _displacements;}
+    void setDisplacements(const std::vector<float>& displacements);
+    const std::vector<float>& getHeelingAngles() const {return _heeling_angles;}
+    /*! \brief set the heeling angles
+     *
+     * \param angles the heeling angles in degrees
+     */
+    void setHeelingAngles(const std::vector<float>& angles);
+    bool isCalculated() const {return _calculated;}
+
+    /*! \brief balance the hull at every displacement and heeling angle
+     */
+    void calculate();
+    /*! \brief the balanced waterline at a displacement and heeling angle
+     *
+     * kn_sin_phi is the righting lever for a center of gravity at the
+     * keel, KN
+     *
+     * \param displacement index of the displacement
+     * \param heel index of the heeling angle
+     * \return the result of the balance
+     */
+    CrosscurvesData& getData(size_t displacement, size_t heel);
+    /*! \brief was a waterline found for a displacement and heeling angle
+     *
+     * \param displacement index of the displacement
+     * \param heel index of the heeling angle
+     * \return true if the hull could be balanced
+     */
+    bool isBalanced(size_t displacement, size_t heel) const;
+    /*! \brief get the KN values as a table in a list of strings
+     *
+     * A row for each displacement, a column for each heeling angle
+     *
+     * \param strings target string list for the table
+     * \param separator character to separate the data
+     */
+    void addData(QStringList& strings, QChar separator);
+
+private:
+
+    size_t index(size_t displacement, size_t heel) const;
+
+    ShipCADModel* _owner;
+    std::vector<float> _displacements;
+    std::vector<float> _heeling_angles;
+    bool _calculated;
+    std::vector<CrosscurvesData> _table;    // by displacement, then heeling angle
+    std::vector<char> _balanced;            // not vector<bool>, threads set neighbours
+};
+
+/*! \brief hydrostatics kept up to date while the hull is edited
+ *
+ * The volume, center of buoyancy, wetted surface and waterplane area
+ * at one waterline, kept as sums over the control faces of the layers
+ * used in hydrostatics. An update integrates again only the control
+ * faces whose subdivided faces changed since the last update, and
+ * corrects the totals by the difference. When the surface was rebuilt
+ * locally, after control points moved, that is only the faces around
+ * the points. The extents of the submerged body and the values found
+ * from them are not sums over the faces and are not kept.
+ */
+class LiveHydrostatics
+{
+public:
+
+    explicit LiveHydrostatics(ShipCADModel* owner);
+    ~LiveHydrostatics() {}
+
+    /*! \brief forget the sums, the next update integrates all faces
+     */
+    void clear();
+
+    ShipCADModel* getOwner() const {return _owner;}
+
+    float getDraft() const {return _draft;}
+    void setDraft(float draft);
+    float getTrim() const {return _trim;}
+    void setTrim(float trim);
+    float getHeelingAngle() const {return _heeling_angle;}
+    void setHeelingAngle(float angle);
+
+    /*! \brief bring the hydrostatics up to date with the surface
+     *
+     * Rebuilds the surface when it is not built, keeping what it can.
+     */
+    void update();
+    /*! \brief the hydrostatics from the last update
+     *
+     * Only waterline_plane, volume, displacement, center_of_buoyancy,
+     * wetted_surface and waterplane_area are set.
+     */
+    const HydrostaticsData& getData() const {return _data;}
+    bool hasError(hydrostatics_error_t error) const;
+    /*! \brief number of control faces integrated in the last update
+     */
+    size_t getFacesIntegrated() const {return _faces_integrated;}
+
+private:
+
+    // integrals over the children of one control face
+    struct FaceSums
+    {
+        double volume;
+        QVector3D moment;       // of volume, about the origin on the waterplane
+        double wetted_surface;
+        double waterplane_area;
+        bool submerged;
+        bool leaks;
+    };
+
+    ShipCADModel* _owner;
+    float _draft;
+    float _trim;
+    float _heeling_angle;
+    Plane _waterline_plane;             // the sums were integrated at
+    size_t _revision;                   // of the hydrostatic mesh the sums are of
+    bool _valid;
+    std::vector<FaceSums> _faces;
+    FaceSums _total;
+    size_t _submerged;                  // number of faces in the water
+    size_t _leaks;                      // number of faces making water
+    std::vector<float> _port_side;      // distance of the mesh points to the waterline
+    std::vector<float> _starboard_side;
+    size_t _faces_integrated;
+    HydrostaticsData _data;
+    std::vector<hydrostatics_error_t> _errors;
 };
 
 typedef PointerVector<HydrostaticCalc> HydrostaticCalcVector;
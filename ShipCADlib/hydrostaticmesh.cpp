@@ -0,0 +1,231 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <cmath>
+
+#include "hydrostaticmesh.h"
+#include "subdivsurface.h"
+#include "subdivlayer.h"
+#include "subdivface.h"
+#include "subdivpoint.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+HydrostaticMesh::HydrostaticMesh()
+    : _lowest_point(0), _built(false), _build_count(0), _revision(0)
+{
+    _first.push_back(0);
+    _control_first.push_back(0);
+}
+
+void HydrostaticMesh::clear()
+{
+    if (_symmetric.size() > 0 || _lowest_point != 0)
+        _revision++;
+    _x.clear();
+    _y.clear();
+    _z.clear();
+    _leak.clear();
+    _first.clear();
+    _first.push_back(0);
+    _symmetric.clear();
+    _lowest_point = 0;
+    _built = false;
+    _build_count = 0;
+    _layers.clear();
+    _control_faces.clear();
+    _control_first.clear();
+    _control_first.push_back(0);
+    _control_revision.clear();
+    _control_index.clear();
+}
+
+void HydrostaticMesh::build(const SubdivisionSurface& surface, float lowest_point)
+{
+    // kept to compare with the new faces
+    vector<float> x, y, z;
+    vector<char> leak, symmetric;
+    vector<size_t> first, control_first;
+    float lowest = _lowest_point;
+    x.swap(_x);
+    y.swap(_y);
+    z.swap(_z);
+    leak.swap(_leak);
+    first.swap(_first);
+    symmetric.swap(_symmetric);
+    control_first.swap(_control_first);
+    _first.push_back(0);
+    _control_first.push_back(0);
+    _layers.clear();
+    _control_faces.clear();
+    _control_index.clear();
+    for (size_t i=0; i<surface.numberOfLayers(); i++) {
+        const SubdivisionLayer* layer = surface.getLayer(i);
+        LayerState state;
+        state.layer = layer;
+        state.faces = layer->numberOfFaces();
+        state.symmetric = layer->isSymmetric();
+        state.hydrostatics = layer->useInHydrostatics();
+        _layers.push_back(state);
+        if (!layer->useInHydrostatics())
+            continue;
+        for (size_t j=0; j<layer->numberOfFaces(); j++) {
+            const SubdivisionControlFace* face = layer->getFace(j);
+            for (size_t k=0; k<face->numberOfAdaptiveFaces(); k++) {
+                SubdivisionFace* child = face->getAdaptiveFace(k);
+                for (size_t l=0; l<child->numberOfPoints(); l++) {
+                    SubdivisionPoint* point = child->getPoint(l);
+                    QVector3D p = point->getCoordinate();
+                    _x.push_back(p.x());
+                    _y.push_back(p.y());
+                    _z.push_back(p.z());
+                    _leak.push_back(point->isBoundaryVertex() && fabs(p.y()) > 1e-4);
+                }
+                _first.push_back(_x.size());
+                _symmetric.push_back(layer->isSymmetric());
+            }
+            _control_index[face] = _control_faces.size();
+            _control_faces.push_back(face);
+            _control_first.push_back(_symmetric.size());
+        }
+    }
+    _lowest_point = lowest_point;
+    _built = true;
+    _build_count = surface.getBuildCount();
+    if (_lowest_point != lowest || _first != first || _symmetric != symmetric
+            || _control_first != control_first
+            || _control_revision.size() != _control_faces.size()) {
+        _revision++;
+        _control_revision.assign(_control_faces.size(), _revision);
+        return;
+    }
+    // the same faces, find the control faces whose points moved
+    vector<size_t> changed;
+    for (size_t i=0; i<_control_faces.size(); i++) {
+        size_t begin = _first[_control_first[i]];
+        size_t end = _first[_control_first[i+1]];
+        for (size_t j=begin; j<end; j++) {
+            if (_x[j] != x[j] || _y[j] != y[j] || _z[j] != z[j] || _leak[j] != leak[j]) {
+                changed.push_back(i);
+                break;
+            }
+        }
+    }
+    if (changed.size() > 0) {
+        _revision++;
+        for (size_t i=0; i<changed.size(); i++)
+            _control_revision[changed[i]] = _revision;
+    }
+}
+
+void HydrostaticMesh::update(const SubdivisionSurface& surface, float lowest_point)
+{
+    // the surface has to be the one copied, rebuilt once locally since
+    if (_layers.empty() || !surface.isBuild() || !surface.isLocalRebuild()
+            || surface.getBuildCount() != _build_count + 1 || lowest_point != _lowest_point
+            || _layers.size() != surface.numberOfLayers()) {
+        build(surface, lowest_point);
+        return;
+    }
+    for (size_t i=0; i<_layers.size(); i++) {
+        const SubdivisionLayer* layer = surface.getLayer(i);
+        if (_layers[i].layer != layer
+                || _layers[i].faces != layer->numberOfFaces()
+                || _layers[i].symmetric != layer->isSymmetric()
+                || _layers[i].hydrostatics != layer->useInHydrostatics()) {
+            build(surface, lowest_point);
+            return;
+        }
+    }
+    // the rebuilt faces in hydrostatic layers, they must still have
+    // as many children with as many points
+    const vector<SubdivisionControlFace*>& rebuilt = surface.getRebuiltFaces();
+    vector<size_t> controls;
+    for (size_t i=0; i<rebuilt.size(); i++) {
+        unordered_map<const SubdivisionControlFace*, size_t>::const_iterator found
+            = _control_index.find(rebuilt[i]);
+        if (found == _control_index.end())
+            continue;
+        size_t control = (*found).second;
+        const SubdivisionControlFace* face = rebuilt[i];
+        if (face->numberOfAdaptiveFaces() != lastFace(control) - firstFace(control)) {
+            build(surface, lowest_point);
+            return;
+        }
+        for (size_t k=0; k<face->numberOfAdaptiveFaces(); k++) {
+            if (face->getAdaptiveFace(k)->numberOfPoints() != numberOfPoints(firstFace(control) + k)) {
+                build(surface, lowest_point);
+                return;
+            }
+        }
+        controls.push_back(control);
+    }
+    vector<size_t> changed;
+    for (size_t i=0; i<controls.size(); i++) {
+        size_t control = controls[i];
+        const SubdivisionControlFace* face = _control_faces[control];
+        bool differs = false;
+        for (size_t k=0; k<face->numberOfAdaptiveFaces(); k++) {
+            SubdivisionFace* child = face->getAdaptiveFace(k);
+            size_t index = _first[firstFace(control) + k];
+            for (size_t l=0; l<child->numberOfPoints(); l++, index++) {
+                SubdivisionPoint* point = child->getPoint(l);
+                QVector3D p = point->getCoordinate();
+                char leak = point->isBoundaryVertex() && fabs(p.y()) > 1e-4;
+                if (_x[index] != p.x() || _y[index] != p.y() || _z[index] != p.z()
+                        || _leak[index] != leak) {
+                    _x[index] = p.x();
+                    _y[index] = p.y();
+                    _z[index] = p.z();
+                    _leak[index] = leak;
+                    differs = true;
+                }
+            }
+        }
+        if (differs)
+            changed.push_back(control);
+    }
+    if (changed.size() > 0) {
+        _revision++;
+        for (size_t i=0; i<changed.size(); i++)
+            _control_revision[changed[i]] = _revision;
+    }
+    _built = true;
+    _build_count = surface.getBuildCount();
+}
+
+bool HydrostaticMesh::isValid(const SubdivisionSurface& surface) const
+{
+    if (!_built || !surface.isBuild() || _build_count != surface.getBuildCount())
+        return false;
+    if (_layers.size() != surface.numberOfLayers())
+        return false;
+    for (size_t i=0; i<_layers.size(); i++) {
+        const SubdivisionLayer* layer = surface.getLayer(i);
+        if (_layers[i].layer != layer
+                || _layers[i].faces != layer->numberOfFaces()
+                || _layers[i].symmetric != layer->isSymmetric()
+                || _layers[i].hydrostatics != layer->useInHydrostatics())
+            return false;
+    }
+    return true;
+}
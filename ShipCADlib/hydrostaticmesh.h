@@ -0,0 +1,163 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef HYDROSTATICMESH_H_
+#define HYDROSTATICMESH_H_
+
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+#include <QVector3D>
+
+namespace ShipCAD {
+
+class SubdivisionSurface;
+class SubdivisionLayer;
+class SubdivisionControlFace;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief copy of the subdivided faces used in hydrostatics
+ *
+ * The adaptive faces of all the layers used in hydrostatics, in layer
+ * order, with their points in arrays of x, y and z. The calculations
+ * go through these instead of the layers, control faces and subdivided
+ * points. A face of a symmetric layer is stored once, for the port
+ * side. Only read once made, so calculations can share it.
+ */
+class HydrostaticMesh
+{
+public:
+
+    HydrostaticMesh();
+    ~HydrostaticMesh() {}
+
+    /*! \brief remove all faces
+     */
+    void clear();
+    /*! \brief mark the copy as out of date, the faces are kept
+     *
+     * The next build compares the new faces to these.
+     */
+    void invalidate() { _built = false; }
+    /*! \brief copy the faces from a surface
+     *
+     * The revision goes up when the faces or the lowest point differ
+     * from the ones copied before. If only points moved, the control
+     * faces they belong to get the new revision, otherwise all do.
+     *
+     * \param surface the rebuilt surface
+     * \param lowest_point height of the lowest point used in hydrostatics
+     */
+    void build(const SubdivisionSurface& surface, float lowest_point);
+    /*! \brief copy the faces that changed since the last copy
+     *
+     * When the surface was rebuilt once since the last copy, and that
+     * rebuild only subdivided some control faces again, the children
+     * of those are copied over the ones they had. The revisions of the
+     * control faces that changed are set to the new revision. Otherwise
+     * this is the same as build.
+     *
+     * \param surface the rebuilt surface
+     * \param lowest_point height of the lowest point used in hydrostatics
+     */
+    void update(const SubdivisionSurface& surface, float lowest_point);
+    /*! \brief check the copy is of the surface as it is now
+     *
+     * \param surface the surface the faces were copied from
+     * \return false if the surface was rebuilt, or a layer changed its
+     * faces or how it is used, since the copy was made
+     */
+    bool isValid(const SubdivisionSurface& surface) const;
+
+    // getters
+    size_t numberOfFaces() const { return _symmetric.size(); }
+    size_t numberOfPoints() const { return _x.size(); }
+    /*! \brief the points of a face are numbered from this
+     */
+    size_t firstPoint(size_t face) const { return _first[face]; }
+    size_t numberOfPoints(size_t face) const { return _first[face+1] - _first[face]; }
+    /*! \brief the face is mirrored to starboard
+     */
+    bool isSymmetric(size_t face) const { return _symmetric[face] != 0; }
+    QVector3D getPoint(size_t index) const
+        { return QVector3D(_x[index], _y[index], _z[index]); }
+    /*! \brief the point is on the edge of the surface, off the centreplane
+     *
+     * The hull is open there, and leaks when it is under water.
+     */
+    bool isLeakPoint(size_t index) const { return _leak[index] != 0; }
+    float getLowestPoint() const { return _lowest_point; }
+    /*! \brief counts the changes to the faces
+     *
+     * Results calculated from faces with the same revision are the
+     * same, whatever else changed in the surface.
+     */
+    size_t getRevision() const { return _revision; }
+    /*! \brief the coordinates of all the points, for loops over them
+     */
+    const std::vector<float>& getX() const { return _x; }
+    const std::vector<float>& getY() const { return _y; }
+    const std::vector<float>& getZ() const { return _z; }
+    /*! \brief number of control faces the faces are the children of
+     */
+    size_t numberOfControlFaces() const { return _control_faces.size(); }
+    /*! \brief the children of a control face are the faces from this
+     */
+    size_t firstFace(size_t control) const { return _control_first[control]; }
+    /*! \brief the children of a control face are the faces before this
+     */
+    size_t lastFace(size_t control) const { return _control_first[control+1]; }
+    /*! \brief the revision in which the children of a control face last changed
+     */
+    size_t getControlFaceRevision(size_t control) const { return _control_revision[control]; }
+
+private:
+
+    // how a layer was when the faces were copied
+    struct LayerState
+    {
+        const SubdivisionLayer* layer;
+        size_t faces;
+        bool symmetric;
+        bool hydrostatics;
+    };
+
+    std::vector<float> _x;
+    std::vector<float> _y;
+    std::vector<float> _z;
+    std::vector<char> _leak;
+    std::vector<size_t> _first;         // one more than the faces
+    std::vector<char> _symmetric;
+    float _lowest_point;
+    bool _built;
+    size_t _build_count;                // of the surface when copied
+    size_t _revision;
+    std::vector<LayerState> _layers;
+    std::vector<const SubdivisionControlFace*> _control_faces;
+    std::vector<size_t> _control_first;         // one more than the control faces
+    std::vector<size_t> _control_revision;
+    std::unordered_map<const SubdivisionControlFace*, size_t> _control_index;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -0,0 +1,247 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <algorithm>
+
+#include "hydrostaticscache.h"
+#include "projsettings.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+HydrostaticsSettings::HydrostaticsSettings()
+    : water_density(0), appendage_coefficient(0), units(fuMetric), length(0), beam(0),
+      mainframe_location(0), coefficients(fcActualData)
+{
+    // does nothing
+}
+
+HydrostaticsSettings::HydrostaticsSettings(ProjectSettings& ps)
+    : water_density(ps.getWaterDensity()), appendage_coefficient(ps.getAppendageCoefficient()),
+      units(ps.getUnits()), length(ps.getLength()), beam(ps.getBeam()),
+      mainframe_location(ps.getMainframeLocation()),
+      coefficients(ps.getHydrostaticCoefficients())
+{
+    // does nothing
+}
+
+bool HydrostaticsSettings::operator==(const HydrostaticsSettings& other) const
+{
+    return water_density == other.water_density
+        && appendage_coefficient == other.appendage_coefficient
+        && units == other.units
+        && length == other.length
+        && beam == other.beam
+        && mainframe_location == other.mainframe_location
+        && coefficients == other.coefficients;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+HydrostaticsCalculationKey::HydrostaticsCalculationKey()
+    : revision(0), draft(0), trim(0), heeling_angle(0), sac_resolution(0)
+{
+    // does nothing
+}
+
+bool HydrostaticsCalculationKey::operator==(const HydrostaticsCalculationKey& other) const
+{
+    return revision == other.revision
+        && draft == other.draft
+        && trim == other.trim
+        && heeling_angle == other.heeling_angle
+        && sac_resolution == other.sac_resolution
+        && settings == other.settings
+        && calculations == other.calculations
+        && stations == other.stations;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+HydrostaticsBalanceKey::HydrostaticsBalanceKey()
+    : revision(0), displacement(0), heeling_angle(0), trim(0), free_to_trim(false),
+      center_of_gravity(0, 0, 0)
+{
+    // does nothing
+}
+
+bool HydrostaticsBalanceKey::operator==(const HydrostaticsBalanceKey& other) const
+{
+    return revision == other.revision
+        && displacement == other.displacement
+        && heeling_angle == other.heeling_angle
+        && trim == other.trim
+        && free_to_trim == other.free_to_trim
+        && center_of_gravity == other.center_of_gravity
+        && settings == other.settings;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+HydrostaticsCache::HydrostaticsCache(size_t max_size)
+    : _max_size(max_size), _hits(0), _misses(0), _clock(0)
+{
+    // does nothing
+}
+
+void HydrostaticsCache::clear()
+{
+    QMutexLocker locker(&_mutex);
+    _calculations.clear();
+    _balances.clear();
+}
+
+size_t HydrostaticsCache::size() const
+{
+    QMutexLocker locker(&_mutex);
+    return _calculations.size() + _balances.size();
+}
+
+size_t HydrostaticsCache::getMaxSize() const
+{
+    QMutexLocker locker(&_mutex);
+    return _max_size;
+}
+
+void HydrostaticsCache::setMaxSize(size_t max_size)
+{
+    QMutexLocker locker(&_mutex);
+    _max_size = max_size;
+    dropOldest(0);
+}
+
+size_t HydrostaticsCache::getHits() const
+{
+    QMutexLocker locker(&_mutex);
+    return _hits;
+}
+
+size_t HydrostaticsCache::getMisses() const
+{
+    QMutexLocker locker(&_mutex);
+    return _misses;
+}
+
+void HydrostaticsCache::resetCounters()
+{
+    QMutexLocker locker(&_mutex);
+    _hits = 0;
+    _misses = 0;
+}
+
+// the entries are kept in the order they were used, the oldest first
+bool HydrostaticsCache::findCalculation(const HydrostaticsCalculationKey& key,
+                                        HydrostaticsData& data,
+                                        vector<hydrostatics_error_t>& errors)
+{
+    QMutexLocker locker(&_mutex);
+    for (size_t i=0; i<_calculations.size(); i++) {
+        if (_calculations[i].key == key) {
+            _calculations[i].used = ++_clock;
+            rotate(_calculations.begin() + i, _calculations.begin() + i + 1, _calculations.end());
+            data = _calculations.back().data;
+            errors = _calculations.back().errors;
+            _hits++;
+            return true;
+        }
+    }
+    _misses++;
+    return false;
+}
+
+void HydrostaticsCache::addCalculation(const HydrostaticsCalculationKey& key,
+                                       const HydrostaticsData& data,
+                                       const vector<hydrostatics_error_t>& errors)
+{
+    QMutexLocker locker(&_mutex);
+    if (_max_size == 0)
+        return;
+    for (size_t i=0; i<_calculations.size(); i++) {
+        // calculated on another thread meanwhile
+        if (_calculations[i].key == key)
+            return;
+    }
+    makeRoom(key.revision);
+    CalculationEntry entry;
+    entry.key = key;
+    entry.data = data;
+    entry.errors = errors;
+    entry.used = ++_clock;
+    _calculations.push_back(entry);
+}
+
+bool HydrostaticsCache::findBalance(const HydrostaticsBalanceKey& key,
+                                    HydrostaticsBalanceResult& result)
+{
+    QMutexLocker locker(&_mutex);
+    for (size_t i=0; i<_balances.size(); i++) {
+        if (_balances[i].key == key) {
+            _balances[i].used = ++_clock;
+            rotate(_balances.begin() + i, _balances.begin() + i + 1, _balances.end());
+            result = _balances.back().result;
+            _hits++;
+            return true;
+        }
+    }
+    _misses++;
+    return false;
+}
+
+void HydrostaticsCache::addBalance(const HydrostaticsBalanceKey& key,
+                                   const HydrostaticsBalanceResult& result)
+{
+    QMutexLocker locker(&_mutex);
+    if (_max_size == 0)
+        return;
+    for (size_t i=0; i<_balances.size(); i++) {
+        if (_balances[i].key == key)
+            return;
+    }
+    makeRoom(key.revision);
+    BalanceEntry entry;
+    entry.key = key;
+    entry.result = result;
+    entry.used = ++_clock;
+    _balances.push_back(entry);
+}
+
+void HydrostaticsCache::makeRoom(size_t revision)
+{
+    for (size_t i=_calculations.size(); i>0; i--)
+        if (_calculations[i-1].key.revision != revision)
+            _calculations.erase(_calculations.begin() + (i-1));
+    for (size_t i=_balances.size(); i>0; i--)
+        if (_balances[i-1].key.revision != revision)
+            _balances.erase(_balances.begin() + (i-1));
+    dropOldest(1);
+}
+
+void HydrostaticsCache::dropOldest(size_t room)
+{
+    while (_calculations.size() + _balances.size() + room > _max_size
+           && _calculations.size() + _balances.size() > 0) {
+        if (_balances.empty()
+                || (!_calculations.empty() && _calculations.front().used < _balances.front().used))
+            _calculations.erase(_calculations.begin());
+        else
+            _balances.erase(_balances.begin());
+    }
+}
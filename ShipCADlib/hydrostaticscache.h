@@ -0,0 +1,195 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef HYDROSTATICSCACHE_H_
+#define HYDROSTATICSCACHE_H_
+
+#include <cstddef>
+#include <vector>
+#include <QMutex>
+#include <QVector3D>
+#include "shipcadlib.h"
+#include "hydrostaticcalc.h"
+
+namespace ShipCAD {
+
+class ProjectSettings;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief the project settings hydrostatics results depend on
+ */
+struct HydrostaticsSettings
+{
+    float water_density;
+    float appendage_coefficient;
+    unit_type_t units;
+    float length;
+    float beam;
+    float mainframe_location;
+    hydrostatic_coeff_t coefficients;
+
+    HydrostaticsSettings();
+    explicit HydrostaticsSettings(ProjectSettings& ps);
+    bool operator==(const HydrostaticsSettings& other) const;
+};
+
+/*! \brief what a HydrostaticCalc::calculate result depends on
+ */
+struct HydrostaticsCalculationKey
+{
+    size_t revision;                    /**< of the hydrostatic mesh */
+    HydrostaticsSettings settings;
+    float draft;
+    float trim;
+    float heeling_angle;
+    std::vector<hydrostatics_calc_t> calculations;  /**< sorted, each once */
+    size_t sac_resolution;
+    std::vector<float> stations;        /**< when the sectional areas are at the stations */
+
+    HydrostaticsCalculationKey();
+    bool operator==(const HydrostaticsCalculationKey& other) const;
+};
+
+/*! \brief what a balance depends on
+ */
+struct HydrostaticsBalanceKey
+{
+    size_t revision;                    /**< of the hydrostatic mesh */
+    HydrostaticsSettings settings;
+    float displacement;
+    float heeling_angle;
+    float trim;                         /**< the trim kept, or the first one tried */
+    bool free_to_trim;
+    QVector3D center_of_gravity;        /**< only used when free to trim */
+
+    HydrostaticsBalanceKey();
+    bool operator==(const HydrostaticsBalanceKey& other) const;
+};
+
+/*! \brief everything a balance leaves behind
+ */
+struct HydrostaticsBalanceResult
+{
+    bool balanced;
+    float trim;                         /**< the trim found */
+    CrosscurvesData output;
+    HydrostaticsData data;              /**< of the last volume calculated */
+    std::vector<hydrostatics_error_t> errors;
+};
+
+/*! \brief hydrostatics results calculated before
+ *
+ * Results of calculations and balances, found again by the settings
+ * they were calculated with and the revision of the hydrostatic mesh
+ * they were calculated on. Only the results of the latest revision
+ * are kept, as the revision never goes back. When full, the result
+ * used longest ago is dropped. Can be used from several threads.
+ */
+class HydrostaticsCache
+{
+public:
+
+    /*! \brief Constructor
+     *
+     * \param max_size the most results kept
+     */
+    explicit HydrostaticsCache(size_t max_size = 256);
+    ~HydrostaticsCache() {}
+
+    /*! \brief drop all results, the counters are kept
+     */
+    void clear();
+    /*! \brief number of results kept
+     */
+    size_t size() const;
+    size_t getMaxSize() const;
+    /*! \brief set the most results kept, 0 keeps none
+     *
+     * \param max_size the most results kept
+     */
+    void setMaxSize(size_t max_size);
+    /*! \brief number of results found since the counters were reset
+     */
+    size_t getHits() const;
+    /*! \brief number of results not found since the counters were reset
+     */
+    size_t getMisses() const;
+    void resetCounters();
+
+    /*! \brief find the result of a calculation
+     *
+     * \param key the calculation
+     * \param data set to the result when found
+     * \param errors set to the errors of the calculation when found
+     * \return true if found
+     */
+    bool findCalculation(const HydrostaticsCalculationKey& key, HydrostaticsData& data,
+                         std::vector<hydrostatics_error_t>& errors);
+    void addCalculation(const HydrostaticsCalculationKey& key, const HydrostaticsData& data,
+                        const std::vector<hydrostatics_error_t>& errors);
+    /*! \brief find the result of a balance
+     *
+     * \param key the balance
+     * \param result set to the result when found
+     * \return true if found
+     */
+    bool findBalance(const HydrostaticsBalanceKey& key, HydrostaticsBalanceResult& result);
+    void addBalance(const HydrostaticsBalanceKey& key, const HydrostaticsBalanceResult& result);
+
+private:
+
+    // define away copy constructor and assignment operator
+    HydrostaticsCache(const HydrostaticsCache&);
+    HydrostaticsCache& operator=(const HydrostaticsCache&);
+
+    struct CalculationEntry
+    {
+        HydrostaticsCalculationKey key;
+        HydrostaticsData data;
+        std::vector<hydrostatics_error_t> errors;
+        size_t used;
+    };
+    struct BalanceEntry
+    {
+        HydrostaticsBalanceKey key;
+        HydrostaticsBalanceResult result;
+        size_t used;
+    };
+
+    // drop results of older revisions, and the least used until there
+    // is room for one more
+    void makeRoom(size_t revision);
+    // drop the least used until there is room for this many more
+    void dropOldest(size_t room);
+
+    mutable QMutex _mutex;
+    size_t _max_size;
+    size_t _hits;
+    size_t _misses;
+    size_t _clock;                      // counts the uses
+    std::vector<CalculationEntry> _calculations;
+    std::vector<BalanceEntry> _balances;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -219,6 +219,11 @@ void Intersection::rebuild()
 {
     setBuild(false);
     _owner->getSurface()->intersectPlane(_plane, _use_hydrostatic_surfaces_only, _items);
+    finishRebuild();
+}
+
+void Intersection::finishRebuild()
+{
     // use a low simplification factor to remove only points that are (nearly) on a line
     if (_owner->getProjectSettings().isSimplifyIntersections()) {
         _items.apply(Simplify);
@@ -227,7 +232,9 @@ void Intersection::rebuild()
     extents(_min, _max);
 }
 
-struct CalculateSplineArea
+// sums for the area, center of gravity and moment of inertia of an
+// intersection, the splines are given to operator() of a subclass
+struct CalculateArea
 {
     float* _area;
     QVector3D* _cog;
@@ -235,8 +242,8 @@ struct CalculateSplineArea
     intersection_type_t _intersection_type;
     Plane _wl_plane;
     Plane _int_plane;
-    CalculateSplineArea(float* area, QVector3D* cog, QVector3D* mom_inertia, intersection_type_t ty, const Plane& wlpln,
-                        const Plane& intersection_plane)
+    CalculateArea(float* area, QVector3D* cog, QVector3D* mom_inertia, intersection_type_t ty, const Plane& wlpln,
+                  const Plane& intersection_plane)
         : _area(area), _cog(cog), _moi(mom_inertia), _intersection_type(ty), _wl_plane(wlpln), _int_plane(intersection_plane)
     {}
     QVector2D ProjectTo2D(const QVector3D& p)
@@ -258,13 +265,63 @@ struct CalculateSplineArea
         return result;
     }
 
+    // add the sums of one spline to the totals
+    void AddSpline(float spline_area, QVector2D c, QVector2D momi)
+    {
+        QVector3D spline_cog = ZERO;
+        if (spline_area != 0) {
+            c /= spline_area;
+            momi.setX(fabs(momi.x()));
+            momi.setY(fabs(momi.y()));
+            switch (_intersection_type) {
+            case fiStation:
+                spline_cog.setX(-_int_plane.d());
+                spline_cog.setY(c.x());
+                spline_cog.setZ(c.y());
+                _moi->setX(0);
+                _moi->setY(momi.x());
+                _moi->setZ(momi.y());
+                break;
+            case fiButtock:
+                spline_cog.setX(c.x());
+                spline_cog.setY(-_int_plane.d());
+                spline_cog.setZ(c.y());
+                _moi->setX(momi.x());
+                _moi->setY(0);
+                _moi->setZ(momi.y());
+                break;
+            case fiWaterline:
+                spline_cog.setX(c.x());
+                spline_cog.setY(c.y());
+                spline_cog.setZ(-_int_plane.d());
+                _moi->setX(momi.x());
+                _moi->setY(momi.y());
+                _moi->setZ(0);
+                break;
+            default:
+                break;
+            }
+        }
+        *_area += spline_area;
+        *_cog += spline_area * spline_cog;
+    }
+};
+
+// integrates along the smooth spline through the intersection points,
+// 500 steps between each pair of waterline crossings
+struct CalculateSplineArea : public CalculateArea
+{
+    CalculateSplineArea(float* area, QVector3D* cog, QVector3D* mom_inertia, intersection_type_t ty, const Plane& wlpln,
+                        const Plane& intersection_plane)
+        : CalculateArea(area, cog, mom_inertia, ty, wlpln, intersection_plane)
+    {}
+
     void operator()(Spline* spline)
     {
         bool closed_spline;
         IntersectionData intersection_data;
         vector<float> parameters;
         float spline_area = 0;
-        QVector3D spline_cog = ZERO;
         QVector2D c = ZERO2;
         QVector2D momi = c;
         closed_spline = DistPP3D(spline->getFirstPoint(), spline->getLastPoint()) < 1e-4;
@@ -315,46 +372,99 @@ struct CalculateSplineArea
                 }
                 t1 = t2;
             }
-            if (spline_area != 0) {
-                c /= spline_area;
-                momi.setX(fabs(momi.x()));
-                momi.setY(fabs(momi.y()));
-                switch (_intersection_type) {
-                case fiStation:
-                    spline_cog.setX(-_int_plane.d());
-                    spline_cog.setY(c.x());
-                    spline_cog.setZ(c.y());
-                    _moi->setX(0);
-                    _moi->setY(momi.x());
-                    _moi->setZ(momi.y());
-                    break;
-                case fiButtock:
-                    spline_cog.setX(c.x());
-                    spline_cog.setY(-_int_plane.d());
-                    spline_cog.setZ(c.y());
-                    _moi->setX(momi.x());
-                    _moi->setY(0);
-                    _moi->setZ(momi.y());
-                    break;
-                case fiWaterline:
-                    spline_cog.setX(c.x());
-                    spline_cog.setY(c.y());
-                    spline_cog.setZ(-_int_plane.d());
-                    _moi->setX(momi.x());
-                    _moi->setY(momi.y());
-                    _moi->setZ(0);
-                    break;
-                default:
-                    break;
+        }
+        AddSpline(spline_area, c, momi);
+    }
+};
+
+// integrates along the straight lines between the intersection points,
+// which are on the subdivided surface. The outline is cut off at the
+// waterline and closed along it, so the sums are exact for the surface
+struct CalculatePolygonArea : public CalculateArea
+{
+    CalculatePolygonArea(float* area, QVector3D* cog, QVector3D* mom_inertia, intersection_type_t ty, const Plane& wlpln,
+                         const Plane& intersection_plane)
+        : CalculateArea(area, cog, mom_inertia, ty, wlpln, intersection_plane)
+    {}
+
+    // add a straight piece of the outline, by Green's theorem
+    static void AddSegment(const QVector2D& p1, const QVector2D& p2, float& spline_area,
+                           QVector2D& c, QVector2D& momi)
+    {
+        float dx = p2.x() - p1.x();
+        float dy = p2.y() - p1.y();
+        spline_area += 0.5 * (p2.x() + p1.x()) * dy;
+        c.setX(c.x() + (1.0/6.0) * (p1.x() * p1.x() + p1.x() * p2.x() + p2.x() * p2.x()) * dy);
+        c.setY(c.y() + (1.0/6.0) * (p1.x() * (2 * p1.y() + p2.y())
+                                    + p2.x() * (p1.y() + 2 * p2.y())) * dy);
+        momi.setX(momi.x() + (1.0/12.0) * (p1.y() + p2.y())
+                  * (p1.y() * p1.y() + p2.y() * p2.y()) * dx);
+        momi.setY(momi.y() + (1.0/12.0) *
+                  (p2.x() * p2.x() * (3 * p2.y() + p1.y())
+                   + 2 * p1.x() * p2.x() * (p1.y() + p2.y())
+                   + p1.x() * p1.x() * (3 * p1.y() + p2.y())) * dx);
+    }
+
+    // distance to the waterline, everything is included for waterlines
+    float Side(const QVector3D& p)
+    {
+        if (_intersection_type == fiWaterline)
+            return -1;
+        return _wl_plane.distance(p);
+    }
+
+    void operator()(Spline* spline)
+    {
+        float spline_area = 0;
+        QVector2D c = ZERO2;
+        QVector2D momi = c;
+        size_t n = spline->numberOfPoints();
+        if (n < 2)
+            return;
+        bool first = true;
+        QVector2D first_point, last_point;
+        // the last point joins up to the first whether the spline is closed or not
+        QVector3D p1 = spline->getPoint(n - 1);
+        float side1 = Side(p1);
+        for (size_t i=0; i<n; i++) {
+            QVector3D p2 = spline->getPoint(i);
+            float side2 = Side(p2);
+            QVector2D q[2];
+            size_t count = 0;
+            if ((side1 < 0) != (side2 < 0))
+                q[count++] = ProjectTo2D(p1 + (side1 / (side1 - side2)) * (p2 - p1));
+            if (side2 < 0)
+                q[count++] = ProjectTo2D(p2);
+            for (size_t j=0; j<count; j++) {
+                if (first) {
+                    first_point = q[j];
+                    first = false;
+                } else {
+                    AddSegment(last_point, q[j], spline_area, c, momi);
                 }
+                last_point = q[j];
             }
+            p1 = p2;
+            side1 = side2;
         }
-        *_area += spline_area;
-        *_cog += spline_area * spline_cog;
+        if (!first)
+            AddSegment(last_point, first_point, spline_area, c, momi);
+        AddSpline(spline_area, c, momi);
     }
 };
 
 void Intersection::calculateArea(const Plane& wlplane, float* area, QVector3D* cog, QVector2D* moment_of_inertia)
+{
+    calculateArea(wlplane, false, area, cog, moment_of_inertia);
+}
+
+void Intersection::calculateSplineArea(const Plane& wlplane, float* area, QVector3D* cog, QVector2D* moment_of_inertia)
+{
+    calculateArea(wlplane, true, area, cog, moment_of_inertia);
+}
+
+void Intersection::calculateArea(const Plane& wlplane, bool along_splines, float* area, QVector3D* cog,
+                                 QVector2D* moment_of_inertia)
 {
     *area = 0;
     *cog = ZERO;
@@ -364,8 +474,13 @@ void Intersection::calculateArea(const Plane& wlplane, float* area, QVector3D* c
         rebuild();
     if (_items.size() > 0) {
         createStarboardPart();  // this ensures correct winding order
-        CalculateSplineArea calc(area, cog, &tmpmoi, _intersection_type, wlplane, _plane);
-        for_each(_items.begin(), _items.end(), calc);
+        if (along_splines) {
+            CalculateSplineArea calc(area, cog, &tmpmoi, _intersection_type, wlplane, _plane);
+            for_each(_items.begin(), _items.end(), calc);
+        } else {
+            CalculatePolygonArea calc(area, cog, &tmpmoi, _intersection_type, wlplane, _plane);
+            for_each(_items.begin(), _items.end(), calc);
+        }
         if (*area != 0) {
             *cog = *cog / *area;
             if (_intersection_type == fiWaterline) {
@@ -412,9 +527,10 @@ void Intersection::createStarboardPart()
     for (size_t i=_items.size(); i>=1; i--) {
         Spline* spline = _items.get(i-1);
         float area = 0;
+        // the points are on the surface, the spline only smooths between them
         QVector3D p1 = spline->getLastPoint();
-        for (size_t j=0; j<500; j++) {
-            QVector3D p2 = spline->value(j/500.);
+        for (size_t j=0; j<spline->numberOfPoints(); j++) {
+            QVector3D p2 = spline->getPoint(j);
             float delta;
             switch (_intersection_type) {
             case fiStation:
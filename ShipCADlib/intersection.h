@@ -70,6 +70,10 @@ public:
     virtual void extents(QVector3D& min, QVector3D& max);
     virtual void draw(Viewport& vp, LineShader* lineshader);
     virtual void rebuild();
+    /*! \brief finish a rebuild whose curves were found by
+     * SubdivisionSurface::intersectPlanes
+     */
+    void finishRebuild();
     virtual void setBuild(bool val);
 
     /* \brief get the color of the intersection
@@ -113,6 +117,9 @@ public:
     SplineVector& getSplines() {return _items;}
 
     /*! \brief calculate area, center of gravity, moment of inertia of intersection
+     *
+     * The area below the waterline plane, bounded by the straight lines
+     * between the intersection points and the waterline.
      *
      * \param wlplane the waterline plane to use for hydrostatic area
      * \param area calculated area
@@ -120,6 +127,19 @@ public:
      * \param moment_of_inertia calculated moment of inertia
      */
     void calculateArea(const Plane& wlplane, float* area, QVector3D* cog, QVector2D* moment_of_inertia);
+    /*! \brief calculate area, center of gravity, moment of inertia along the splines
+     *
+     * The previous calculation, integrating in small steps along the
+     * smooth splines through the intersection points instead of along
+     * the straight lines between them. Slower, and it leaves out the
+     * waterline closing the area, so it is only right without heel.
+     *
+     * \param wlplane the waterline plane to use for hydrostatic area
+     * \param area calculated area
+     * \param cog calculated center of gravity
+     * \param moment_of_inertia calculated moment of inertia
+     */
+    void calculateSplineArea(const Plane& wlplane, float* area, QVector3D* cog, QVector2D* moment_of_inertia);
     void createStarboardPart();
     void deleteItem(Spline* item);
 
@@ -134,6 +154,9 @@ protected:
 
 private:
 
+    void calculateArea(const Plane& wlplane, bool along_splines, float* area, QVector3D* cog,
+                       QVector2D* moment_of_inertia);
+
     ShipCADModel* _owner;
     SplineVector _items;
     intersection_type_t _intersection_type;
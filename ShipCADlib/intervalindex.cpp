@@ -0,0 +1,112 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+#include "intervalindex.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+// orders intervals on their start
+struct StartLess
+{
+    const vector<float>& lo;
+
+    StartLess(const vector<float>& l) : lo(l) {}
+    bool operator()(size_t a, size_t b) const
+        { return lo[a] < lo[b]; }
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+IntervalIndex::IntervalIndex()
+    : _leaves(0)
+{
+    // does nothing
+}
+
+void IntervalIndex::clear()
+{
+    _leaves = 0;
+    _lo.clear();
+    _items.clear();
+    _max.clear();
+}
+
+void IntervalIndex::build(const vector<float>& lo, const vector<float>& hi)
+{
+    if (lo.size() != hi.size())
+        throw invalid_argument("IntervalIndex::build interval ends don't match");
+    clear();
+    if (lo.empty())
+        return;
+    _items.resize(lo.size());
+    for (size_t i=0; i<_items.size(); ++i)
+        _items[i] = i;
+    sort(_items.begin(), _items.end(), StartLess(lo));
+    _lo.resize(_items.size());
+    for (size_t i=0; i<_items.size(); ++i)
+        _lo[i] = lo[_items[i]];
+    _leaves = 1;
+    while (_leaves < _items.size())
+        _leaves *= 2;
+    // leaves past the last interval never overlap anything
+    _max.assign(2 * _leaves, -numeric_limits<float>::max());
+    for (size_t i=0; i<_items.size(); ++i)
+        _max[_leaves + i] = hi[_items[i]];
+    for (size_t i=_leaves; i-->1; )
+        _max[i] = max(_max[2*i], _max[2*i+1]);
+}
+
+void IntervalIndex::query(float lo, float hi, vector<size_t>& items) const
+{
+    items.clear();
+    // only the intervals starting at or before the end of the range
+    size_t count = upper_bound(_lo.begin(), _lo.end(), hi) - _lo.begin();
+    if (count == 0)
+        return;
+    // nodes to look at, the children of node i are 2i and 2i+1
+    vector<size_t> stack;
+    stack.push_back(1);
+    while (!stack.empty()) {
+        size_t node = stack.back();
+        stack.pop_back();
+        if (_max[node] < lo)
+            continue;
+        // the first leaf under the node
+        size_t first = node;
+        while (first < _leaves)
+            first *= 2;
+        first -= _leaves;
+        if (first >= count)
+            continue;
+        if (node >= _leaves)
+            items.push_back(_items[first]);
+        else {
+            stack.push_back(2*node+1);
+            stack.push_back(2*node);
+        }
+    }
+    sort(items.begin(), items.end());
+}
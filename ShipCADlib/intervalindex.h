@@ -0,0 +1,76 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef INTERVALINDEX_H_
+#define INTERVALINDEX_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief index of intervals on a line, finds the ones overlapping a range
+ *
+ * The intervals are sorted on their start, with a tree over them
+ * holding the largest end in each subtree. A query only descends
+ * into subtrees which start before the range and end after it.
+ * Intervals are numbered in the order they were given to build.
+ */
+class IntervalIndex
+{
+public:
+
+    IntervalIndex();
+    ~IntervalIndex() {}
+
+    /*! \brief remove all intervals
+     */
+    void clear();
+    /*! \brief make the index
+     *
+     * \param lo the start of each interval
+     * \param hi the end of each interval
+     */
+    void build(const std::vector<float>& lo, const std::vector<float>& hi);
+    /*! \brief find the intervals overlapping a range
+     *
+     * \param lo start of the range
+     * \param hi end of the range
+     * \param items the interval numbers, in increasing order
+     */
+    void query(float lo, float hi, std::vector<size_t>& items) const;
+
+    // getters
+    size_t numberOfItems() const { return _items.size(); }
+
+private:
+
+    size_t _leaves;             // number of leaves in the tree, a power of 2
+    std::vector<float> _lo;     // interval starts, sorted
+    std::vector<size_t> _items; // interval numbers, in the order of _lo
+    std::vector<float> _max;    // largest end under each node, the root is 1
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
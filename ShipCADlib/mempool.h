@@ -1,6 +1,7 @@
 // The MIT License (MIT)
 // Copyright (c) 2014 Mohammad Dashti
 // (mohammad.dashti [at] epfl.ch - mdashti [at] GMail)
+#include <vector>
 #define DEFAULT_CHUNK_SIZE 1024
 #define DEFAULT_FORCE_CLEAR true
 template<typename T>
@@ -17,6 +18,7 @@ private:
     El *free_;
     El *data_;
     size_t size_;
+    size_t used_;
     bool forceClear;
     void add_chunk()   // precondition: no available elements
         {
@@ -30,7 +32,7 @@ private:
             free_ = chunk;
         }
 public:
-    Pool(size_t chunk_size = DEFAULT_CHUNK_SIZE) : data_(nullptr), size_(chunk_size >> 1), forceClear(false)
+    Pool(size_t chunk_size = DEFAULT_CHUNK_SIZE) : data_(nullptr), size_(chunk_size >> 1), used_(0), forceClear(false)
         {
             add_chunk();
         }
@@ -54,12 +56,27 @@ public:
             }
             El *el = free_;
             free_ = free_->next;
+            ++used_;
             return &(el->obj);
         }
+    // take n elements at once, so they can be handed to code that
+    // must not touch the free list, e.g. other threads
+    void take(size_t n, std::vector<T*>& dest)
+        {
+            dest.reserve(dest.size() + n);
+            for (size_t i = 0; i < n; ++i)
+                dest.push_back(add());
+        }
     inline void del(T *obj)
         {
             ((El *)obj)->next = free_;
             free_ = (El *)obj;
+            --used_;
+        }
+    // number of elements handed out and not given back
+    size_t used() const
+        {
+            return used_;
         }
     void clear(bool force = DEFAULT_FORCE_CLEAR)
         {
@@ -84,6 +101,7 @@ public:
                     sz = sz >> 1;
                 }
                 free_ = data_;
+                used_ = 0;
                 forceClear = false;
             }
         }
@@ -0,0 +1,123 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *##############################################################################################*/
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <exception>
+#include <vector>
+#include <algorithm>
+
+#include "parallel.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// runs one chunk of a ParallelFor on a thread pool thread
+class ChunkRunner : public QRunnable
+{
+public:
+    ChunkRunner(const function<void(size_t, size_t, size_t)>& fn,
+                size_t chunk, size_t begin, size_t end,
+                exception_ptr& error, QSemaphore& done)
+        : _fn(fn), _chunk(chunk), _begin(begin), _end(end),
+          _error(error), _done(done)
+        {
+            setAutoDelete(true);
+        }
+
+    virtual void run()
+        {
+            try {
+                _fn(_chunk, _begin, _end);
+            } catch (...) {
+                _error = current_exception();
+            }
+            _done.release();
+        }
+
+private:
+    const function<void(size_t, size_t, size_t)>& _fn;
+    size_t _chunk;
+    size_t _begin;
+    size_t _end;
+    exception_ptr& _error;
+    QSemaphore& _done;
+};
+
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+size_t ShipCAD::ParallelChunks(size_t count, size_t grain)
+{
+    if (grain == 0)
+        grain = 1;
+    size_t threads = static_cast<size_t>(max(1, QThread::idealThreadCount()));
+    size_t chunks = (count + grain - 1) / grain;
+    return max(static_cast<size_t>(1), min(chunks, threads));
+}
+
+void ShipCAD::ParallelFor(size_t count, size_t grain,
+                          const function<void(size_t, size_t, size_t)>& fn,
+                          bool parallel)
+{
+    if (count == 0)
+        return;
+    size_t chunks = ParallelChunks(count, grain);
+    size_t size = count / chunks;
+    size_t extra = count % chunks;
+    if (!parallel || chunks == 1) {
+        size_t begin = 0;
+        for (size_t i=0; i<chunks; ++i) {
+            size_t end = begin + size + (i < extra ? 1 : 0);
+            fn(i, begin, end);
+            begin = end;
+        }
+        return;
+    }
+    // one error slot per chunk, so that the threads don't share one
+    vector<exception_ptr> errors(chunks);
+    QSemaphore done;
+    QThreadPool* pool = QThreadPool::globalInstance();
+    size_t begin = 0;
+    for (size_t i=0; i<chunks-1; ++i) {
+        size_t end = begin + size + (i < extra ? 1 : 0);
+        ChunkRunner* runner = new ChunkRunner(fn, i, begin, end, errors[i], done);
+        if (!pool->tryStart(runner)) {
+            runner->run();
+            delete runner;
+        }
+        begin = end;
+    }
+    try {
+        fn(chunks - 1, begin, count);
+    } catch (...) {
+        errors[chunks - 1] = current_exception();
+    }
+    done.acquire(static_cast<int>(chunks - 1));
+    for (size_t i=0; i<chunks; ++i)
+        if (errors[i])
+            rethrow_exception(errors[i]);
+}
@@ -0,0 +1,61 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief number of chunks ParallelFor will split a range into
+ *
+ * \param count number of elements in the range
+ * \param grain smallest number of elements worth giving to a thread
+ * \return the number of chunks, at least 1
+ */
+size_t ParallelChunks(size_t count, size_t grain);
+
+/*! \brief run a function over a range of indices on the global thread pool
+ *
+ * The range [0, count) is split into ParallelChunks(count, grain)
+ * contiguous chunks, chunk i is passed to fn as (i, begin, end). The
+ * calling thread runs the last chunk itself and waits for the
+ * others. If the thread pool has no free thread, a chunk is run on
+ * the calling thread instead, so nested calls can not deadlock. An
+ * exception thrown by fn is rethrown in the calling thread after all
+ * chunks have finished.
+ *
+ * \param count number of elements in the range
+ * \param grain smallest number of elements worth giving to a thread
+ * \param fn function called for each chunk
+ * \param parallel if false, run all chunks in order on the calling thread
+ */
+void ParallelFor(size_t count, size_t grain,
+                 const std::function<void(size_t chunk, size_t begin, size_t end)>& fn,
+                 bool parallel = true);
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -0,0 +1,202 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+#include "picktree.h"
+#include "utility.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+// largest number of items in a leaf
+static const size_t k_leaf_size = 4;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+// orders items on the centre of their box along one axis
+struct CentreLess
+{
+    const vector<QVector3D>& mins;
+    const vector<QVector3D>& maxs;
+    int axis;
+
+    CentreLess(const vector<QVector3D>& lo, const vector<QVector3D>& hi, int ax)
+        : mins(lo), maxs(hi), axis(ax) {}
+    bool operator()(size_t a, size_t b) const
+        { return mins[a][axis] + maxs[a][axis] < mins[b][axis] + maxs[b][axis]; }
+};
+
+// parameters where the line enters and leaves the box, false if it misses
+static bool LineBox(const QVector3D& pt, const QVector3D& dir,
+                    const QVector3D& boxmin, const QVector3D& boxmax, float radius,
+                    float& tenter, float& texit)
+{
+    tenter = -numeric_limits<float>::max();
+    texit = numeric_limits<float>::max();
+    for (int i=0; i<3; ++i) {
+        float lo = boxmin[i] - radius;
+        float hi = boxmax[i] + radius;
+        if (fabs(dir[i]) < 1E-12) {
+            // parallel to this slab
+            if (pt[i] < lo || pt[i] > hi)
+                return false;
+            continue;
+        }
+        float t1 = (lo - pt[i]) / dir[i];
+        float t2 = (hi - pt[i]) / dir[i];
+        if (t1 > t2)
+            swap(t1, t2);
+        tenter = max(tenter, t1);
+        texit = min(texit, t2);
+        if (tenter > texit)
+            return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+PickTree::PickTree()
+{
+    // does nothing
+}
+
+void PickTree::clear()
+{
+    _nodes.clear();
+    _items.clear();
+    _mins.clear();
+    _maxs.clear();
+}
+
+void PickTree::build(const vector<QVector3D>& mins, const vector<QVector3D>& maxs)
+{
+    if (mins.size() != maxs.size())
+        throw invalid_argument("PickTree::build box corners don't match");
+    clear();
+    if (mins.empty())
+        return;
+    _items.resize(mins.size());
+    for (size_t i=0; i<_items.size(); ++i)
+        _items[i] = i;
+    _nodes.reserve(2 * (mins.size() / k_leaf_size + 1));
+    buildNode(mins, maxs, 0, _items.size());
+    _mins = mins;
+    _maxs = maxs;
+}
+
+size_t PickTree::buildNode(const vector<QVector3D>& mins, const vector<QVector3D>& maxs,
+                           size_t begin, size_t end)
+{
+    size_t index = _nodes.size();
+    _nodes.push_back(Node());
+    QVector3D min = mins[_items[begin]];
+    QVector3D max = maxs[_items[begin]];
+    QVector3D cmin = 0.5 * (min + max);
+    QVector3D cmax = cmin;
+    for (size_t i=begin; i<end; ++i) {
+        MinMax(mins[_items[i]], min, max);
+        MinMax(maxs[_items[i]], min, max);
+        MinMax(0.5 * (mins[_items[i]] + maxs[_items[i]]), cmin, cmax);
+    }
+    _nodes[index].min = min;
+    _nodes[index].max = max;
+    if (end - begin <= k_leaf_size) {
+        _nodes[index].first = begin;
+        _nodes[index].count = end - begin;
+        return index;
+    }
+    // split at the median along the axis the centres spread most
+    QVector3D size = cmax - cmin;
+    int axis = 0;
+    if (size.y() > size[axis])
+        axis = 1;
+    if (size.z() > size[axis])
+        axis = 2;
+    size_t mid = begin + (end - begin) / 2;
+    nth_element(_items.begin() + begin, _items.begin() + mid, _items.begin() + end,
+                CentreLess(mins, maxs, axis));
+    buildNode(mins, maxs, begin, mid);
+    size_t right = buildNode(mins, maxs, mid, end);
+    _nodes[index].first = right;
+    _nodes[index].count = 0;
+    return index;
+}
+
+void PickTree::refit(const vector<QVector3D>& mins, const vector<QVector3D>& maxs)
+{
+    if (mins.size() != _items.size() || maxs.size() != _items.size())
+        throw invalid_argument("PickTree::refit number of boxes changed");
+    _mins = mins;
+    _maxs = maxs;
+    // children come after their parent, so go backwards
+    for (size_t i=_nodes.size(); i-->0; ) {
+        Node& node = _nodes[i];
+        if (node.count > 0) {
+            node.min = mins[_items[node.first]];
+            node.max = maxs[_items[node.first]];
+            for (size_t j=node.first; j<node.first+node.count; ++j) {
+                MinMax(mins[_items[j]], node.min, node.max);
+                MinMax(maxs[_items[j]], node.min, node.max);
+            }
+        }
+        else {
+            const Node& left = _nodes[i+1];
+            const Node& right = _nodes[node.first];
+            node.min = left.min;
+            node.max = left.max;
+            MinMax(right.min, node.min, node.max);
+            MinMax(right.max, node.min, node.max);
+        }
+    }
+}
+
+void PickTree::query(const QVector3D& pt, const QVector3D& dir, float radius,
+                     vector<Candidate>& hits) const
+{
+    hits.clear();
+    if (_nodes.empty())
+        return;
+    vector<size_t> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        size_t index = stack.back();
+        stack.pop_back();
+        const Node& node = _nodes[index];
+        float tenter, texit;
+        if (!LineBox(pt, dir, node.min, node.max, radius, tenter, texit))
+            continue;
+        if (node.count > 0) {
+            for (size_t j=node.first; j<node.first+node.count; ++j) {
+                size_t item = _items[j];
+                if (LineBox(pt, dir, _mins[item], _maxs[item], radius, tenter, texit))
+                    hits.push_back(make_pair(tenter, item));
+            }
+        }
+        else {
+            stack.push_back(node.first);
+            stack.push_back(index + 1);
+        }
+    }
+    sort(hits.begin(), hits.end());
+}
@@ -0,0 +1,104 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef PICKTREE_H_
+#define PICKTREE_H_
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <QVector3D>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief bounding volume hierarchy used to pick elements with a ray
+ *
+ * The tree holds one axis aligned box for each item, items are
+ * numbered in the order their boxes were given to build. A query
+ * returns the items whose box the pick ray passes close to, the exact
+ * test is left to the caller. When only the coordinates change, refit
+ * grows and shrinks the boxes but keeps the tree.
+ */
+class PickTree
+{
+public:
+
+    /*! \brief an item hit by a query, the distance along the ray where
+     * the ray enters its box, and the item number
+     */
+    typedef std::pair<float, size_t> Candidate;
+
+    PickTree();
+    ~PickTree() {}
+
+    /*! \brief remove all items
+     */
+    void clear();
+    /*! \brief make the tree
+     *
+     * \param mins the smallest corner of the box of each item
+     * \param maxs the largest corner of the box of each item
+     */
+    void build(const std::vector<QVector3D>& mins, const std::vector<QVector3D>& maxs);
+    /*! \brief change the boxes of the items, keeping the tree
+     *
+     * \param mins the smallest corner of the box of each item
+     * \param maxs the largest corner of the box of each item
+     */
+    void refit(const std::vector<QVector3D>& mins, const std::vector<QVector3D>& maxs);
+    /*! \brief find the items the line through a point may pick
+     *
+     * \param pt a point on the line
+     * \param dir direction of the line
+     * \param radius the boxes are grown by this much
+     * \param hits the items, nearest entry point first
+     */
+    void query(const QVector3D& pt, const QVector3D& dir, float radius,
+               std::vector<Candidate>& hits) const;
+
+    // getters
+    size_t numberOfItems() const { return _items.size(); }
+    size_t numberOfNodes() const { return _nodes.size(); }
+
+private:
+
+    struct Node
+    {
+        QVector3D min;
+        QVector3D max;
+        size_t first;           // leaf: first entry in _items, else index of the right child
+        size_t count;           // leaf: number of items, 0 for an inner node
+    };
+
+    size_t buildNode(const std::vector<QVector3D>& mins, const std::vector<QVector3D>& maxs,
+                     size_t begin, size_t end);
+
+    std::vector<Node> _nodes;   // depth first, the left child follows its parent
+    std::vector<size_t> _items; // item numbers, in leaf order
+    std::vector<QVector3D> _mins;       // box of each item
+    std::vector<QVector3D> _maxs;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -0,0 +1,70 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <stdexcept>
+#include <cmath>
+
+#include "pointgrid.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+PointGrid::PointGrid(float cellsize)
+    : _cell_size(cellsize)
+{
+    if (cellsize <= 0)
+        throw invalid_argument("PointGrid cell size must be positive");
+}
+
+void PointGrid::clear()
+{
+    _cells.clear();
+}
+
+PointGrid::Cell PointGrid::cellOf(const QVector3D& coord) const
+{
+    // in double, so points closer than a cell are never two cells apart
+    Cell c;
+    c.x = static_cast<int>(floor(static_cast<double>(coord.x()) / _cell_size));
+    c.y = static_cast<int>(floor(static_cast<double>(coord.y()) / _cell_size));
+    c.z = static_cast<int>(floor(static_cast<double>(coord.z()) / _cell_size));
+    return c;
+}
+
+void PointGrid::insert(const QVector3D& coord, size_t item)
+{
+    _cells[cellOf(coord)].push_back(item);
+}
+
+void PointGrid::find(const QVector3D& coord, vector<size_t>& items) const
+{
+    Cell centre = cellOf(coord);
+    Cell c;
+    for (c.x=centre.x-1; c.x<=centre.x+1; ++c.x) {
+        for (c.y=centre.y-1; c.y<=centre.y+1; ++c.y) {
+            for (c.z=centre.z-1; c.z<=centre.z+1; ++c.z) {
+                CellMap::const_iterator i = _cells.find(c);
+                if (i != _cells.end())
+                    items.insert(items.end(), (*i).second.begin(), (*i).second.end());
+            }
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef POINTGRID_H_
+#define POINTGRID_H_
+
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+#include <QVector3D>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief spatial hash of numbered points
+ *
+ * Used to find the ends of curves or segments that may join. Space is
+ * divided into cubes of equal size, finding the points near a
+ * coordinate looks in the cube it falls in and the 26 around it, so
+ * every point closer than the cube size is found. Points farther away
+ * may be found too, the caller has to check the distance.
+ */
+class PointGrid
+{
+public:
+
+    /*! \brief Constructor
+     *
+     * \param cellsize size of the cubes, the distance searched for
+     */
+    explicit PointGrid(float cellsize);
+    ~PointGrid() {}
+
+    /*! \brief remove all points
+     */
+    void clear();
+    /*! \brief add a point
+     *
+     * \param coord where the point is
+     * \param item the number of the point
+     */
+    void insert(const QVector3D& coord, size_t item);
+    /*! \brief find the points near a coordinate
+     *
+     * \param coord the coordinate
+     * \param items the numbers of the points found are added to this,
+     * a point added more than once is found more than once
+     */
+    void find(const QVector3D& coord, std::vector<size_t>& items) const;
+
+private:
+
+    struct Cell
+    {
+        int x, y, z;
+        bool operator==(const Cell& other) const
+            { return x == other.x && y == other.y && z == other.z; }
+    };
+    struct CellHash
+    {
+        size_t operator()(const Cell& c) const
+            { return (static_cast<size_t>(c.x) * 73856093u)
+                    ^ (static_cast<size_t>(c.y) * 19349663u)
+                    ^ (static_cast<size_t>(c.z) * 83492791u); }
+    };
+    typedef std::unordered_map<Cell, std::vector<size_t>, CellHash> CellMap;
+
+    Cell cellOf(const QVector3D& coord) const;
+
+    double _cell_size;
+    CellMap _cells;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -0,0 +1,124 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cmath>
+
+#include "pointhash.h"
+#include "subdivpoint.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+static bool CloserThan(const pair<float, SubdivisionControlPoint*>& a,
+                       const pair<float, SubdivisionControlPoint*>& b)
+{
+    return a.first < b.first;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+PointHash::PointHash(float cellsize)
+    : _cell_size(cellsize), _size(0)
+{
+    if (cellsize <= 0)
+        throw invalid_argument("PointHash cell size must be positive");
+}
+
+void PointHash::clear()
+{
+    _cells.clear();
+    _size = 0;
+}
+
+PointHash::Cell PointHash::cellOf(const QVector3D& coord) const
+{
+    Cell c;
+    c.x = static_cast<int>(floor(coord.x() / _cell_size));
+    c.y = static_cast<int>(floor(coord.y() / _cell_size));
+    c.z = static_cast<int>(floor(coord.z() / _cell_size));
+    return c;
+}
+
+void PointHash::insert(SubdivisionControlPoint* pt)
+{
+    _cells[cellOf(pt->getCoordinate())].push_back(pt);
+    ++_size;
+}
+
+bool PointHash::remove(SubdivisionControlPoint* pt, const QVector3D& coord)
+{
+    CellMap::iterator i = _cells.find(cellOf(coord));
+    if (i == _cells.end())
+        return false;
+    vector<SubdivisionControlPoint*>& points = (*i).second;
+    vector<SubdivisionControlPoint*>::iterator j = std::find(points.begin(), points.end(), pt);
+    if (j == points.end())
+        return false;
+    points.erase(j);
+    if (points.empty())
+        _cells.erase(i);
+    --_size;
+    return true;
+}
+
+void PointHash::move(SubdivisionControlPoint* pt, const QVector3D& from)
+{
+    Cell c1 = cellOf(from);
+    Cell c2 = cellOf(pt->getCoordinate());
+    if (c1 == c2)
+        return;
+    if (remove(pt, from))
+        insert(pt);
+}
+
+void PointHash::find(const QVector3D& coord, float distance,
+                     vector<SubdivisionControlPoint*>& result) const
+{
+    result.clear();
+    vector<pair<float, SubdivisionControlPoint*> > found;
+    Cell lo = cellOf(coord - QVector3D(distance, distance, distance));
+    Cell hi = cellOf(coord + QVector3D(distance, distance, distance));
+    float limit = distance * distance;
+    Cell c;
+    for (c.x=lo.x; c.x<=hi.x; ++c.x) {
+        for (c.y=lo.y; c.y<=hi.y; ++c.y) {
+            for (c.z=lo.z; c.z<=hi.z; ++c.z) {
+                CellMap::const_iterator i = _cells.find(c);
+                if (i == _cells.end())
+                    continue;
+                const vector<SubdivisionControlPoint*>& points = (*i).second;
+                for (size_t j=0; j<points.size(); ++j) {
+                    float d = (points[j]->getCoordinate() - coord).lengthSquared();
+                    if (d <= limit)
+                        found.push_back(make_pair(d, points[j]));
+                }
+            }
+        }
+    }
+    // stable, so points at the same place come in the order they were added
+    stable_sort(found.begin(), found.end(), CloserThan);
+    result.reserve(found.size());
+    for (size_t i=0; i<found.size(); ++i)
+        result.push_back(found[i].second);
+}
@@ -0,0 +1,116 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef POINTHASH_H_
+#define POINTHASH_H_
+
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+#include <QVector3D>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+class SubdivisionControlPoint;
+
+/*! \brief spatial hash of control points
+ *
+ * Space is divided into cubes of equal size, each point is kept in the
+ * cube its coordinate falls in. Finding the points near a coordinate
+ * only looks at the cubes around it, so it doesn't depend on the
+ * number of points. The hash has to be told when a point moves.
+ */
+class PointHash
+{
+public:
+
+    /*! \brief Constructor
+     *
+     * \param cellsize size of the cubes, best the distance searched for
+     */
+    explicit PointHash(float cellsize);
+    ~PointHash() {}
+
+    /*! \brief remove all points
+     */
+    void clear();
+    /*! \brief add a point at its coordinate
+     *
+     * \param pt the point
+     */
+    void insert(SubdivisionControlPoint* pt);
+    /*! \brief remove a point
+     *
+     * \param pt the point
+     * \param coord the coordinate the point was added or last moved to
+     * \return false if the point wasn't there
+     */
+    bool remove(SubdivisionControlPoint* pt, const QVector3D& coord);
+    /*! \brief a point has moved, put it in its new cube
+     *
+     * Points which aren't in the hash are left out
+     *
+     * \param pt the point, at its new coordinate
+     * \param from the coordinate before the move
+     */
+    void move(SubdivisionControlPoint* pt, const QVector3D& from);
+    /*! \brief find the points near a coordinate
+     *
+     * \param coord the coordinate
+     * \param distance largest distance from the coordinate
+     * \param result the points, nearest first
+     */
+    void find(const QVector3D& coord, float distance,
+              std::vector<SubdivisionControlPoint*>& result) const;
+
+    // getters
+    size_t size() const { return _size; }
+    float getCellSize() const { return _cell_size; }
+
+private:
+
+    struct Cell
+    {
+        int x, y, z;
+        bool operator==(const Cell& other) const
+            { return x == other.x && y == other.y && z == other.z; }
+    };
+    struct CellHash
+    {
+        size_t operator()(const Cell& c) const
+            { return (static_cast<size_t>(c.x) * 73856093u)
+                    ^ (static_cast<size_t>(c.y) * 19349663u)
+                    ^ (static_cast<size_t>(c.z) * 83492791u); }
+    };
+    typedef std::unordered_map<Cell, std::vector<SubdivisionControlPoint*>, CellHash> CellMap;
+
+    Cell cellOf(const QVector3D& coord) const;
+
+    float _cell_size;
+    size_t _size;
+    CellMap _cells;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -31,42 +31,6 @@ namespace ShipCAD {
     
 //////////////////////////////////////////////////////////////////////////////////////
 
-// predicate class to find an element with given point
-struct FirstPointPairPredicate {
-    ShipCAD::SubdivisionPoint* _querypt;
-    bool operator()(const std::pair<ShipCAD::SubdivisionPoint*,
-                    ShipCAD::SubdivisionPoint*>& val)
-    {
-        return val.first == _querypt;
-    }
-    FirstPointPairPredicate (ShipCAD::SubdivisionPoint* querypt)
-        : _querypt(querypt) {}
-};
-
-// predicate class to find an element with given face
-struct FirstFacePointPredicate {
-    ShipCAD::SubdivisionFace* _queryface;
-    bool operator()(const std::pair<ShipCAD::SubdivisionFace*,
-                    ShipCAD::SubdivisionPoint*>& val)
-    {
-        return val.first == _queryface;
-    }
-    FirstFacePointPredicate (ShipCAD::SubdivisionFace* queryface)
-        : _queryface(queryface) {}
-};
-
-// predicate class to find an element with given edge
-struct FirstEdgePointPredicate {
-    ShipCAD::SubdivisionEdge* _queryedge;
-    bool operator()(const std::pair<ShipCAD::SubdivisionEdge*,
-                    ShipCAD::SubdivisionPoint*>& val)
-    {
-        return val.first == _queryedge;
-    }
-    FirstEdgePointPredicate (ShipCAD::SubdivisionEdge* queryedge)
-        : _queryedge(queryedge) {}
-};
-
 // predicate class to find an element with given point
 struct FirstCPointPairPredicate {
     ShipCAD::SubdivisionControlPoint* _querypt;
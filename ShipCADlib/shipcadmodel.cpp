@@ -47,14 +47,18 @@
 #include "iges.h"
 #include "grid.h"
 #include "exception.h"
+#include "parallel.h"
 
 using namespace std;
 using namespace ShipCAD;
 using namespace Eigen;
 
+// number of intersection planes given to a thread at a time
+static const size_t k_intersection_grain = 2;
+
 ShipCADModel::ShipCADModel()
     : _precision(fpLow), _file_version(k_current_version), _edit_mode(emSelectItems), _prefs(this),
-      _active_control_point(0), _file_changed(false), _filename(""),
+      _active_control_point(0), _file_changed(false), _live_hydrostatics(this), _filename(""),
       _stations(true), _waterlines(true), _buttocks(true), _diagonals(true),
       _markers(true), _vis(this), _filename_set(false), _currently_moving(false),
       _stop_asking_for_file_version(false), _settings(this), _calculations(true),
@@ -175,20 +179,32 @@ void ShipCADModel::extents(QVector3D& min, QVector3D& max)
 void ShipCADModel::setBuild(bool set)
 {
     _surface.setBuild(set);
-    if (!set) {
-        for (size_t i=0; i<getStations().size(); i++)
-            getStations().get(i)->setBuild(false);
-        for (size_t i=0; i<getButtocks().size(); i++)
-            getButtocks().get(i)->setBuild(false);
-        for (size_t i=0; i<getWaterlines().size(); i++)
-            getWaterlines().get(i)->setBuild(false);
-        for (size_t i=0; i<getDiagonals().size(); i++)
-            getDiagonals().get(i)->setBuild(false);
-        for (size_t i=0; i<getHydrostaticCalculations().size(); i++)
-            getHydrostaticCalculations().get(i)->setCalculated(false);
-        for (size_t i=0; i<_flowlines.size(); i++)
-            _flowlines.get(i)->setBuild(false);
-    }
+    if (!set)
+        invalidateSurfaceData();
+}
+
+void ShipCADModel::controlPointsMoved()
+{
+    // the surface already knows which points moved
+    invalidateSurfaceData();
+}
+
+void ShipCADModel::invalidateSurfaceData()
+{
+    for (size_t i=0; i<getStations().size(); i++)
+        getStations().get(i)->setBuild(false);
+    for (size_t i=0; i<getButtocks().size(); i++)
+        getButtocks().get(i)->setBuild(false);
+    for (size_t i=0; i<getWaterlines().size(); i++)
+        getWaterlines().get(i)->setBuild(false);
+    for (size_t i=0; i<getDiagonals().size(); i++)
+        getDiagonals().get(i)->setBuild(false);
+    for (size_t i=0; i<getHydrostaticCalculations().size(); i++)
+        getHydrostaticCalculations().get(i)->setCalculated(false);
+    for (size_t i=0; i<_flowlines.size(); i++)
+        _flowlines.get(i)->setBuild(false);
+    // kept to see if the faces changed when copied again
+    _hydrostatic_mesh.invalidate();
 }
 
 void ShipCADModel::rebuildModel(bool redo_intersections)
@@ -219,15 +235,73 @@ void ShipCADModel::rebuildModel(bool redo_intersections)
     }
     _surface.setDesiredSubdivisionLevel(static_cast<int>(_precision)+1);
     _surface.rebuild();
+    if (redo_intersections)
+        rebuildIntersections();
+}
+
+void ShipCADModel::rebuildIntersections()
+{
+    rebuildIntersections(true, true, true, true);
+}
+
+void ShipCADModel::rebuildIntersections(bool stations, bool buttocks, bool waterlines,
+                                        bool diagonals)
+{
+    vector<Intersection*> pending;
+    IntersectionVector* lists[] = { &_stations, &_buttocks, &_waterlines, &_diagonals };
+    bool use[] = { stations, buttocks, waterlines, diagonals };
+    for (size_t i=0; i<4; ++i)
+        for (size_t j=0; j<lists[i]->size() && use[i]; ++j)
+            if (!lists[i]->get(j)->isBuild())
+                pending.push_back(lists[i]->get(j));
+    if (pending.empty())
+        return;
+    // the threads only read the surface
+    if (!_surface.isBuild())
+        _surface.rebuild();
+    vector<Intersection*> batch, rest;
+    while (!pending.empty()) {
+        // all with the same normal and the same layers as the first
+        Plane first = pending[0]->getPlane();
+        bool hydrostatics = pending[0]->useHydrostaticsSurfacesOnly();
+        batch.clear();
+        rest.clear();
+        for (size_t i=0; i<pending.size(); ++i) {
+            Plane pln = pending[i]->getPlane();
+            if (pln.a() == first.a() && pln.b() == first.b() && pln.c() == first.c()
+                    && pending[i]->useHydrostaticsSurfacesOnly() == hydrostatics)
+                batch.push_back(pending[i]);
+            else
+                rest.push_back(pending[i]);
+        }
+        for (size_t i=0; i<batch.size(); ++i)
+            batch[i]->setBuild(false);
+        // each thread cuts its neighbouring planes in one pass
+        ParallelFor(batch.size(), k_intersection_grain,
+                    [&](size_t, size_t begin, size_t end) {
+                        vector<Plane> planes;
+                        vector<SplineVector*> destinations;
+                        for (size_t i=begin; i<end; ++i) {
+                            planes.push_back(batch[i]->getPlane());
+                            destinations.push_back(&batch[i]->getSplines());
+                        }
+                        _surface.intersectPlanes(planes, hydrostatics, destinations);
+                        for (size_t i=begin; i<end; ++i)
+                            batch[i]->finishRebuild();
+                    }, _surface.isParallelSubdivision());
+        pending.swap(rest);
+    }
 }
 
 void ShipCADModel::setPrecision(precision_t precision)
 {
     if (_precision != precision) {
         _precision = precision;
+        // the surface keeps the levels it has subdivided, only what was
+        // made from the surface has to be redone
         _surface.setDesiredSubdivisionLevel(static_cast<int>(_precision) + 1);
         setFileChanged(true);
-        setBuild(false);
+        invalidateSurfaceData();
     }
 }
 
@@ -681,6 +755,10 @@ struct draw_intersection
 // FreeShipUnit.pas:12186
 void ShipCADModel::draw(Viewport& vp)
 {
+    // intersections are only drawn in wireframe, build the visible ones together
+    if (vp.getViewportMode() == vmWireFrame)
+        rebuildIntersections(_vis.isShowStations(), _vis.isShowButtocks(),
+                             _vis.isShowWaterlines(), _vis.isShowDiagonals());
     LineShader* lineshader = vp.setLineShader();
     draw_intersection di(vp, lineshader);
     // draw intersection lines BEFORE the surface is drawn
@@ -1085,6 +1163,13 @@ float ShipCADModel::findLowestHydrostaticsPoint() const
     return result;
 }
 
+const HydrostaticMesh& ShipCADModel::getHydrostaticMesh()
+{
+    if (!_hydrostatic_mesh.isValid(_surface))
+        _hydrostatic_mesh.update(_surface, findLowestHydrostaticsPoint());
+    return _hydrostatic_mesh;
+}
+
 void ShipCADModel::setFileVersion(version_t v)
 {
     if (v != _file_version) {
@@ -45,6 +45,8 @@
 #include "preferences.h"
 #include "marker.h"
 #include "subdivsurface.h"
+#include "hydrostaticmesh.h"
+#include "hydrostaticscache.h"
 #include "resistance.h"
 #include "flowline.h"
 #include "backgroundimage.h"
@@ -98,6 +100,12 @@ public:
     // getBackgroundImage()
     bool isBuild() const {return _surface.isBuild();}
     void setBuild(bool set);
+    /*! \brief control points were moved, but the topology is the same
+     *
+     * Like setBuild(false), but the surface keeps its subdivision so
+     * it can update only the subdivided points
+     */
+    void controlPointsMoved();
 
     /*! \brief scale the entire model and all associated data such as sttions
      *
@@ -284,6 +292,27 @@ public:
      * \return lowest point of hull
      */
     float findLowestHydrostaticsPoint() const;
+    /*! \brief get the faces used in hydrostatics
+     *
+     * Copied from the surface when it has been rebuilt since the last
+     * call, so get it before starting calculations on other threads.
+     * After a rebuild for moved control points only the faces around
+     * them are copied again.
+     *
+     * \return the faces of the layers used in hydrostatics
+     */
+    const HydrostaticMesh& getHydrostaticMesh();
+    /*! \brief get the hydrostatics calculated before
+     *
+     * \return the results of calculations and balances, by the revision
+     * of the hydrostatic mesh they were calculated on
+     */
+    HydrostaticsCache& getHydrostaticsCache() {return _hydrostatics_cache;}
+    /*! \brief get the hydrostatics updated while control points are dragged
+     *
+     * \return the hydrostatics summed over the control faces
+     */
+    LiveHydrostatics& getLiveHydrostatics() {return _live_hydrostatics;}
     
     void loadBinary(FileBuffer& source);
     void saveBinary(FileBuffer& dest);
@@ -333,6 +362,22 @@ public:
     void importChines(size_t np, SplineVector& chines);
     
     void rebuildModel(bool redo_intersections);
+    /*! \brief rebuild the stations, buttocks, waterlines and diagonals
+     * that aren't built
+     *
+     * Intersections with parallel planes are cut from the surface
+     * together, spread over the thread pool when the surface subdivides
+     * in parallel
+     */
+    void rebuildIntersections();
+    /*! \brief rebuild the intersections of some kinds that aren't built
+     *
+     * \param stations rebuild the stations
+     * \param buttocks rebuild the buttocks
+     * \param waterlines rebuild the waterlines
+     * \param diagonals rebuild the diagonals
+     */
+    void rebuildIntersections(bool stations, bool buttocks, bool waterlines, bool diagonals);
 
     void drawWithPainter(Viewport& vp, QPainter* painter);
     void draw(Viewport& vp);
@@ -362,6 +407,8 @@ protected:
      * \return the undo object
      */
     UndoObject* createRedo();
+    // intersections, hydrostatics and flowlines need to be done again
+    void invalidateSurfaceData();
 
 private:
 
@@ -377,6 +424,9 @@ private:
     SubdivisionControlPoint* _active_control_point;
     bool _file_changed;
     SubdivisionSurface _surface;
+    HydrostaticMesh _hydrostatic_mesh;
+    HydrostaticsCache _hydrostatics_cache;
+    LiveHydrostatics _live_hydrostatics;
     QString _filename;
     IntersectionVector _stations;
     IntersectionVector _waterlines;
@@ -70,6 +70,12 @@ public:
     void addPoint(SubdivisionControlPoint* p);
     virtual void clear();
     void resetDivPoints();
+    /*! \brief use the subdivided points of another level
+     *
+     * \param points the subdivided points along the curve
+     */
+    void setSubdivPoints(const std::vector<SubdivisionPoint*>& points)
+        { _div_points = points; _build = false; }
 
     // getters/setters
     bool isSelected() const;
@@ -80,6 +86,7 @@ public:
     size_t numberOfSubdivPoints() const { return _div_points.size(); }
     SubdivisionControlPoint* getControlPoint(size_t index) const;
     SubdivisionPoint* getSubdivPoint(size_t index) const;
+    const std::vector<SubdivisionPoint*>& getSubdivPoints() const { return _div_points; }
     void setVisible(bool val);
     void setBuild(bool val) { _build = val; }
     void setSelected(bool val);
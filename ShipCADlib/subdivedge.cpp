@@ -57,7 +57,8 @@ SubdivisionEdge* SubdivisionEdge::construct(SubdivisionSurface* owner)
 }
 
 SubdivisionEdge::SubdivisionEdge(SubdivisionSurface* owner)
-    : SubdivisionBase(owner), _crease(false), _control_edge(false), _curve(0)
+    : SubdivisionBase(owner), _crease(false), _control_edge(false), _net_edge(false),
+      _curve(0)
 {
 	// does nothing
 }
@@ -76,8 +77,15 @@ void SubdivisionEdge::clear()
     _control_edge = false;
 }
 
-// algorithm from http://geomalgorithms.com/a07-_distance.html#Distance-between-Segments-and-Rays
 float SubdivisionEdge::distanceToEdge(const QVector3D& pt, const QVector3D& dir) const
+{
+    float depth;
+    return distanceToEdge(pt, dir, depth);
+}
+
+// algorithm from http://geomalgorithms.com/a07-_distance.html#Distance-between-Segments-and-Rays
+float SubdivisionEdge::distanceToEdge(const QVector3D& pt, const QVector3D& dir,
+                                      float& depth) const
 {
     QVector3D l2p1 = pt + 1000*dir;
     QVector3D u = _points[1]->getCoordinate() - _points[0]->getCoordinate();
@@ -143,6 +151,7 @@ float SubdivisionEdge::distanceToEdge(const QVector3D& pt, const QVector3D& dir)
     // get the difference of the two closest points
     QVector3D dP = w + (sc * u) - (tc * v);   // = S1(sc) - S2(sc)
 
+    depth = tc * v.length();
     return dP.length();
 }
 
@@ -285,17 +294,28 @@ void SubdivisionEdge::addFace(SubdivisionFace* face)
 }
 
 SubdivisionPoint* SubdivisionEdge::calculateEdgePoint()
+{
+    SubdivisionPoint* result = createEdgePoint(_owner->getPointPool().add());
+    insertInCurve(result);
+    return result;
+}
+
+SubdivisionPoint* SubdivisionEdge::createEdgePoint(void* mem) const
 {
     QVector3D point = 0.5 * (startPoint()->getCoordinate() + endPoint()->getCoordinate());
-    SubdivisionPoint* result = SubdivisionPoint::construct(_owner);
+    SubdivisionPoint* result = SubdivisionPoint::construct(_owner, mem);
     if (_crease)
         result->setVertexType(svCrease);
-    if (_curve)
-        _curve->insertEdgePoint(startPoint(), endPoint(), result);
     result->setCoordinate(point);
     return result;
 }
 
+void SubdivisionEdge::insertInCurve(SubdivisionPoint* edgepoint)
+{
+    if (_curve)
+        _curve->insertEdgePoint(startPoint(), endPoint(), edgepoint);
+}
+
 void SubdivisionEdge::swapData()
 {
     swap(_points[0], _points[1]);
@@ -304,7 +324,7 @@ void SubdivisionEdge::swapData()
 void SubdivisionEdge::deleteFace(SubdivisionFace* face)
 {
     if (hasFace(face)) {
-        vector<SubdivisionFace*>::iterator del = find(_faces.begin(), _faces.end(), face);
+        AdjacencyList<SubdivisionFace*>::iterator del = find(_faces.begin(), _faces.end(), face);
         _faces.erase(del);
         if (_faces.size() == 1)
             _crease = true;
@@ -432,6 +452,7 @@ SubdivisionControlEdge::SubdivisionControlEdge(SubdivisionSurface* owner)
     : SubdivisionEdge(owner), _visible(true)
 {
     _control_edge = true;
+    _net_edge = true;
 }
 
 void SubdivisionControlEdge::removeEdge()
@@ -627,7 +648,7 @@ void SubdivisionControlEdge::priv_trace(SubdivisionControlPoint* p)
         // find next edge
         for (size_t i=0; i<p->numberOfEdges(); ++i) {
             if (p->getEdge(i) != this) {
-                edge = dynamic_cast<SubdivisionControlEdge*>(p->getEdge(i));
+                edge = p->getEdge(i)->asControlEdge();
                 if (edge->isSelected() != isSelected() && edge->isCrease() == isCrease()) {
                     bool shares_face = false;
                     for (size_t j=0; j<numberOfFaces(); ++j) {
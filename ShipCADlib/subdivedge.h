@@ -36,6 +36,7 @@
 #include <QColor>
 
 #include "subdivbase.h"
+#include "adjacency.h"
 
 namespace ShipCAD {
 
@@ -44,6 +45,7 @@ namespace ShipCAD {
 class SubdivisionPoint;
 class SubdivisionControlPoint;
 class SubdivisionControlCurve;
+class SubdivisionControlEdge;
 class SubdivisionFace;
 class Viewport;
 class LineShader;
@@ -63,11 +65,33 @@ public:
                       const QColor& edgeColor);
 
     float distanceToEdge(const QVector3D& pt, const QVector3D& dir) const;
+    /*! \brief distance from a ray to this edge
+     *
+     * \param pt start of the ray
+     * \param dir direction of the ray
+     * \param depth distance along the ray to where it comes closest
+     * \return the distance
+     */
+    float distanceToEdge(const QVector3D& pt, const QVector3D& dir, float& depth) const;
     
     // modifiers
     void addFace(SubdivisionFace* face);
     void assign(SubdivisionEdge* edge);
     SubdivisionPoint* calculateEdgePoint();
+    /*! \brief make the edge point in memory already taken from the point pool
+     *
+     * Same as calculateEdgePoint, but the point is not added to the
+     * curve, use insertInCurve for that
+     *
+     * \param mem memory for the new point
+     * \return the midpoint of the edge
+     */
+    SubdivisionPoint* createEdgePoint(void* mem) const;
+    /*! \brief add the edge point to the curve of this edge, if any
+     *
+     * \param edgepoint the edge point made from this edge
+     */
+    void insertInCurve(SubdivisionPoint* edgepoint);
     void deleteFace(SubdivisionFace* face);
     void swapData();
 
@@ -77,6 +101,14 @@ public:
     virtual bool isBoundaryEdge() const;
     bool isControlEdge() const { return _control_edge; }
     void setControlEdge(bool val) { _control_edge = val; }
+    /*! \brief this edge as an edge of the control net
+     *
+     * Checks the type tag set by SubdivisionControlEdge, cheaper than
+     * a dynamic_cast
+     *
+     * \return the control edge, or 0 if this is a subdivided edge
+     */
+    SubdivisionControlEdge* asControlEdge();
     size_t numberOfFaces() const { return _faces.size(); }
     bool isCrease() const { return _crease; }
     void setCrease(bool val);
@@ -88,6 +120,12 @@ public:
     SubdivisionEdge* getNextEdge();
     void setPoints(SubdivisionPoint* p1, SubdivisionPoint* p2)
         { _points[0] = p1; _points[1] = p2; }
+    /*! \brief keep the face list in a slice of the level's block
+     *
+     * \param faces slice for the faces
+     * \param n number of faces expected
+     */
+    void useSlice(SubdivisionFace** faces, size_t n) { _faces.use(faces, n); }
 
     // output
     virtual void dump(std::ostream& os, const char* prefix = "") const;
@@ -102,9 +140,10 @@ protected:
 protected:
 
     SubdivisionPoint* _points[2];
-    std::vector<SubdivisionFace*> _faces;
+    AdjacencyList<SubdivisionFace*> _faces;
     bool _crease;
     bool _control_edge;
+    bool _net_edge;             /**< type tag, this is a SubdivisionControlEdge */
     SubdivisionControlCurve* _curve;
 };
 
@@ -160,6 +199,11 @@ protected:
 typedef std::vector<SubdivisionControlEdge*>::iterator subdivctledge_iter;
 typedef std::vector<SubdivisionControlEdge*>::const_iterator const_subdivctledge_iter;
 
+inline SubdivisionControlEdge* SubdivisionEdge::asControlEdge()
+{
+    return _net_edge ? static_cast<SubdivisionControlEdge*>(this) : 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 
 };				/* end namespace */
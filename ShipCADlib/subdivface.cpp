@@ -30,6 +30,7 @@
 #include <cmath>
 #include <stdexcept>
 #include <algorithm>
+#include <unordered_set>
 
 #include "subdivface.h"
 #include "subdivsurface.h"
@@ -43,7 +44,6 @@
 #include "shader.h"
 #include "grid.h"
 #include "viewportview.h"
-#include "predicate.h"
 #include "drawfaces.h"
 
 using namespace std;
@@ -57,15 +57,20 @@ SubdivisionFace* SubdivisionFace::construct(SubdivisionSurface* owner)
     return new (mem) SubdivisionFace(owner);
 }
 
+SubdivisionFace* SubdivisionFace::construct(SubdivisionSurface* owner, void* mem)
+{
+    return new (mem) SubdivisionFace(owner);
+}
+
 SubdivisionFace::SubdivisionFace(SubdivisionSurface* owner)
-    : SubdivisionBase(owner)
+    : SubdivisionBase(owner), _list_index(0)
 {
 	// does nothing
 }
 
 size_t SubdivisionFace::indexOfPoint(const SubdivisionPoint* pt) const
 {
-    vector<SubdivisionPoint*>::const_iterator i = find(_points.begin(), _points.end(), pt);
+    AdjacencyList<SubdivisionPoint*>::const_iterator i = find(_points.begin(), _points.end(), pt);
     return i - _points.begin();
 }
 
@@ -114,6 +119,14 @@ QVector3D SubdivisionFace::getFaceCenter() const
 }
 
 QVector3D SubdivisionFace::getFaceNormal() const
+{
+    QVector3D result;
+    if (_owner->cachedFaceNormal(this, result))
+        return result;
+    return calculateFaceNormal();
+}
+
+QVector3D SubdivisionFace::calculateFaceNormal() const
 {
     QVector3D result = ZERO;
     QVector3D c = ZERO;
@@ -166,7 +179,7 @@ void SubdivisionFace::addPoint(SubdivisionPoint *point)
 
 // algorithm from http://geomalgorithms.com/a06-_intersect.html
 static bool privIntersectWithRay(const PickRay& ray, const QVector3D& p1, const QVector3D& p2,
-                          const QVector3D& p3)
+                                 const QVector3D& p3, float& r)
 {
     // get triangle edge vectors and plane normal
     QVector3D u = p2 - p1;
@@ -179,13 +192,14 @@ static bool privIntersectWithRay(const PickRay& ray, const QVector3D& p1, const
     float a = -QVector3D::dotProduct(n, w0);
     float b = QVector3D::dotProduct(n, ray.dir);
     if (abs(b) < 1E-5) {
+        r = 0;
         if (a == 0)
             return true;        // ray lies in triangle plane
         return false;           // ray disjoint from plane
     }
 
     // get intersect point of ray with triangle plane
-    float r = a / b;
+    r = a / b;
     if (r < 0.0)                // ray goes away from triangle
         return false;
 
@@ -196,15 +210,21 @@ static bool privIntersectWithRay(const PickRay& ray, const QVector3D& p1, const
 }
 
 bool SubdivisionFace::intersectWithRay(const PickRay& ray) const
+{
+    float depth;
+    return intersectWithRay(ray, depth);
+}
+
+bool SubdivisionFace::intersectWithRay(const PickRay& ray, float& depth) const
 {
     if (_points.size() < 3)
         return false;
     if (_points.size() == 3)
         return privIntersectWithRay(ray, _points[0]->getCoordinate(), _points[1]->getCoordinate(),
-                                    _points[2]->getCoordinate());
+                                    _points[2]->getCoordinate(), depth);
     for (size_t i=2; i<_points.size(); i++) {
         if (privIntersectWithRay(ray, _points[0]->getCoordinate(), _points[i-1]->getCoordinate(),
-                                 _points[i]->getCoordinate()))
+                                 _points[i]->getCoordinate(), depth))
             return true;
     }
     return false;
@@ -212,19 +232,30 @@ bool SubdivisionFace::intersectWithRay(const PickRay& ray) const
 
 SubdivisionPoint* SubdivisionFace::calculateFacePoint()
 {
-    SubdivisionPoint* result = 0;
-    QVector3D centre = ZERO;
     if (_points.size() < 3)
         throw invalid_argument("trying to calculate face point with less than 3 points");
-    if (_points.size() > 3 || _owner->getSubdivisionMode() == fmCatmullClark) {
-        for (size_t i=0; i<_points.size(); ++i) {
-            QVector3D p = _points[i]->getCoordinate();
-            centre += p;
-        }
-        centre /= _points.size();
-        result = SubdivisionPoint::construct(_owner);
-        result->setCoordinate(centre);
+    if (!hasFacePoint())
+        return 0;
+    return createFacePoint(_owner->getPointPool().add());
+}
+
+bool SubdivisionFace::hasFacePoint() const
+{
+    return _points.size() > 3 || _owner->getSubdivisionMode() == fmCatmullClark;
+}
+
+SubdivisionPoint* SubdivisionFace::createFacePoint(void* mem) const
+{
+    if (_points.size() < 3)
+        throw invalid_argument("trying to calculate face point with less than 3 points");
+    QVector3D centre = ZERO;
+    for (size_t i=0; i<_points.size(); ++i) {
+        QVector3D p = _points[i]->getCoordinate();
+        centre += p;
     }
+    centre /= _points.size();
+    SubdivisionPoint* result = SubdivisionPoint::construct(_owner, mem);
+    result->setCoordinate(centre);
     return result;
 }
 
@@ -248,14 +279,17 @@ void SubdivisionFace::edgeCheck(SubdivisionPoint* p1,
                                 bool controledge,
                                 SubdivisionControlCurve* curve,
                                 vector<SubdivisionEdge*> &interioredges,
-                                vector<SubdivisionEdge*> &controledges
-                                )
+                                vector<SubdivisionEdge*> &controledges,
+                                AdjacencyBlock<SubdivisionFace*>* edgefaces)
 {
     if (p1 == nullptr || p2 == nullptr)
         throw invalid_argument("null end points in SubdivisionFace::edgeCheck");
     SubdivisionEdge* newedge = _owner->edgeExists(p1, p2);
     if (newedge == nullptr) {
         newedge = SubdivisionEdge::construct(_owner);
+        // an edge has a face on either side
+        if (edgefaces != nullptr)
+            newedge->useSlice(edgefaces->take(2), 2);
         newedge->setControlEdge(controledge);
         newedge->setPoints(p1, p2);
         newedge->startPoint()->addEdge(newedge);
@@ -273,25 +307,54 @@ void SubdivisionFace::edgeCheck(SubdivisionPoint* p1,
     newedge->addFace(this);
 }
 
-// TODO: facepoints should be common to this face, and then we don't
-// have to search the list each time to find the facepoint for this
-// face
 void SubdivisionFace::subdivide(bool controlface,
-                                vector<pair<SubdivisionPoint*,SubdivisionPoint*> > &vertexpoints,
-                                vector<pair<SubdivisionEdge*,SubdivisionPoint*> > &edgepoints,
-                                vector<pair<SubdivisionFace*,SubdivisionPoint*> > &facepoints,
+                                const VertexPointMap& vertexpoints,
+                                const EdgePointMap& edgepoints,
+                                const FacePointMap& facepoints,
                                 vector<SubdivisionEdge*> &interioredges,
                                 vector<SubdivisionEdge*> &controledges,
                                 vector<SubdivisionFace*> &dest)
+{
+    size_t first = dest.size();
+    vector<FaceEdgeCheck> checks;
+    createChildren(controlface, vertexpoints, edgepoints, facepoints, dest, checks);
+    size_t k = 0;
+    for (size_t i=first; i<dest.size(); ++i) {
+        dest[i]->connect(&checks[k], interioredges, controledges);
+        k += dest[i]->numberOfPoints();
+    }
+}
+
+size_t SubdivisionFace::numberOfSubdividedFaces() const
+{
+    if (_points.size() != 3 || _owner->getSubdivisionMode() == fmCatmullClark)
+        return _points.size();
+    return 4;
+}
+
+static void addEdgeCheck(vector<FaceEdgeCheck>& checks,
+                         SubdivisionPoint* p1, SubdivisionPoint* p2,
+                         bool crease, bool controledge,
+                         SubdivisionControlCurve* curve)
+{
+    FaceEdgeCheck check = {p1, p2, crease, controledge, curve};
+    checks.push_back(check);
+}
+
+void SubdivisionFace::createChildren(bool controlface,
+                                     const VertexPointMap& vertexpoints,
+                                     const EdgePointMap& edgepoints,
+                                     const FacePointMap& facepoints,
+                                     vector<SubdivisionFace*>& dest,
+                                     vector<FaceEdgeCheck>& checks,
+                                     SubdivisionFace** mem,
+                                     SubdivisionPoint** pointmem)
 {
     SubdivisionPoint* pts[4];
     SubdivisionFace* newface;
     SubdivisionPoint* p2;
     SubdivisionEdge* prevedge;
     SubdivisionEdge* curedge;
-    vector<pair<SubdivisionPoint*,SubdivisionPoint*> >::iterator ptmpindex;
-    vector<pair<SubdivisionEdge*,SubdivisionPoint*> >::iterator etmpindex;
-    vector<pair<SubdivisionFace*,SubdivisionPoint*> >::iterator ftmpindex;
 
     if (_points.size() != 3 || _owner->getSubdivisionMode() == fmCatmullClark) {
         for (size_t i=1; i<=_points.size(); ++i) {
@@ -301,44 +364,33 @@ void SubdivisionFace::subdivide(bool controlface,
             index = (i + _points.size()) % _points.size();
             curedge = _owner->edgeExists(p2, _points[index]);
             index = (i - 1) % 4;
-            ptmpindex = find_if(vertexpoints.begin(), vertexpoints.end(),
-                                FirstPointPairPredicate(p2));
-            pts[index] = (*ptmpindex).second; // p2.newlocation
+            pts[index] = vertexpoints.at(p2); // p2.newlocation
             SubdivisionPoint* p2pt = pts[index];
             index = (index + 1) % 4;
-            etmpindex = find_if(edgepoints.begin(), edgepoints.end(),
-                                FirstEdgePointPredicate(curedge));
-            pts[index] = (*etmpindex).second; // curedge.newlocation
+            pts[index] = edgepoints.at(curedge); // curedge.newlocation
             SubdivisionPoint* curredgept = pts[index];
             index = (index + 1) % 4;
-            ftmpindex = find_if(facepoints.begin(), facepoints.end(),
-                                FirstFacePointPredicate(this));
-            pts[index] = (*ftmpindex).second; // this.newlocation
+            pts[index] = facepoints.at(this); // this.newlocation
             SubdivisionPoint* newlocation = pts[index];
             index = (index + 1) % 4;
-            etmpindex = find_if(edgepoints.begin(), edgepoints.end(),
-                                FirstEdgePointPredicate(prevedge));
-            pts[index] = (*etmpindex).second; // prevedge.newlocation
+            pts[index] = edgepoints.at(prevedge); // prevedge.newlocation
             SubdivisionPoint* prevedgept = pts[index];
             // add the new face
-            newface = SubdivisionFace::construct(_owner);
+            newface = (mem != nullptr) ? construct(_owner, *mem++) : construct(_owner);
             dest.push_back(newface);
-            // check the edges of the new face
-            newface->edgeCheck(prevedgept, p2pt, prevedge->isCrease(),
-							   prevedge->isControlEdge() || controlface,
-							   prevedge->getCurve(), interioredges, controledges);
-            newface->edgeCheck(p2pt, curredgept, curedge->isCrease(),
-							   curedge->isControlEdge() || controlface,
-							   curedge->getCurve(), interioredges, controledges);
-            newface->edgeCheck(curredgept, newlocation, false, false, 0,
-							   interioredges, controledges);
-            newface->edgeCheck(prevedgept, newlocation, false, false, 0,
-							   interioredges, controledges);
-            for (size_t j=0; j<4; ++j) {
-                // add new face to points
-                pts[j]->addFace(newface);
-                newface->addPoint(pts[j]);
+            if (pointmem != nullptr) {
+                newface->_points.use(pointmem, 4);
+                pointmem += 4;
             }
+            // the edges of the new face
+            addEdgeCheck(checks, prevedgept, p2pt, prevedge->isCrease(),
+                         prevedge->isControlEdge() || controlface, prevedge->getCurve());
+            addEdgeCheck(checks, p2pt, curredgept, curedge->isCrease(),
+                         curedge->isControlEdge() || controlface, curedge->getCurve());
+            addEdgeCheck(checks, curredgept, newlocation, false, false, 0);
+            addEdgeCheck(checks, prevedgept, newlocation, false, false, 0);
+            // the points get the face in connect, this may run on several threads
+            newface->_points.assign(pts, pts + 4);
         }
     }
     else if (numberOfPoints() == 3) {
@@ -352,35 +404,23 @@ void SubdivisionFace::subdivide(bool controlface,
             index = (i+numberOfPoints()) % numberOfPoints();
             curedge = _owner->edgeExists(p2, _points[index]);
 
-            index = 0;
-            etmpindex = find_if(edgepoints.begin(), edgepoints.end(),
-                                FirstEdgePointPredicate(prevedge));
-            pts[index] = (*etmpindex).second;
-            index = 1;
-            ptmpindex = find_if(vertexpoints.begin(), vertexpoints.end(),
-                                FirstPointPairPredicate(p2));
-            pts[index] = (*ptmpindex).second;
-            index = 2;
-            etmpindex = find_if(edgepoints.begin(), edgepoints.end(),
-                                FirstEdgePointPredicate(curedge));
-            pts[index] = (*etmpindex).second;
+            pts[0] = edgepoints.at(prevedge);
+            pts[1] = vertexpoints.at(p2);
+            pts[2] = edgepoints.at(curedge);
             // add the new face
-            newface = SubdivisionFace::construct(_owner);
+            newface = (mem != nullptr) ? construct(_owner, *mem++) : construct(_owner);
             dest.push_back(newface);
-            // check the edges of the new face
-            newface->edgeCheck(pts[0], pts[1], prevedge->isCrease(),
-							   prevedge->isControlEdge() || controlface,
-							   prevedge->getCurve(), interioredges, controledges);
-            newface->edgeCheck(pts[1], pts[2], curedge->isCrease(),
-                               curedge->isControlEdge() || controlface,
-							   curedge->getCurve(), interioredges, controledges);
-            newface->edgeCheck(pts[2], pts[0], false, false, 0,
-							   interioredges, controledges);
-            for (size_t j=0; j<3; ++j) {
-                // add new face to points
-                pts[j]->addFace(newface);
-                newface->addPoint(pts[j]);
+            if (pointmem != nullptr) {
+                newface->_points.use(pointmem, 4);
+                pointmem += 4;
             }
+            // the edges of the new face
+            addEdgeCheck(checks, pts[0], pts[1], prevedge->isCrease(),
+                         prevedge->isControlEdge() || controlface, prevedge->getCurve());
+            addEdgeCheck(checks, pts[1], pts[2], curedge->isCrease(),
+                         curedge->isControlEdge() || controlface, curedge->getCurve());
+            addEdgeCheck(checks, pts[2], pts[0], false, false, 0);
+            newface->_points.assign(pts, pts + 3);
         }
 
         // then the center triangle
@@ -388,25 +428,33 @@ void SubdivisionFace::subdivide(bool controlface,
             p2 = _points[i];
             size_t index = (i - 1 + numberOfPoints()) % numberOfPoints();
             prevedge = _owner->edgeExists(p2, _points[index]);
-            etmpindex = find_if(edgepoints.begin(), edgepoints.end(),
-                                FirstEdgePointPredicate(prevedge));
-            pts[i] = (*etmpindex).second;
+            pts[i] = edgepoints.at(prevedge);
         }
         // add the new face
-        newface = SubdivisionFace::construct(_owner);
+        newface = (mem != nullptr) ? construct(_owner, *mem++) : construct(_owner);
         dest.push_back(newface);
-        newface->edgeCheck(pts[0], pts[1], false, false, 0,
-						   interioredges, controledges);
-        newface->edgeCheck(pts[1], pts[2], false, false, 0,
-						   interioredges, controledges);
-        newface->edgeCheck(pts[2], pts[0], false, false, 0,
-						   interioredges, controledges);
-        for (size_t j=0; j<3; ++j) {
-            // add new face to points
-            pts[j]->addFace(newface);
-            newface->addPoint(pts[j]);
-        }
+        if (pointmem != nullptr)
+            newface->_points.use(pointmem, 4);
+        addEdgeCheck(checks, pts[0], pts[1], false, false, 0);
+        addEdgeCheck(checks, pts[1], pts[2], false, false, 0);
+        addEdgeCheck(checks, pts[2], pts[0], false, false, 0);
+        newface->_points.assign(pts, pts + 3);
+    }
+}
+
+void SubdivisionFace::connect(const FaceEdgeCheck* checks,
+                              vector<SubdivisionEdge*>& interioredges,
+                              vector<SubdivisionEdge*>& controledges,
+                              AdjacencyBlock<SubdivisionFace*>* edgefaces)
+{
+    for (size_t j=0; j<_points.size(); ++j) {
+        const FaceEdgeCheck& check = checks[j];
+        edgeCheck(check.p1, check.p2, check.crease, check.controledge,
+                  check.curve, interioredges, controledges, edgefaces);
     }
+    // add new face to points
+    for (size_t j=0; j<_points.size(); ++j)
+        _points[j]->addFace(this);
 }
 
 void SubdivisionFace::dump(ostream& os, const char* prefix) const
@@ -703,7 +751,8 @@ void SubdivisionControlFace::drawZebraFaces(Viewport& vp, CurveFaceShader* shade
 void SubdivisionControlFace::drawFaces(Viewport &vp, FaceShader* faceshader)
 {
     function<void(QVector3D&, QVector3D&)> mirrorit = HullMirror;
-    DrawFaces(faceshader, _owner->getWaterlinePlane(), _children, _vertices1, _vertices2, mirrorit,
+    DrawFaces(faceshader, _owner->getWaterlinePlane(),
+              _adaptive_faces.empty() ? _children : _adaptive_faces, _vertices1, _vertices2, mirrorit,
               (_owner->shadeUnderWater() && vp.getViewportMode() == vmShade
                && getLayer()->useInHydrostatics()),
               (_owner->drawMirror() && getLayer()->isSymmetric()),
@@ -931,6 +980,14 @@ SubdivisionFace* SubdivisionControlFace::getChild(size_t index) const
     throw out_of_range("Bad index in SubdivisionControlFace::getChild");
 }
 
+SubdivisionFace* SubdivisionControlFace::getAdaptiveFace(size_t index) const
+{
+    const vector<SubdivisionFace*>& faces = getAdaptiveFaces();
+    if (index < faces.size())
+        return faces[index];
+    throw out_of_range("Bad index in SubdivisionControlFace::getAdaptiveFace");
+}
+
 QColor SubdivisionControlFace::getColor() const
 {
     if (isSelected())
@@ -1025,12 +1082,44 @@ void SubdivisionControlFace::clear()
 // used to clear all subdivided edges and faces, but not the subdivided points
 void SubdivisionControlFace::clearChildren()
 {
-    for (size_t i=0; i<_children.size(); ++i)
+    // the pool only takes back the memory, the destructors free the
+    // point and face lists
+    for (size_t i=0; i<_children.size(); ++i) {
+        _children[i]->~SubdivisionFace();
         _owner->getFacePool().del(_children[i]);
-    for (size_t i=0; i<_edges.size(); ++i)
+    }
+    for (size_t i=0; i<_edges.size(); ++i) {
+        _edges[i]->~SubdivisionEdge();
         _owner->getEdgePool().del(_edges[i]);
+    }
     _children.clear();
     _edges.clear();
+    clearAdaptiveFaces();
+}
+
+void SubdivisionControlFace::setAdaptiveFaces(vector<SubdivisionFace*>& faces)
+{
+    clearAdaptiveFaces();
+    _adaptive_faces.swap(faces);
+}
+
+void SubdivisionControlFace::swapLevel(vector<SubdivisionFace*>& children,
+                                       vector<SubdivisionEdge*>& edges,
+                                       vector<SubdivisionEdge*>& controledges)
+{
+    clearAdaptiveFaces();
+    _children.swap(children);
+    _edges.swap(edges);
+    _control_edges.swap(controledges);
+}
+
+void SubdivisionControlFace::clearAdaptiveFaces()
+{
+    for (size_t i=0; i<_adaptive_faces.size(); ++i) {
+        _adaptive_faces[i]->~SubdivisionFace();
+        _owner->getFacePool().del(_adaptive_faces[i]);
+    }
+    _adaptive_faces.clear();
 }
 
 void SubdivisionControlFace::loadBinary(FileBuffer &source)
@@ -1262,45 +1351,89 @@ void SubdivisionControlFace::loadFromStream(size_t &lineno, QStringList &strings
 // TODO: controledges should be reworked in subdivsurf::subdivide, we have them here in the face
 // list, so we shouldn't have to collect them in the param list also
 void SubdivisionControlFace::subdivide(
-	vector<pair<SubdivisionPoint*,SubdivisionPoint*> >& vertexpoints,
-	vector<pair<SubdivisionEdge*,SubdivisionPoint*> >& edgepoints,
-	vector<pair<SubdivisionFace*,SubdivisionPoint*> >& facepoints,
+	const VertexPointMap& vertexpoints,
+	const EdgePointMap& edgepoints,
+	const FacePointMap& facepoints,
 	vector<SubdivisionEdge*>& controledges)
 {
-    _control_edges.clear();
+    vector<SubdivisionFace*> newchildren;
+    vector<FaceEdgeCheck> checks;
+    createSubdividedFaces(vertexpoints, edgepoints, facepoints, newchildren, checks);
+    connectSubdividedFaces(newchildren, checks, controledges);
+    calcExtents();
+}
+
+size_t SubdivisionControlFace::numberOfSubdividedFaces() const
+{
+    if (_children.size() == 0)
+        return SubdivisionFace::numberOfSubdividedFaces();
+    size_t n = 0;
+    for (size_t i=0; i<_children.size(); ++i)
+        n += _children[i]->numberOfSubdividedFaces();
+    return n;
+}
+
+void SubdivisionControlFace::createSubdividedFaces(const VertexPointMap& vertexpoints,
+                                                   const EdgePointMap& edgepoints,
+                                                   const FacePointMap& facepoints,
+                                                   vector<SubdivisionFace*>& newchildren,
+                                                   vector<FaceEdgeCheck>& checks,
+                                                   SubdivisionFace** mem,
+                                                   SubdivisionPoint** pointmem)
+{
     if (_children.size() == 0) {
         // not subdivided yet
-        SubdivisionFace::subdivide(true,
-                                   vertexpoints,
-                                   edgepoints,
-                                   facepoints,
-                                   _edges,          // interior edges
-                                   _control_edges,  // control edges
-                                   _children);
+        createChildren(true, vertexpoints, edgepoints, facepoints,
+                       newchildren, checks, mem, pointmem);
     }
     else {
         // has been subdivided
-        vector<SubdivisionFace*> tmpfaces;
-        vector<SubdivisionEdge*> tmpedges;
         for (size_t i=0; i<_children.size(); ++i) {
             SubdivisionFace* face = _children[i];
-            face->subdivide(false,
-                            vertexpoints,
-                            edgepoints,
-                            facepoints,
-                            tmpedges,               // interior edges
-                            _control_edges,         // control edges
-                            tmpfaces);
+            face->createChildren(false, vertexpoints, edgepoints, facepoints,
+                                 newchildren, checks, mem, pointmem);
+            if (mem != nullptr)
+                mem += face->numberOfSubdividedFaces();
+            if (pointmem != nullptr)
+                pointmem += 4 * face->numberOfSubdividedFaces();
         }
+    }
+}
+
+void SubdivisionControlFace::connectSubdividedFaces(const vector<SubdivisionFace*>& newchildren,
+                                                    const vector<FaceEdgeCheck>& checks,
+                                                    vector<SubdivisionEdge*>& controledges,
+                                                    AdjacencyBlock<SubdivisionFace*>* edgefaces)
+{
+    _control_edges.clear();
+    vector<SubdivisionEdge*> newedges;
+    size_t k = 0;
+    for (size_t i=0; i<newchildren.size(); ++i) {
+        newchildren[i]->connect(&checks[k], newedges, _control_edges, edgefaces);
+        k += newchildren[i]->numberOfPoints();
+    }
+    if (_children.size() == 0) {
+        // not subdivided yet
+        _edges.insert(_edges.end(), newedges.begin(), newedges.end());
+        _children.insert(_children.end(), newchildren.begin(), newchildren.end());
+    }
+    else {
+        // has been subdivided
         clearChildren();
-        _edges = tmpedges;
-        _children = tmpfaces;
+        _edges = newedges;
+        _children = newchildren;
     }
+    // edgeCheck adds an existing control edge once for every new face
+    // that uses it, so remove the duplicates before handing them back
+    unordered_set<SubdivisionEdge*> seen;
+    seen.reserve(_control_edges.size());
+    size_t n = 0;
     for (size_t i=0; i<_control_edges.size(); ++i) {
-        if (find(controledges.begin(), controledges.end(), _control_edges[i]) == controledges.end())
-            controledges.push_back(_control_edges[i]);
+        if (seen.insert(_control_edges[i]).second)
+            _control_edges[n++] = _control_edges[i];
     }
-    calcExtents();
+    _control_edges.resize(n);
+    controledges.insert(controledges.end(), _control_edges.begin(), _control_edges.end());
 }
 
 void SubdivisionControlFace::findAttachedFaces(vector<SubdivisionControlFace*>& todo_list,
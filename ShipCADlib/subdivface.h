@@ -32,11 +32,13 @@
 
 #include <iosfwd>
 #include <vector>
+#include <unordered_map>
 #include <QObject>
 #include <QVector3D>
 #include <QColor>
 
 #include "subdivbase.h"
+#include "adjacency.h"
 
 namespace ShipCAD {
 
@@ -54,6 +56,32 @@ namespace ShipCAD {
   class FaceShader;
   class CurveFaceShader;
   struct PickRay;
+  class SubdivisionFace;
+
+  /*! \brief map from a point to its new vertex point in the next subdivision level
+   */
+  typedef std::unordered_map<SubdivisionPoint*,SubdivisionPoint*> VertexPointMap;
+  /*! \brief map from an edge to its new edge point in the next subdivision level
+   */
+  typedef std::unordered_map<SubdivisionEdge*,SubdivisionPoint*> EdgePointMap;
+  /*! \brief map from a face to its new face point in the next subdivision level
+   */
+  typedef std::unordered_map<SubdivisionFace*,SubdivisionPoint*> FacePointMap;
+
+  /*! \brief an edge of a newly subdivided face
+   *
+   * Subdivision creates the new faces first, then connects them to
+   * the mesh. This holds the arguments for the edge check done on
+   * each side of a new face when it is connected.
+   */
+  struct FaceEdgeCheck
+  {
+      SubdivisionPoint* p1;	/**< start point of edge */
+      SubdivisionPoint* p2;	/**< end point of edge */
+      bool crease;		/**< edge is a crease */
+      bool controledge;		/**< edge descends from a control edge */
+      SubdivisionControlCurve* curve; /**< curve attached to the edge, or null */
+  };
 
   class SubdivisionFace : public SubdivisionBase
   {
@@ -81,21 +109,31 @@ namespace ShipCAD {
      * \param point point to add to face
      */
     void insertPoint(size_t index, SubdivisionPoint* point);
+    /*! \brief set the points of the face
+     *
+     * The points don't get this face, used for faces that are not
+     * part of the subdivided mesh
+     *
+     * \param points the points of the face
+     */
+    void assignPoints(const std::vector<SubdivisionPoint*>& points) { _points.assign(points); }
     /*! \brief reset point attributes to default values
      */
     virtual void clear();
     /*! \brief subdivide the face
      *
-     * \param vertexpoints list of Point <-> Point pairs. The first
-     * point is a vertex point on this face, the second point is a
-     * copy of this point to use in the new subdivided faces
+     * \param controlface true if this face is a control face
+     *
+     * \param vertexpoints map of Point -> Point. The key is a vertex
+     * point on this face, the value is a copy of this point to use
+     * in the new subdivided faces
      *
-     * \param edgepoints list of Edge <-> Point pairs. The edge is an
-     * edge on this face. The point is the midpoint of that edge to
-     * use in the new subdivided faces
+     * \param edgepoints map of Edge -> Point. The key is an edge on
+     * this face. The value is the midpoint of that edge to use in the
+     * new subdivided faces
      *
-     * \param facepoints list of Face <-> Point
-     * pairs.  
+     * \param facepoints map of Face -> Point. The value is the
+     * centroid of the face
      * 
      * \param interioredges after subdivision, the new interior edges
      * of the newly created faces will be added to this list
@@ -107,12 +145,59 @@ namespace ShipCAD {
      */
     virtual void subdivide(
 			   bool controlface,
-			   std::vector<std::pair<SubdivisionPoint*,SubdivisionPoint*> > &vertexpoints,
-			   std::vector<std::pair<SubdivisionEdge*,SubdivisionPoint*> > &edgepoints,
-			   std::vector<std::pair<SubdivisionFace*,SubdivisionPoint*> > &facepoints,
+			   const VertexPointMap& vertexpoints,
+			   const EdgePointMap& edgepoints,
+			   const FacePointMap& facepoints,
 			   std::vector<SubdivisionEdge*>& interioredges,
 			   std::vector<SubdivisionEdge*>& controledges,
 			   std::vector<SubdivisionFace*>& dest);
+    /*! \brief create the subdivided faces without connecting them
+     *
+     * First half of subdivide. The new faces get their points, but
+     * the points and edges of the mesh are not touched, so faces
+     * of different control faces can be created concurrently.
+     *
+     * \param controlface true if this face is a control face
+     * \param vertexpoints map of Point -> new vertex point
+     * \param edgepoints map of Edge -> new edge point
+     * \param facepoints map of Face -> new face point
+     * \param dest the new faces are added to this list
+     * \param checks the edge checks for each new face are added to
+     * this list, one per point of the new face
+     * \param mem if not null, memory taken from the face pool for
+     * the new faces, must have numberOfSubdividedFaces() entries
+     * \param pointmem if not null, 4 entries for the points of each
+     * new face
+     */
+    void createChildren(bool controlface,
+                        const VertexPointMap& vertexpoints,
+                        const EdgePointMap& edgepoints,
+                        const FacePointMap& facepoints,
+                        std::vector<SubdivisionFace*>& dest,
+                        std::vector<FaceEdgeCheck>& checks,
+                        SubdivisionFace** mem = nullptr,
+                        SubdivisionPoint** pointmem = nullptr);
+    /*! \brief connect a face made by createChildren to the mesh
+     *
+     * Second half of subdivide. Creates the missing edges between the
+     * points of this face, and adds the face to its points and edges.
+     *
+     * \param checks the edge checks for this face, one per point
+     * \param interioredges new interior edges are added to this list
+     * \param controledges new edges descended from control edges
+     * are added to this list
+     * \param edgefaces if not null, new edges keep their faces in
+     * slices of this block
+     */
+    void connect(const FaceEdgeCheck* checks,
+                 std::vector<SubdivisionEdge*>& interioredges,
+                 std::vector<SubdivisionEdge*>& controledges,
+                 AdjacencyBlock<SubdivisionFace*>* edgefaces = nullptr);
+    /*! \brief number of faces this face will be divided into
+     *
+     * \return number of faces created by subdivide
+     */
+    size_t numberOfSubdividedFaces() const;
 
     // getters/setters
     /*! \brief number of points for this face
@@ -149,6 +234,17 @@ namespace ShipCAD {
      * or the number of face points is less than 3
      */
     SubdivisionPoint* calculateFacePoint();
+    /*! \brief does this face get a face point when subdivided
+     *
+     * \return false if triangle and not using fvCatmullClark
+     */
+    bool hasFacePoint() const;
+    /*! \brief make the face point in memory already taken from the point pool
+     *
+     * \param mem memory for the new point
+     * \return the point at center of face
+     */
+    SubdivisionPoint* createFacePoint(void* mem) const;
     /*! \brief get index of point for this face
      *
      * \param pt point to find in face
@@ -163,23 +259,49 @@ namespace ShipCAD {
      * \return coordinates of the face center
      */
     QVector3D getFaceCenter() const;
+    /*! \brief calculate the face normal
+     *
+     * \return coordinates of the face normal
+     */
+    QVector3D calculateFaceNormal() const;
     /*! \brief get coordinates of the face normal
+     *
+     * Subdivided faces read it from the normals the surface keeps
+     * after a rebuild, otherwise it is calculated
      *
      * \return coordinates of the face normal
      */
     QVector3D getFaceNormal() const;
+    /*! \brief position of this face in the normal cache of its surface
+     */
+    size_t getListIndex() const { return _list_index; }
+    void setListIndex(size_t index) { _list_index = index; }
 
     /*! \brief does a ray intersect this face
      *
      * \return true if ray intersects face
      */
     bool intersectWithRay(const PickRay& ray) const;
+    /*! \brief does a ray intersect this face
+     *
+     * \param ray the ray
+     * \param depth distance along the ray to the intersection, in
+     * lengths of the ray direction
+     * \return true if ray intersects face
+     */
+    bool intersectWithRay(const PickRay& ray, float& depth) const;
     
     // output
     virtual void dump(std::ostream& os, const char* prefix = "") const;
 
     // makers
     static SubdivisionFace* construct(SubdivisionSurface* owner);
+    /*! \brief make a face in memory already taken from the face pool
+     *
+     * \param owner surface this face belongs to
+     * \param mem memory for the new face
+     */
+    static SubdivisionFace* construct(SubdivisionSurface* owner, void* mem);
 
   protected:
 
@@ -197,6 +319,8 @@ namespace ShipCAD {
      * \param curve if edge is a controledge, then pass the curve to be attached
      * \param interioredges if this edge is an interior edge, add it to this list
      * \param controledges if this edge is a control, add it to this list
+     * \param edgefaces if not null, a new edge keeps its faces in a
+     * slice of this block
      */
     void edgeCheck(SubdivisionPoint* p1,
                    SubdivisionPoint* p2,
@@ -204,11 +328,13 @@ namespace ShipCAD {
                    bool controledge,
                    SubdivisionControlCurve* curve,
                    std::vector<SubdivisionEdge*> &interioredges,
-                   std::vector<SubdivisionEdge*> &controledges);
+                   std::vector<SubdivisionEdge*> &controledges,
+                   AdjacencyBlock<SubdivisionFace*>* edgefaces = nullptr);
 
   protected:
 
-    std::vector<SubdivisionPoint*> _points; /**< points belonging to this face */
+    AdjacencyList<SubdivisionPoint*> _points; /**< points belonging to this face */
+    size_t _list_index;		/**< position in the surface normal cache */
   };
 
   typedef std::vector<SubdivisionFace*>::iterator subdivface_iter;
@@ -249,6 +375,29 @@ namespace ShipCAD {
     /*! \brief remove all control edges of this face
      */
     void clearControlEdges() {_control_edges.clear();}
+    /*! \brief use these faces instead of the children
+     *
+     * The faces are made from the subdivided points, but are not
+     * connected to them. The face takes ownership of them.
+     *
+     * \param faces the adaptive faces, empty on return
+     */
+    void setAdaptiveFaces(std::vector<SubdivisionFace*>& faces);
+    /*! \brief remove the adaptive faces, the children are used again
+     */
+    void clearAdaptiveFaces();
+    /*! \brief exchange the children and edges with those of another level
+     *
+     * Used by the level cache of the surface. The adaptive faces
+     * belong to the current level and are removed.
+     *
+     * \param children the subdivided faces
+     * \param edges the subdivided internal edges
+     * \param controledges the edges descended from control edges
+     */
+    void swapLevel(std::vector<SubdivisionFace*>& children,
+                   std::vector<SubdivisionEdge*>& edges,
+                   std::vector<SubdivisionEdge*>& controledges);
     /*! \brief add a control edge
      *
      * TODO: this shouldn't exist here, but belongs to
@@ -277,25 +426,72 @@ namespace ShipCAD {
     void removeReferences();
     /*! \brief subdivide the face
      *
-     * \param vertexpoints list of Point <-> Point pairs. The first
-     * point is a vertex point on this face, the second point is a
-     * copy of this point to use in the new subdivided faces
+     * \param vertexpoints map of Point -> Point. The key is a vertex
+     * point on this face, the value is a copy of this point to use
+     * in the new subdivided faces
      *
-     * \param edgepoints list of Edge <-> Point pairs. The edge is an
-     * edge on this face. The point is the midpoint of that edge to
-     * use in the new subdivided faces
+     * \param edgepoints map of Edge -> Point. The key is an edge on
+     * this face. The value is the midpoint of that edge to use in the
+     * new subdivided faces
      *
-     * \param facepoints list of Face <-> Point
-     * pairs.  
+     * \param facepoints map of Face -> Point. The value is the
+     * centroid of the face
      * 
      * \param controledges after subdivision, the new edges descended
-     * from control edges will be added to this list
+     * from control edges will be added to this list. Edges shared
+     * with neighbouring control faces are not filtered out, the
+     * caller is responsible for removing those duplicates
      */
     virtual void subdivide(
-			   std::vector<std::pair<SubdivisionPoint*,SubdivisionPoint*> > &vertexpoints,
-			   std::vector<std::pair<SubdivisionEdge*,SubdivisionPoint*> > &edgepoints,
-			   std::vector<std::pair<SubdivisionFace*,SubdivisionPoint*> > &facepoints,
+			   const VertexPointMap& vertexpoints,
+			   const EdgePointMap& edgepoints,
+			   const FacePointMap& facepoints,
 			   std::vector<SubdivisionEdge*>& controledges);
+    /*! \brief number of faces the next subdivide will create
+     *
+     * \return number of faces created by subdividing this face or
+     * its children
+     */
+    size_t numberOfSubdividedFaces() const;
+    /*! \brief first half of subdivide, create the new children
+     *
+     * Does not change this face or the mesh, see
+     * SubdivisionFace::createChildren
+     *
+     * \param vertexpoints map of Point -> new vertex point
+     * \param edgepoints map of Edge -> new edge point
+     * \param facepoints map of Face -> new face point
+     * \param newchildren the new faces are added to this list
+     * \param checks the edge checks of the new faces
+     * \param mem if not null, memory taken from the face pool for
+     * the new faces, must have numberOfSubdividedFaces() entries
+     * \param pointmem if not null, 4 entries for the points of each
+     * new face
+     */
+    void createSubdividedFaces(const VertexPointMap& vertexpoints,
+                               const EdgePointMap& edgepoints,
+                               const FacePointMap& facepoints,
+                               std::vector<SubdivisionFace*>& newchildren,
+                               std::vector<FaceEdgeCheck>& checks,
+                               SubdivisionFace** mem = nullptr,
+                               SubdivisionPoint** pointmem = nullptr);
+    /*! \brief second half of subdivide, replace the children
+     *
+     * Connect the faces made by createSubdividedFaces to the mesh,
+     * and replace the current children and interior edges with them.
+     * Does not update the extents.
+     *
+     * \param newchildren the faces from createSubdividedFaces
+     * \param checks the edge checks from createSubdividedFaces
+     * \param controledges the new edges descended from control
+     * edges are added to this list, see subdivide
+     * \param edgefaces if not null, the new edges keep their faces
+     * in slices of this block
+     */
+    void connectSubdividedFaces(const std::vector<SubdivisionFace*>& newchildren,
+                                const std::vector<FaceEdgeCheck>& checks,
+                                std::vector<SubdivisionEdge*>& controledges,
+                                AdjacencyBlock<SubdivisionFace*>* edgefaces = nullptr);
     /*! \brief select all control faces connected to this one
      *
      * Select all control faces connected to this one on the same
@@ -308,6 +504,18 @@ namespace ShipCAD {
     void setLayer(SubdivisionLayer* layer);
     SubdivisionFace* getChild(size_t index) const;
     size_t numberOfChildren() const { return _children.size(); }
+    /*! \brief faces of the adaptive mesh
+     *
+     * When the surface has an adaptive tolerance, a flat face is
+     * covered by fewer and larger faces than its children. Otherwise
+     * these are the children.
+     *
+     * \return the faces covering this control face
+     */
+    const std::vector<SubdivisionFace*>& getAdaptiveFaces() const
+        { return _adaptive_faces.empty() ? _children : _adaptive_faces; }
+    size_t numberOfAdaptiveFaces() const { return getAdaptiveFaces().size(); }
+    SubdivisionFace* getAdaptiveFace(size_t index) const;
     QColor getColor() const;
     SubdivisionEdge* getControlEdge(size_t index) const;
     size_t numberOfControlEdges() const { return _control_edges.size(); }
@@ -355,6 +563,7 @@ namespace ShipCAD {
     QVector3D _min;				/**< minimum coordinate of this face */
     QVector3D _max;				/**< maximum coordinate of this face */
     std::vector<SubdivisionFace*> _children;    /**< subdivided faces */
+    std::vector<SubdivisionFace*> _adaptive_faces;  /**< faces replacing the children in adaptive mode */
     std::vector<SubdivisionEdge*> _edges;       /**< subdivided internal edges */
     std::vector<SubdivisionEdge*> _control_edges;   /**< control edges (may be of SubdivisionEdge type if this face has been subdivided */
     size_t _vertices1;           /**< number of vertices drawn to size buffers for next draw */
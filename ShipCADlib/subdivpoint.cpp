@@ -58,8 +58,13 @@ SubdivisionPoint* SubdivisionPoint::construct(SubdivisionSurface* owner)
     return new (mem) SubdivisionPoint(owner);
 }
 
+SubdivisionPoint* SubdivisionPoint::construct(SubdivisionSurface* owner, void* mem)
+{
+    return new (mem) SubdivisionPoint(owner);
+}
+
 SubdivisionPoint::SubdivisionPoint(SubdivisionSurface* owner)
-    : SubdivisionBase(owner), _coordinate(ZERO), _vtype(svRegular)
+    : SubdivisionBase(owner), _coordinate(ZERO), _vtype(svRegular), _list_index(0)
 {
 	// does nothing
 }
@@ -324,6 +329,13 @@ void SubdivisionPoint::addEdge(SubdivisionEdge* edge)
         _edges.push_back(edge);
 }
 
+void SubdivisionPoint::useSlices(SubdivisionFace** faces, size_t nfaces,
+                                 SubdivisionEdge** edges, size_t nedges)
+{
+    _faces.use(faces, nfaces);
+    _edges.use(edges, nedges);
+}
+
 void SubdivisionPoint::addFace(SubdivisionFace* face)
 {
     if (find(_faces.begin(), _faces.end(), face) == _faces.end())
@@ -413,31 +425,110 @@ QVector3D SubdivisionPoint::averaging() const
     return result;
 }
 
+void SubdivisionPoint::averagingWeights(vector<pair<SubdivisionPoint*, float> >& weights) const
+{
+    // must give the same sums as averaging
+    SubdivisionPoint* self = const_cast<SubdivisionPoint*>(this);
+    SubdivisionPoint* p;
+    float totalweight = 0.0;
+    size_t nt = 0;
+    float weight;
+
+    weights.clear();
+    if (_edges.size() == 0 || _vtype == svCorner)
+        weights.push_back(make_pair(self, 1.0f));
+    else if (_vtype == svCrease) {
+        weights.push_back(make_pair(self, 0.5f));
+        for (size_t i=0; i<_edges.size(); ++i) {
+            SubdivisionEdge* edge = _edges[i];
+            if (edge->numberOfFaces() == 1 || edge->isCrease()) {
+                if (edge->startPoint() == this)
+                    p = edge->endPoint();
+                else
+                    p = edge->startPoint();
+                weights.push_back(make_pair(p, 0.25f));
+            }
+        }
+    }
+    else {
+        for (size_t i=0; i<_faces.size(); ++i) {
+            SubdivisionFace* face = _faces[i];
+            if (face->numberOfPoints() == 3) {
+                ++nt;
+                for (size_t j=0; j<face->numberOfPoints(); ++j) {
+                    p = face->getPoint(j);
+                    weights.push_back(make_pair(p, static_cast<float>(third_pi * (p == this ? .25 : .375))));
+                }
+                weight = third_pi;
+            }
+            else if (face->numberOfPoints() == 4) {
+                for (size_t j=0; j<face->numberOfPoints(); ++j)
+                    weights.push_back(make_pair(face->getPoint(j), static_cast<float>(half_pi * .25)));
+                weight = half_pi;
+            }
+            else
+                throw runtime_error("invalid number of points in SubdivisionPoint::averagingWeights");
+            totalweight += weight;
+        }
+        if (totalweight != 0) {
+            for (size_t i=0; i<weights.size(); ++i)
+                weights[i].second /= totalweight;
+        }
+        size_t nq = _faces.size() - nt;
+        float a;
+        if (nt == _faces.size())
+            a = 5/3.0 - 8/3.0*sqrt(.375+.25*cos(two_pi/_faces.size()));
+        else if (nq == _faces.size())
+            a = 4 / static_cast<float>(_faces.size());
+        else {
+            if (nq == 0 && nt == 3)
+                a = 1.5;
+            else
+                a = 12 / static_cast<float>(3 * nq + 2 * nt);
+        }
+        // result = self + a * (average - self)
+        for (size_t i=0; i<weights.size(); ++i)
+            weights[i].second *= a;
+        weights.push_back(make_pair(self, 1 - a));
+    }
+}
+
 SubdivisionPoint* SubdivisionPoint::calculateVertexPoint()
 {
-    SubdivisionPoint* result = SubdivisionPoint::construct(_owner);
+    SubdivisionPoint* result = createVertexPoint(_owner->getPointPool().add());
+    replaceInCurves(result);
+    return result;
+}
+
+SubdivisionPoint* SubdivisionPoint::createVertexPoint(void* mem) const
+{
+    SubdivisionPoint* result = SubdivisionPoint::construct(_owner, mem);
     result->setVertexType(_vtype);
     result->setCoordinate(getCoordinate());
+    return result;
+}
+
+void SubdivisionPoint::replaceInCurves(SubdivisionPoint* vertexpoint)
+{
     for (size_t i=0; i<_edges.size(); ++i) {
         SubdivisionEdge* edge = _edges[i];
         if (edge->getCurve() != 0)
-            edge->getCurve()->replaceVertexPoint(this, result);
+            edge->getCurve()->replaceVertexPoint(this, vertexpoint);
     }
-    return result;
 }
 
 void SubdivisionPoint::deleteEdge(SubdivisionEdge* edge)
 {
-    vector<SubdivisionEdge*>::iterator i = find(_edges.begin(),
-                                                _edges.end(), edge);
+    AdjacencyList<SubdivisionEdge*>::iterator i = find(_edges.begin(),
+                                                       _edges.end(), edge);
     if (i != _edges.end())
         _edges.erase(i);
 }
 
 void SubdivisionPoint::deleteFace(SubdivisionFace* face)
 {
-    vector<SubdivisionFace*>::iterator i = find(_faces.begin(),
-                                                _faces.end(), face);
+    AdjacencyList<SubdivisionFace*>::iterator i = find(_faces.begin(),
+                                                       _faces.end(), face);
     if (i != _faces.end())
         _faces.erase(i);
 }
@@ -461,6 +552,14 @@ bool SubdivisionPoint::hasFace(SubdivisionFace* face) const
 }
 
 QVector3D SubdivisionPoint::getNormal() const
+{
+    QVector3D result;
+    if (_owner->cachedPointNormal(this, result))
+        return result;
+    return calculateNormal();
+}
+
+QVector3D SubdivisionPoint::calculateNormal() const
 {
     QVector3D result;
     for (size_t i=0; i<_faces.size(); ++i) {
@@ -540,7 +639,7 @@ SubdivisionControlPoint::SubdivisionControlPoint(SubdivisionSurface *owner)
 void SubdivisionControlPoint::removePoint()
 {
     for (size_t i=0; i<_edges.size(); i++) {
-        SubdivisionControlEdge* edge = dynamic_cast<SubdivisionControlEdge*>(_edges[i]);
+        SubdivisionControlEdge* edge = _edges[i]->asControlEdge();
         _owner->deleteControlEdge(edge);
     }
 }
@@ -634,8 +733,9 @@ void SubdivisionControlPoint::setLocked(bool val)
 
 void SubdivisionControlPoint::setCoordinate(const QVector3D &val)
 {
+    QVector3D from = _coordinate;
     SubdivisionPoint::setCoordinate(val);
-    _owner->setBuild(false);
+    _owner->controlPointMoved(this, from);
 }
 
 // FreeGeometry.pas:10088
@@ -655,10 +755,10 @@ void SubdivisionControlPoint::collapse()
         for (size_t i=0; i<numberOfEdges(); ++i) {
             if (_edges[i]->numberOfFaces() == 1) {
                 if (edge1 == 0) {
-                    edge1 = dynamic_cast<SubdivisionControlEdge*>(_edges[i]);
+                    edge1 = _edges[i]->asControlEdge();
                 }
                 else {
-                    edge2 = dynamic_cast<SubdivisionControlEdge*>(_edges[i]);
+                    edge2 = _edges[i]->asControlEdge();
                 }
             }
         }
@@ -670,7 +770,7 @@ void SubdivisionControlPoint::collapse()
         bool crease = false;
         if (_edges.size() == 2) {
             edge_collapse = true;
-            edge1 = dynamic_cast<SubdivisionControlEdge*>(_edges[0]);
+            edge1 = _edges[0]->asControlEdge();
             if (edge1 == nullptr)
                 throw invalid_argument("edge is not a control edge SubdivisionControlPoint::collapse");
             if (edge1->startPoint() == this) {
@@ -679,7 +779,7 @@ void SubdivisionControlPoint::collapse()
             else {
                 p1 = dynamic_cast<SubdivisionControlPoint*>(edge1->startPoint());
             }
-            edge2 = dynamic_cast<SubdivisionControlEdge*>(_edges[1]);
+            edge2 = _edges[1]->asControlEdge();
             if (edge2 == nullptr)
                 throw invalid_argument("edge is not a control edge SubdivisionControlPoint::collapse");
             if (edge2->startPoint() == this) {
@@ -895,11 +995,19 @@ void SubdivisionControlPoint::drawControlPoints(Viewport& vp,
 
 float SubdivisionControlPoint::distanceFromPickRay(
     Viewport& vp, const PickRay& ray) const
+{
+    float depth;
+    return distanceFromPickRay(vp, ray, depth);
+}
+
+float SubdivisionControlPoint::distanceFromPickRay(
+    Viewport& vp, const PickRay& ray, float& depth) const
 {
     QVector3D pt(_coordinate);
     if (vp.getViewportType() == fvBodyplan
         && pt.x() <= _owner->getMainframeLocation())
         pt.setY(-pt.y());
+    depth = QVector3D::dotProduct(pt - ray.pt, ray.dir) / ray.dir.lengthSquared();
     return pt.distanceToLine(ray.pt, ray.dir);
 }
 
@@ -31,12 +31,14 @@
 #define SUBDIVPOINT_H_
 
 #include <vector>
+#include <utility>
 #include <iosfwd>
 #include <QObject>
 #include <QVector3D>
 #include <QColor>
 #include "shipcadlib.h"
 #include "subdivbase.h"
+#include "adjacency.h"
 
 namespace ShipCAD {
 
@@ -92,6 +94,18 @@ public:
      * \param face the face to delete from this point
      */
     void deleteFace(SubdivisionFace* face);
+    /*! \brief keep the face and edge lists in slices of the level's blocks
+     *
+     * Subdivided points know how many faces and edges they will get,
+     * so their lists can be laid out once for the whole level
+     *
+     * \param faces slice for the faces
+     * \param nfaces number of faces expected
+     * \param edges slice for the edges
+     * \param nedges number of edges expected
+     */
+    void useSlices(SubdivisionFace** faces, size_t nfaces,
+                   SubdivisionEdge** edges, size_t nedges);
     
     // geometry ops
 
@@ -114,6 +128,15 @@ public:
      * \return coordinates of the calculated point
      */
     QVector3D averaging() const;
+    /*! \brief the weights averaging gives to the surrounding points
+     *
+     * The coordinates from averaging are the sum of the coordinates of
+     * these points times their weights. A point can be in the list more
+     * than once.
+     *
+     * \param weights the points and their weights
+     */
+    void averagingWeights(std::vector<std::pair<SubdivisionPoint*, float> >& weights) const;
     /*! \brief Create a vertex point
      *
      * During the subdivision process, new points are created at the
@@ -125,6 +148,20 @@ public:
      * \return new point that is a copy of this one
      */
     SubdivisionPoint* calculateVertexPoint();
+    /*! \brief Create a vertex point in memory already taken from the point pool
+     *
+     * Same as calculateVertexPoint, but the curves are not changed,
+     * use replaceInCurves for that
+     *
+     * \param mem memory for the new point
+     * \return new point that is a copy of this one
+     */
+    SubdivisionPoint* createVertexPoint(void* mem) const;
+    /*! \brief replace this point with its vertex point in the curves
+     *
+     * \param vertexpoint the vertex point made from this point
+     */
+    void replaceInCurves(SubdivisionPoint* vertexpoint);
 
     // getters/setters
 
@@ -147,15 +184,33 @@ public:
      *
      * \return coordinates of the normal vector
      */
+    QVector3D calculateNormal() const;
+    /*! \brief normal vector of the surface at this point
+     *
+     * Subdivided points read it from the normals the surface keeps
+     * after a rebuild, otherwise it is calculated
+     *
+     * \return coordinates of the normal vector
+     */
     QVector3D getNormal() const;
     SubdivisionFace* getFace(size_t index) const;
     SubdivisionEdge* getEdge(size_t index) const;
+    /*! \brief the edges attached to this point
+     */
+    const AdjacencyList<SubdivisionEdge*>& getEdges() const { return _edges; }
     bool isBoundaryVertex() const;
     /*! \brief index of this point in parent surface 
      *
      * \return the index of this point in parent surface
      */
     virtual size_t getIndex() const;
+    /*! \brief position of this point in the point list of its surface
+     *
+     * Kept up to date by the surface whenever the list changes, so
+     * getIndex doesn't have to search the list
+     */
+    size_t getListIndex() const { return _list_index; }
+    void setListIndex(size_t index) { _list_index = index; }
     size_t numberOfEdges() const { return _edges.size(); }
     size_t numberOfFaces() const { return _faces.size(); }
     size_t numberOfCurves() const;
@@ -179,6 +234,14 @@ public:
      * \param owner surface this point belongs to
      */
     static SubdivisionPoint* construct(SubdivisionSurface* owner);
+    /*! \brief make a point in memory already taken from the point pool
+     *
+     * This doesn't add the point to the parent surface
+     *
+     * \param owner surface this point belongs to
+     * \param mem memory for the new point
+     */
+    static SubdivisionPoint* construct(SubdivisionSurface* owner, void* mem);
 
 protected:
 
@@ -189,10 +252,11 @@ protected:
  
 protected:
 
-    std::vector<SubdivisionFace*> _faces;	/**< list of faces attached to this point */
-    std::vector<SubdivisionEdge*> _edges;	/**< list of edges attached to this point */
+    AdjacencyList<SubdivisionFace*> _faces;	/**< list of faces attached to this point */
+    AdjacencyList<SubdivisionEdge*> _edges;	/**< list of edges attached to this point */
     QVector3D _coordinate;					/**< 3D coordinates of this point */
     vertex_type_t _vtype;					/**< vertex type of this point */
+    size_t _list_index;					/**< position in the surface point list */
 };
 
 typedef std::vector<SubdivisionPoint*>::iterator subdivpt_iter;
@@ -257,6 +321,15 @@ public:
 
     // distance
     float distanceFromPickRay(Viewport& vp, const PickRay& ray) const;
+    /*! \brief distance from the pick ray to this point
+     *
+     * \param vp the viewport the ray comes from
+     * \param ray the pick ray
+     * \param depth distance along the ray to where it comes closest, in
+     * lengths of the ray direction
+     * \return the distance
+     */
+    float distanceFromPickRay(Viewport& vp, const PickRay& ray, float& depth) const;
     
 protected:
 
@@ -0,0 +1,147 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <Eigen/Sparse>
+
+#include "subdivstencils.h"
+#include "subdivpoint.h"
+#include "parallel.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+// rows handed to a thread at a time in evaluate
+static const size_t k_stencil_grain = 1024;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+SubdivisionStencils::SubdivisionStencils()
+    : _valid(false)
+{
+    // does nothing
+}
+
+void SubdivisionStencils::clear()
+{
+    _valid = false;
+    vector<int>().swap(_row_start);
+    vector<int>().swap(_column_index);
+    vector<float>().swap(_weights);
+    _columns.clear();
+}
+
+void SubdivisionStencils::assign(const vector<Stencil>& rows,
+                                 const vector<SubdivisionControlPoint*>& columns)
+{
+    size_t nweights = 0;
+    for (size_t i=0; i<rows.size(); ++i)
+        nweights += rows[i].size();
+    _row_start.assign(1, 0);
+    _row_start.reserve(rows.size() + 1);
+    _column_index.clear();
+    _column_index.reserve(nweights);
+    _weights.clear();
+    _weights.reserve(nweights);
+    for (size_t i=0; i<rows.size(); ++i) {
+        for (size_t j=0; j<rows[i].size(); ++j) {
+            if (rows[i][j].first >= columns.size())
+                throw out_of_range("stencil column outside of control points");
+            _column_index.push_back(static_cast<int>(rows[i][j].first));
+            _weights.push_back(rows[i][j].second);
+        }
+        _row_start.push_back(static_cast<int>(_weights.size()));
+    }
+    _columns = columns;
+    _valid = true;
+}
+
+void SubdivisionStencils::evaluate(vector<QVector3D>& result, bool parallel) const
+{
+    typedef Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> PointMatrix;
+    typedef Eigen::Map<const Eigen::SparseMatrix<float, Eigen::RowMajor> > WeightMap;
+
+    if (!_valid)
+        throw runtime_error("evaluating invalid stencil table");
+    PointMatrix control(_columns.size(), 3);
+    for (size_t i=0; i<_columns.size(); ++i) {
+        QVector3D p = _columns[i]->getCoordinate();
+        control(i, 0) = p.x();
+        control(i, 1) = p.y();
+        control(i, 2) = p.z();
+    }
+    size_t nrows = numberOfRows();
+    result.resize(nrows);
+    // each chunk multiplies its own block of rows
+    ParallelFor(nrows, k_stencil_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    int offset = _row_start[begin];
+                    vector<int> starts(_row_start.begin() + begin, _row_start.begin() + end + 1);
+                    for (size_t i=0; i<starts.size(); ++i)
+                        starts[i] -= offset;
+                    WeightMap block(static_cast<int>(end - begin), static_cast<int>(_columns.size()),
+                                    starts.back(), starts.data(),
+                                    _column_index.data() + offset, _weights.data() + offset);
+                    PointMatrix points = block * control;
+                    for (size_t i=begin; i<end; ++i)
+                        result[i] = QVector3D(points(i - begin, 0), points(i - begin, 1),
+                                              points(i - begin, 2));
+                }, parallel);
+}
+
+void SubdivisionStencils::identity(size_t column, Stencil& dest)
+{
+    dest.assign(1, make_pair(column, 1.0f));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+StencilAccumulator::StencilAccumulator(size_t columns)
+    : _sum(columns, 0.0f), _used(columns, false)
+{
+    // does nothing
+}
+
+void StencilAccumulator::add(const SubdivisionStencils::Stencil& stencil, float weight)
+{
+    for (size_t i=0; i<stencil.size(); ++i) {
+        size_t col = stencil[i].first;
+        if (!_used[col]) {
+            _used[col] = true;
+            _columns.push_back(col);
+        }
+        _sum[col] += weight * stencil[i].second;
+    }
+}
+
+void StencilAccumulator::extract(SubdivisionStencils::Stencil& dest)
+{
+    sort(_columns.begin(), _columns.end());
+    dest.clear();
+    dest.reserve(_columns.size());
+    for (size_t i=0; i<_columns.size(); ++i) {
+        size_t col = _columns[i];
+        if (_sum[col] != 0)
+            dest.push_back(make_pair(col, _sum[col]));
+        _sum[col] = 0;
+        _used[col] = false;
+    }
+    _columns.clear();
+}
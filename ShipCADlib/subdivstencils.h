@@ -0,0 +1,137 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#ifndef SUBDIVSTENCILS_H_
+#define SUBDIVSTENCILS_H_
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <QVector3D>
+
+namespace ShipCAD {
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+class SubdivisionPoint;
+class SubdivisionControlPoint;
+
+/*! \brief weights of the control points in each subdivided point
+ *
+ * Subdivision is linear in the control point coordinates. As long as
+ * the topology, crease edges and vertex types don't change, every
+ * subdivided point is the same weighted sum of control points. The
+ * table holds these weights as a sparse matrix, one row for each
+ * subdivided point and one column for each control point, so the
+ * subdivided points can be found again with one matrix product.
+ */
+class SubdivisionStencils
+{
+public:
+
+    /*! \brief weights of one point, pairs of (column, weight)
+     */
+    typedef std::vector<std::pair<size_t, float> > Stencil;
+
+    SubdivisionStencils();
+    ~SubdivisionStencils() {}
+
+    /*! \brief throw away the table
+     */
+    void clear();
+    /*! \brief make the table
+     *
+     * \param rows the stencil of each subdivided point, columns index the
+     * control points
+     * \param columns the control points
+     */
+    void assign(const std::vector<Stencil>& rows,
+                const std::vector<SubdivisionControlPoint*>& columns);
+    /*! \brief find the subdivided points from the control points
+     *
+     * \param result coordinates of the subdivided points, one for each row
+     * \param parallel split the rows over the thread pool
+     */
+    void evaluate(std::vector<QVector3D>& result, bool parallel) const;
+
+    // getters
+    bool isValid() const { return _valid; }
+    size_t numberOfRows() const { return _row_start.empty() ? 0 : _row_start.size() - 1; }
+    size_t numberOfColumns() const { return _columns.size(); }
+    size_t numberOfWeights() const { return _weights.size(); }
+
+    /*! \brief stencil of a control point, all weight on its own column
+     *
+     * \param column the column of the control point
+     * \param dest the stencil
+     */
+    static void identity(size_t column, Stencil& dest);
+
+private:
+
+    bool _valid;
+    // compressed rows, kept in plain vectors so Eigen stays out of this header
+    std::vector<int> _row_start;
+    std::vector<int> _column_index;
+    std::vector<float> _weights;
+    std::vector<SubdivisionControlPoint*> _columns;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief adds up weighted stencils
+ *
+ * Keeps a dense sum over all columns and a list of the columns used, so
+ * adding a stencil and reading back the sum only costs the number of
+ * weights involved. Each thread needs its own accumulator.
+ */
+class StencilAccumulator
+{
+public:
+
+    /*! \brief Constructor
+     *
+     * \param columns number of columns in the stencils
+     */
+    explicit StencilAccumulator(size_t columns);
+
+    /*! \brief add a stencil
+     *
+     * \param stencil the stencil to add
+     * \param weight multiplies the stencil
+     */
+    void add(const SubdivisionStencils::Stencil& stencil, float weight);
+    /*! \brief move the sum into a stencil and start a new sum
+     *
+     * \param dest the sum, sorted by column
+     */
+    void extract(SubdivisionStencils::Stencil& dest);
+
+private:
+
+    std::vector<float> _sum;
+    std::vector<bool> _used;
+    std::vector<size_t> _columns;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+};				/* end namespace */
+
+#endif
@@ -31,6 +31,10 @@
 #include <algorithm>
 #include <stdexcept>
 #include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <cmath>
 
 #include "subdivsurface.h"
 #include "subdivpoint.h"
@@ -47,6 +51,8 @@
 #include "version.h"
 #include "grid.h"
 #include "predicate.h"
+#include "parallel.h"
+#include "pointgrid.h"
 
 using namespace std;
 using namespace ShipCAD;
@@ -55,6 +61,76 @@ static int sDecimals = 4;
 
 bool ShipCAD::g_surface_verbose = true;
 
+// number of elements given to a thread at a time during subdivision
+static const size_t k_subdivide_grain = 256;
+// number of control faces given to a thread at a time during subdivision
+static const size_t k_subdivide_face_grain = 16;
+// default memory for subdivided levels kept in the level cache
+static const size_t k_level_cache_budget = 128 * 1024 * 1024;
+// squared distance within which a new control point is welded to an existing one
+static const float k_weld_error = 1E-5f;
+
+// the point lists keep each point's position in it up to date, so the
+// index lookups don't have to search
+template <typename T>
+static void ReindexPoints(vector<T*>& points, size_t from)
+{
+    for (size_t i=from; i<points.size(); ++i)
+        points[i]->setListIndex(i);
+}
+
+// memory used by the elements of a subdivided level, their lists are
+// in the blocks of the level
+static size_t LevelBytes(size_t points, size_t edges, size_t faces)
+{
+    return points * sizeof(SubdivisionPoint)
+        + edges * sizeof(SubdivisionEdge)
+        + faces * sizeof(SubdivisionFace);
+}
+
+// where the faces and edges of each new point of a level go in the
+// blocks of the level, point k has the entries from first[k] up to
+// first[k+1]
+struct PointSlices
+{
+    vector<size_t> firstface;
+    vector<size_t> firstedge;
+    SubdivisionFace** faces;
+    SubdivisionEdge** edges;
+
+    PointSlices() : firstface(1, 0), firstedge(1, 0), faces(nullptr), edges(nullptr) {}
+    void add(size_t nfaces, size_t nedges)
+        {
+            firstface.push_back(firstface.back() + nfaces);
+            firstedge.push_back(firstedge.back() + nedges);
+        }
+    void use(SubdivisionPoint* point, size_t k) const
+        {
+            point->useSlices(faces + firstface[k], firstface[k+1] - firstface[k],
+                             edges + firstedge[k], firstedge[k+1] - firstedge[k]);
+        }
+};
+
+// the faces and edges the edge point of an edge gets, the two halves of
+// the edge and in each face next to it the new faces and edges touching
+// the edge point
+static void EdgePointValence(const SubdivisionEdge* edge, size_t& faces, size_t& edges)
+{
+    faces = 0;
+    edges = 2;
+    for (size_t i=0; i<edge->numberOfFaces(); ++i) {
+        if (edge->getFace(i)->hasFacePoint()) {
+            faces += 2;
+            edges += 1;
+        }
+        else {
+            // quadrisected triangle
+            faces += 3;
+            edges += 2;
+        }
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 
 DeleteElementsCollection::DeleteElementsCollection()
@@ -78,11 +154,11 @@ SubdivisionSurface::SubdivisionSurface()
     : Entity(),
       _show_control_net(true), _initialized(false), _show_interior_edges(false),
       _draw_mirror(false), _shade_under_water(false), _show_normals(true),
-      _show_curvature(true), _show_control_curves(true),
+      _show_curvature(true), _show_control_curves(true), _parallel_subdivision(true),
       _subdivision_mode(fmQuadTriangle), _desired_subdiv_level(1),
       _current_subdiv_level(-1), _control_point_size(2),
       _curvature_scale(0.25), _min_gaus_curvature(0), _max_gaus_curvature(0),
-      _main_frame_location(1E10),
+      _main_frame_location(1E10), _adaptive_tolerance(0),
       _crease_color(Qt::green), _crease_edge_color(Qt::red),
       _underwater_color(Qt::gray),
       _edge_color(Qt::darkGray), _selected_color(Qt::yellow),
@@ -91,6 +167,9 @@ SubdivisionSurface::SubdivisionSurface()
       _layer_color(QColor(0, 255, 255)), _normal_color(QColor(0xc0, 0xc0, 0xc0)), _leak_color(Qt::red),
       _curvature_color(Qt::white), _control_curve_color(Qt::red),
       _zebra_color(Qt::black), _last_used_layerID(0), _active_layer(0),
+      _level_cache_budget(k_level_cache_budget), _pick_rebuild(true), _pick_refit(false),
+      _point_hash(sqrt(k_weld_error)), _point_hash_valid(false), _face_index_valid(false),
+      _build_count(0), _local_rebuild(false),
       _cpoint_pool(sizeof(SubdivisionControlPoint)),
       _cedge_pool(sizeof(SubdivisionControlEdge)),
       _cface_pool(sizeof(SubdivisionControlFace)),
@@ -107,6 +186,9 @@ SubdivisionSurface::SubdivisionSurface()
 
 SubdivisionSurface::~SubdivisionSurface()
 {
+    // the pools only free the memory, run the destructors first
+    clearFaces();
+    destroyControlElements();
     // clear the pools
     _ccurve_pool.clear();
     _cface_pool.clear();
@@ -118,6 +200,20 @@ SubdivisionSurface::~SubdivisionSurface()
     _spline_pool.clear();
 }
 
+void SubdivisionSurface::destroyControlElements()
+{
+    for (size_t i=0; i<_control_curves.size(); ++i) {
+        _control_curves[i]->getSpline()->~Spline();
+        _control_curves[i]->~SubdivisionControlCurve();
+    }
+    for (size_t i=0; i<_control_faces.size(); ++i)
+        _control_faces[i]->~SubdivisionControlFace();
+    for (size_t i=0; i<_control_edges.size(); ++i)
+        _control_edges[i]->~SubdivisionControlEdge();
+    for (size_t i=0; i<_control_points.size(); ++i)
+        _control_points[i]->~SubdivisionControlPoint();
+}
+
 void SubdivisionSurface::deleteElementsCollection()
 {
     if (_deleted.isSuppressed()) {
@@ -130,26 +226,31 @@ void SubdivisionSurface::deleteElementsCollection()
     size_t pt,edge,fc,crv,spl;
     pt = 0;
     for (set<SubdivisionControlPoint*>::iterator i=_deleted.points.begin(); i!=_deleted.points.end(); i++) {
+        (*i)->~SubdivisionControlPoint();
         _cpoint_pool.del(*i);
         pt++;
     }
     edge = 0;
     for (set<SubdivisionControlEdge*>::iterator i=_deleted.edges.begin(); i!=_deleted.edges.end(); i++) {
+        (*i)->~SubdivisionControlEdge();
         _cedge_pool.del(*i);
         edge++;
     }
     fc = 0;
     for (set<SubdivisionControlFace*>::iterator i=_deleted.faces.begin(); i!=_deleted.faces.end(); i++) {
+        (*i)->~SubdivisionControlFace();
         _cface_pool.del(*i);
         fc++;
     }
     crv = 0;
     for (set<SubdivisionControlCurve*>::iterator i=_deleted.curves.begin(); i!=_deleted.curves.end(); i++) {
+        (*i)->~SubdivisionControlCurve();
         _ccurve_pool.del(*i);
         crv++;
     }
     spl = 0;
     for (set<Spline*>::iterator i=_deleted.splines.begin(); i!=_deleted.splines.end(); i++) {
+        (*i)->~Spline();
         _spline_pool.del(*i);
         spl++;
     }
@@ -165,65 +266,62 @@ SubdivisionControlPoint* SubdivisionSurface::newControlPoint(const QVector3D& p)
 {
     SubdivisionControlPoint* pt = SubdivisionControlPoint::construct(this);
     pt->setCoordinate(p);
+    pt->setListIndex(_control_points.size());
     _control_points.push_back(pt);
+    if (_point_hash_valid)
+        _point_hash.insert(pt);
     return pt;
 }
 
 SubdivisionControlPoint* SubdivisionSurface::addControlPoint(const QVector3D& pt)
 {
-    SubdivisionControlPoint* result = 0;
-    double max_error = 1E-5;
-    for (size_t i=0; i<numberOfControlEdges(); ++i) {
-        SubdivisionControlEdge* edge = getControlEdge(i);
-        if (edge->numberOfFaces() <= 1) { // boundary edge
-            if (SquaredDistPP(pt, edge->startPoint()->getCoordinate()) <= max_error) {
-                result = dynamic_cast<SubdivisionControlPoint*>(edge->startPoint());
-                break;
-            }
-            else if (SquaredDistPP(pt, edge->endPoint()->getCoordinate()) <= max_error) {
-                result = dynamic_cast<SubdivisionControlPoint*>(edge->endPoint());
-                break;
-            }
-        }
-    }
-    if (result == 0) {
-        // search controlpoints without edges
-        for (size_t i=0; i<numberOfControlPoints(); ++i) {
-            SubdivisionControlPoint* point = getControlPoint(i);
-            if (point->numberOfEdges() == 0) {
-                if (SquaredDistPP(pt, point->getCoordinate()) <= max_error) {
-                    result = point;
-                    break;
-                }
-            }
-        }
-    }
-    if (result == 0) {
-        result = newControlPoint(pt);
-    }
-    return result;
+    if (!_point_hash_valid) {
+        _point_hash.clear();
+        for (size_t i=0; i<numberOfControlPoints(); ++i)
+            _point_hash.insert(getControlPoint(i));
+        _point_hash_valid = true;
+    }
+    // the nearest point on a boundary edge, or without edges
+    vector<SubdivisionControlPoint*> near;
+    _point_hash.find(pt, _point_hash.getCellSize(), near);
+    for (size_t i=0; i<near.size(); ++i) {
+        SubdivisionControlPoint* point = near[i];
+        bool boundary = point->numberOfEdges() == 0;
+        for (size_t j=0; j<point->numberOfEdges() && !boundary; ++j)
+            boundary = point->getEdge(j)->numberOfFaces() <= 1;
+        if (boundary)
+            return point;
+    }
+    return newControlPoint(pt);
 }
 
 void SubdivisionSurface::addControlPoint(SubdivisionControlPoint* pt)
 {
     if (!hasControlPoint(pt)) {
+        pt->setListIndex(_control_points.size());
         _control_points.push_back(pt);
         pt->setOwner(this);
+        if (_point_hash_valid)
+            _point_hash.insert(pt);
     }
     setBuild(false);
 }
 
 bool SubdivisionSurface::hasControlPoint(const SubdivisionControlPoint* pt) const
 {
-    return find(_control_points.begin(), _control_points.end(), pt)
-            != _control_points.end();
+    size_t index = pt->getListIndex();
+    return index < _control_points.size() && _control_points[index] == pt;
 }
 
 void SubdivisionSurface::removeControlPoint(SubdivisionControlPoint* pt)
 {
-    vector<SubdivisionControlPoint*>::iterator i = find(_control_points.begin(), _control_points.end(), pt);
-    if (i != _control_points.end())
-        _control_points.erase(i);
+    if (hasControlPoint(pt)) {
+        size_t index = pt->getListIndex();
+        _control_points.erase(_control_points.begin() + index);
+        ReindexPoints(_control_points, index);
+        if (_point_hash_valid)
+            _point_hash.remove(pt, pt->getCoordinate());
+    }
 }
 
 SubdivisionControlPoint* SubdivisionSurface::addControlPoint()
@@ -1037,11 +1135,8 @@ float SubdivisionSurface::getGaussCurvature(size_t idx) const
 
 size_t SubdivisionSurface::indexOfControlPoint(const SubdivisionControlPoint *pt) const
 {
-    vector<SubdivisionControlPoint*>::const_iterator i = find(_control_points.begin(),
-                                                        _control_points.end(),
-                                                        pt);
-    if (i != _control_points.end())
-        return i - _control_points.begin();
+    if (hasControlPoint(pt))
+        return pt->getListIndex();
     throw out_of_range("point not found in SubdivisionSurface::indexOfControlPoint");
 }
 
@@ -1222,6 +1317,14 @@ size_t SubdivisionSurface::numberOfFaces()
     return result;
 }
 
+size_t SubdivisionSurface::numberOfAdaptiveFaces() const
+{
+    size_t result = 0;
+    for (size_t i=0; i<numberOfControlFaces(); ++i)
+        result += getControlFace(i)->numberOfAdaptiveFaces();
+    return result;
+}
+
 size_t SubdivisionSurface::numberOfLockedPoints() const
 {
     size_t result = 0;
@@ -1233,12 +1336,9 @@ size_t SubdivisionSurface::numberOfLockedPoints() const
 
 size_t SubdivisionSurface::indexOfPoint(const SubdivisionPoint *pt) const
 {
-    vector<SubdivisionPoint*>::const_iterator i = find(_points.begin(),
-                                                 _points.end(),
-                                                 pt);
-    if (i != _points.end())
-        return i - _points.begin();
-
+    size_t index = pt->getListIndex();
+    if (index < _points.size() && _points[index] == pt)
+        return index;
     throw out_of_range("point is not in SubdivisionSurface");
 }
 
@@ -1251,9 +1351,11 @@ SubdivisionPoint* SubdivisionSurface::getPoint(size_t index) const
 
 void SubdivisionSurface::deletePoint(SubdivisionPoint* point)
 {
-    vector<SubdivisionPoint*>::iterator i = find(_points.begin(), _points.end(), point);
-    if (i != _points.end()) {
-        _points.erase(i);
+    size_t index = point->getListIndex();
+    if (index < _points.size() && _points[index] == point) {
+        clearNormals();
+        _points.erase(_points.begin() + index);
+        ReindexPoints(_points, index);
         point->~SubdivisionPoint();
         _point_pool.del(point);
     }
@@ -1381,6 +1483,7 @@ void SubdivisionSurface::setBuild(bool val)
     cout << "set build" << endl;
     Entity::setBuild(val);
     if (!val) {
+        _pick_rebuild = true;
         clearFaces();
         for (size_t i=0; i<numberOfControlCurves(); ++i)
             getControlCurve(i)->setBuild(false);
@@ -1388,9 +1491,31 @@ void SubdivisionSurface::setBuild(bool val)
         _gaus_curvature.clear();
         _min_gaus_curvature = 0;
         _max_gaus_curvature = 0;
+        _moved_points.clear();
+        _stencils.clear();
     }
 }
 
+void SubdivisionSurface::controlPointMoved(SubdivisionControlPoint* pt, const QVector3D& from)
+{
+    _pick_refit = true;
+    if (_point_hash_valid)
+        _point_hash.move(pt, from);
+    // nothing subdivided to keep, or a full rebuild is already pending
+    if (_current_subdiv_level <= 0) {
+        setBuild(false);
+        return;
+    }
+    Entity::setBuild(false);
+    _moved_points.insert(pt);
+    // the normals are kept, the rebuild finds the changed ones again
+    // the other levels no longer fit the control points
+    clearLevelCache();
+    _gaus_curvature.clear();
+    _min_gaus_curvature = 0;
+    _max_gaus_curvature = 0;
+}
+
 SubdivisionBase*
 SubdivisionSurface::shootPickRay(Viewport& vp, const PickRay& ray)
 {
@@ -1406,25 +1531,33 @@ SubdivisionSurface::shootPickRay(Viewport& vp, const PickRay& ray)
         else
             pick_fwd = true;
     }
+    // the trees give the elements whose boxes the ray passes, nearest
+    // first, so the search stops once the boxes are behind the best pick
+    updatePickTrees();
+    vector<PickTree::Candidate> hits;
+    float best = numeric_limits<float>::max();
+    float depth;
     // check control points
     if (ray.point) {
-        for (size_t i=0; i<numberOfControlPoints(); i++) {
-            SubdivisionControlPoint* cp = getControlPoint(i);
+        _point_tree.query(useray.pt, useray.dir, useray.pickDist, hits);
+        for (size_t i=0; i<hits.size() && hits[i].first <= best; i++) {
+            SubdivisionControlPoint* cp = getControlPoint(hits[i].second);
             if (!cp->isVisible())
                 continue;
             if ((pick_aft && cp->getCoordinate().x() > _main_frame_location)
                     || (pick_fwd && cp->getCoordinate().x() < _main_frame_location))
                 continue;
-            if (cp->distanceFromPickRay(vp, useray) < useray.pickDist) {
+            if (cp->distanceFromPickRay(vp, useray, depth) < useray.pickDist && depth < best) {
                 pick = cp;
-                break;
+                best = depth;
             }
         }
     }
     if (ray.edge && pick == nullptr) {
         // check control edges
-        for (size_t i=0; i<numberOfControlEdges(); i++) {
-            SubdivisionControlEdge* edge = getControlEdge(i);
+        _edge_tree.query(useray.pt, useray.dir, useray.pickDist, hits);
+        for (size_t i=0; i<hits.size() && hits[i].first <= best; i++) {
+            SubdivisionControlEdge* edge = getControlEdge(hits[i].second);
             if (!edge->isVisible())
                 continue;
             if ((pick_aft && edge->startPoint()->getCoordinate().x() > _main_frame_location
@@ -1432,34 +1565,121 @@ SubdivisionSurface::shootPickRay(Viewport& vp, const PickRay& ray)
                 || (pick_fwd && edge->startPoint()->getCoordinate().x() < _main_frame_location
                                  && edge->endPoint()->getCoordinate().x() < _main_frame_location))
                 continue;
-            if (edge->distanceToEdge(useray.pt, useray.dir) < useray.pickDist) {
+            if (edge->distanceToEdge(useray.pt, useray.dir, depth) < useray.pickDist
+                    && depth < best) {
                 pick = edge;
-                break; // if we came close to an edge, pick it and stop looking
+                best = depth;
             }
         }
     }
     if (ray.face && pick == nullptr) {
         // check face
-        for (size_t i=0; i<numberOfControlFaces(); i++) {
-            SubdivisionControlFace* face = getControlFace(i);
+        _face_tree.query(useray.pt, useray.dir, useray.pickDist, hits);
+        for (size_t i=0; i<hits.size() && hits[i].first <= best; i++) {
+            SubdivisionControlFace* face = getControlFace(hits[i].second);
             if (!face->isVisible())
                 continue;
-            if (face->intersectWithRay(useray)) {
+            if (face->intersectWithRay(useray, depth) && depth < best) {
                 pick = face;
-                break;
+                best = depth;
             }
         }
     }
     return pick;
 }
 
+// box of each control point, and of its mirror image as the bodyplan
+// shows the points aft of the main frame on the other side
+static void PointBoxes(const vector<SubdivisionControlPoint*>& points,
+                       vector<QVector3D>& mins, vector<QVector3D>& maxs)
+{
+    mins.resize(points.size());
+    maxs.resize(points.size());
+    for (size_t i=0; i<points.size(); ++i) {
+        QVector3D p = points[i]->getCoordinate();
+        mins[i] = maxs[i] = p;
+        p.setY(-p.y());
+        MinMax(p, mins[i], maxs[i]);
+    }
+}
+
+static void EdgeBoxes(const vector<SubdivisionControlEdge*>& edges,
+                      vector<QVector3D>& mins, vector<QVector3D>& maxs)
+{
+    mins.resize(edges.size());
+    maxs.resize(edges.size());
+    for (size_t i=0; i<edges.size(); ++i) {
+        mins[i] = maxs[i] = edges[i]->startPoint()->getCoordinate();
+        MinMax(edges[i]->endPoint()->getCoordinate(), mins[i], maxs[i]);
+    }
+}
+
+static void FaceBoxes(const vector<SubdivisionControlFace*>& faces,
+                      vector<QVector3D>& mins, vector<QVector3D>& maxs)
+{
+    mins.resize(faces.size());
+    maxs.resize(faces.size());
+    for (size_t i=0; i<faces.size(); ++i) {
+        mins[i] = maxs[i] = faces[i]->getPoint(0)->getCoordinate();
+        for (size_t j=1; j<faces[i]->numberOfPoints(); ++j)
+            MinMax(faces[i]->getPoint(j)->getCoordinate(), mins[i], maxs[i]);
+    }
+}
+
+void SubdivisionSurface::updatePickTrees()
+{
+    if (_point_tree.numberOfItems() != numberOfControlPoints()
+            || _edge_tree.numberOfItems() != numberOfControlEdges()
+            || _face_tree.numberOfItems() != numberOfControlFaces())
+        _pick_rebuild = true;
+    if (!_pick_rebuild && !_pick_refit)
+        return;
+    vector<QVector3D> mins, maxs;
+    PointBoxes(_control_points, mins, maxs);
+    if (_pick_rebuild)
+        _point_tree.build(mins, maxs);
+    else
+        _point_tree.refit(mins, maxs);
+    EdgeBoxes(_control_edges, mins, maxs);
+    if (_pick_rebuild)
+        _edge_tree.build(mins, maxs);
+    else
+        _edge_tree.refit(mins, maxs);
+    FaceBoxes(_control_faces, mins, maxs);
+    if (_pick_rebuild)
+        _face_tree.build(mins, maxs);
+    else
+        _face_tree.refit(mins, maxs);
+    _pick_rebuild = false;
+    _pick_refit = false;
+}
+
 void SubdivisionSurface::setDesiredSubdivisionLevel(int val)
 {
     if (val > 4)
         val = 4;
     if (val != _desired_subdiv_level) {
         _desired_subdiv_level = val;
-        setBuild(false);
+        // keep the subdivided levels, rebuild moves to the new one
+        Entity::setBuild(false);
+    }
+}
+
+void SubdivisionSurface::setLevelCacheBudget(size_t bytes)
+{
+    _level_cache_budget = bytes;
+    trimLevelCache();
+}
+
+void SubdivisionSurface::setAdaptiveTolerance(float val)
+{
+    if (val < 0)
+        val = 0;
+    if (val != _adaptive_tolerance) {
+        _adaptive_tolerance = val;
+        // the subdivided mesh stays, the next rebuild only makes new adaptive faces
+        _adaptive_strides.clear();
+        Entity::setBuild(false);
     }
 }
 
@@ -1690,6 +1910,8 @@ SubdivisionControlFace* SubdivisionSurface::addControlFace(std::vector<Subdivisi
 void SubdivisionSurface::clear()
 {
     Entity::clear();
+    clearFaces();
+    destroyControlElements();
     _control_curves.clear();
     _control_faces.clear();
     _control_edges.clear();
@@ -1724,22 +1946,32 @@ void SubdivisionSurface::clear()
     _show_normals = true;
     _shade_under_water = false;
     _main_frame_location = 1E10;
+    _adaptive_tolerance = 0;
+    _point_hash.clear();
+    _point_hash_valid = false;
     setBuild(false);
 }
 
 void SubdivisionSurface::clearFaces()
 {
+    clearNormals();
+    clearLevelCache();
     for (size_t i=0; i<numberOfControlFaces(); ++i) {
         getControlFace(i)->clearChildren();       // deletes children and rendermesh
     }
     // dump all edges
+    for (size_t i=0; i<_edges.size(); ++i)
+        _edges[i]->~SubdivisionEdge();
     _edges.clear();
     _edge_pool.clear();
     // dump all points
+    for (size_t i=0; i<_points.size(); ++i)
+        _points[i]->~SubdivisionPoint();
     _points.clear();
     _point_pool.clear();
     // dump all faces
     _face_pool.clear();
+    _adjacency.clear();
     // clear edges in control faces
     for (size_t i=0; i<numberOfControlFaces(); ++i)
         getControlFace(i)->clearControlEdges();
@@ -2090,8 +2322,8 @@ void SubdivisionSurface::exportObjFile(bool export_control_net, QStringList& str
     if (!isBuild())
         rebuild();
     strings.push_back("# FREE!ship model");
-    // first sort controlpoints for faster access of function indexOf()
-    sort(_points.begin(), _points.end());
+    // the points know their position in the list, so indexOfPoint doesn't
+    // need them sorted
 
     if (!export_control_net) {
         // export subdivided surface
@@ -2103,8 +2335,8 @@ void SubdivisionSurface::exportObjFile(bool export_control_net, QStringList& str
             strings.push_back(QString("v %1 %2 %3").arg(getPoint(i)->getCoordinate().y())
                               .arg(getPoint(i)->getCoordinate().z())
                               .arg(getPoint(i)->getCoordinate().x()));
-            if (getPoint(i-1)->getCoordinate().y() > 0)
-                tmp.push_back(getPoint(i-1));
+            if (getPoint(i)->getCoordinate().y() > 0)
+                tmp.push_back(getPoint(i));
         }
         if (drawMirror()) {
             // create points for starboard side
@@ -2135,7 +2367,7 @@ void SubdivisionSurface::exportObjFile(bool export_control_net, QStringList& str
                             size_t index;
                             if (child->getPoint(k-1)->getCoordinate().y() > 0) {
                                 vector<SubdivisionPoint*>::iterator idx =
-                                        find(tmp.begin(), tmp.end(), child->getPoint(k-1));
+                                        lower_bound(tmp.begin(), tmp.end(), child->getPoint(k-1));
                                 index = (idx - tmp.begin()) + numberOfPoints();
                             }
                             else
@@ -2150,10 +2382,9 @@ void SubdivisionSurface::exportObjFile(bool export_control_net, QStringList& str
     }
     else {
         // export the control net only
-        // first sort controlpoints for fac
         // create points for portside
       vector<SubdivisionPoint*> tmp;
-      tmp.reserve(numberOfPoints());
+      tmp.reserve(numberOfControlPoints());
         for (size_t i=0; i<numberOfControlPoints(); ++i) {
             // BUGBUG: FloatToStrF ffFixed, 7, 4
             strings.push_back(QString("v %1 %2 %3").arg(getControlPoint(i)->getCoordinate().y())
@@ -2175,31 +2406,28 @@ void SubdivisionSurface::exportObjFile(bool export_control_net, QStringList& str
         for (size_t i=0; i<numberOfControlFaces(); ++i) {
             SubdivisionControlFace* cface = _control_faces[i];
             if (cface->getLayer()->isVisible()) {
-                for (size_t j=0; j<cface->numberOfChildren(); ++j) {
-                    // BUGBUG, j isn't used
-                    // portside
+                // portside
+                QString str("f");
+                for (size_t k=0; k<cface->numberOfPoints(); ++k) {
+                    size_t index = cface->getPoint(k)->getIndex();
+                    str.append(QString(" %1").arg(index+1));
+                }
+                strings.push_back(str);
+                if (cface->getLayer()->isSymmetric() && drawMirror()) {
+                    // starboard side
                     QString str("f");
-                    for (size_t k=0; k<cface->numberOfPoints(); ++k) {
-                        size_t index = indexOfPoint(cface->getPoint(k));
+                    for (size_t k=cface->numberOfPoints(); k>=1; --k) {
+                        size_t index;
+                        if (cface->getPoint(k-1)->getCoordinate().y() > 0) {
+                            vector<SubdivisionPoint*>::iterator idx =
+                                    lower_bound(tmp.begin(), tmp.end(), cface->getPoint(k-1));
+                            index = (idx - tmp.begin()) + numberOfControlPoints();
+                        }
+                        else
+                            index = cface->getPoint(k-1)->getIndex();
                         str.append(QString(" %1").arg(index+1));
                     }
                     strings.push_back(str);
-                    if (cface->getLayer()->isSymmetric() && drawMirror()) {
-                        // starboard side
-                        QString str("f");
-                        for (size_t k=cface->numberOfPoints(); k>=1; --k) {
-                            size_t index;
-                            if (cface->getPoint(k-1)->getCoordinate().y() > 0) {
-                                vector<SubdivisionPoint*>::iterator idx =
-                                        find(tmp.begin(), tmp.end(), cface->getPoint(k-1));
-                                index = (idx - tmp.begin()) + numberOfPoints();
-                            }
-                            else
-                                index = indexOfPoint(cface->getPoint(k-1));
-                            str.append(QString(" %1").arg(index+1));
-                        }
-                        strings.push_back(str);
-                    }
                 }
             }
         }
@@ -2300,261 +2528,240 @@ void SubdivisionSurface::extrudeEdges(vector<SubdivisionControlEdge*>& edges,
     setBuild(false);
 }
 
-struct SurfIntersectionData
-{
-    QVector3D point;
-    bool knuckle;
-    SubdivisionEdge* edge;
-    SurfIntersectionData() : point(ZERO), knuckle(false), edge(0) {}
-    SurfIntersectionData(const QVector3D& pt) : point(pt), knuckle(false), edge(0) {}
-};
-
-void SubdivisionSurface::calculateIntersections(const Plane& plane,
-                                                vector<SubdivisionControlFace*>& faces,
-                                                SplineVector& destination)
+// the segments where a plane cuts a subdivided face, edges holds the
+// edges lying in the plane found so far
+static void IntersectFace(SubdivisionSurface* surface, const Plane& plane, SubdivisionFace* face,
+                          vector<SubdivisionEdge*>& edges, IntersectionSegments& segments)
 {
-    SubdivisionControlFace* ctrlface;
-    SubdivisionFace* face, *f2;
+    SubdivisionFace* f2;
     SubdivisionPoint* p1, *p2, *p3;
     SubdivisionEdge* edge;
     float side1, side2;
-    bool addedge;
-
-    // first assemble all edges belong to this set of faces
-    vector<SubdivisionEdge*> edges;
-    edges.reserve(faces.size()+100);
     vector<SurfIntersectionData> intarray;
 
-    // first is start point, second is end point
-    vector<pair<SurfIntersectionData, SurfIntersectionData> > segments;
-
-    for (size_t i=0; i<faces.size(); ++i) {
-        ctrlface = faces[i];
-        for (size_t j=0; j<ctrlface->numberOfChildren(); ++j) {
-            face = ctrlface->getChild(j);
-            intarray.clear();
-            p1 = face->getPoint(face->numberOfPoints()-1);
-            side1 = plane.distance(p1->getCoordinate());
-            for (size_t k=0; k<face->numberOfPoints(); ++k) {
-                p2 = face->getPoint(k);
-                side2 = plane.distance(p2->getCoordinate());
-                bool addedge = false;
-                if ((side1 < -1E-5 && side2 > 1E-5) || (side1 > 1E-5 && side2 < -1E-5)) {
-                    // regular intersection of edge
-                    // add the edge to the list
-                    float parameter = -side1 / (side2 - side1);
-                    QVector3D output = p1->getCoordinate()
-                            + parameter * (p2->getCoordinate() - p1->getCoordinate());
-                    intarray.push_back(SurfIntersectionData(output));
-                    edge = edgeExists(p1, p2);
-                    if (edge != 0) {
-                        intarray.back().knuckle = edge->isCrease();
-                        intarray.back().edge = edge;
-                    }
+    p1 = face->getPoint(face->numberOfPoints()-1);
+    side1 = plane.distance(p1->getCoordinate());
+    for (size_t k=0; k<face->numberOfPoints(); ++k) {
+        p2 = face->getPoint(k);
+        side2 = plane.distance(p2->getCoordinate());
+        bool addedge = false;
+        if ((side1 < -1E-5 && side2 > 1E-5) || (side1 > 1E-5 && side2 < -1E-5)) {
+            // regular intersection of edge
+            // add the edge to the list
+            float parameter = -side1 / (side2 - side1);
+            QVector3D output = p1->getCoordinate()
+                    + parameter * (p2->getCoordinate() - p1->getCoordinate());
+            intarray.push_back(SurfIntersectionData(output));
+            edge = surface->edgeExists(p1, p2);
+            if (edge != 0) {
+                intarray.back().knuckle = edge->isCrease();
+                intarray.back().edge = edge;
+            }
+            else {
+                intarray.back().knuckle = false;
+                intarray.back().edge = 0;
+            }
+        }
+        else {
+            // does the edge lie entirely within the plane?
+            if ((fabs(side1) <= 1E-5) && (fabs(side2) <= 1E-5)) {
+                // if so, then add this edge ONLY if:
+                // 1. the edge is a boundary edge
+                // 2. at least ONE of the attached faces does NOT lie in the plane
+                edge = surface->edgeExists(p1, p2);
+                if (edge != 0) {
+                    if (edge->numberOfFaces() == 1)
+                        addedge = true;
                     else {
-                        intarray.back().knuckle = false;
-                        intarray.back().edge = 0;
-                    }
-                }
-                else {
-                    // does the edge lie entirely within the plane?
-                    if ((fabs(side1) <= 1E-5) && (fabs(side2) <= 1E-5)) {
-                        // if so, then add this edge ONLY if:
-                        // 1. the edge is a boundary edge
-                        // 2. at least ONE of the attached faces does NOT lie in the plane
-                        edge = edgeExists(p1, p2);
-                        if (edge != 0) {
-                            if (edge->numberOfFaces() == 1)
-                                addedge = true;
-                            else {
-                                for (size_t n=0; n<edge->numberOfFaces(); ++n) {
-                                    f2 = edge->getFace(n);
-                                    for (size_t m=0; m<f2->numberOfPoints(); ++m) {
-                                        p3 = f2->getPoint(m);
-                                        float parameter = plane.distance(p3->getCoordinate());
-                                        if (fabs(parameter) > 1E-5) {
-                                            addedge = true;
-                                            break;
-                                        }
-                                    }
-                                    if (addedge)
-                                        break;
-                                }
-                            }
-                            if (addedge) {
-                                if (find(edges.begin(), edges.end(), edge) == edges.end()) {
-                                    edges.push_back(edge);
-                                    SurfIntersectionData sp;
-                                    sp.point = p1->getCoordinate();
-                                    sp.edge = edge;
-                                    SurfIntersectionData ep;
-                                    ep.point = p2->getCoordinate();
-                                    ep.edge = edge;
-                                    if (!edge->isCrease()) {
-                                        sp.knuckle = p1->getVertexType() != svRegular;
-                                        ep.knuckle = p2->getVertexType() != svRegular;
-                                    }
-                                    else {
-                                        sp.knuckle = p1->getVertexType() == svCorner;
-                                        ep.knuckle = p2->getVertexType() == svCorner;
-                                    }
-                                    segments.push_back(make_pair(sp, ep));
+                        for (size_t n=0; n<edge->numberOfFaces(); ++n) {
+                            f2 = edge->getFace(n);
+                            for (size_t m=0; m<f2->numberOfPoints(); ++m) {
+                                p3 = f2->getPoint(m);
+                                float parameter = plane.distance(p3->getCoordinate());
+                                if (fabs(parameter) > 1E-5) {
+                                    addedge = true;
+                                    break;
                                 }
                             }
+                            if (addedge)
+                                break;
                         }
                     }
-                    else if (fabs(side2) < 1E-5) {
-                        SurfIntersectionData id(p2->getCoordinate());
-                        id.knuckle = p2->getVertexType() != svRegular;
-                        id.edge = edgeExists(p1, p2);
-                        intarray.push_back(id);
-                    }
-                }
-                p1 = p2;
-                side1 = side2;
-            }
-            if (intarray.size() > 1) {
-                if (intarray.front().edge == intarray.back().edge) {
-                    if (intarray.front().point.distanceToPoint(intarray.back().point) < 1E-4) {
-                        intarray.pop_back();
-                    }
-                }
-                size_t k = 1;
-                while (k < intarray.size()) {
-                    if (intarray[k].edge == intarray[k-1].edge) {
-                        if (intarray[k].point.distanceToPoint(intarray[k-1].point) < 1E-4) {
-                            intarray.erase(intarray.begin()+k-1);
+                    if (addedge) {
+                        if (find(edges.begin(), edges.end(), edge) == edges.end()) {
+                            edges.push_back(edge);
+                            SurfIntersectionData sp;
+                            sp.point = p1->getCoordinate();
+                            sp.edge = edge;
+                            SurfIntersectionData ep;
+                            ep.point = p2->getCoordinate();
+                            ep.edge = edge;
+                            if (!edge->isCrease()) {
+                                sp.knuckle = p1->getVertexType() != svRegular;
+                                ep.knuckle = p2->getVertexType() != svRegular;
+                            }
+                            else {
+                                sp.knuckle = p1->getVertexType() == svCorner;
+                                ep.knuckle = p2->getVertexType() == svCorner;
+                            }
+                            segments.push_back(make_pair(sp, ep));
                         }
-                        else
-                            ++k;
                     }
-                    else
-                        ++k;
-                }
-                for (size_t l=1; l<intarray.size(); ++l) {
-                    segments.push_back(make_pair(intarray[l-1], intarray[l]));
                 }
             }
+            else if (fabs(side2) < 1E-5) {
+                SurfIntersectionData id(p2->getCoordinate());
+                id.knuckle = p2->getVertexType() != svRegular;
+                id.edge = surface->edgeExists(p1, p2);
+                intarray.push_back(id);
+            }
         }
+        p1 = p2;
+        side1 = side2;
     }
-
-    // convert segments into polylines
-    Spline* spline = 0;
-    SurfIntersectionData startp, endp;
-    pair<SurfIntersectionData, SurfIntersectionData> segment;
-    while (segments.size() > 0) {
-        if (spline == 0) {
-            spline = new Spline();
-            destination.add(spline);
-            segment = segments.back();
-            spline->add(segment.first.point);
-            spline->setKnuckle(0, segment.first.knuckle);
-            spline->add(segment.second.point);
-            spline->setKnuckle(1, segment.second.knuckle);
-            startp = segment.first;
-            endp = segment.second;
-            segments.pop_back();
-        }
-        addedge = false;
-        size_t j = 0;
-        while (j < segments.size()) {
-            segment = segments[j];
-            if (endp.edge == segment.first.edge) {
-                addedge = endp.point.distanceToPoint(segment.first.point) < 1E-4;
-                if (addedge) {
-                    spline->setKnuckle(spline->numberOfPoints()-1, segment.first.knuckle
-                                       || spline->isKnuckle(spline->numberOfPoints()-1));
-                    spline->add(segment.second.point);
-                    spline->setKnuckle(spline->numberOfPoints()-1, segment.second.knuckle);
-                    endp = segment.second;
-                }
-            }
-            else if (endp.edge == segment.second.edge) {
-                addedge = endp.point.distanceToPoint(segment.second.point) < 1E-4;
-                if (addedge) {
-                    spline->setKnuckle(spline->numberOfPoints()-1, segment.second.knuckle
-                                       || spline->isKnuckle(spline->numberOfPoints()-1));
-                    spline->add(segment.first.point);
-                    spline->setKnuckle(spline->numberOfPoints()-1, segment.first.knuckle);
-                    endp = segment.first;
-                }
-            }
-            else if (startp.edge == segment.first.edge) {
-                addedge = startp.point.distanceToPoint(segment.first.point) < 1E-4;
-                if (addedge) {
-                    spline->setKnuckle(0, segment.first.knuckle || spline->isKnuckle(0));
-                    spline->insert(0, segment.second.point);
-                    spline->setKnuckle(0, segment.second.knuckle);
-                    startp = segment.second;
-                }
+    if (intarray.size() > 1) {
+        if (intarray.front().edge == intarray.back().edge) {
+            if (intarray.front().point.distanceToPoint(intarray.back().point) < 1E-4) {
+                intarray.pop_back();
             }
-            else if (startp.edge == segment.second.edge) {
-                addedge = startp.point.distanceToPoint(segment.second.point) < 1E-4;
-                if (addedge) {
-                    spline->setKnuckle(0, segment.second.knuckle || spline->isKnuckle(0));
-                    spline->insert(0, segment.first.point);
-                    spline->setKnuckle(0, segment.first.knuckle);
-                    startp = segment.first;
+        }
+        size_t k = 1;
+        while (k < intarray.size()) {
+            if (intarray[k].edge == intarray[k-1].edge) {
+                if (intarray[k].point.distanceToPoint(intarray[k-1].point) < 1E-4) {
+                    intarray.erase(intarray.begin()+k-1);
                 }
+                else
+                    ++k;
             }
-            else if (segment.first.edge == segment.second.edge) {
-                // special case, edge lies entirely in plane
-                // perform more extensive test to check whether the two edges
-                // are possibly connected
-                if (startp.edge->startPoint()->hasEdge(segment.first.edge)
-                        || startp.edge->endPoint()->hasEdge(segment.first.edge)
-                        || endp.edge->startPoint()->hasEdge(segment.first.edge)
-                        || endp.edge->endPoint()->hasEdge(segment.first.edge)) {
-                    addedge = endp.point.distanceToPoint(segment.first.point) < 1E-4;
-                    if (addedge) {
-                        spline->setKnuckle(spline->numberOfPoints()-1, segment.first.knuckle
-                                           || spline->isKnuckle(spline->numberOfPoints()-1));
-                        spline->add(segment.second.point);
-                        spline->setKnuckle(spline->numberOfPoints()-1, segment.second.knuckle);
-                        endp = segment.second;
-                    }
-                    else {
-                        addedge = endp.point.distanceToPoint(segment.second.point) < 1E-4;
-                        if (addedge) {
-                            spline->setKnuckle(spline->numberOfPoints()-1, segment.second.knuckle
-                                               || spline->isKnuckle(spline->numberOfPoints()-1));
-                            spline->add(segment.first.point);
-                            spline->setKnuckle(spline->numberOfPoints()-1, segment.first.knuckle);
-                            endp = segment.first;
-                        }
-                        else {
-                            addedge = startp.point.distanceToPoint(segment.first.point) < 1E-4;
-                            if (addedge) {
-                                spline->setKnuckle(0, segment.first.knuckle
-                                                   || spline->isKnuckle(0));
-                                spline->insert(0, segment.second.point);
-                                spline->setKnuckle(0, segment.second.knuckle);
-                                startp = segment.second;
-                            } else {
-                                addedge = startp.point.distanceToPoint(segment.second.point) < 1E-4;
-                                if (addedge) {
-                                    spline->setKnuckle(0, segment.second.knuckle
-                                                       || spline->isKnuckle(0));
-                                    spline->insert(0, segment.first.point);
-                                    spline->setKnuckle(0, segment.first.knuckle);
-                                    startp = segment.first;
-                                }
-                            }
-                        }
-                    }
-                }
+            else
+                ++k;
+        }
+        for (size_t l=1; l<intarray.size(); ++l) {
+            segments.push_back(make_pair(intarray[l-1], intarray[l]));
+        }
+    }
+}
+
+// ways a segment can be joined to a polyline
+enum segment_join_t {
+    sjNone,
+    sjAppendSecond,             // first point at the end, add the second
+    sjAppendFirst,              // second point at the end, add the first
+    sjInsertSecond,             // first point at the start, insert the second
+    sjInsertFirst               // second point at the start, insert the first
+};
+
+// how a segment joins a polyline running from startp to endp
+static segment_join_t SegmentJoin(const pair<SurfIntersectionData, SurfIntersectionData>& segment,
+                                  const SurfIntersectionData& startp, const SurfIntersectionData& endp)
+{
+    if (endp.edge == segment.first.edge)
+        return endp.point.distanceToPoint(segment.first.point) < 1E-4 ? sjAppendSecond : sjNone;
+    if (endp.edge == segment.second.edge)
+        return endp.point.distanceToPoint(segment.second.point) < 1E-4 ? sjAppendFirst : sjNone;
+    if (startp.edge == segment.first.edge)
+        return startp.point.distanceToPoint(segment.first.point) < 1E-4 ? sjInsertSecond : sjNone;
+    if (startp.edge == segment.second.edge)
+        return startp.point.distanceToPoint(segment.second.point) < 1E-4 ? sjInsertFirst : sjNone;
+    if (segment.first.edge == segment.second.edge) {
+        // special case, edge lies entirely in plane
+        // perform more extensive test to check whether the two edges
+        // are possibly connected
+        if (startp.edge->startPoint()->hasEdge(segment.first.edge)
+                || startp.edge->endPoint()->hasEdge(segment.first.edge)
+                || endp.edge->startPoint()->hasEdge(segment.first.edge)
+                || endp.edge->endPoint()->hasEdge(segment.first.edge)) {
+            if (endp.point.distanceToPoint(segment.first.point) < 1E-4)
+                return sjAppendSecond;
+            if (endp.point.distanceToPoint(segment.second.point) < 1E-4)
+                return sjAppendFirst;
+            if (startp.point.distanceToPoint(segment.first.point) < 1E-4)
+                return sjInsertSecond;
+            if (startp.point.distanceToPoint(segment.second.point) < 1E-4)
+                return sjInsertFirst;
+        }
+    }
+    return sjNone;
+}
+
+void SubdivisionSurface::chainSegments(IntersectionSegments& segments, SplineVector& destination)
+{
+    // a polyline grows by the first segment that joins either of its
+    // ends, all of them touch an end so only those near the ends are tried
+    PointGrid ends(2E-4f);
+    for (size_t i=0; i<segments.size(); ++i) {
+        ends.insert(segments[i].first.point, i);
+        ends.insert(segments[i].second.point, i);
+    }
+    vector<bool> used(segments.size(), false);
+    size_t remaining = segments.size();
+    vector<size_t> near;
+    while (remaining > 0) {
+        // start with the last segment left
+        while (used[remaining-1])
+            --remaining;
+        if (remaining == 0)
+            break;
+        const pair<SurfIntersectionData, SurfIntersectionData>& first = segments[remaining-1];
+        used[remaining-1] = true;
+        Spline* spline = new Spline();
+        destination.add(spline);
+        spline->add(first.first.point);
+        spline->setKnuckle(0, first.first.knuckle);
+        spline->add(first.second.point);
+        spline->setKnuckle(1, first.second.knuckle);
+        SurfIntersectionData startp = first.first;
+        SurfIntersectionData endp = first.second;
+        while (true) {
+            near.clear();
+            ends.find(startp.point, near);
+            ends.find(endp.point, near);
+            sort(near.begin(), near.end());
+            size_t j = 0;
+            segment_join_t join = sjNone;
+            for (size_t k=0; k<near.size() && join == sjNone; ++k) {
+                j = near[k];
+                if (!used[j])
+                    join = SegmentJoin(segments[j], startp, endp);
             }
-            if (addedge) {
-                segments.erase(segments.begin()+j);
-                j = 0;
-                addedge = false;
+            if (join == sjNone)
+                break;
+            const pair<SurfIntersectionData, SurfIntersectionData>& segment = segments[j];
+            used[j] = true;
+            size_t last = spline->numberOfPoints() - 1;
+            switch (join) {
+            case sjAppendSecond:
+                spline->setKnuckle(last, segment.first.knuckle || spline->isKnuckle(last));
+                spline->add(segment.second.point);
+                spline->setKnuckle(last + 1, segment.second.knuckle);
+                endp = segment.second;
+                break;
+            case sjAppendFirst:
+                spline->setKnuckle(last, segment.second.knuckle || spline->isKnuckle(last));
+                spline->add(segment.first.point);
+                spline->setKnuckle(last + 1, segment.first.knuckle);
+                endp = segment.first;
+                break;
+            case sjInsertSecond:
+                spline->setKnuckle(0, segment.first.knuckle || spline->isKnuckle(0));
+                spline->insert(0, segment.second.point);
+                spline->setKnuckle(0, segment.second.knuckle);
+                startp = segment.second;
+                break;
+            case sjInsertFirst:
+                spline->setKnuckle(0, segment.second.knuckle || spline->isKnuckle(0));
+                spline->insert(0, segment.first.point);
+                spline->setKnuckle(0, segment.first.knuckle);
+                startp = segment.first;
+                break;
+            default:
+                break;
             }
-            else
-                ++j;
         }
-        if (!addedge)
-            spline = 0;
     }
+    segments.clear();
+    Spline* spline;
     if (destination.size() > 1) {
         JoinSplineSegments(0.01f, false, destination);
         for (size_t i=destination.size(); i>=1; --i) {
@@ -2570,6 +2777,31 @@ void SubdivisionSurface::calculateIntersections(const Plane& plane,
     }
 }
 
+
+void SubdivisionSurface::intersectionSegments(const Plane& plane,
+                                              vector<SubdivisionControlFace*>& faces,
+                                              IntersectionSegments& segments)
+{
+    // first assemble all edges belong to this set of faces
+    vector<SubdivisionEdge*> edges;
+    edges.reserve(faces.size()+100);
+
+    for (size_t i=0; i<faces.size(); ++i) {
+        SubdivisionControlFace* ctrlface = faces[i];
+        for (size_t j=0; j<ctrlface->numberOfAdaptiveFaces(); ++j)
+            IntersectFace(this, plane, ctrlface->getAdaptiveFace(j), edges, segments);
+    }
+}
+
+void SubdivisionSurface::calculateIntersections(const Plane& plane,
+                                                vector<SubdivisionControlFace*>& faces,
+                                                SplineVector& destination)
+{
+    IntersectionSegments segments;
+    intersectionSegments(plane, faces, segments);
+    chainSegments(segments, destination);
+}
+
 // FreeGeometry.pas:15169
 void SubdivisionSurface::draw(Viewport &vp)
 {
@@ -2601,27 +2833,21 @@ void SubdivisionSurface::draw(Viewport &vp, LineShader *lineshader)
 
 SubdivisionEdge* SubdivisionSurface::edgeExists(SubdivisionPoint *p1, SubdivisionPoint *p2)
 {
-    SubdivisionEdge* result = 0;
     // if the edge exists then it must exist
     // in both the points, therefore only the point
-    // with the smallest number of edges has to be checked
-    if (p1->numberOfEdges() <= p2->numberOfEdges()) {
-        for (size_t i=0; i<p1->numberOfEdges(); ++i) {
-            SubdivisionEdge* edge = p1->getEdge(i);
-            if ((edge->startPoint() == p1 && edge->endPoint() == p2)
-                    || (edge->startPoint() == p2 && edge->endPoint() == p1))
-                return edge;
-        }
-    }
-    else {
-        for (size_t i=0; i<p2->numberOfEdges(); ++i) {
-            SubdivisionEdge* edge = p2->getEdge(i);
-            if ((edge->startPoint() == p1 && edge->endPoint() == p2)
-                    || (edge->startPoint() == p2 && edge->endPoint() == p1))
-                return edge;
-        }
+    // with the smallest number of edges has to be checked.
+    // The edge lists of the points are the index of the edges, their
+    // length is the valence of the point, so this doesn't grow with
+    // the size of the mesh
+    const AdjacencyList<SubdivisionEdge*>& edges = p1->numberOfEdges() <= p2->numberOfEdges()
+            ? p1->getEdges() : p2->getEdges();
+    for (size_t i=0; i<edges.size(); ++i) {
+        SubdivisionEdge* edge = edges[i];
+        if ((edge->startPoint() == p1 && edge->endPoint() == p2)
+                || (edge->startPoint() == p2 && edge->endPoint() == p1))
+            return edge;
     }
-    return result;
+    return 0;
 }
 
 SubdivisionControlEdge* SubdivisionSurface::controlEdgeExists(SubdivisionPoint *p1,
@@ -2629,7 +2855,7 @@ SubdivisionControlEdge* SubdivisionSurface::controlEdgeExists(SubdivisionPoint *
 {
     SubdivisionEdge* result = edgeExists(p1, p2);
     if (result != 0)
-        return dynamic_cast<SubdivisionControlEdge*>(result);
+        return result->asControlEdge();
     return static_cast<SubdivisionControlEdge*>(0);
 }
 
@@ -2862,8 +3088,10 @@ void SubdivisionSurface::importFeFFile(QStringList &strings, size_t& lineno)
     start = 0;
     // read controlpoints
     n = ReadIntFromStr(lineno, str, start);
+    _point_hash_valid = false;
     for (size_t i=0; i<n; ++i) {
         SubdivisionControlPoint* point = SubdivisionControlPoint::construct(this);
+        point->setListIndex(_control_points.size());
         _control_points.push_back(point);
         point->loadFromStream(lineno, strings);
     }
@@ -2995,6 +3223,72 @@ void SubdivisionSurface::initialize(size_t point_start, size_t edge_start)
     _initialized = true;
 }
 
+void SubdivisionSurface::buildFaceIndex()
+{
+    _indexed_faces.clear();
+    _indexed_places.clear();
+    for (size_t i=0; i<numberOfLayers(); ++i) {
+        SubdivisionLayer* layer = getLayer(i);
+        for (size_t j=0; j<layer->numberOfFaces(); ++j) {
+            _indexed_faces.push_back(layer->getFace(j));
+            _indexed_places.push_back(make_pair(i, j));
+        }
+    }
+    vector<float> lo(_indexed_faces.size()), hi(_indexed_faces.size());
+    for (int axis=0; axis<3; ++axis) {
+        for (size_t i=0; i<_indexed_faces.size(); ++i) {
+            lo[i] = _indexed_faces[i]->getMin()[axis];
+            hi[i] = _indexed_faces[i]->getMax()[axis];
+        }
+        _face_index[axis].build(lo, hi);
+    }
+    _face_index_valid = true;
+}
+
+bool SubdivisionSurface::findControlFaces(int axis, float lo, float hi,
+                                          vector<SubdivisionControlFace*>& faces)
+{
+    faces.clear();
+    if (!_face_index_valid)
+        buildFaceIndex();
+    // a face added to a layer isn't in the index
+    size_t count = 0;
+    for (size_t i=0; i<numberOfLayers(); ++i)
+        count += getLayer(i)->numberOfFaces();
+    if (count != _indexed_faces.size())
+        return false;
+    vector<size_t> items;
+    _face_index[axis].query(lo, hi, items);
+    for (size_t i=0; i<items.size(); ++i) {
+        // or moved to another layer or place
+        SubdivisionControlFace* face = _indexed_faces[items[i]];
+        const pair<size_t, size_t>& place = _indexed_places[items[i]];
+        if (place.first >= numberOfLayers() || getLayer(place.first) != face->getLayer()
+                || face->getLayer()->getFace(place.second) != face)
+            return false;
+        faces.push_back(face);
+    }
+    return true;
+}
+
+// the axis a plane is perpendicular to, and where it cuts the axis, or
+// -1 for other planes
+static int PlaneAxis(const Plane& plane, float& offset)
+{
+    const float n[3] = { plane.a(), plane.b(), plane.c() };
+    int axis = -1;
+    for (int i=0; i<3; ++i) {
+        if (n[i] == 0)
+            continue;
+        if (axis >= 0)
+            return -1;
+        axis = i;
+    }
+    if (axis >= 0)
+        offset = -plane.d() / n[axis];
+    return axis;
+}
+
 bool SubdivisionSurface::intersectPlane(const Plane& plane, bool hydrostatics_layers_only, SplineVector& destination)
 {
     QVector3D min, max;
@@ -3004,6 +3298,25 @@ bool SubdivisionSurface::intersectPlane(const Plane& plane, bool hydrostatics_la
     if (!plane.intersectsBox(_min, _max))
         return result;
     vector<SubdivisionControlFace*> intersectedfaces;
+    // planes across an axis only look at the faces spanning the plane
+    float offset = 0;
+    int axis = PlaneAxis(plane, offset);
+    vector<SubdivisionControlFace*> spanning;
+    float margin = 1E-5f * (1 + fabs(offset));
+    if (axis >= 0 && findControlFaces(axis, offset - margin, offset + margin, spanning)) {
+        for (size_t i=0; i<spanning.size(); ++i) {
+            SubdivisionControlFace* ctrlface = spanning[i];
+            bool use_layer;
+            if (hydrostatics_layers_only)
+                use_layer = ctrlface->getLayer()->useInHydrostatics();
+            else
+                use_layer = ctrlface->getLayer()->useForIntersections();
+            if (use_layer && plane.intersectsBox(ctrlface->getMin(), ctrlface->getMax()))
+                intersectedfaces.push_back(ctrlface);
+        }
+        calculateIntersections(plane, intersectedfaces, destination);
+        return destination.size() > 0;
+    }
     for (size_t i=0; i<numberOfLayers(); ++i) {
         SubdivisionLayer* layer = getLayer(i);
         bool use_layer;
@@ -3026,6 +3339,111 @@ bool SubdivisionSurface::intersectPlane(const Plane& plane, bool hydrostatics_la
     return result;
 }
 
+// orders planes on their offset along the common normal
+struct PlaneOffsetLess
+{
+    const vector<Plane>& planes;
+
+    PlaneOffsetLess(const vector<Plane>& p) : planes(p) {}
+    bool operator()(size_t a, size_t b) const
+        { return -planes[a].d() < -planes[b].d(); }
+    bool operator()(size_t a, float offset) const
+        { return -planes[a].d() < offset; }
+    bool operator()(float offset, size_t b) const
+        { return offset < -planes[b].d(); }
+};
+
+// range of a*x+b*y+c*z over a box, grown by enough to cover the rounding
+// of Plane::distance and the 1E-5 used when cutting faces
+static void PlaneRange(const Plane& plane, const QVector3D& min, const QVector3D& max,
+                       float& lo, float& hi)
+{
+    lo = hi = 0;
+    const QVector3D n(plane.a(), plane.b(), plane.c());
+    for (int i=0; i<3; ++i) {
+        if (n[i] >= 0) {
+            lo += n[i] * min[i];
+            hi += n[i] * max[i];
+        }
+        else {
+            lo += n[i] * max[i];
+            hi += n[i] * min[i];
+        }
+    }
+    float margin = 1E-4f + 1E-5f * (fabs(lo) + fabs(hi));
+    lo -= margin;
+    hi += margin;
+}
+
+void SubdivisionSurface::intersectPlanes(const vector<Plane>& planes, bool hydrostatics_layers_only,
+                                         vector<SplineVector*>& destinations)
+{
+    if (planes.size() != destinations.size())
+        throw invalid_argument("SubdivisionSurface::intersectPlanes planes and destinations don't match");
+    if (planes.empty())
+        return;
+    for (size_t i=1; i<planes.size(); ++i)
+        if (planes[i].a() != planes[0].a() || planes[i].b() != planes[0].b()
+                || planes[i].c() != planes[0].c())
+            throw invalid_argument("SubdivisionSurface::intersectPlanes planes not parallel");
+    if (!isBuild())
+        rebuild();
+
+    // planes missing the surface give no intersections, the rest sorted
+    // on offset so a face only looks at the planes within its extents
+    vector<size_t> order;
+    for (size_t i=0; i<planes.size(); ++i)
+        if (planes[i].intersectsBox(_min, _max))
+            order.push_back(i);
+    sort(order.begin(), order.end(), PlaneOffsetLess(planes));
+    vector<vector<SubdivisionEdge*> > edges(planes.size());
+    vector<IntersectionSegments> segments(planes.size());
+    vector<size_t> cut;
+    for (size_t i=0; i<numberOfLayers(); ++i) {
+        SubdivisionLayer* layer = getLayer(i);
+        bool use_layer;
+        if (hydrostatics_layers_only)
+            use_layer = layer->useInHydrostatics();
+        else
+            use_layer = layer->useForIntersections();
+        if (!use_layer)
+            continue;
+        for (size_t j=0; j<layer->numberOfFaces(); ++j) {
+            SubdivisionControlFace* ctrlface = layer->getFace(j);
+            QVector3D min = ctrlface->getMin();
+            QVector3D max = ctrlface->getMax();
+            float lo, hi;
+            PlaneRange(planes[0], min, max, lo, hi);
+            vector<size_t>::iterator first = lower_bound(order.begin(), order.end(), lo,
+                                                         PlaneOffsetLess(planes));
+            vector<size_t>::iterator last = upper_bound(first, order.end(), hi,
+                                                        PlaneOffsetLess(planes));
+            // the same box test as intersectPlane
+            cut.clear();
+            for (vector<size_t>::iterator k=first; k!=last; ++k)
+                if (planes[*k].intersectsBox(min, max))
+                    cut.push_back(*k);
+            if (cut.empty())
+                continue;
+            for (size_t k=0; k<ctrlface->numberOfAdaptiveFaces(); ++k) {
+                SubdivisionFace* face = ctrlface->getAdaptiveFace(k);
+                QVector3D fmin = face->getPoint(0)->getCoordinate();
+                QVector3D fmax = fmin;
+                for (size_t l=1; l<face->numberOfPoints(); ++l)
+                    MinMax(face->getPoint(l)->getCoordinate(), fmin, fmax);
+                PlaneRange(planes[0], fmin, fmax, lo, hi);
+                for (size_t l=0; l<cut.size(); ++l) {
+                    float offset = -planes[cut[l]].d();
+                    if (offset >= lo && offset <= hi)
+                        IntersectFace(this, planes[cut[l]], face, edges[cut[l]], segments[cut[l]]);
+                }
+            }
+        }
+    }
+    for (size_t i=0; i<order.size(); ++i)
+        chainSegments(segments[order[i]], *destinations[order[i]]);
+}
+
 void SubdivisionSurface::insertPlane(const Plane& plane, bool add_curves)
 {
     vector<SubdivisionControlPoint*> points;
@@ -3348,8 +3766,10 @@ void SubdivisionSurface::loadBinary(FileBuffer &source)
     // read control points
     source.load(n);
     _control_points.reserve(n);
+    _point_hash_valid = false;
     for (size_t i=0; i<n; ++i) {
         SubdivisionControlPoint* point = SubdivisionControlPoint::construct(this);
+        point->setListIndex(_control_points.size());
         _control_points.push_back(point);
         point->load_binary(source);
     }
@@ -3409,8 +3829,10 @@ void SubdivisionSurface::loadFromStream(size_t& lineno, QStringList& strings)
     str = strings[lineno++].trimmed();
     start = 0;
     n = ReadIntFromStr(lineno, str, start);
+    _point_hash_valid = false;
     for (size_t i=0; i<n; ++i) {
         SubdivisionControlPoint* point = SubdivisionControlPoint::construct(this);
+        point->setListIndex(_control_points.size());
         _control_points.push_back(point);
         point->loadFromStream(lineno, strings);
     }
@@ -3440,17 +3862,78 @@ void SubdivisionSurface::rebuild()
 {
     if (!_initialized)
         initialize(1,1);
+    _local_rebuild = false;
+    _rebuilt_faces.clear();
     if (numberOfControlFaces() > 0) {
+        // when only control points moved, subdivide just the faces around
+        // them, or if there are too many use the stencil table
+        bool local = false;
+        bool build_stencils = false;
+        vector<SubdivisionControlFace*> dirtyfaces;
+        if (!_moved_points.empty()) {
+            local = subdivideMovedPoints(dirtyfaces);
+            if (!local) {
+                if (_stencils.isValid() && _stencils.numberOfRows() == numberOfPoints()) {
+                    evaluateStencils();
+                }
+                else {
+                    // a geometry edit, more are likely to follow
+                    setBuild(false);
+                    build_stencils = true;
+                }
+            }
+            _moved_points.clear();
+        }
+        // the precision changed, start from a kept level if there is one
+        if (_current_subdiv_level > 0 && _current_subdiv_level != _desired_subdiv_level) {
+            local = false;
+            dirtyfaces.clear();
+            selectCachedLevel();
+        }
         for (size_t i=0; i<numberOfControlCurves(); ++i) {
             SubdivisionControlCurve* curve = _control_curves[i];
             if (_current_subdiv_level == 0)
                 curve->resetDivPoints();
         }
         _build = true;
+        vector<SubdivisionStencils::Stencil> stencils;
+        if (build_stencils) {
+            stencils.resize(numberOfControlPoints());
+            for (size_t i=0; i<numberOfControlPoints(); ++i)
+                SubdivisionStencils::identity(i, stencils[i]);
+        }
         while (_current_subdiv_level < _desired_subdiv_level)
-            subdivide();
+            subdivide(build_stencils ? &stencils : nullptr);
+        if (build_stencils && numberOfPoints() > 0)
+            _stencils.assign(stencils, _control_points);
+        if (!local) {
+            for (size_t i=0; i<numberOfControlFaces(); ++i)
+                getControlFace(i)->calcExtents();
+        }
+        else {
+            for (size_t i=0; i<dirtyfaces.size(); ++i)
+                dirtyfaces[i]->calcExtents();
+        }
+        if (local)
+            updateNormals(dirtyfaces);
+        else
+            calculateNormals();
+        buildAdaptiveFaces(local ? &dirtyfaces : nullptr);
+        // made again by the next search, a drag rebuilds far more often
+        // than planes are cut
+        _face_index_valid = false;
+        _build_count++;
+        if (local) {
+            _local_rebuild = true;
+            _rebuilt_faces = dirtyfaces;
+        }
+        // the div points of a curve lie on the control edges between its
+        // control points, so only curves through a dirty face have changed
+        unordered_set<SubdivisionPoint*> dirtypoints;
+        for (size_t i=0; i<dirtyfaces.size(); ++i)
+            for (size_t j=0; j<dirtyfaces[i]->numberOfPoints(); ++j)
+                dirtypoints.insert(dirtyfaces[i]->getPoint(j));
         for (size_t i=0; i<numberOfControlFaces(); ++i) {
-            getControlFace(i)->calcExtents();
             if (i == 0) {
                 _min = getControlFace(i)->getMin();
                 _max = getControlFace(i)->getMax();
@@ -3462,6 +3945,13 @@ void SubdivisionSurface::rebuild()
         }
         for (size_t i=0; i<numberOfControlCurves(); ++i) {
             SubdivisionControlCurve* curve = getControlCurve(i);
+            if (local) {
+                bool changed = false;
+                for (size_t j=0; j<curve->numberOfControlPoints() && !changed; ++j)
+                    changed = dirtypoints.find(curve->getControlPoint(j)) != dirtypoints.end();
+                if (!changed)
+                    continue;
+            }
             curve->getSpline()->clear();
             for (size_t j=0; j<curve->numberOfSubdivPoints(); ++j) {
                 SubdivisionPoint* point = curve->getSubdivPoint(j);
@@ -3481,6 +3971,7 @@ void SubdivisionSurface::rebuild()
         }
     }
     else if (numberOfControlPoints() > 0) {
+        _face_index_valid = false;
         for (size_t i=0; i<numberOfControlPoints(); ++i) {
             if (i == 0) {
                 _min = getControlPoint(i)->getCoordinate();
@@ -3496,6 +3987,471 @@ void SubdivisionSurface::rebuild()
     }
 }
 
+void SubdivisionSurface::evaluateStencils()
+{
+    vector<QVector3D> coords;
+    _stencils.evaluate(coords, _parallel_subdivision);
+    ParallelFor(_points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        _points[i]->setCoordinate(coords[i]);
+                }, _parallel_subdivision);
+}
+
+void SubdivisionSurface::calculateNormals()
+{
+    clearNormals();
+    // where the children of each control face start in the face list
+    vector<size_t> start(numberOfControlFaces() + 1, 0);
+    for (size_t i=0; i<numberOfControlFaces(); ++i)
+        start[i+1] = start[i] + getControlFace(i)->numberOfChildren();
+    _normal_faces.resize(start.back());
+    _face_normals.resize(start.back());
+    ParallelFor(numberOfControlFaces(), k_subdivide_face_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i) {
+                        SubdivisionControlFace* face = getControlFace(i);
+                        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+                            SubdivisionFace* child = face->getChild(j);
+                            child->setListIndex(start[i] + j);
+                            _normal_faces[start[i] + j] = child;
+                            _face_normals[start[i] + j] = child->calculateFaceNormal();
+                        }
+                    }
+                }, _parallel_subdivision);
+    vector<QVector3D> normals(_points.size());
+    ParallelFor(_points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        normals[i] = _points[i]->calculateNormal();
+                }, _parallel_subdivision);
+    _point_normals.swap(normals);
+}
+
+void SubdivisionSurface::updateNormals(const vector<SubdivisionControlFace*>& faces)
+{
+    // the kept normals must be for the same points and faces
+    if (_point_normals.size() != _points.size()) {
+        calculateNormals();
+        return;
+    }
+    vector<size_t> points;
+    for (size_t i=0; i<faces.size(); ++i) {
+        for (size_t j=0; j<faces[i]->numberOfChildren(); ++j) {
+            SubdivisionFace* child = faces[i]->getChild(j);
+            size_t index = child->getListIndex();
+            if (index >= _normal_faces.size() || _normal_faces[index] != child) {
+                calculateNormals();
+                return;
+            }
+            for (size_t k=0; k<child->numberOfPoints(); ++k)
+                points.push_back(child->getPoint(k)->getListIndex());
+        }
+    }
+    sort(points.begin(), points.end());
+    points.erase(unique(points.begin(), points.end()), points.end());
+    ParallelFor(faces.size(), k_subdivide_face_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i) {
+                        for (size_t j=0; j<faces[i]->numberOfChildren(); ++j) {
+                            SubdivisionFace* child = faces[i]->getChild(j);
+                            _face_normals[child->getListIndex()] = child->calculateFaceNormal();
+                        }
+                    }
+                }, _parallel_subdivision);
+    // the faces around the other points kept their shape
+    ParallelFor(points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        _point_normals[points[i]] = _points[points[i]]->calculateNormal();
+                }, _parallel_subdivision);
+}
+
+void SubdivisionSurface::clearNormals()
+{
+    _point_normals.clear();
+    _normal_faces.clear();
+    _face_normals.clear();
+}
+
+bool SubdivisionSurface::cachedPointNormal(const SubdivisionPoint* pt, QVector3D& normal) const
+{
+    // control points moved since the normals were found
+    if (!_build)
+        return false;
+    size_t index = pt->getListIndex();
+    if (index >= _point_normals.size() || _points[index] != pt)
+        return false;
+    normal = _point_normals[index];
+    return true;
+}
+
+bool SubdivisionSurface::cachedFaceNormal(const SubdivisionFace* face, QVector3D& normal) const
+{
+    if (!_build)
+        return false;
+    size_t index = face->getListIndex();
+    if (index >= _normal_faces.size() || _normal_faces[index] != face)
+        return false;
+    normal = _face_normals[index];
+    return true;
+}
+
+// all the faces sharing a point with one of the given faces
+static void FacesAround(const unordered_set<SubdivisionFace*>& faces,
+                        unordered_set<SubdivisionFace*>& result)
+{
+    for (unordered_set<SubdivisionFace*>::const_iterator i=faces.begin(); i!=faces.end(); ++i) {
+        SubdivisionFace* face = *i;
+        for (size_t j=0; j<face->numberOfPoints(); ++j) {
+            SubdivisionPoint* pt = face->getPoint(j);
+            for (size_t k=0; k<pt->numberOfFaces(); ++k)
+                result.insert(pt->getFace(k));
+        }
+    }
+}
+
+// corners of a quad in the grid of its level 1 face, in point order. Children
+// keep the point order of their parent quad, child i is in the corner of point i
+static const size_t k_corner_u[4] = {0, 1, 1, 0};
+static const size_t k_corner_v[4] = {0, 0, 1, 1};
+
+// the subdivided points of one level 1 face of a control face, as a grid
+struct AdaptivePatch
+{
+    size_t size;                        // cells on a side
+    vector<SubdivisionPoint*> points;   // (size+1)*(size+1) points
+
+    SubdivisionPoint* at(size_t u, size_t v) const {return points[u * (size + 1) + v];}
+};
+
+// lay out the children of a control face as one grid for each of its level 1
+// faces, false if the children are not all quads
+static bool MakeAdaptivePatches(const SubdivisionControlFace* face, int level,
+                                vector<AdaptivePatch>& patches)
+{
+    if (level < 1)
+        return false;
+    size_t perpatch = 1;
+    for (int l=1; l<level; ++l)
+        perpatch *= 4;
+    size_t n = face->numberOfPoints();
+    if (face->numberOfChildren() != n * perpatch)
+        return false;
+    size_t size = static_cast<size_t>(1) << (level - 1);
+    patches.resize(n);
+    for (size_t k=0; k<n; ++k) {
+        AdaptivePatch& patch = patches[k];
+        patch.size = size;
+        patch.points.assign((size + 1) * (size + 1), nullptr);
+        for (size_t c=0; c<perpatch; ++c) {
+            SubdivisionFace* child = face->getChild(k * perpatch + c);
+            if (child->numberOfPoints() != 4)
+                return false;
+            // the base 4 digits of c are the corners the child is in on each level
+            size_t u = 0;
+            size_t v = 0;
+            size_t half = size;
+            size_t digit = perpatch;
+            for (int l=1; l<level; ++l) {
+                digit /= 4;
+                half /= 2;
+                size_t corner = (c / digit) % 4;
+                u += k_corner_u[corner] * half;
+                v += k_corner_v[corner] * half;
+            }
+            for (size_t j=0; j<4; ++j) {
+                SubdivisionPoint*& pt = patch.points[(u + k_corner_u[j]) * (size + 1)
+                                                     + v + k_corner_v[j]];
+                if (pt != nullptr && pt != child->getPoint(j))
+                    return false;
+                pt = child->getPoint(j);
+            }
+        }
+    }
+    return true;
+}
+
+// largest distance of the points of a patch from the faces of the grid with this
+// stride, each face split in two triangles on the diagonal from its first point
+static float AdaptiveDeviation(const AdaptivePatch& patch, size_t stride)
+{
+    float result = 0;
+    for (size_t cu=0; cu<patch.size; cu+=stride) {
+        for (size_t cv=0; cv<patch.size; cv+=stride) {
+            QVector3D p00 = patch.at(cu, cv)->getCoordinate();
+            QVector3D p10 = patch.at(cu + stride, cv)->getCoordinate();
+            QVector3D p11 = patch.at(cu + stride, cv + stride)->getCoordinate();
+            QVector3D p01 = patch.at(cu, cv + stride)->getCoordinate();
+            for (size_t a=0; a<=stride; ++a) {
+                float s = static_cast<float>(a) / stride;
+                for (size_t b=0; b<=stride; ++b) {
+                    float t = static_cast<float>(b) / stride;
+                    QVector3D q = (s >= t) ? p00 + s * (p10 - p00) + t * (p11 - p10)
+                                           : p00 + t * (p01 - p00) + s * (p11 - p01);
+                    float dist = (patch.at(cu + a, cv + b)->getCoordinate() - q).length();
+                    if (dist > result)
+                        result = dist;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void SubdivisionSurface::buildAdaptiveFaces(const vector<SubdivisionControlFace*>* dirtyfaces)
+{
+    size_t nfaces = numberOfControlFaces();
+    if (_adaptive_tolerance <= 0 || _current_subdiv_level < 2) {
+        for (size_t i=0; i<nfaces; ++i)
+            getControlFace(i)->clearAdaptiveFaces();
+        _adaptive_strides.clear();
+        return;
+    }
+    // the control faces whose grid is chosen again, the ones whose adaptive
+    // faces are made again, and the ones whose grid points those need
+    vector<char> measure(nfaces, 1);
+    vector<char> remake(nfaces, 1);
+    vector<char> needed(nfaces, 1);
+    if (dirtyfaces != nullptr && _adaptive_strides.size() == nfaces) {
+        // a new grid on a face changes the points on the edges of the
+        // faces around it
+        unordered_set<SubdivisionFace*> changed(dirtyfaces->begin(), dirtyfaces->end());
+        unordered_set<SubdivisionFace*> around;
+        unordered_set<SubdivisionFace*> context;
+        FacesAround(changed, around);
+        FacesAround(around, context);
+        for (size_t i=0; i<nfaces; ++i) {
+            SubdivisionFace* face = getControlFace(i);
+            measure[i] = (changed.find(face) != changed.end());
+            remake[i] = (around.find(face) != around.end());
+            needed[i] = (context.find(face) != context.end());
+        }
+    }
+    else
+        _adaptive_strides.assign(nfaces, 0);
+    for (size_t i=0; i<nfaces; ++i) {
+        if (remake[i])
+            getControlFace(i)->clearAdaptiveFaces();
+    }
+    // grid stride chosen for each control face, 0 keeps its children
+    vector<size_t>& strides = _adaptive_strides;
+    vector<vector<AdaptivePatch> > patches(nfaces);
+    ParallelFor(nfaces, k_subdivide_face_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i) {
+                        if (!needed[i])
+                            continue;
+                        SubdivisionControlFace* face = getControlFace(i);
+                        // an unchanged face keeps its grid
+                        if (!measure[i] && (strides[i] == 0
+                                || MakeAdaptivePatches(face, _current_subdiv_level, patches[i])))
+                            continue;
+                        strides[i] = 0;
+                        // keep all the children along creases, where the edges matter
+                        bool crease = false;
+                        for (size_t j=0; j<face->numberOfPoints() && !crease; ++j) {
+                            SubdivisionEdge* edge = edgeExists(face->getPoint(j),
+                                face->getPoint((j + 1) % face->numberOfPoints()));
+                            crease = (edge != 0 && edge->isCrease());
+                        }
+                        if (crease || !MakeAdaptivePatches(face, _current_subdiv_level, patches[i])) {
+                            patches[i].clear();
+                            continue;
+                        }
+                        // try the coarsest grid first
+                        for (size_t stride=patches[i][0].size; stride>1 && strides[i]==0; stride/=2) {
+                            bool flat = true;
+                            for (size_t k=0; k<patches[i].size() && flat; ++k)
+                                flat = AdaptiveDeviation(patches[i][k], stride) <= _adaptive_tolerance;
+                            if (flat)
+                                strides[i] = stride;
+                        }
+                        if (strides[i] == 0)
+                            patches[i].clear();
+                    }
+                }, _parallel_subdivision);
+
+    // the points at the corners of the faces that will be used
+    vector<char> used(numberOfPoints(), 0);
+    vector<size_t> firstface(nfaces + 1, 0);
+    for (size_t i=0; i<nfaces; ++i) {
+        size_t count = 0;
+        if (!needed[i]) {
+            firstface[i+1] = firstface[i];
+            continue;
+        }
+        if (strides[i] == 0) {
+            SubdivisionControlFace* face = getControlFace(i);
+            for (size_t j=0; j<face->numberOfChildren(); ++j) {
+                SubdivisionFace* child = face->getChild(j);
+                for (size_t k=0; k<child->numberOfPoints(); ++k)
+                    used[child->getPoint(k)->getListIndex()] = 1;
+            }
+        }
+        else {
+            for (size_t k=0; k<patches[i].size(); ++k) {
+                const AdaptivePatch& patch = patches[i][k];
+                for (size_t u=0; u<=patch.size; u+=strides[i])
+                    for (size_t v=0; v<=patch.size; v+=strides[i])
+                        used[patch.at(u, v)->getListIndex()] = 1;
+                if (remake[i])
+                    count += (patch.size / strides[i]) * (patch.size / strides[i]);
+            }
+        }
+        firstface[i+1] = firstface[i] + count;
+    }
+    vector<SubdivisionFace*> facemem;
+    _face_pool.take(firstface.back(), facemem);
+
+    // make the faces, a face also gets the points a finer neighbour uses on
+    // its edges so the mesh stays closed
+    ParallelFor(nfaces, k_subdivide_face_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    vector<SubdivisionPoint*> pts;
+                    for (size_t i=begin; i<end; ++i) {
+                        size_t stride = strides[i];
+                        if (stride == 0 || !remake[i])
+                            continue;
+                        vector<SubdivisionFace*> faces;
+                        faces.reserve(firstface[i+1] - firstface[i]);
+                        for (size_t k=0; k<patches[i].size(); ++k) {
+                            const AdaptivePatch& patch = patches[i][k];
+                            for (size_t cu=0; cu<patch.size; cu+=stride) {
+                                for (size_t cv=0; cv<patch.size; cv+=stride) {
+                                    pts.clear();
+                                    for (size_t j=0; j<4; ++j) {
+                                        size_t e = (j + 1) % 4;
+                                        for (size_t step=0; step<stride; ++step) {
+                                            size_t u = cu + k_corner_u[j] * (stride - step)
+                                                + k_corner_u[e] * step;
+                                            size_t v = cv + k_corner_v[j] * (stride - step)
+                                                + k_corner_v[e] * step;
+                                            SubdivisionPoint* pt = patch.at(u, v);
+                                            if (step == 0 || used[pt->getListIndex()])
+                                                pts.push_back(pt);
+                                        }
+                                    }
+                                    SubdivisionFace* face = SubdivisionFace::construct(
+                                        this, facemem[firstface[i] + faces.size()]);
+                                    face->assignPoints(pts);
+                                    faces.push_back(face);
+                                }
+                            }
+                        }
+                        getControlFace(i)->setAdaptiveFaces(faces);
+                    }
+                }, _parallel_subdivision);
+}
+
+bool SubdivisionSurface::subdivideMovedPoints(vector<SubdivisionControlFace*>& dirtyfaces)
+{
+    if (_current_subdiv_level <= 0)
+        return false;
+    unordered_set<SubdivisionFace*> moved;
+    for (set<SubdivisionControlPoint*>::iterator i=_moved_points.begin(); i!=_moved_points.end(); ++i)
+        for (size_t j=0; j<(*i)->numberOfFaces(); ++j)
+            moved.insert((*i)->getFace(j));
+    // the subdivided points of a face only depend on the control points
+    // of the faces sharing a point with it, so the faces sharing a point
+    // with a moved face are the ones that change
+    unordered_set<SubdivisionFace*> dirty;
+    FacesAround(moved, dirty);
+    // and to get their points right the local surface needs the ring of
+    // faces around them as well
+    unordered_set<SubdivisionFace*> context;
+    FacesAround(dirty, context);
+    if (2 * context.size() > numberOfControlFaces())
+        return false;               // cheaper to do all of it
+
+    // build the local surface, with the faces in the same order and with
+    // the same crease edges and vertex types as this one
+    SubdivisionSurface local;
+    local._subdivision_mode = _subdivision_mode;
+    local._parallel_subdivision = _parallel_subdivision;
+    unordered_map<SubdivisionPoint*, SubdivisionControlPoint*> localpoints;
+    vector<pair<SubdivisionControlEdge*, bool> > creases;
+    vector<SubdivisionControlFace*> localdirty;
+    vector<SubdivisionControlPoint*> facepoints;
+    for (size_t i=0; i<numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = getControlFace(i);
+        if (context.find(face) == context.end())
+            continue;
+        facepoints.clear();
+        for (size_t j=0; j<face->numberOfPoints(); ++j) {
+            SubdivisionPoint* pt = face->getPoint(j);
+            SubdivisionControlPoint*& lpt = localpoints[pt];
+            if (lpt == nullptr) {
+                lpt = SubdivisionControlPoint::construct(&local);
+                lpt->SubdivisionPoint::setCoordinate(pt->getCoordinate());
+                lpt->setListIndex(local._control_points.size());
+                local._control_points.push_back(lpt);
+            }
+            facepoints.push_back(lpt);
+        }
+        SubdivisionControlFace* lface = SubdivisionControlFace::construct(&local);
+        lface->setLayer(local.getLayer(0));
+        local._control_faces.push_back(lface);
+        SubdivisionControlPoint* p1 = facepoints.back();
+        SubdivisionPoint* orig1 = face->getPoint(face->numberOfPoints() - 1);
+        for (size_t j=0; j<facepoints.size(); ++j) {
+            SubdivisionControlPoint* p2 = facepoints[j];
+            SubdivisionPoint* orig2 = face->getPoint(j);
+            p2->addFace(lface);
+            lface->addPoint(p2);
+            SubdivisionControlEdge* edge = local.controlEdgeExists(p1, p2);
+            if (edge == nullptr) {
+                SubdivisionControlEdge* origedge = controlEdgeExists(orig1, orig2);
+                if (origedge == nullptr)
+                    return false;
+                edge = SubdivisionControlEdge::construct(&local);
+                edge->setPoints(p1, p2);
+                edge->setControlEdge(true);
+                p1->addEdge(edge);
+                p2->addEdge(edge);
+                local._control_edges.push_back(edge);
+                creases.push_back(make_pair(edge, origedge->isCrease()));
+            }
+            edge->addFace(lface);
+            p1 = p2;
+            orig1 = orig2;
+        }
+        if (dirty.find(face) != dirty.end()) {
+            dirtyfaces.push_back(face);
+            localdirty.push_back(lface);
+        }
+    }
+    // setCrease changes the vertex types, so copy those afterwards
+    for (size_t i=0; i<creases.size(); ++i)
+        creases[i].first->setCrease(creases[i].second);
+    for (unordered_map<SubdivisionPoint*, SubdivisionControlPoint*>::iterator i=localpoints.begin();
+         i!=localpoints.end(); ++i)
+        i->second->setVertexType(i->first->getVertexType());
+    local._initialized = true;
+    local._current_subdiv_level = 0;
+    // only the last level is used
+    local._level_cache_budget = 0;
+    while (local._current_subdiv_level < _current_subdiv_level)
+        local.subdivide();
+
+    // both surfaces made the children of a face in the same order
+    for (size_t i=0; i<dirtyfaces.size(); ++i) {
+        SubdivisionControlFace* face = dirtyfaces[i];
+        SubdivisionControlFace* lface = localdirty[i];
+        if (face->numberOfChildren() != lface->numberOfChildren())
+            return false;
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            SubdivisionFace* child = face->getChild(j);
+            SubdivisionFace* lchild = lface->getChild(j);
+            if (child->numberOfPoints() != lchild->numberOfPoints())
+                return false;
+            for (size_t k=0; k<child->numberOfPoints(); ++k)
+                child->getPoint(k)->setCoordinate(lchild->getPoint(k)->getCoordinate());
+        }
+    }
+    return true;
+}
+
 void SubdivisionSurface::saveBinary(FileBuffer &destination)
 {
     // first save layerdata
@@ -3510,6 +4466,7 @@ void SubdivisionSurface::saveBinary(FileBuffer &destination)
     destination.add(active);
     // first sort controlpoints for faster access of function
     sort(_control_points.begin(), _control_points.end());
+    ReindexPoints(_control_points, 0);
     destination.add(static_cast<quint32>(numberOfControlPoints()));
     for (size_t i=0; i<numberOfControlPoints(); ++i)
         getControlPoint(i)->save_binary(destination);
@@ -3574,108 +4531,499 @@ void SubdivisionSurface::deleteSelected()
     setBuild(false);
 }
 
-// edges seem to be usually looked up by points or the edge itself, it might make
-// sense to use a map(s)
+// the stencils of the new points before averaging, vertex points then
+// edge points then face points, the same order as the point list
+static void LinearStencils(const vector<SubdivisionPoint*>& oldpoints,
+                           const vector<SubdivisionEdge*>& oldedges,
+                           const vector<SubdivisionFace*>& pointfaces,
+                           const vector<SubdivisionStencils::Stencil>& old,
+                           size_t columns, bool parallel,
+                           vector<SubdivisionStencils::Stencil>& dest)
+{
+    unordered_map<SubdivisionPoint*, size_t> index;
+    index.reserve(oldpoints.size());
+    for (size_t i=0; i<oldpoints.size(); ++i)
+        index.insert(make_pair(oldpoints[i], i));
+    size_t nv = oldpoints.size();
+    size_t ne = oldedges.size();
+    dest.resize(nv + ne + pointfaces.size());
+    ParallelFor(dest.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    StencilAccumulator sum(columns);
+                    for (size_t i=begin; i<end; ++i) {
+                        if (i < nv)
+                            dest[i] = old[i];
+                        else if (i < nv + ne) {
+                            SubdivisionEdge* edge = oldedges[i - nv];
+                            sum.add(old[index.at(edge->startPoint())], 0.5f);
+                            sum.add(old[index.at(edge->endPoint())], 0.5f);
+                            sum.extract(dest[i]);
+                        }
+                        else {
+                            SubdivisionFace* face = pointfaces[i - nv - ne];
+                            float weight = 1.0f / face->numberOfPoints();
+                            for (size_t j=0; j<face->numberOfPoints(); ++j)
+                                sum.add(old[index.at(face->getPoint(j))], weight);
+                            sum.extract(dest[i]);
+                        }
+                    }
+                }, parallel);
+}
+
+// the stencils of the points after averaging
+static void AveragedStencils(const vector<SubdivisionPoint*>& points,
+                             const vector<SubdivisionStencils::Stencil>& linear,
+                             size_t columns, bool parallel,
+                             vector<SubdivisionStencils::Stencil>& dest)
+{
+    unordered_map<SubdivisionPoint*, size_t> index;
+    index.reserve(points.size());
+    for (size_t i=0; i<points.size(); ++i)
+        index.insert(make_pair(points[i], i));
+    dest.resize(points.size());
+    ParallelFor(points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    StencilAccumulator sum(columns);
+                    vector<pair<SubdivisionPoint*, float> > weights;
+                    for (size_t i=begin; i<end; ++i) {
+                        points[i]->averagingWeights(weights);
+                        for (size_t j=0; j<weights.size(); ++j)
+                            sum.add(linear[index.at(weights[j].first)], weights[j].second);
+                        sum.extract(dest[i]);
+                    }
+                }, parallel);
+}
+
 void SubdivisionSurface::subdivide()
+{
+    // the points no longer match the stencil table
+    _stencils.clear();
+    subdivide(nullptr);
+}
+
+// one level of refinement. The new vertex, edge and face points are
+// kept in hash maps keyed on the element they were created from, so
+// that each face can find its new points in constant time, and the
+// whole level is linear in the number of faces, edges and points.
+//
+// The points, the new faces of each control face, and the averaging
+// are computed over the thread pool if parallel subdivision is on.
+// Workers never touch the pools, the memory for the new points and
+// faces is taken up front and each worker gets the slice for its
+// range. Anything that changes shared state (curves, connecting the
+// new faces to their points and edges) is done afterwards on this
+// thread in element order, so the serial and parallel paths give
+// the same surface.
+void SubdivisionSurface::subdivide(vector<SubdivisionStencils::Stencil>* stencils)
 {
     if (numberOfControlFaces() < 1)
         return;
+    clearNormals();
     ++_current_subdiv_level;
-    vector<SubdivisionEdge*> newedgelist;
+    bool parallel = _parallel_subdivision;
     size_t number = numberOfFaces();
 
-    // create the list with new facepoints and a reference to the original face
-    vector<pair<SubdivisionFace*,SubdivisionPoint*> > facepoints;
-    // create the list with new edgepoints and a reference to the original edge
-    vector<pair<SubdivisionEdge*,SubdivisionPoint*> > edgepoints;
-    // create the list with new vertexpoints and a reference to the original vertex
-    vector<pair<SubdivisionPoint*,SubdivisionPoint*> > vertexpoints;
-
+    // the faces, edges and points of the current level, in the order
+    // their new points are added to the point list
+    vector<SubdivisionFace*> oldfaces;
+    vector<SubdivisionEdge*> oldedges;
+    vector<SubdivisionPoint*> oldpoints;
     if (number == 0) {
-        facepoints.reserve(numberOfControlFaces());
-        for (size_t i=0; i<numberOfControlFaces(); ++i) {
-            SubdivisionPoint *pt = getControlFace(i)->calculateFacePoint();
-            if (pt)
-                facepoints.push_back(make_pair(getControlFace(i), pt));
-        }
+        oldfaces.assign(_control_faces.begin(), _control_faces.end());
     }
     else {
-        facepoints.reserve(4*numberOfControlFaces());
+        oldfaces.reserve(number);
         for (size_t i=0; i<numberOfControlFaces(); ++i) {
             SubdivisionControlFace* ctrlface = getControlFace(i);
-            for (size_t j=0; j<ctrlface->numberOfChildren(); ++j) {
-                SubdivisionPoint *pt = ctrlface->getChild(j)->calculateFacePoint();
-                if (pt)
-                    facepoints.push_back(make_pair(ctrlface->getChild(j), pt));
-            }
+            for (size_t j=0; j<ctrlface->numberOfChildren(); ++j)
+                oldfaces.push_back(ctrlface->getChild(j));
             for (size_t j=0; j<ctrlface->numberOfEdges(); ++j)
-                edgepoints.push_back(make_pair(ctrlface->getEdge(j), ctrlface->getEdge(j)->calculateEdgePoint()));
+                oldedges.push_back(ctrlface->getEdge(j));
         }
     }
-    // calculate other edgepoints
-    if (numberOfEdges() == 0) {
-        edgepoints.reserve(edgepoints.size() + numberOfControlEdges());
-        for (size_t i=0; i<numberOfControlEdges(); ++i) {
-            edgepoints.push_back(make_pair(getControlEdge(i), getControlEdge(i)->calculateEdgePoint()));
+    if (numberOfEdges() == 0)
+        oldedges.insert(oldedges.end(), _control_edges.begin(), _control_edges.end());
+    else
+        oldedges.insert(oldedges.end(), _edges.begin(), _edges.end());
+    if (numberOfPoints() == 0)
+        oldpoints.assign(_control_points.begin(), _control_points.end());
+    else
+        oldpoints = _points;
+    // keep the current level in the level cache instead of deleting it
+    CachedLevel kept;
+    kept.level = _current_subdiv_level - 1;
+    kept.bytes = LevelBytes(oldpoints.size(), oldedges.size(), oldfaces.size())
+        + _adjacency.bytes();
+    bool keep = number > 0 && kept.bytes <= _level_cache_budget;
+    if (keep) {
+        kept.curve_points.resize(numberOfControlCurves());
+        for (size_t i=0; i<numberOfControlCurves(); ++i)
+            kept.curve_points[i] = getControlCurve(i)->getSubdivPoints();
+    }
+
+    // calculate the new face, edge and vertex points
+    vector<SubdivisionPoint*> facemem;
+    vector<SubdivisionPoint*> edgemem;
+    vector<SubdivisionPoint*> vertexmem;
+    _point_pool.take(oldfaces.size(), facemem);
+    _point_pool.take(oldedges.size(), edgemem);
+    _point_pool.take(oldpoints.size(), vertexmem);
+    // the lists of the new level are slices of a few flat blocks, laid
+    // out from the number of faces and edges each new point will get,
+    // face points then edge points then vertex points
+    LevelAdjacency adjacency;
+    PointSlices slices;
+    for (size_t i=0; i<oldfaces.size(); ++i) {
+        size_t n = oldfaces[i]->hasFacePoint() ? oldfaces[i]->numberOfPoints() : 0;
+        slices.add(n, n);
+    }
+    for (size_t i=0; i<oldedges.size(); ++i) {
+        size_t faces, edges;
+        EdgePointValence(oldedges[i], faces, edges);
+        slices.add(faces, edges);
+    }
+    for (size_t i=0; i<oldpoints.size(); ++i)
+        slices.add(oldpoints[i]->numberOfFaces(), oldpoints[i]->numberOfEdges());
+    adjacency.point_faces.allocate(slices.firstface.back());
+    adjacency.point_edges.allocate(slices.firstedge.back());
+    slices.faces = adjacency.point_faces.take(slices.firstface.back());
+    slices.edges = adjacency.point_edges.take(slices.firstedge.back());
+    size_t firstedgepoint = oldfaces.size();
+    size_t firstvertexpoint = oldfaces.size() + oldedges.size();
+    vector<SubdivisionPoint*> newfacepoints(oldfaces.size(), nullptr);
+    vector<SubdivisionPoint*> newedgepoints(oldedges.size());
+    vector<SubdivisionPoint*> newvertexpoints(oldpoints.size());
+    ParallelFor(oldfaces.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i) {
+                        if (oldfaces[i]->hasFacePoint()) {
+                            newfacepoints[i] = oldfaces[i]->createFacePoint(facemem[i]);
+                            slices.use(newfacepoints[i], i);
+                        }
+                    }
+                }, parallel);
+    ParallelFor(oldedges.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i) {
+                        newedgepoints[i] = oldedges[i]->createEdgePoint(edgemem[i]);
+                        slices.use(newedgepoints[i], firstedgepoint + i);
+                    }
+                }, parallel);
+    ParallelFor(oldpoints.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i) {
+                        newvertexpoints[i] = oldpoints[i]->createVertexPoint(vertexmem[i]);
+                        slices.use(newvertexpoints[i], firstvertexpoint + i);
+                    }
+                }, parallel);
+
+    // new facepoints with a reference to the original face, triangles
+    // don't get a facepoint unless in Catmull-Clark mode
+    FacePointMap facepoints;
+    facepoints.reserve(oldfaces.size());
+    vector<SubdivisionFace*> pointfaces;
+    size_t n = 0;
+    for (size_t i=0; i<oldfaces.size(); ++i) {
+        if (newfacepoints[i] != nullptr) {
+            facepoints.insert(make_pair(oldfaces[i], newfacepoints[i]));
+            newfacepoints[n++] = newfacepoints[i];
+            if (stencils != nullptr)
+                pointfaces.push_back(oldfaces[i]);
         }
+        else
+            _point_pool.del(facemem[i]);
+    }
+    newfacepoints.resize(n);
+    // new edgepoints with a reference to the original edge
+    EdgePointMap edgepoints;
+    edgepoints.reserve(oldedges.size());
+    for (size_t i=0; i<oldedges.size(); ++i) {
+        edgepoints.insert(make_pair(oldedges[i], newedgepoints[i]));
+        oldedges[i]->insertInCurve(newedgepoints[i]);
+    }
+    // new vertexpoints with a reference to the original vertex
+    VertexPointMap vertexpoints;
+    vertexpoints.reserve(oldpoints.size());
+    for (size_t i=0; i<oldpoints.size(); ++i) {
+        vertexpoints.insert(make_pair(oldpoints[i], newvertexpoints[i]));
+        oldpoints[i]->replaceInCurves(newvertexpoints[i]);
+    }
+
+    // the old points and edges are gone once the new mesh is made
+    vector<SubdivisionStencils::Stencil> linearstencils;
+    if (stencils != nullptr)
+        LinearStencils(oldpoints, oldedges, pointfaces, *stencils,
+                       numberOfControlPoints(), parallel, linearstencils);
+
+    // create the refined mesh over the newly created vertexpoints,
+    // edgepoints, and facepoints, first the new faces of each control face
+    vector<size_t> firstface(numberOfControlFaces() + 1, 0);
+    for (size_t i=0; i<numberOfControlFaces(); ++i)
+        firstface[i+1] = firstface[i] + getControlFace(i)->numberOfSubdividedFaces();
+    vector<SubdivisionFace*> newfacemem;
+    _face_pool.take(firstface.back(), newfacemem);
+    // room for a quad in each new face, and for the two faces of each
+    // new edge, two halves of each old edge and the ones inside each face
+    adjacency.face_points.allocate(4 * firstface.back());
+    SubdivisionPoint** newfacepts = adjacency.face_points.take(4 * firstface.back());
+    size_t nedges = 2 * oldedges.size();
+    for (size_t i=0; i<oldfaces.size(); ++i)
+        nedges += oldfaces[i]->hasFacePoint() ? oldfaces[i]->numberOfPoints() : 3;
+    adjacency.edge_faces.allocate(2 * nedges);
+    vector<vector<SubdivisionFace*> > newchildren(numberOfControlFaces());
+    vector<vector<FaceEdgeCheck> > checks(numberOfControlFaces());
+    ParallelFor(numberOfControlFaces(), k_subdivide_face_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        getControlFace(i)->createSubdividedFaces(
+                            vertexpoints, edgepoints, facepoints,
+                            newchildren[i], checks[i], newfacemem.data() + firstface[i],
+                            newfacepts + 4 * firstface[i]);
+                }, parallel);
+    // then connect them to the mesh
+    if (keep) {
+        kept.children.resize(numberOfControlFaces());
+        kept.face_edges.resize(numberOfControlFaces());
+        kept.control_edges.resize(numberOfControlFaces());
+        for (size_t i=0; i<numberOfControlFaces(); ++i)
+            getControlFace(i)->swapLevel(kept.children[i], kept.face_edges[i],
+                                         kept.control_edges[i]);
     }
-    else {
-        edgepoints.reserve(edgepoints.size() + numberOfEdges());
-        for (size_t i=0; i<numberOfEdges(); ++i) {
-            edgepoints.push_back(make_pair(getEdge(i), getEdge(i)->calculateEdgePoint()));
-        }
+    vector<SubdivisionEdge*> newedgelist;
+    for (size_t i=0; i<numberOfControlFaces(); ++i)
+        getControlFace(i)->connectSubdividedFaces(newchildren[i], checks[i], newedgelist,
+                                                  &adjacency.edge_faces);
+    // control edges shared by neighbouring control faces are in the list once for each face
+    unordered_set<SubdivisionEdge*> seen;
+    seen.reserve(newedgelist.size());
+    n = 0;
+    for (size_t i=0; i<newedgelist.size(); ++i) {
+        if (seen.insert(newedgelist[i]).second)
+            newedgelist[n++] = newedgelist[i];
+    }
+    newedgelist.resize(n);
+
+    // delete the old edges and points, not dumping the pool, as we have new edges
+    // and points that are in the pool that we want to keep
+    if (keep) {
+        kept.edges.swap(_edges);
+        kept.points.swap(_points);
+        kept.adjacency.swap(_adjacency);
     }
-    // calculate vertex points
-    if (numberOfPoints() == 0) {
-        vertexpoints.reserve(vertexpoints.size() + numberOfControlPoints());
-        for (size_t i=0; i<numberOfControlPoints(); ++i)
-            vertexpoints.push_back(make_pair(getControlPoint(i), getControlPoint(i)->calculateVertexPoint()));
+    for (size_t i=0; i<_edges.size(); ++i) {
+        _edges[i]->~SubdivisionEdge();
+        _edge_pool.del(_edges[i]);
     }
-    else {
-        vertexpoints.reserve(vertexpoints.size() + numberOfPoints());
-        for (size_t i=0; i<numberOfPoints(); ++i)
-            vertexpoints.push_back(make_pair(getPoint(i), getPoint(i)->calculateVertexPoint()));
+    _edges = newedgelist;
+    for (size_t i=0; i<_points.size(); ++i) {
+        _points[i]->~SubdivisionPoint();
+        _point_pool.del(_points[i]);
     }
-    // sort the points for faster access
-    // vertexpoints.sort
-    // edgepoints.sort
-    // facepoints.sort
+    // the blocks of the old level are freed on return unless kept
+    _adjacency.swap(adjacency);
+    _points.clear();
+    _points.reserve(newvertexpoints.size() + newedgepoints.size() + newfacepoints.size());
+    _points.insert(_points.end(), newvertexpoints.begin(), newvertexpoints.end());
+    _points.insert(_points.end(), newedgepoints.begin(), newedgepoints.end());
+    _points.insert(_points.end(), newfacepoints.begin(), newfacepoints.end());
+    ParallelFor(_points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        _points[i]->setListIndex(i);
+                }, parallel);
+    if (stencils != nullptr)
+        AveragedStencils(_points, linearstencils, numberOfControlPoints(), parallel, *stencils);
+    // perform averaging procedure to smooth the new mesh
+    // make a copy of all points, average them, put em back
+    vector<QVector3D> tmppoints(_points.size());
+    ParallelFor(_points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        tmppoints[i] = _points[i]->averaging();
+                }, parallel);
+    ParallelFor(_points.size(), k_subdivide_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        _points[i]->setCoordinate(tmppoints[i]);
+                }, parallel);
+    ParallelFor(numberOfControlFaces(), k_subdivide_face_grain,
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i=begin; i<end; ++i)
+                        getControlFace(i)->calcExtents();
+                }, parallel);
+    if (keep)
+        addCachedLevel(kept);
+}
+
+bool SubdivisionSurface::selectCachedLevel()
+{
+    // the highest kept level that isn't above the desired one
+    size_t best = _level_cache.size();
+    for (size_t i=0; i<_level_cache.size(); ++i) {
+        int level = _level_cache[i].level;
+        if (level <= _desired_subdiv_level
+                && (best == _level_cache.size() || level > _level_cache[best].level))
+            best = i;
+    }
+    bool usable = best < _level_cache.size()
+            && (_current_subdiv_level > _desired_subdiv_level
+                || _level_cache[best].level > _current_subdiv_level);
+    // going up from the current level is quickest
+    if (!usable && _current_subdiv_level < _desired_subdiv_level)
+        return false;
+    CachedLevel current;
+    takeLevel(current);
+    if (usable) {
+        CachedLevel chosen;
+        swap(chosen, _level_cache[best]);
+        _level_cache.erase(_level_cache.begin() + best);
+        restoreLevel(chosen);
+    }
+    // otherwise start again from the control net
+    addCachedLevel(current);
+    return true;
+}
 
-    // finally create the refined mesh over the newly created vertexpoints, edgepoints, and facepoints
+void SubdivisionSurface::takeLevel(CachedLevel& dest)
+{
+    dest.level = _current_subdiv_level;
+    dest.points.swap(_points);
+    dest.edges.swap(_edges);
+    size_t faces = 0;
+    dest.children.resize(numberOfControlFaces());
+    dest.face_edges.resize(numberOfControlFaces());
+    dest.control_edges.resize(numberOfControlFaces());
     for (size_t i=0; i<numberOfControlFaces(); ++i) {
-        getControlFace(i)->subdivide(vertexpoints, edgepoints, facepoints, newedgelist);
+        getControlFace(i)->swapLevel(dest.children[i], dest.face_edges[i],
+                                     dest.control_edges[i]);
+        faces += dest.children[i].size();
     }
+    dest.curve_points.resize(numberOfControlCurves());
+    for (size_t i=0; i<numberOfControlCurves(); ++i) {
+        dest.curve_points[i] = getControlCurve(i)->getSubdivPoints();
+        getControlCurve(i)->resetDivPoints();
+    }
+    dest.adjacency.swap(_adjacency);
+    dest.bytes = LevelBytes(dest.points.size(), dest.edges.size(), faces)
+        + dest.adjacency.bytes();
+    _current_subdiv_level = 0;
+    clearNormals();
+    _gaus_curvature.clear();
+    _min_gaus_curvature = 0;
+    _max_gaus_curvature = 0;
+    // the table is for the points of the level taken out
+    _stencils.clear();
+}
 
-    // delete the edges that are in the list, not dumping the pool, as we have new edges that
-    // are in the pool that we want to keep
-    for (size_t i=0; i<_edges.size(); ++i) {
-      deleteEdge(_edges[i]);
+void SubdivisionSurface::restoreLevel(CachedLevel& level)
+{
+    _points.swap(level.points);
+    _edges.swap(level.edges);
+    for (size_t i=0; i<numberOfControlFaces(); ++i)
+        getControlFace(i)->swapLevel(level.children[i], level.face_edges[i],
+                                     level.control_edges[i]);
+    for (size_t i=0; i<numberOfControlCurves(); ++i)
+        getControlCurve(i)->setSubdivPoints(level.curve_points[i]);
+    _adjacency.swap(level.adjacency);
+    _current_subdiv_level = level.level;
+    level.adjacency.clear();
+    level.points.clear();
+    level.edges.clear();
+    level.children.clear();
+    level.face_edges.clear();
+    level.control_edges.clear();
+    level.curve_points.clear();
+}
+
+void SubdivisionSurface::addCachedLevel(CachedLevel& level)
+{
+    if (level.bytes > _level_cache_budget) {
+        destroyLevel(level);
+        return;
     }
-    _edges = newedgelist;
-    // delete the points that are in the list, don't dump the pool
-    for (size_t i=0; i<_points.size(); ++i) {
-      deletePoint(_points[i]);
-    }
-    _points.reserve(vertexpoints.size() + edgepoints.size() + facepoints.size());
-    for (size_t i=0; i<vertexpoints.size(); ++i)
-        if (vertexpoints[i].first != 0)
-            _points.push_back(vertexpoints[i].second);
-    for (size_t i=0; i<edgepoints.size(); ++i)
-        if (edgepoints[i].first != 0)
-            _points.push_back(edgepoints[i].second);
-    for (size_t i=0; i<facepoints.size(); ++i)
-        if (facepoints[i].first != 0)
-            _points.push_back(facepoints[i].second);
-    // perform averaging procedure to smooth the new mesh
-    vector<QVector3D> tmppoints;
-    tmppoints.reserve(_points.size());
-    // make a copy of all points, average them, put em back
-    for (size_t i=0; i<_points.size(); ++i) {
-        tmppoints.push_back(_points[i]->averaging());
+    _level_cache.push_back(CachedLevel());
+    swap(_level_cache.back(), level);
+    trimLevelCache();
+}
+
+void SubdivisionSurface::trimLevelCache()
+{
+    size_t total = 0;
+    for (size_t i=0; i<_level_cache.size(); ++i)
+        total += _level_cache[i].bytes;
+    while (total > _level_cache_budget) {
+        // the level farthest from the desired one goes, the higher one on a tie
+        size_t worst = 0;
+        for (size_t i=1; i<_level_cache.size(); ++i) {
+            int d1 = abs(_level_cache[i].level - _desired_subdiv_level);
+            int d2 = abs(_level_cache[worst].level - _desired_subdiv_level);
+            if (d1 > d2 || (d1 == d2 && _level_cache[i].level > _level_cache[worst].level))
+                worst = i;
+        }
+        total -= _level_cache[worst].bytes;
+        destroyLevel(_level_cache[worst]);
+        _level_cache.erase(_level_cache.begin() + worst);
     }
-    for (size_t i=0; i<_points.size(); ++i) {
-        _points[i]->setCoordinate(tmppoints[i]);
+}
+
+void SubdivisionSurface::destroyLevel(CachedLevel& level)
+{
+    // the control edges of the faces are in the edge list of the level
+    for (size_t i=0; i<level.children.size(); ++i) {
+        for (size_t j=0; j<level.children[i].size(); ++j) {
+            level.children[i][j]->~SubdivisionFace();
+            _face_pool.del(level.children[i][j]);
+        }
+        for (size_t j=0; j<level.face_edges[i].size(); ++j) {
+            level.face_edges[i][j]->~SubdivisionEdge();
+            _edge_pool.del(level.face_edges[i][j]);
+        }
     }
+    for (size_t i=0; i<level.edges.size(); ++i) {
+        level.edges[i]->~SubdivisionEdge();
+        _edge_pool.del(level.edges[i]);
+    }
+    for (size_t i=0; i<level.points.size(); ++i) {
+        level.points[i]->~SubdivisionPoint();
+        _point_pool.del(level.points[i]);
+    }
+    level.points.clear();
+    level.edges.clear();
+    level.children.clear();
+    level.face_edges.clear();
+    level.control_edges.clear();
+    level.curve_points.clear();
+    level.adjacency.clear();
+    level.bytes = 0;
+}
+
+void SubdivisionSurface::LevelAdjacency::swap(LevelAdjacency& other)
+{
+    point_faces.swap(other.point_faces);
+    point_edges.swap(other.point_edges);
+    face_points.swap(other.face_points);
+    edge_faces.swap(other.edge_faces);
+}
+
+void SubdivisionSurface::LevelAdjacency::clear()
+{
+    point_faces.clear();
+    point_edges.clear();
+    face_points.clear();
+    edge_faces.clear();
+}
+
+size_t SubdivisionSurface::LevelAdjacency::bytes() const
+{
+    return point_faces.bytes() + point_edges.bytes()
+        + face_points.bytes() + edge_faces.bytes();
+}
+
+void SubdivisionSurface::clearLevelCache()
+{
+    for (size_t i=0; i<_level_cache.size(); ++i)
+        destroyLevel(_level_cache[i]);
+    _level_cache.clear();
 }
 
 static void privFindConnectedFaces(vector<SubdivisionControlFace*>& done,
@@ -3733,7 +5081,7 @@ bool SubdivisionSurface::check(SurfaceCheckResult& checked, bool quiet)
             if (edge1->numberOfFaces() == 1 &&
                 doubleedges.find(edge1) == doubleedges.end()) {
                 for (size_t j=0; j<edge1->startPoint()->numberOfEdges(); ++j) {
-                    SubdivisionControlEdge* edge2 = dynamic_cast<SubdivisionControlEdge*>(edge1->startPoint()->getEdge(j));
+                    SubdivisionControlEdge* edge2 = edge1->startPoint()->getEdge(j)->asControlEdge();
                     if (edge1 != edge2 && edge2->numberOfFaces() == 1) {
                         if (((edge1->startPoint()->getCoordinate().distanceToPoint(
                                   edge2->startPoint()->getCoordinate()) < edge_error)
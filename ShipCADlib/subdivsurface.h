@@ -33,6 +33,7 @@
 #include <iosfwd>
 #include <vector>
 #include <set>
+#include <utility>
 #include <QObject>
 #include <QColor>
 #include <QVector3D>
@@ -44,6 +45,11 @@
 #include "orderedmap.h"
 #include "tempvar.h"
 #include "grid.h"
+#include "subdivstencils.h"
+#include "picktree.h"
+#include "pointhash.h"
+#include "intervalindex.h"
+#include "adjacency.h"
 
 namespace ShipCAD {
 
@@ -90,6 +96,22 @@ private:
 
 //////////////////////////////////////////////////////////////////////////////////////
 
+/*! \brief where a plane cuts a subdivided edge
+ */
+struct SurfIntersectionData
+{
+    QVector3D point;
+    bool knuckle;
+    SubdivisionEdge* edge;
+    SurfIntersectionData() : point(ZERO), knuckle(false), edge(0) {}
+    SurfIntersectionData(const QVector3D& pt) : point(pt), knuckle(false), edge(0) {}
+};
+
+// first is start point, second is end point
+typedef std::vector<std::pair<SurfIntersectionData, SurfIntersectionData> > IntersectionSegments;
+
+//////////////////////////////////////////////////////////////////////////////////////
+
 /*! \brief Subdivision Surface
  *
  * This is the subdivision surface used for modelling the hull.
@@ -112,8 +134,45 @@ public:
     void initialize(size_t point_start, size_t edge_start);
     virtual void rebuild();
     virtual void setBuild(bool val);
+    /*! \brief number of times the surface has been rebuilt
+     *
+     * Anything made from the subdivided surface can keep this, if it
+     * changes the subdivided points may have moved.
+     */
+    size_t getBuildCount() const {return _build_count;}
+    /*! \brief a control point has been moved
+     *
+     * If the surface has been subdivided, only the faces around the
+     * point are marked for subdivision on the next rebuild, the rest
+     * of the subdivided surface is kept. Otherwise this is the same
+     * as setBuild(false)
+     *
+     * \param pt the control point that moved
+     * \param from the coordinate of the point before the move
+     */
+    void controlPointMoved(SubdivisionControlPoint* pt, const QVector3D& from);
+    /*! \brief the last rebuild only subdivided the faces around moved points
+     *
+     * \return true if the children of the faces in getRebuiltFaces()
+     * are the only ones that changed in the last rebuild
+     */
+    bool isLocalRebuild() const {return _local_rebuild;}
+    /*! \brief the control faces subdivided again by the last local rebuild
+     *
+     * \return the faces, empty if the last rebuild was not local
+     */
+    const std::vector<SubdivisionControlFace*>& getRebuiltFaces() const {return _rebuilt_faces;}
 
     // selecting
+    /*! \brief find the control element a ray picks
+     *
+     * Points are picked before edges, and edges before faces. Of the
+     * elements of one kind, the one closest along the ray is picked.
+     *
+     * \param vp the viewport the ray comes from
+     * \param ray the pick ray
+     * \return the picked element, or nullptr
+     */
     SubdivisionBase* shootPickRay(Viewport& vp, const PickRay& ray);
     
     // modifiers
@@ -158,6 +217,25 @@ public:
     void calculateIntersections(const Plane& plane,
                                 std::vector<SubdivisionControlFace*>& faces,
                                 SplineVector& destination);
+    /*! \brief the segments where a plane cuts the subdivided faces
+     *
+     * \param plane the plane
+     * \param faces the control faces whose adaptive faces are cut
+     * \param segments where the segments are added
+     */
+    void intersectionSegments(const Plane& plane,
+                              std::vector<SubdivisionControlFace*>& faces,
+                              IntersectionSegments& segments);
+    /*! \brief join intersection segments into polylines
+     *
+     * A polyline grows by the lowest numbered unused segment that
+     * joins either of its ends, and starts from the last segment
+     * left. The polylines are then joined where their ends meet.
+     *
+     * \param segments the segments, emptied
+     * \param destination where the polylines are added
+     */
+    static void chainSegments(IntersectionSegments& segments, SplineVector& destination);
     void extractAllEdgeLoops(std::vector<std::vector<SubdivisionPoint*> >& destination);
     void extractPointsFromFaces(std::vector<SubdivisionFace*>& selectedfaces,
                                 std::vector<SubdivisionControlPoint*>& points,
@@ -165,7 +243,29 @@ public:
     void extractPointsFromSelection(std::vector<SubdivisionControlPoint*>& selectedpoints,
                                     size_t& lockedpoints);
     void importGrid(Grid<QVector3D>& points, SubdivisionLayer* layer);
+    /*! \brief intersect the surface with a plane
+     *
+     * A built surface is only read, so several threads may intersect
+     * it at once
+     *
+     * \param plane the plane
+     * \param hydrostatics_layers_only only use layers used in hydrostatics
+     * \param destination where the curves are added
+     * \return true if there are any curves
+     */
     bool intersectPlane(const Plane& plane, bool hydrostatics_layers_only, SplineVector& destination);
+    /*! \brief intersect the surface with a set of parallel planes
+     *
+     * Gives the same curves as intersectPlane for each plane, but each
+     * subdivided face is only tested against the planes within its
+     * extents. Like intersectPlane, a built surface is only read
+     *
+     * \param planes the planes, all with the same normal
+     * \param hydrostatics_layers_only only use layers used in hydrostatics
+     * \param destinations where the curves of each plane are added
+     */
+    void intersectPlanes(const std::vector<Plane>& planes, bool hydrostatics_layers_only,
+                         std::vector<SplineVector*>& destinations);
     void insertPlane(const Plane& plane, bool add_curves);
     void subdivide();
     void deleteSelected();
@@ -300,8 +400,83 @@ public:
     subdiv_mode_t getSubdivisionMode() const {return _subdivision_mode;}
     void setSubdivisionMode(subdiv_mode_t val);
     int getDesiredSubdivisionLevel() const {return _desired_subdiv_level;}
+    int getCurrentSubdivisionLevel() const {return _current_subdiv_level;}
     
     void setDesiredSubdivisionLevel(int val);
+    /*! \brief is subdivision split over the thread pool
+     *
+     * \return true if subdivide uses multiple threads
+     */
+    bool isParallelSubdivision() const {return _parallel_subdivision;}
+    /*! \brief choose between serial and parallel subdivision
+     *
+     * Both give the same surface, the serial path is kept for
+     * comparison and debugging
+     *
+     * \param val true to split subdivision over the thread pool
+     */
+    void setParallelSubdivision(bool val) {_parallel_subdivision = val;}
+    /*! \brief memory the level cache may use
+     *
+     * Subdivided levels are kept when the surface moves to another
+     * level, so going back to a level doesn't subdivide again. Levels
+     * are dropped once they use more than this.
+     *
+     * \param bytes the budget, 0 keeps no levels
+     */
+    void setLevelCacheBudget(size_t bytes);
+    size_t getLevelCacheBudget() const {return _level_cache_budget;}
+    /*! \brief number of subdivided levels kept besides the current one
+     */
+    size_t numberOfCachedLevels() const {return _level_cache.size();}
+    /*! \brief memory of the adjacency lists of the current level
+     */
+    size_t getAdjacencyBytes() const {return _adjacency.bytes();}
+    /*! \brief chord tolerance of the adaptive mesh
+     *
+     * \return the tolerance, 0 if the adaptive mesh is off
+     */
+    float getAdaptiveTolerance() const {return _adaptive_tolerance;}
+    /*! \brief cover flat control faces with fewer faces
+     *
+     * After subdividing, each control face is covered by the coarsest
+     * grid of its subdivided points that stays within this distance
+     * of all its subdivided points. Where neighbouring faces use
+     * different grids the coarser faces also get the points of the
+     * finer ones on the shared edge, so there are no cracks. Faces
+     * along a crease keep all their children.
+     *
+     * \param val the tolerance in model units, 0 turns it off
+     */
+    void setAdaptiveTolerance(float val);
+    /*! \brief number of faces in the adaptive mesh
+     *
+     * \return total of the adaptive faces of all control faces
+     */
+    size_t numberOfAdaptiveFaces() const;
+    /*! \brief the weights of the control points in the subdivided points
+     *
+     * The table is made on the first rebuild after control points
+     * moved that can't be done locally, and used on the next ones
+     * until the topology changes
+     *
+     * \return the stencil table
+     */
+    const SubdivisionStencils& getStencils() const {return _stencils;}
+    /*! \brief normal of a subdivided point, kept since the last rebuild
+     *
+     * \param pt the point
+     * \param normal the normal, if found
+     * \return false if the point has no normal kept
+     */
+    bool cachedPointNormal(const SubdivisionPoint* pt, QVector3D& normal) const;
+    /*! \brief normal of a subdivided face, kept since the last rebuild
+     *
+     * \param face the face
+     * \param normal the normal, if found
+     * \return false if the face has no normal kept
+     */
+    bool cachedFaceNormal(const SubdivisionFace* face, QVector3D& normal) const;
 
     bool isGaussCurvatureCalculated() const;
     float getCurvatureScale() const {return _curvature_scale;}
@@ -395,6 +570,8 @@ public:
 protected:
 
     void priv_dump(std::ostream& os, const char* prefix) const;
+    // runs the destructors of the control elements, before their pools are cleared
+    void destroyControlElements();
     SubdivisionControlPoint* newControlPoint(const QVector3D& p);
     // used in convertToGrid
     void doAssemble(Grid<SubdivisionPoint*>& grid, size_t& cols, size_t& rows,
@@ -411,6 +588,129 @@ protected:
     void sortEdges(std::vector<SubdivisionEdge*>& edges);
     void sortEdges(std::vector<SubdivisionPoint*>& points, std::vector<SubdivisionEdge*>& edges);
     void sortControlEdges(std::vector<SubdivisionControlPoint*>& points, std::vector<SubdivisionControlEdge*>& edges);
+    /*! \brief subdivide again the faces around the moved control points
+     *
+     * The faces around the moved points are subdivided in a small
+     * surface of their own, and the new coordinates copied into the
+     * subdivided points of this surface
+     *
+     * \param dirtyfaces the control faces whose subdivided points changed
+     * \return false if the whole surface has to be subdivided instead
+     */
+    bool subdivideMovedPoints(std::vector<SubdivisionControlFace*>& dirtyfaces);
+    /*! \brief set the subdivided points from the stencil table
+     */
+    void evaluateStencils();
+    /*! \brief one level of subdivision
+     *
+     * \param stencils if not null, the stencils of the current points on
+     * entry and of the new points on return
+     */
+    void subdivide(std::vector<SubdivisionStencils::Stencil>* stencils);
+    /*! \brief find the normals of all subdivided points and faces
+     */
+    void calculateNormals();
+    /*! \brief find the normals again for the children of some control faces
+     *
+     * The other normals are kept, so only the given faces may have changed
+     * shape since the normals were calculated.
+     *
+     * \param faces the control faces
+     */
+    void updateNormals(const std::vector<SubdivisionControlFace*>& faces);
+    /*! \brief throw away the normals, the subdivided mesh changed
+     */
+    void clearNormals();
+    /*! \brief cover the flat control faces with fewer faces
+     *
+     * \param dirtyfaces if not null, the only control faces which changed
+     * shape since the last time, the others keep their adaptive faces unless
+     * a neighbour changed its grid
+     */
+    void buildAdaptiveFaces(const std::vector<SubdivisionControlFace*>* dirtyfaces);
+    /*! \brief make or refit the pick trees of the control net
+     */
+    void updatePickTrees();
+    /*! \brief index the extents of the control faces along each axis
+     */
+    void buildFaceIndex();
+    /*! \brief find the control faces whose extents overlap a range on an axis
+     *
+     * The first call after a rebuild makes the index.
+     *
+     * \param axis 0, 1 or 2 for x, y or z
+     * \param lo start of the range
+     * \param hi end of the range
+     * \param faces the faces, in the order of the layers and their faces
+     * \return false if the layers changed since the index was made
+     */
+    bool findControlFaces(int axis, float lo, float hi,
+                          std::vector<SubdivisionControlFace*>& faces);
+
+    /*! \brief the adjacency lists of the elements of a subdivided level
+     *
+     * Each point, face and edge of the level keeps its list in a slice
+     * of one of these blocks, so a level is a few large allocations
+     * instead of one or two per element
+     */
+    struct LevelAdjacency
+    {
+        AdjacencyBlock<SubdivisionFace*> point_faces;
+        AdjacencyBlock<SubdivisionEdge*> point_edges;
+        AdjacencyBlock<SubdivisionPoint*> face_points;
+        AdjacencyBlock<SubdivisionFace*> edge_faces;
+        void swap(LevelAdjacency& other);
+        void clear();
+        size_t bytes() const;
+    };
+    /*! \brief a subdivided level kept in the level cache
+     */
+    struct CachedLevel
+    {
+        int level;
+        size_t bytes;                   // estimate of the memory used
+        LevelAdjacency adjacency;
+        std::vector<SubdivisionPoint*> points;
+        std::vector<SubdivisionEdge*> edges;
+        // children, internal edges and control edges of each control face
+        std::vector<std::vector<SubdivisionFace*> > children;
+        std::vector<std::vector<SubdivisionEdge*> > face_edges;
+        std::vector<std::vector<SubdivisionEdge*> > control_edges;
+        // subdivided points of each control curve
+        std::vector<std::vector<SubdivisionPoint*> > curve_points;
+    };
+    /*! \brief move to the desired level using the level cache
+     *
+     * \return false if the current level has to be subdivided further
+     */
+    bool selectCachedLevel();
+    /*! \brief move the current level out of the surface
+     *
+     * The surface is left at level 0
+     *
+     * \param dest the level
+     */
+    void takeLevel(CachedLevel& dest);
+    /*! \brief make a level taken with takeLevel the current one
+     *
+     * \param level the level, empty on return
+     */
+    void restoreLevel(CachedLevel& level);
+    /*! \brief keep a level, dropping others if over the budget
+     *
+     * \param level the level, empty on return
+     */
+    void addCachedLevel(CachedLevel& level);
+    /*! \brief drop the levels farthest from the desired one until
+     * the cache fits its budget
+     */
+    void trimLevelCache();
+    /*! \brief delete the elements of a level
+     */
+    void destroyLevel(CachedLevel& level);
+    /*! \brief delete all kept levels
+     */
+    void clearLevelCache();
 
 protected:
 
@@ -422,6 +722,7 @@ protected:
     bool _show_normals;
     bool _show_curvature;
     bool _show_control_curves;
+    bool _parallel_subdivision;
 
     subdiv_mode_t _subdivision_mode;
     int _desired_subdiv_level;
@@ -432,6 +733,7 @@ protected:
     float _min_gaus_curvature;
     float _max_gaus_curvature;
     float _main_frame_location;
+    float _adaptive_tolerance;
 
     QColor _crease_color;
     QColor _crease_edge_color;
@@ -467,6 +769,43 @@ protected:
     std::vector<SubdivisionLayer*> _layers;
     // curvature at points
     std::vector<float> _gaus_curvature;
+    // control points moved since the last rebuild
+    std::set<SubdivisionControlPoint*> _moved_points;
+    // weights of the control points in the subdivided points
+    SubdivisionStencils _stencils;
+    // normals of the subdivided points, same order as _points
+    std::vector<QVector3D> _point_normals;
+    // the subdivided faces, children of each control face in turn, and their normals
+    std::vector<SubdivisionFace*> _normal_faces;
+    std::vector<QVector3D> _face_normals;
+    // grid stride of the adaptive faces of each control face, 0 if it uses
+    // its children
+    std::vector<size_t> _adaptive_strides;
+    // subdivided levels kept for changes of precision
+    std::vector<CachedLevel> _level_cache;
+    // the adjacency lists of the current subdivided level
+    LevelAdjacency _adjacency;
+    size_t _level_cache_budget;
+    // trees over the control points, edges and faces used for picking
+    PickTree _point_tree;
+    PickTree _edge_tree;
+    PickTree _face_tree;
+    bool _pick_rebuild;         // the control net changed, make the trees again
+    bool _pick_refit;           // control points moved, refit the trees
+    // control points by position, for welding new points to them. Made
+    // by the first weld, then kept up to date until the points are loaded
+    PointHash _point_hash;
+    bool _point_hash_valid;
+    // control face extents along x, y and z, made by the first search
+    // after a rebuild. The faces are numbered in layer order, with the
+    // layer and place in it
+    IntervalIndex _face_index[3];
+    std::vector<SubdivisionControlFace*> _indexed_faces;
+    std::vector<std::pair<size_t, size_t> > _indexed_places;
+    bool _face_index_valid;     // the extents didn't change since it was made
+    size_t _build_count;        // number of rebuilds, to tell if copies are stale
+    bool _local_rebuild;        // the last rebuild only redid _rebuilt_faces
+    std::vector<SubdivisionControlFace*> _rebuilt_faces;
 
     // entities obtained by subdividing the surface
     std::vector<SubdivisionPoint*> _points;     // all subdivided points, corners of the SubdivisionFace
@@ -30,9 +30,11 @@
 #include <cmath>
 #include <climits>
 #include <algorithm>
+#include <set>
 #include <boost/math/constants/constants.hpp>
 #include "utility.h"
 #include "shipcadlib.h"
+#include "pointgrid.h"
 
 using namespace std;
 using namespace ShipCAD;
@@ -419,40 +421,62 @@ static float Minimum(float d1, float d2, float d3, float d4)
     return result.first;
 }
 
-// This procedure takes a lot of linesegments and tries to connect them into as few as possible splines
-void ShipCAD::JoinSplineSegments(float join_error,
-                                        bool force_to_one_segment,
-                                        SplineVector& list)
+// the smallest squared distance between an end of one spline and an end of the other
+static float EndDistance(Spline* fixed, Spline* match)
+{
+    float d1 = SquaredDistPP(fixed->getFirstPoint(), match->getFirstPoint());
+    float d2 = SquaredDistPP(fixed->getFirstPoint(), match->getLastPoint());
+    float d3 = SquaredDistPP(fixed->getLastPoint(), match->getFirstPoint());
+    float d4 = SquaredDistPP(fixed->getLastPoint(), match->getLastPoint());
+    return Minimum(d1, d2, d3, d4);
+}
+
+// add match to fixed at the ends nearest each other
+static void JoinAtNearestEnds(Spline* fixed, Spline* match)
+{
+    float d1 = SquaredDistPP(fixed->getFirstPoint(), match->getFirstPoint());
+    float d2 = SquaredDistPP(fixed->getFirstPoint(), match->getLastPoint());
+    float d3 = SquaredDistPP(fixed->getLastPoint(), match->getFirstPoint());
+    float d4 = SquaredDistPP(fixed->getLastPoint(), match->getLastPoint());
+    float min = Minimum(d1, d2, d3, d4);
+    // the splines do touch each other on one of their ends
+    if (min == d1)
+        fixed->insert_spline(0, true, true, *match);
+    else if (min == d2)
+        fixed->insert_spline(0, false, true, *match);
+    else if (min == d3)
+        fixed->insert_spline(fixed->numberOfPoints(), false, true, *match);
+    else if (min == d4)
+        fixed->insert_spline(fixed->numberOfPoints(), true, true, *match);
+    else
+        throw runtime_error("Error in comparing minimum values JoinSplineSegments");
+}
+
+// a spline with more than one point whose ends are apart
+static bool IsOpenSpline(Spline* spline)
+{
+    if (spline->numberOfPoints() <= 1)
+        return false;
+    return !(spline->getFirstPoint().distanceToPoint(spline->getLastPoint()) < 1E-5);
+}
+
+// compares each spline against all others, starting again after each join
+static void JoinSplinesScan(float join_error, bool force_to_one_segment, SplineVector& list)
 {
-    bool fixedclosed;
-    bool matchclosed;
     Spline* nearest, *match;
     // remove any single line segments
     size_t i = 1;
     while (i < list.size()) {
         Spline* fixed = list.get(i-1);
-        if (fixed->numberOfPoints() > 1) {
-            fixedclosed = fixed->getFirstPoint().distanceToPoint(fixed->getLastPoint()) < 1E-5;
-        }
-        else
-            fixedclosed = false;
-        if (fixed->numberOfPoints() > 1 && !fixedclosed) {
+        if (IsOpenSpline(fixed)) {
             float nearestdist = 1E30f;
             nearest = 0;
             for (size_t j=1; j<=list.size(); ++j) {
                 if (i == j)
                     continue;
                 match = list.get(j-1);
-                if (match->numberOfPoints() > 1)
-                    matchclosed = match->getFirstPoint().distanceToPoint(match->getLastPoint()) < 1E-5;
-                else
-                    matchclosed = false;
-                if (match->numberOfPoints() > 1 && !matchclosed) {
-                    float d1 = SquaredDistPP(fixed->getFirstPoint(), match->getFirstPoint());
-                    float d2 = SquaredDistPP(fixed->getFirstPoint(), match->getLastPoint());
-                    float d3 = SquaredDistPP(fixed->getLastPoint(), match->getFirstPoint());
-                    float d4 = SquaredDistPP(fixed->getLastPoint(), match->getLastPoint());
-                    float min = Minimum(d1, d2, d3, d4);
+                if (IsOpenSpline(match)) {
+                    float min = EndDistance(fixed, match);
                     if (min < nearestdist) {
                         nearestdist = min;
                         nearest = match;
@@ -463,23 +487,9 @@ void ShipCAD::JoinSplineSegments(float join_error,
             }
             if (nearest != 0) {
                 match = nearest;
-                float d1 = SquaredDistPP(fixed->getFirstPoint(), match->getFirstPoint());
-                float d2 = SquaredDistPP(fixed->getFirstPoint(), match->getLastPoint());
-                float d3 = SquaredDistPP(fixed->getLastPoint(), match->getFirstPoint());
-                float d4 = SquaredDistPP(fixed->getLastPoint(), match->getLastPoint());
-                float min = Minimum(d1, d2, d3, d4);
+                float min = EndDistance(fixed, match);
                 if (min < join_error || force_to_one_segment) {
-                    // the splines do touch each other on one of their ends
-                    if (min == d1)
-                        fixed->insert_spline(0, true, true, *match);
-                    else if (min == d2)
-                        fixed->insert_spline(0, false, true, *match);
-                    else if (min == d3)
-                        fixed->insert_spline(fixed->numberOfPoints(), false, true, *match);
-                    else if (min == d4)
-                        fixed->insert_spline(fixed->numberOfPoints(), true, true, *match);
-                    else
-                        throw runtime_error("Error in comparing minimum values JoinSplineSegments");
+                    JoinAtNearestEnds(fixed, match);
                     list.del(match);
                     i = 0;  // reset match index to start searching for a new matching spline
                 }
@@ -489,6 +499,87 @@ void ShipCAD::JoinSplineSegments(float join_error,
     }
 }
 
+// Gives the same splines as JoinSplinesScan, without comparing all of
+// them. The scan joins the first spline in the list that has another
+// within the join distance, so that is the first one waiting to be
+// tried. Those closer than the join distance are found through the
+// ends of the splines. A spline which didn't join can only join later
+// if a spline grew an end near it, so those are tried again.
+static void JoinSplinesHashed(float join_error, SplineVector& list)
+{
+    vector<Spline*> splines(list.begin(), list.end());
+    vector<bool> joined(splines.size(), false);
+    // the scan compares squared distances with the join error
+    PointGrid ends(sqrt(join_error) * 1.01f);
+    set<size_t> waiting;
+    for (size_t i=0; i<splines.size(); ++i) {
+        if (IsOpenSpline(splines[i])) {
+            ends.insert(splines[i]->getFirstPoint(), i);
+            ends.insert(splines[i]->getLastPoint(), i);
+            waiting.insert(i);
+        }
+    }
+    size_t count = splines.size();
+    vector<size_t> near;
+    while (!waiting.empty()) {
+        size_t i = *waiting.begin();
+        waiting.erase(waiting.begin());
+        // the scan never takes the last spline as the one to join to
+        while (count > 0 && joined[count-1])
+            --count;
+        Spline* fixed = splines[i];
+        if (joined[i] || i + 1 >= count || !IsOpenSpline(fixed))
+            continue;
+        near.clear();
+        ends.find(fixed->getFirstPoint(), near);
+        ends.find(fixed->getLastPoint(), near);
+        sort(near.begin(), near.end());
+        near.erase(unique(near.begin(), near.end()), near.end());
+        float nearestdist = 1E30f;
+        size_t nearest = i;
+        for (size_t k=0; k<near.size(); ++k) {
+            size_t j = near[k];
+            if (j == i || joined[j] || !IsOpenSpline(splines[j]))
+                continue;
+            float min = EndDistance(fixed, splines[j]);
+            if (min < nearestdist) {
+                nearestdist = min;
+                nearest = j;
+                if (min < 1E-5)
+                    break;
+            }
+        }
+        if (nearest == i || !(nearestdist < join_error))
+            continue;
+        JoinAtNearestEnds(fixed, splines[nearest]);
+        joined[nearest] = true;
+        ends.insert(fixed->getFirstPoint(), i);
+        ends.insert(fixed->getLastPoint(), i);
+        waiting.insert(i);
+        near.clear();
+        ends.find(fixed->getFirstPoint(), near);
+        ends.find(fixed->getLastPoint(), near);
+        for (size_t k=0; k<near.size(); ++k)
+            if (!joined[near[k]])
+                waiting.insert(near[k]);
+    }
+    for (size_t i=0; i<splines.size(); ++i)
+        if (joined[i])
+            list.del(splines[i]);
+}
+
+// This procedure takes a lot of linesegments and tries to connect them into as few as possible splines
+void ShipCAD::JoinSplineSegments(float join_error,
+                                        bool force_to_one_segment,
+                                        SplineVector& list)
+{
+    // joining regardless of distance needs the nearest of all splines
+    if (force_to_one_segment || join_error <= 1E-5)
+        JoinSplinesScan(join_error, force_to_one_segment, list);
+    else
+        JoinSplinesHashed(join_error, list);
+}
+
 int ShipCAD::ReadIntFromStr(size_t lineno, const QString& str, size_t& start)
 {
     int spc = str.indexOf(' ', start);
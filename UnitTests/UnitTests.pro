@@ -13,4 +13,10 @@ SUBDIRS = \
     subdivsurface \
     developedpatch \
     projsettings \
-    visibility
+    visibility \
+    picktree \
+    pointhash \
+    intervalindex \
+    pointgrid \
+    hydrostaticmesh \
+    hydrostaticscache
@@ -84,21 +84,21 @@ void DevelopedpatchTest::testUnrollSimpleFace()
     pt4->addEdge(edge4);
     pt1->addEdge(edge4);
 
-    vector<pair<SubdivisionPoint*,SubdivisionPoint*> > vertexpoints;
-    vector<pair<SubdivisionFace*,SubdivisionPoint*> > facepoints;
-    vector<pair<SubdivisionEdge*,SubdivisionPoint*> > edgepoints;
+    VertexPointMap vertexpoints;
+    FacePointMap facepoints;
+    EdgePointMap edgepoints;
     vector<SubdivisionEdge*> controledges;
 
     // create vertex points
     for (size_t i=0; i<face->numberOfPoints(); i++)
-        vertexpoints.push_back(make_pair(face->getPoint(i), face->getPoint(i)->calculateVertexPoint()));
+        vertexpoints.insert(make_pair(face->getPoint(i), face->getPoint(i)->calculateVertexPoint()));
     // create facepoints
-    facepoints.push_back(make_pair(face, face->calculateFacePoint()));
+    facepoints.insert(make_pair(face, face->calculateFacePoint()));
     // create edgepoints
-    edgepoints.push_back(make_pair(edge1, edge1->calculateEdgePoint()));
-    edgepoints.push_back(make_pair(edge2, edge2->calculateEdgePoint()));
-    edgepoints.push_back(make_pair(edge3, edge3->calculateEdgePoint()));
-    edgepoints.push_back(make_pair(edge4, edge4->calculateEdgePoint()));
+    edgepoints.insert(make_pair(edge1, edge1->calculateEdgePoint()));
+    edgepoints.insert(make_pair(edge2, edge2->calculateEdgePoint()));
+    edgepoints.insert(make_pair(edge3, edge3->calculateEdgePoint()));
+    edgepoints.insert(make_pair(edge4, edge4->calculateEdgePoint()));
 
     face->subdivide(vertexpoints, edgepoints, facepoints, controledges);
 
@@ -1,13 +1,22 @@
 #include <QString>
+#include <QFile>
 #include <QtTest>
+#include <vector>
+#include <cmath>
 
 #include "shipcadmodel.h"
 #include "hydrostaticcalc.h"
+#include "intersection.h"
 #include "subdivsurface.h"
 #include "subdivface.h"
 #include "subdivedge.h"
+#include "subdivlayer.h"
+#include "subdivpoint.h"
 #include "projsettings.h"
 #include "utility.h"
+#include "filebuffer.h"
+#include "hydrostaticmesh.h"
+#include "../testutil.h"
 
 using namespace ShipCAD;
 using namespace std;
@@ -26,6 +35,27 @@ private:
 private Q_SLOTS:
     void testCalculateVolume();
     void testCalculate();
+    void testCurves();
+    void testCurvesDemoHull();
+    void testVolumeDemoHulls();
+    void benchmarkVolume_data();
+    void benchmarkVolume();
+    void testSAC();
+    void testSACDemoHull();
+    void benchmarkSAC_data();
+    void benchmarkSAC();
+    void testLiveHydrostatics();
+    void testLiveHydrostaticsDemoHull();
+    void benchmarkCurves_data();
+    void benchmarkCurves();
+    void testBalance();
+    void testBalanceFreeToTrim();
+    void testBalanceDemoHull();
+    void benchmarkBalanceEvaluations_data();
+    void benchmarkBalanceEvaluations();
+    void testCrossCurves();
+    void benchmarkCrossCurves_data();
+    void benchmarkCrossCurves();
 };
 
 HydrostaticcalcTest::HydrostaticcalcTest()
@@ -171,6 +201,738 @@ void HydrostaticcalcTest::testCalculate()
     QVERIFY(!hc.hasError(feNothingSubmerged) && !hc.hasError(feNotEnoughBuoyancy) && !hc.hasError(feMakingWater));
 }
 
+// compare relative to the size of the expected value
+static bool closeTo(float val, float expected, float error)
+{
+    return fabs(val - expected) <= error * max(1.0f, fabs(expected));
+}
+
+// the curves against HydrostaticCalc at each draft, the waterplane
+// there comes from the waterline curves so is less exact, and its
+// moments of inertia aren't compared
+static bool sameAsCalculate(ShipCADModel* model, HydrostaticCurves& curves, size_t index)
+{
+    HydrostaticCalc hc(model);
+    hc.setDraft(curves.getDraft(index));
+    hc.setHeelingAngle(curves.getHeelingAngle());
+    hc.setTrim(curves.getTrim());
+    hc.addCalculationType(hcWaterline);
+    hc.calculate();
+    const HydrostaticsData& a = curves.getData(index);
+    const HydrostaticsData& b = hc.getData();
+    float length = b.model_max.x() - b.model_min.x();
+    return curves.hasError(index, feNothingSubmerged) == hc.hasError(feNothingSubmerged)
+        && curves.hasError(index, feMakingWater) == hc.hasError(feMakingWater)
+        && closeTo(a.absolute_draft, b.absolute_draft, 1E-3)
+        && closeTo(a.volume, b.volume, 1E-3)
+        && closeTo(a.displacement, b.displacement, 1E-3)
+        && closeTo(a.center_of_buoyancy.x(), b.center_of_buoyancy.x(), 1E-3 * length)
+        && closeTo(a.center_of_buoyancy.z(), b.center_of_buoyancy.z(), 1E-3 * length)
+        && closeTo(a.wetted_surface, b.wetted_surface, 1E-3)
+        && closeTo(a.length_waterline, b.length_waterline, 1E-3)
+        && closeTo(a.beam_waterline, b.beam_waterline, 1E-3)
+        && closeTo(a.waterplane_area, b.waterplane_area, 1E-2);
+}
+
+void HydrostaticcalcTest::testCurves()
+{
+    HydrostaticCurves curves(_model);
+    vector<float> drafts;
+    drafts.push_back(0.75f);
+    drafts.push_back(-0.1f);
+    drafts.push_back(0.25f);
+    drafts.push_back(0.5f);
+    curves.calculate(drafts);
+    QCOMPARE(curves.numberOfDrafts(), drafts.size());
+    QVERIFY(curves.hasError(1, feNothingSubmerged));
+    QVERIFY(curves.getData(1).volume == 0);
+    for (size_t i=0; i<drafts.size(); i++) {
+        if (i == 1)
+            continue;
+        const HydrostaticsData& data = curves.getData(i);
+        QVERIFY(!curves.hasError(i, feNothingSubmerged) && !curves.hasError(i, feMakingWater));
+        QVERIFY(FuzzyCompare(data.absolute_draft, drafts[i], 1E-3));
+        QVERIFY(FuzzyCompare(data.volume, drafts[i], 1E-3));
+        QVERIFY(FuzzyCompare(data.center_of_buoyancy.x(), 0.5, 1E-3));
+        QVERIFY(FuzzyCompare(data.center_of_buoyancy.y(), 0, 1E-3));
+        QVERIFY(FuzzyCompare(data.center_of_buoyancy.z(), 0.5 * drafts[i], 1E-3));
+        // the face on the centerplane is mirrored onto itself, so counts twice
+        QVERIFY(FuzzyCompare(data.wetted_surface, 1 + 6 * drafts[i], 1E-3));
+        QVERIFY(FuzzyCompare(data.waterplane_area, 1, 1E-3));
+        QVERIFY(FuzzyCompare(data.km_transverse, 0.5 * drafts[i] + (1.0 / 12) / drafts[i], 1E-3));
+        QVERIFY(FuzzyCompare(data.km_longitudinal, 0.5 * drafts[i] + (1.0 / 12) / drafts[i], 1E-3));
+        QVERIFY(FuzzyCompare(data.block_coefficient, 1, 1E-3));
+        QVERIFY(sameAsCalculate(_model, curves, i));
+    }
+    QVERIFY_EXCEPTION_THROWN(curves.getData(drafts.size()), out_of_range);
+}
+
+void HydrostaticcalcTest::testCurvesDemoHull()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    float draft = model.getProjectSettings().getDraft();
+    HydrostaticCurves curves(&model);
+    vector<float> drafts;
+    for (size_t i=1; i<=6; i++)
+        drafts.push_back(draft * i / 4);
+    curves.calculate(drafts);
+    for (size_t i=0; i<drafts.size(); i++)
+        QVERIFY(sameAsCalculate(&model, curves, i));
+    // with heel and trim
+    curves.setHeelingAngle(10);
+    curves.setTrim(0.1f * draft);
+    QCOMPARE(curves.numberOfDrafts(), static_cast<size_t>(0));
+    curves.calculate(drafts);
+    for (size_t i=0; i<drafts.size(); i++) {
+        HydrostaticCalc hc(&model);
+        hc.setDraft(drafts[i]);
+        hc.setHeelingAngle(10);
+        hc.setTrim(0.1f * draft);
+        hc.calculateVolume(hc.getWlPlane());
+        QVERIFY(closeTo(curves.getData(i).volume, hc.getData().volume, 1E-3));
+        QVERIFY(closeTo(curves.getData(i).wetted_surface, hc.getData().wetted_surface, 1E-3));
+    }
+}
+
+// the sums of VolumeCalc as it found them before it worked in batches,
+// going through the faces of the hydrostatic mesh one point at a time,
+// and through the starboard side of a face in a second pass
+struct ReferenceVolume
+{
+    float volume;
+    QVector3D moment;
+    float wetted_surface;
+    float absolute_draft;
+    double wl_area;
+    double wl_moment;
+    double wl_inertia;
+};
+
+static void referenceTriangle(const QVector3D& origin, const QVector3D& normal,
+                              const QVector3D& axis, QVector3D p1, QVector3D p2,
+                              QVector3D p3, ReferenceVolume& ref)
+{
+    p1 -= origin;
+    p2 -= origin;
+    p3 -= origin;
+    QVector3D center = (p1 + p2 + p3) / 3.0f;
+    float volume = QVector3D::dotProduct(p1, QVector3D::crossProduct(p2, p3)) / 6.0f;
+    if (volume != 0) {
+        ref.volume += volume;
+        ref.moment += .75 * volume * center;
+    }
+    float ax = 0.5 * ((p1.y() - p2.y()) * (p1.z() + p2.z()) + (p2.y() - p3.y()) * (p2.z() + p3.z())
+                      + (p3.y() - p1.y()) * (p3.z() + p1.z()));
+    float ay = 0.5 * ((p1.z() - p2.z()) * (p1.x() + p2.x()) + (p2.z() - p3.z()) * (p2.x() + p3.x())
+                      + (p3.z() - p1.z()) * (p3.x() + p1.x()));
+    float az = 0.5 * ((p1.x() - p2.x()) * (p1.y() + p2.y()) + (p2.x() - p3.x()) * (p2.y() + p3.y())
+                      + (p3.x() - p1.x()) * (p3.y() + p1.y()));
+    ref.wetted_surface += sqrt(ax * ax + ay * ay + az * az);
+    double area = 0.5 * QVector3D::dotProduct(QVector3D::crossProduct(p2 - p1, p3 - p1),
+                                              normal) / normal.length();
+    double u1 = QVector3D::dotProduct(p1 + origin, axis);
+    double u2 = QVector3D::dotProduct(p2 + origin, axis);
+    double u3 = QVector3D::dotProduct(p3 + origin, axis);
+    double su = u1 + u2 + u3;
+    ref.wl_area -= area;
+    ref.wl_moment -= area * su / 3;
+    ref.wl_inertia -= area * (u1 * u1 + u2 * u2 + u3 * u3 + su * su) / 12;
+}
+
+static void referenceVolume(ShipCADModel* model, const Plane& wl, ReferenceVolume& ref)
+{
+    ref.volume = 0;
+    ref.moment = ZERO;
+    ref.wetted_surface = 0;
+    ref.absolute_draft = 1000;
+    ref.wl_area = ref.wl_moment = ref.wl_inertia = 0;
+    QVector3D origin = wl.projectPointOnPlane(ZERO);
+    QVector3D normal(wl.a(), wl.b(), wl.c());
+    QVector3D unit = normal.normalized();
+    QVector3D axis = QVector3D(1, 0, 0) - unit.x() * unit;
+    axis.normalize();
+    const HydrostaticMesh& mesh = model->getHydrostaticMesh();
+    vector<QVector3D> points;
+    for (size_t i=0; i<mesh.numberOfFaces(); i++) {
+        size_t first = mesh.firstPoint(i);
+        size_t count = mesh.numberOfPoints(i);
+        size_t sides = mesh.isSymmetric(i) ? 2 : 1;
+        for (size_t side=0; side<sides; side++) {
+            points.clear();
+            QVector3D p1 = mesh.getPoint(first + count - 1);
+            if (side == 1)
+                p1.setY(-p1.y());
+            float side1 = wl.distance(p1);
+            for (size_t l=0; l<count; l++) {
+                QVector3D p2 = mesh.getPoint(first + l);
+                if (side == 1)
+                    p2.setY(-p2.y());
+                float side2 = wl.distance(p2);
+                if ((side1 < -1e-5 && side2 > 1e-5) || (side1 > 1e-5 && side2 < -1e-5)) {
+                    float parameter = -side1 / (side2 - side1);
+                    points.push_back(p1 + parameter * (p2 - p1));
+                }
+                if (side2 <= 1e-5) {
+                    if (side2 < ref.absolute_draft)
+                        ref.absolute_draft = side2;
+                    points.push_back(p2);
+                }
+                p1 = p2;
+                side1 = side2;
+            }
+            for (size_t l=3; l<=points.size(); l++) {
+                if (side == 0)
+                    referenceTriangle(origin, normal, axis, points[0], points[l-2], points[l-1], ref);
+                else
+                    referenceTriangle(origin, normal, axis, points[0], points[l-1], points[l-2], ref);
+            }
+        }
+    }
+    ref.absolute_draft = -ref.absolute_draft;
+    if (ref.volume != 0)
+        ref.volume *= model->getProjectSettings().getAppendageCoefficient();
+}
+
+// the same sums in the same order, so the same to the last bit
+void HydrostaticcalcTest::testVolumeDemoHulls()
+{
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    size_t compared = 0;
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); i++) {
+        ShipCADModel model;
+        if (!loadDemoHull(model, hulls[i]))
+            continue;
+        float draft = model.getProjectSettings().getDraft();
+        for (size_t j=1; j<=3; j++) {
+            for (size_t k=0; k<3; k++) {
+                HydrostaticCalc hc(&model);
+                hc.setDraft(draft * j / 2);
+                hc.setHeelingAngle(k * 15.0f);
+                hc.setTrim(k * 0.05f * draft);
+                hc.calculateVolume(hc.getWlPlane());
+                if (hc.hasError(feMakingWater))
+                    continue;
+                ReferenceVolume ref;
+                referenceVolume(&model, hc.getWlPlane(), ref);
+                QVERIFY(hc.getData().volume == ref.volume);
+                QVERIFY(hc.getData().wetted_surface == ref.wetted_surface);
+                QVERIFY(hc.getData().absolute_draft == ref.absolute_draft);
+                compared++;
+            }
+        }
+    }
+    if (compared == 0)
+        QSKIP("demo hulls not found");
+}
+
+void HydrostaticcalcTest::benchmarkVolume_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("batched");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 one point at a time").arg(hulls[i]).toLatin1().data())
+            << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 batched").arg(hulls[i]).toLatin1().data())
+            << QString(hulls[i]) << true;
+    }
+}
+
+// the volume at the design draft and a heel, as VolumeCalc finds it
+// and as the reference did before it worked in batches
+void HydrostaticcalcTest::benchmarkVolume()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, batched);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    HydrostaticCalc hc(&model);
+    hc.setDraft(model.getProjectSettings().getDraft());
+    hc.setHeelingAngle(15);
+    Plane wl = hc.getWlPlane();
+    model.getHydrostaticMesh();
+    ReferenceVolume ref;
+    QBENCHMARK {
+        if (batched)
+            hc.calculateVolume(wl);
+        else
+            referenceVolume(&model, wl, ref);
+    }
+}
+
+void HydrostaticcalcTest::testSAC()
+{
+    HydrostaticCalc hc(_model);
+    hc.setDraft(0.5);
+    hc.addCalculationType(hcSAC);
+    hc.setSACResolution(10);
+    hc.calculate();
+    const vector<QVector2D>& sac = hc.getData().sac;
+    QCOMPARE(sac.size(), static_cast<size_t>(10));
+    for (size_t i=0; i<sac.size(); i++) {
+        QVERIFY(FuzzyCompare(sac[i].x(), 0.05f + 0.1f * i, 1E-5));
+        QVERIFY(FuzzyCompare(sac[i].y(), 0.5, 1E-4));
+    }
+    // heeled and trimmed the bins still hold all of the volume
+    hc.setHeelingAngle(10);
+    hc.setTrim(0.1f);
+    hc.calculate();
+    QCOMPARE(hc.getData().sac.size(), static_cast<size_t>(10));
+    float volume = 0;
+    for (size_t i=0; i<hc.getData().sac.size(); i++)
+        volume += hc.getData().sac[i].y() * 0.1f;
+    QVERIFY(closeTo(volume, hc.getData().volume, 1E-4));
+    // the bow is deeper
+    QVERIFY(hc.getData().sac.back().y() > hc.getData().sac.front().y());
+    // back to the stations, the box has none
+    hc.setSACResolution(0);
+    hc.calculate();
+    QCOMPARE(hc.getData().sac.size(), static_cast<size_t>(0));
+}
+
+void HydrostaticcalcTest::testSACDemoHull()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    ProjectSettings& ps = model.getProjectSettings();
+    HydrostaticCalc hc(&model);
+    hc.setDraft(ps.getDraft());
+    hc.addCalculationType(hcSAC);
+    hc.setSACResolution(200);
+    hc.calculate();
+    const HydrostaticsData& data = hc.getData();
+    QVERIFY(data.sac.size() > 100);
+    float width = (data.model_max.x() - data.model_min.x()) / 200;
+    float volume = 0;
+    float largest = 0;
+    for (size_t i=0; i<data.sac.size(); i++) {
+        volume += data.sac[i].y() * width;
+        largest = max(largest, data.sac[i].y());
+    }
+    QVERIFY(closeTo(volume, data.volume / ps.getAppendageCoefficient(), 1E-3));
+    // against the areas of the sections through the middle of some bins
+    for (size_t i=10; i<data.sac.size(); i+=20) {
+        float x = data.sac[i].x();
+        Intersection station(&model, fiStation, Plane(1, 0, 0, -x), true);
+        float area;
+        QVector3D cog;
+        QVector2D moi;
+        station.calculateArea(data.waterline_plane, &area, &cog, &moi);
+        QVERIFY(FuzzyCompare(data.sac[i].y(), area, 0.01f * largest));
+    }
+}
+
+void HydrostaticcalcTest::benchmarkSAC_data()
+{
+    QTest::addColumn<QString>("filename");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i)
+        QTest::newRow(hulls[i]) << QString(hulls[i]);
+}
+
+// the volume and 200 sectional areas
+void HydrostaticcalcTest::benchmarkSAC()
+{
+    QFETCH(QString, filename);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    // calculated each time
+    model.getHydrostaticsCache().setMaxSize(0);
+    HydrostaticCalc hc(&model);
+    hc.setDraft(model.getProjectSettings().getDraft());
+    hc.addCalculationType(hcSAC);
+    hc.setSACResolution(200);
+    QBENCHMARK {
+        hc.calculate();
+    }
+    QVERIFY(hc.getData().sac.size() > 0);
+}
+
+// a control point of a hull face, on the side and under water
+static SubdivisionControlPoint* submergedSidePoint(ShipCADModel& model, float draft)
+{
+    SubdivisionSurface* surface = model.getSurface();
+    float lowest = model.findLowestHydrostaticsPoint();
+    for (size_t i=0; i<surface->numberOfControlPoints(); i++) {
+        SubdivisionControlPoint* point = surface->getControlPoint(i);
+        QVector3D p = point->getCoordinate();
+        if (point->numberOfFaces() == 0 || p.y() < 0.1f
+                || p.z() < lowest + 0.1f * draft || p.z() > lowest + 0.5f * draft)
+            continue;
+        SubdivisionControlFace* face = static_cast<SubdivisionControlFace*>(point->getFace(0));
+        if (face->getLayer()->useInHydrostatics())
+            return point;
+    }
+    return 0;
+}
+
+void HydrostaticcalcTest::testLiveHydrostatics()
+{
+    LiveHydrostatics live(_model);
+    live.setDraft(0.5);
+    live.update();
+    const HydrostaticsData& data = live.getData();
+    QVERIFY(!live.hasError(feNothingSubmerged) && !live.hasError(feMakingWater));
+    QVERIFY(FuzzyCompare(data.volume, .5, 1E-3));
+    QVERIFY(FuzzyCompare(data.displacement, .5125, 1E-3));
+    QVERIFY(FuzzyCompare(data.waterplane_area, 1, 1E-3));
+    QVERIFY(FuzzyCompare(data.wetted_surface, 4, 1E-2));
+    QVERIFY(FuzzyCompare(data.center_of_buoyancy.x(), .5, 1E-3));
+    QVERIFY(FuzzyCompare(data.center_of_buoyancy.z(), .25, 1E-3));
+    QCOMPARE(live.getFacesIntegrated(), _model->getHydrostaticMesh().numberOfControlFaces());
+    // nothing changed, nothing to integrate
+    live.update();
+    QCOMPARE(live.getFacesIntegrated(), static_cast<size_t>(0));
+    QVERIFY(FuzzyCompare(live.getData().volume, .5, 1E-3));
+    // another waterline, all faces again
+    live.setDraft(0.25);
+    live.update();
+    QCOMPARE(live.getFacesIntegrated(), _model->getHydrostaticMesh().numberOfControlFaces());
+    QVERIFY(FuzzyCompare(live.getData().volume, .25, 1E-3));
+}
+
+void HydrostaticcalcTest::testLiveHydrostaticsDemoHull()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    float draft = model.getProjectSettings().getDraft();
+    LiveHydrostatics live(&model);
+    live.setDraft(draft);
+    live.update();
+    HydrostaticCalc hc(&model);
+    hc.setDraft(draft);
+    hc.calculateVolume(hc.getWlPlane());
+    QVERIFY(closeTo(live.getData().volume, hc.getData().volume, 1E-4));
+    QVERIFY(closeTo(live.getData().displacement, hc.getData().displacement, 1E-4));
+    QVERIFY(closeTo(live.getData().wetted_surface, hc.getData().wetted_surface, 1E-4));
+    QVERIFY(closeTo(live.getData().center_of_buoyancy.x(), hc.getData().center_of_buoyancy.x(), 1E-4));
+    QVERIFY(closeTo(live.getData().center_of_buoyancy.z(), hc.getData().center_of_buoyancy.z(), 1E-4));
+    float volume = live.getData().volume;
+
+    // move a point as Controller::movePoint does
+    SubdivisionControlPoint* point = submergedSidePoint(model, draft);
+    QVERIFY(point != 0);
+    point->setCoordinate(point->getCoordinate() * QVector3D(1, 1.05f, 1));
+    live.update();
+    QVERIFY(live.getFacesIntegrated() > 0);
+    QVERIFY(live.getFacesIntegrated() < model.getHydrostaticMesh().numberOfControlFaces());
+    QVERIFY(live.getData().volume > volume);
+    HydrostaticCalc moved(&model);
+    moved.setDraft(draft);
+    moved.calculateVolume(moved.getWlPlane());
+    QVERIFY(closeTo(live.getData().volume, moved.getData().volume, 1E-4));
+    QVERIFY(closeTo(live.getData().wetted_surface, moved.getData().wetted_surface, 1E-4));
+    QVERIFY(closeTo(live.getData().center_of_buoyancy.x(), moved.getData().center_of_buoyancy.x(), 1E-4));
+}
+
+void HydrostaticcalcTest::benchmarkCurves_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("curves");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 calculate").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 curves").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+// hydrostatics at 20 drafts up to 1.5 times the design draft
+void HydrostaticcalcTest::benchmarkCurves()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, curves);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    model.rebuildModel(false);
+    vector<float> drafts;
+    for (size_t i=1; i<=20; i++)
+        drafts.push_back(1.5f * model.getProjectSettings().getDraft() * i / 20);
+    float volume = 0;
+    QBENCHMARK {
+        if (curves) {
+            HydrostaticCurves table(&model);
+            table.calculate(drafts);
+            volume = table.getData(drafts.size() - 1).volume;
+        } else {
+            for (size_t i=0; i<drafts.size(); i++) {
+                HydrostaticCalc hc(&model);
+                hc.setDraft(drafts[i]);
+                hc.addCalculationType(hcWaterline);
+                hc.calculate();
+                volume = hc.getData().volume;
+            }
+        }
+    }
+    QVERIFY(volume >= 0);
+}
+
+void HydrostaticcalcTest::testBalance()
+{
+    HydrostaticCalc hc(_model);
+    CrosscurvesData output;
+    QVERIFY(hc.balance(0.5f * 1.025f, false, output));
+    QVERIFY(FuzzyCompare(output.absolute_draft, 0.5, 1E-3));
+    QVERIFY(FuzzyCompare(output.volume, 0.5, 1E-3));
+    QVERIFY(FuzzyCompare(output.kn_sin_phi, 0, 1E-5));
+    // the waterplane area is constant, so newton's method finds it at once
+    QVERIFY(hc.getBalanceVolumeEvaluations() <= 3);
+    QCOMPARE(hc.getBalanceTrimIterations(), 1);
+    // more than the box holds
+    QVERIFY(!hc.balance(5, false, output));
+    QVERIFY(hc.hasError(feNotEnoughBuoyancy));
+}
+
+void HydrostaticcalcTest::testBalanceFreeToTrim()
+{
+    HydrostaticCalc hc(_model);
+    CrosscurvesData output;
+    // above the center of buoyancy, so it floats level
+    hc.setCenterOfGravity(QVector3D(0.5f, 0, 0.25f));
+    QVERIFY(hc.balance(0.5f * 1.025f, true, output));
+    QVERIFY(FuzzyCompare(hc.getTrim(), 0, 1E-3));
+    QVERIFY(FuzzyCompare(output.volume, 0.5, 1E-3));
+    // forward, so the bow goes down, BML is 1/6
+    hc.setTrim(0);
+    hc.setCenterOfGravity(QVector3D(0.52f, 0, 0.25f));
+    QVERIFY(hc.balance(0.5f * 1.025f, true, output));
+    QVERIFY(closeTo(hc.getTrim(), 0.12f, 1E-3f));
+    QVERIFY(FuzzyCompare(output.volume, 0.5, 1E-3));
+    QVERIFY(hc.getBalanceTrimIterations() > 1);
+    QVERIFY(hc.getBalanceTrimIterations() <= 6);
+    // the trim is kept when not free to trim
+    float trim = hc.getTrim();
+    QVERIFY(hc.balance(0.4f * 1.025f, false, output));
+    QCOMPARE(hc.getTrim(), trim);
+}
+
+void HydrostaticcalcTest::testBalanceDemoHull()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    float draft = model.getProjectSettings().getDraft();
+    for (size_t i=1; i<=4; i++) {
+        HydrostaticCalc hc(&model);
+        hc.setDraft(draft * i / 3);
+        hc.calculateVolume(hc.getWlPlane());
+        float displacement = hc.getData().displacement;
+        float volume = hc.getData().volume;
+        CrosscurvesData output;
+        QVERIFY(hc.balance(displacement, false, output));
+        QVERIFY(closeTo(output.volume, volume, 1E-3));
+        // the volume at the deepest draft, then a few newton steps
+        QVERIFY(hc.getBalanceVolumeEvaluations() <= 6);
+    }
+}
+
+// the draft between two known drafts, as interpolated before the newton steps
+static float interpolateDraft(float displ, float displ1, float draft1, float displ2, float draft2)
+{
+    float result;
+    if (fabs(displ2 - displ1) < 1e-3)
+        result = 0.5f * (draft1 + draft2);
+    else
+        result = draft1 + (draft2 - draft1) * (displ - displ1) / (displ2 - displ1);
+    if (result < draft1 || result > draft2)
+        result = 0.5f * (draft1 + draft2);
+    return result;
+}
+
+// volume evaluations of the old balance, interpolating between the
+// drafts too shallow and too deep until the displacement is found
+static int interpolationEvaluations(ShipCADModel& model, float displacement)
+{
+    QVector3D min, max;
+    model.extents(min, max);
+    HydrostaticCalc hc(&model);
+    float min_draft = 0;
+    float min_displ = 0;
+    float max_draft = max.z() - model.findLowestHydrostaticsPoint();
+    hc.setDraft(max_draft);
+    hc.calculateVolume(hc.getWlPlane());
+    float max_displ = hc.getData().displacement;
+    int evaluations = 1;
+    float prev_error = 0;
+    float error;
+    float error_difference;
+    do {
+        float draft = interpolateDraft(displacement, min_displ, min_draft, max_displ, max_draft);
+        hc.setDraft(draft);
+        hc.calculateVolume(hc.getWlPlane());
+        evaluations++;
+        float displ = hc.getData().displacement;
+        error = fabs((displacement - displ) / displacement);
+        if (error > 5e-4f) {
+            if (displ < displacement) {
+                min_draft = draft;
+                min_displ = displ;
+            } else {
+                max_draft = draft;
+                max_displ = displ;
+            }
+        }
+        error_difference = fabs(error - prev_error);
+        prev_error = error;
+    } while (error >= 5e-4f && evaluations <= 26 && error_difference >= 1e-5f);
+    return evaluations;
+}
+
+void HydrostaticcalcTest::benchmarkBalanceEvaluations_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("newton");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 interpolation").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 newton").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+// volume evaluations to balance at a third of the design draft up to
+// a third above it, upright and on an even keel
+void HydrostaticcalcTest::benchmarkBalanceEvaluations()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, newton);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    model.getHydrostaticsCache().setMaxSize(0);
+    float draft = model.getProjectSettings().getDraft();
+    int evaluations = 0;
+    for (size_t i=1; i<=4; i++) {
+        HydrostaticCalc hc(&model);
+        hc.setDraft(draft * i / 3);
+        hc.calculateVolume(hc.getWlPlane());
+        float displacement = hc.getData().displacement;
+        if (newton) {
+            CrosscurvesData output;
+            QVERIFY(hc.balance(displacement, false, output));
+            evaluations += hc.getBalanceVolumeEvaluations();
+        } else {
+            evaluations += interpolationEvaluations(model, displacement);
+        }
+    }
+    QTest::setBenchmarkResult(evaluations, QTest::Events);
+}
+
+// KN of a wall sided hull, beam and length of 1, at a draft and heel
+static float boxKN(float draft, float heel)
+{
+    float phi = DegToRad(heel);
+    float bm = (1.0f / 12) / draft;
+    return sin(phi) * (0.5f * draft + bm + 0.5f * bm * tan(phi) * tan(phi));
+}
+
+void HydrostaticcalcTest::testCrossCurves()
+{
+    CrossCurves curves(_model);
+    vector<float> displacements;
+    displacements.push_back(0.4f * 1.025f);
+    displacements.push_back(0.5f * 1.025f);
+    displacements.push_back(5);
+    vector<float> angles;
+    angles.push_back(0);
+    angles.push_back(5);
+    angles.push_back(10);
+    curves.setDisplacements(displacements);
+    curves.setHeelingAngles(angles);
+    QVERIFY(!curves.isCalculated());
+    QVERIFY_EXCEPTION_THROWN(curves.getData(0, 0), out_of_range);
+    curves.calculate();
+    QVERIFY(curves.isCalculated());
+    for (size_t i=0; i<2; i++) {
+        for (size_t j=0; j<angles.size(); j++) {
+            QVERIFY(curves.isBalanced(i, j));
+            float draft = displacements[i] / 1.025f;
+            QVERIFY(FuzzyCompare(curves.getData(i, j).volume, draft, 1E-3));
+            QVERIFY(FuzzyCompare(curves.getData(i, j).kn_sin_phi, boxKN(draft, angles[j]), 2E-3));
+        }
+    }
+    for (size_t j=0; j<angles.size(); j++)
+        QVERIFY(!curves.isBalanced(2, j));
+    QVERIFY_EXCEPTION_THROWN(curves.getData(3, 0), out_of_range);
+
+    // the same one balance at a time, not from the cache
+    _model->getHydrostaticsCache().clear();
+    _model->getSurface()->setParallelSubdivision(false);
+    CrossCurves serial(_model);
+    serial.setDisplacements(displacements);
+    serial.setHeelingAngles(angles);
+    serial.calculate();
+    _model->getSurface()->setParallelSubdivision(true);
+    for (size_t i=0; i<displacements.size(); i++)
+        for (size_t j=0; j<angles.size(); j++)
+            QVERIFY(serial.getData(i, j).kn_sin_phi == curves.getData(i, j).kn_sin_phi);
+
+    QStringList strings;
+    curves.addData(strings, ' ');
+    QCOMPARE(strings.size(), 4 + static_cast<int>(displacements.size()) + 2);
+}
+
+void HydrostaticcalcTest::benchmarkCrossCurves_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("parallel");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 serial").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 parallel").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+// 10 displacements up to the design displacement, heeling angles to 70 degrees
+void HydrostaticcalcTest::benchmarkCrossCurves()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, parallel);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    model.getSurface()->setParallelSubdivision(parallel);
+    HydrostaticCalc hc(&model);
+    hc.setDraft(model.getProjectSettings().getDraft());
+    hc.calculateVolume(hc.getWlPlane());
+    vector<float> displacements;
+    for (size_t i=1; i<=10; i++)
+        displacements.push_back(hc.getData().displacement * i / 10);
+    vector<float> angles;
+    for (size_t i=0; i<15; i++)
+        angles.push_back(5.0f * i);
+    model.getHydrostaticsCache().setMaxSize(0);
+    CrossCurves curves(&model);
+    curves.setDisplacements(displacements);
+    curves.setHeelingAngles(angles);
+    QBENCHMARK {
+        curves.calculate();
+    }
+    QVERIFY(curves.isBalanced(9, 0));
+}
+
 QTEST_APPLESS_MAIN(HydrostaticcalcTest)
 
 #include "tst_hydrostaticcalctest.moc"
@@ -0,0 +1,273 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <QString>
+#include <QFile>
+#include <QtTest>
+#include <vector>
+
+#include "hydrostaticmesh.h"
+#include "hydrostaticcalc.h"
+#include "subdivsurface.h"
+#include "subdivface.h"
+#include "subdivedge.h"
+#include "subdivlayer.h"
+#include "subdivpoint.h"
+#include "shipcadmodel.h"
+#include "filebuffer.h"
+#include "../testutil.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+class HydrostaticMeshTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    HydrostaticMeshTest();
+
+private Q_SLOTS:
+    void testCaseBox();
+    void testCaseValid();
+    void testCaseRevision();
+    void testCaseUpdate();
+    void testCaseDemoHull();
+    void benchmarkCalculate_data();
+    void benchmarkCalculate();
+};
+
+HydrostaticMeshTest::HydrostaticMeshTest()
+{
+}
+
+// the mesh against the adaptive faces of the surface
+static bool sameAsSurface(const HydrostaticMesh& mesh, SubdivisionSurface* surface)
+{
+    size_t face = 0;
+    for (size_t i=0; i<surface->numberOfLayers(); i++) {
+        SubdivisionLayer* layer = surface->getLayer(i);
+        if (!layer->useInHydrostatics())
+            continue;
+        for (size_t j=0; j<layer->numberOfFaces(); j++) {
+            SubdivisionControlFace* ctrlface = layer->getFace(j);
+            for (size_t k=0; k<ctrlface->numberOfAdaptiveFaces(); k++) {
+                SubdivisionFace* child = ctrlface->getAdaptiveFace(k);
+                if (face >= mesh.numberOfFaces()
+                        || mesh.numberOfPoints(face) != child->numberOfPoints()
+                        || mesh.isSymmetric(face) != layer->isSymmetric())
+                    return false;
+                for (size_t l=0; l<child->numberOfPoints(); l++) {
+                    SubdivisionPoint* point = child->getPoint(l);
+                    size_t index = mesh.firstPoint(face) + l;
+                    bool leak = point->isBoundaryVertex() && fabs(point->getCoordinate().y()) > 1e-4;
+                    if (mesh.getPoint(index) != point->getCoordinate()
+                            || mesh.isLeakPoint(index) != leak)
+                        return false;
+                }
+                face++;
+            }
+        }
+    }
+    return face == mesh.numberOfFaces();
+}
+
+void HydrostaticMeshTest::testCaseBox()
+{
+    HydrostaticMesh empty;
+    QCOMPARE(empty.numberOfFaces(), static_cast<size_t>(0));
+    QCOMPARE(empty.numberOfPoints(), static_cast<size_t>(0));
+
+    ShipCADModel model;
+    makeBox(model);
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    const HydrostaticMesh& mesh = model.getHydrostaticMesh();
+    QVERIFY(mesh.numberOfFaces() >= 5);
+    QVERIFY(sameAsSurface(mesh, surface));
+    QCOMPARE(mesh.getLowestPoint(), model.findLowestHydrostaticsPoint());
+    // only the rim of the open top leaks
+    bool leaks = false;
+    for (size_t i=0; i<mesh.numberOfPoints(); i++) {
+        if (mesh.isLeakPoint(i)) {
+            leaks = true;
+            QCOMPARE(mesh.getPoint(i).z(), 1.0f);
+        }
+    }
+    QVERIFY(leaks);
+}
+
+void HydrostaticMeshTest::testCaseValid()
+{
+    ShipCADModel model;
+    makeBox(model);
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    HydrostaticMesh mesh;
+    QVERIFY(!mesh.isValid(*surface));
+    mesh.build(*surface, 0);
+    QVERIFY(mesh.isValid(*surface));
+    // layers not used in hydrostatics are left out
+    SubdivisionLayer* layer = surface->getLayer(0);
+    layer->setUseInHydrostatics(false);
+    QVERIFY(!mesh.isValid(*surface));
+    QCOMPARE(model.getHydrostaticMesh().numberOfFaces(), static_cast<size_t>(0));
+    layer->setUseInHydrostatics(true);
+    QVERIFY(mesh.isValid(*surface));
+    layer->setSymmetric(false);
+    QVERIFY(!mesh.isValid(*surface));
+    QVERIFY(!model.getHydrostaticMesh().isSymmetric(0));
+    layer->setSymmetric(true);
+    // a face moved to another layer
+    SubdivisionLayer* other = surface->addNewLayer();
+    QVERIFY(!mesh.isValid(*surface));
+    mesh.build(*surface, 0);
+    layer->getFace(0)->setLayer(other);
+    QVERIFY(!mesh.isValid(*surface));
+    // a rebuild may move the points
+    mesh.build(*surface, 0);
+    surface->setBuild(false);
+    QVERIFY(!mesh.isValid(*surface));
+    surface->rebuild();
+    QVERIFY(!mesh.isValid(*surface));
+    QVERIFY(sameAsSurface(model.getHydrostaticMesh(), surface));
+}
+
+void HydrostaticMeshTest::testCaseRevision()
+{
+    ShipCADModel model;
+    makeBox(model);
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    size_t revision = model.getHydrostaticMesh().getRevision();
+    // copied again, but the same faces
+    model.setBuild(false);
+    surface->rebuild();
+    QCOMPARE(model.getHydrostaticMesh().getRevision(), revision);
+    // not the same faces
+    SubdivisionLayer* layer = surface->getLayer(0);
+    layer->setUseInHydrostatics(false);
+    size_t removed = model.getHydrostaticMesh().getRevision();
+    QVERIFY(removed != revision);
+    layer->setUseInHydrostatics(true);
+    QVERIFY(model.getHydrostaticMesh().getRevision() != removed);
+    revision = model.getHydrostaticMesh().getRevision();
+    surface->getControlPoint(0)->setCoordinate(QVector3D(-.5, 0, 0));
+    model.setBuild(false);
+    surface->rebuild();
+    QVERIFY(model.getHydrostaticMesh().getRevision() != revision);
+}
+
+void HydrostaticMeshTest::testCaseDemoHull()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    const HydrostaticMesh& mesh = model.getHydrostaticMesh();
+    QVERIFY(sameAsSurface(mesh, surface));
+    // copied again after the subdivision changes
+    model.setPrecision(fpHigh);
+    surface->rebuild();
+    QVERIFY(sameAsSurface(model.getHydrostaticMesh(), surface));
+}
+
+// a control point of a hull face, on the side and under water
+static SubdivisionControlPoint* submergedSidePoint(ShipCADModel& model, float draft)
+{
+    SubdivisionSurface* surface = model.getSurface();
+    float lowest = model.findLowestHydrostaticsPoint();
+    for (size_t i=0; i<surface->numberOfControlPoints(); i++) {
+        SubdivisionControlPoint* point = surface->getControlPoint(i);
+        QVector3D p = point->getCoordinate();
+        if (point->numberOfFaces() == 0 || p.y() < 0.1f
+                || p.z() < lowest + 0.1f * draft || p.z() > lowest + 0.5f * draft)
+            continue;
+        SubdivisionControlFace* face = static_cast<SubdivisionControlFace*>(point->getFace(0));
+        if (face->getLayer()->useInHydrostatics())
+            return point;
+    }
+    return 0;
+}
+
+void HydrostaticMeshTest::testCaseUpdate()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    const HydrostaticMesh& mesh = model.getHydrostaticMesh();
+    size_t revision = mesh.getRevision();
+    SubdivisionControlPoint* point = submergedSidePoint(model, model.getProjectSettings().getDraft());
+    QVERIFY(point != 0);
+    point->setCoordinate(point->getCoordinate() * QVector3D(1, 1.05f, 1));
+    surface->rebuild();
+    QVERIFY(sameAsSurface(model.getHydrostaticMesh(), surface));
+    QCOMPARE(mesh.getRevision(), revision + 1);
+    // only the faces around the point changed
+    size_t changed = 0;
+    for (size_t i=0; i<mesh.numberOfControlFaces(); i++) {
+        QVERIFY(mesh.firstFace(i) <= mesh.lastFace(i));
+        if (mesh.getControlFaceRevision(i) == mesh.getRevision())
+            changed++;
+    }
+    QVERIFY(changed > 0);
+    QVERIFY(changed < mesh.numberOfControlFaces());
+    QCOMPARE(mesh.lastFace(mesh.numberOfControlFaces() - 1), mesh.numberOfFaces());
+}
+
+void HydrostaticMeshTest::benchmarkCalculate_data()
+{
+    QTest::addColumn<QString>("filename");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i)
+        QTest::newRow(hulls[i]) << QString(hulls[i]);
+}
+
+// volumes at 20 drafts, each going through the faces
+void HydrostaticMeshTest::benchmarkCalculate()
+{
+    QFETCH(QString, filename);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    model.getSurface()->rebuild();
+    float draft = model.getProjectSettings().getDraft();
+    HydrostaticCalc hc(&model);
+    float volume = 0;
+    QBENCHMARK {
+        for (size_t i=1; i<=20; i++) {
+            hc.setDraft(draft * i / 10);
+            hc.calculateVolume(hc.getWlPlane());
+            // the deepest drafts may be making water, which has no volume
+            if (hc.getData().volume > volume)
+                volume = hc.getData().volume;
+        }
+    }
+    QVERIFY(volume > 0);
+}
+
+QTEST_APPLESS_MAIN(HydrostaticMeshTest)
+
+#include "tst_hydrostaticmeshtest.moc"
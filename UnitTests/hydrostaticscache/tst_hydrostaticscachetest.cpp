@@ -0,0 +1,241 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <QString>
+#include <QtTest>
+#include <vector>
+
+#include "hydrostaticscache.h"
+#include "hydrostaticcalc.h"
+#include "subdivsurface.h"
+#include "subdivface.h"
+#include "subdivedge.h"
+#include "subdivlayer.h"
+#include "subdivpoint.h"
+#include "shipcadmodel.h"
+#include "projsettings.h"
+#include "utility.h"
+#include "../testutil.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+class HydrostaticsCacheTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    HydrostaticsCacheTest();
+
+private Q_SLOTS:
+    void testCaseFind();
+    void testCaseSize();
+    void testCaseCalculate();
+    void testCaseBalance();
+};
+
+HydrostaticsCacheTest::HydrostaticsCacheTest()
+{
+}
+
+static HydrostaticsCalculationKey makeKey(size_t revision, float draft)
+{
+    HydrostaticsCalculationKey key;
+    key.revision = revision;
+    key.draft = draft;
+    key.calculations.push_back(hcAll);
+    return key;
+}
+
+static HydrostaticsData makeData(float volume)
+{
+    HydrostaticsData data;
+    data.clear();
+    data.volume = volume;
+    return data;
+}
+
+// the box of makeBox, and a deck above it on a layer not used in
+// hydrostatics
+static void makeBoxWithDeck(ShipCADModel& model)
+{
+    ProjectSettings& ps = model.getProjectSettings();
+    ps.setLength(1.0);
+    ps.setBeam(1.0);
+    ps.setDraft(0.5);
+    makeBox(model);
+    SubdivisionSurface* s = model.getSurface();
+    vector<QVector3D> deck;
+    deck.push_back(QVector3D(0,0,2));
+    deck.push_back(QVector3D(1,0,2));
+    deck.push_back(QVector3D(1,.5,2));
+    deck.push_back(QVector3D(0,.5,2));
+    SubdivisionControlFace* face = s->addControlFace(deck);
+    SubdivisionLayer* layer = s->addNewLayer();
+    layer->setUseInHydrostatics(false);
+    face->setLayer(layer);
+    for (size_t i=0; i<s->numberOfControlEdges(); i++)
+        s->getControlEdge(i)->setCrease(true);
+}
+
+static SubdivisionControlPoint* findPoint(ShipCADModel& model, const QVector3D& coord)
+{
+    SubdivisionSurface* s = model.getSurface();
+    for (size_t i=0; i<s->numberOfControlPoints(); i++)
+        if (s->getControlPoint(i)->getCoordinate() == coord)
+            return s->getControlPoint(i);
+    return 0;
+}
+
+void HydrostaticsCacheTest::testCaseFind()
+{
+    HydrostaticsCache cache;
+    HydrostaticsData data;
+    vector<hydrostatics_error_t> errors;
+    QVERIFY(!cache.findCalculation(makeKey(1, .5f), data, errors));
+    vector<hydrostatics_error_t> leaking;
+    leaking.push_back(feMakingWater);
+    cache.addCalculation(makeKey(1, .5f), makeData(2), leaking);
+    QVERIFY(cache.findCalculation(makeKey(1, .5f), data, errors));
+    QCOMPARE(data.volume, 2.0f);
+    QVERIFY(errors == leaking);
+    // any difference in the key is another calculation
+    QVERIFY(!cache.findCalculation(makeKey(1, .6f), data, errors));
+    HydrostaticsCalculationKey key = makeKey(1, .5f);
+    key.calculations.push_back(hcSAC);
+    QVERIFY(!cache.findCalculation(key, data, errors));
+    key = makeKey(1, .5f);
+    key.settings.water_density = 1.0f;
+    QVERIFY(!cache.findCalculation(key, data, errors));
+    QCOMPARE(cache.getHits(), static_cast<size_t>(1));
+    QCOMPARE(cache.getMisses(), static_cast<size_t>(4));
+    // a new revision drops the results of the old one
+    cache.addCalculation(makeKey(2, .5f), makeData(3), errors);
+    QCOMPARE(cache.size(), static_cast<size_t>(1));
+    QVERIFY(!cache.findCalculation(makeKey(1, .5f), data, errors));
+    cache.resetCounters();
+    QCOMPARE(cache.getHits(), static_cast<size_t>(0));
+    QCOMPARE(cache.getMisses(), static_cast<size_t>(0));
+}
+
+void HydrostaticsCacheTest::testCaseSize()
+{
+    HydrostaticsCache cache(3);
+    HydrostaticsData data;
+    vector<hydrostatics_error_t> errors;
+    for (size_t i=0; i<3; i++)
+        cache.addCalculation(makeKey(1, i), makeData(i), errors);
+    HydrostaticsBalanceKey balance;
+    balance.revision = 1;
+    HydrostaticsBalanceResult result;
+    result.balanced = true;
+    result.trim = 0;
+    QVERIFY(cache.findCalculation(makeKey(1, 0), data, errors));
+    // the one used longest ago goes
+    cache.addBalance(balance, result);
+    QCOMPARE(cache.size(), static_cast<size_t>(3));
+    QVERIFY(cache.findBalance(balance, result));
+    QVERIFY(cache.findCalculation(makeKey(1, 0), data, errors));
+    QVERIFY(!cache.findCalculation(makeKey(1, 1), data, errors));
+    QVERIFY(cache.findCalculation(makeKey(1, 2), data, errors));
+    cache.setMaxSize(1);
+    QCOMPARE(cache.size(), static_cast<size_t>(1));
+    QVERIFY(cache.findCalculation(makeKey(1, 2), data, errors));
+    // keeps nothing
+    cache.setMaxSize(0);
+    cache.addCalculation(makeKey(1, 5), makeData(5), errors);
+    QCOMPARE(cache.size(), static_cast<size_t>(0));
+}
+
+void HydrostaticsCacheTest::testCaseCalculate()
+{
+    ShipCADModel model;
+    makeBoxWithDeck(model);
+    HydrostaticsCache& cache = model.getHydrostaticsCache();
+    HydrostaticCalc hc(&model);
+    hc.setDraft(0.5);
+    hc.addCalculationType(hcAll);
+    hc.calculate();
+    float volume = hc.getData().volume;
+    QVERIFY(FuzzyCompare(volume, 0.5, 1E-3));
+    QCOMPARE(cache.getMisses(), static_cast<size_t>(1));
+    HydrostaticCalc other(&model);
+    other.setDraft(0.5);
+    other.addCalculationType(hcAll);
+    other.calculate();
+    QCOMPARE(cache.getHits(), static_cast<size_t>(1));
+    QCOMPARE(other.getData().volume, volume);
+    QCOMPARE(other.getData().waterplane_area, hc.getData().waterplane_area);
+    // moving the deck leaves the hydrostatics as they were
+    size_t revision = model.getHydrostaticMesh().getRevision();
+    findPoint(model, QVector3D(0,0,2))->setCoordinate(QVector3D(0,0,2.5));
+    model.setBuild(false);
+    other.calculate();
+    QCOMPARE(cache.getHits(), static_cast<size_t>(2));
+    QCOMPARE(model.getHydrostaticMesh().getRevision(), revision);
+    // moving the hull does not
+    findPoint(model, QVector3D(1,.5,0))->setCoordinate(QVector3D(1.5,.5,0));
+    model.setBuild(false);
+    other.calculate();
+    QCOMPARE(cache.getMisses(), static_cast<size_t>(2));
+    QVERIFY(model.getHydrostaticMesh().getRevision() != revision);
+    QVERIFY(other.getData().volume > volume);
+    // nor does a setting
+    model.getProjectSettings().setLength(2.0);
+    other.calculate();
+    QCOMPARE(cache.getMisses(), static_cast<size_t>(3));
+}
+
+void HydrostaticsCacheTest::testCaseBalance()
+{
+    ShipCADModel model;
+    makeBoxWithDeck(model);
+    HydrostaticsCache& cache = model.getHydrostaticsCache();
+    HydrostaticCalc hc(&model);
+    CrosscurvesData output;
+    QVERIFY(hc.balance(0.5f * 1.025f, false, output));
+    QVERIFY(hc.getBalanceVolumeEvaluations() > 0);
+    float draft = output.absolute_draft;
+    QVERIFY(hc.balance(0.5f * 1.025f, false, output));
+    QCOMPARE(hc.getBalanceVolumeEvaluations(), 0);
+    QCOMPARE(output.absolute_draft, draft);
+    QCOMPARE(cache.getHits(), static_cast<size_t>(1));
+    // cross curves at the same heel and displacement balance the same
+    CrossCurves curves(&model);
+    vector<float> displacements;
+    displacements.push_back(0.5f * 1.025f);
+    displacements.push_back(0.4f * 1.025f);
+    vector<float> angles;
+    angles.push_back(0);
+    curves.setDisplacements(displacements);
+    curves.setHeelingAngles(angles);
+    curves.calculate();
+    QCOMPARE(cache.getHits(), static_cast<size_t>(2));
+    QCOMPARE(curves.getData(0, 0).absolute_draft, draft);
+    curves.calculate();
+    QCOMPARE(cache.getHits(), static_cast<size_t>(4));
+    // free to trim the center of gravity is part of the balance
+    hc.setCenterOfGravity(QVector3D(0.5f, 0, 0.25f));
+    QVERIFY(hc.balance(0.5f * 1.025f, true, output));
+    QCOMPARE(cache.getHits(), static_cast<size_t>(4));
+}
+
+QTEST_APPLESS_MAIN(HydrostaticsCacheTest)
+
+#include "tst_hydrostaticscachetest.moc"
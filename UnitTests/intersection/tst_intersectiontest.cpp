@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include <QString>
 #include <QtTest>
@@ -8,11 +9,13 @@
 #include "shipcadlib.h"
 #include "shipcadmodel.h"
 #include "subdivsurface.h"
+#include "subdivpoint.h"
 #include "subdivface.h"
 #include "subdivedge.h"
 #include "projsettings.h"
 #include "utility.h"
 #include "filebuffer.h"
+#include "../testutil.h"
 
 using namespace ShipCAD;
 using namespace std;
@@ -30,8 +33,21 @@ private Q_SLOTS:
     void testConstructWL();
     void testConstructSta();
     void testArea();
+    void testAreaHeeled();
+    void testAreaDemoHull();
+    void benchmarkStationAreas_data();
+    void benchmarkStationAreas();
     void testDXF();
     void testWriteRead();
+    void testIntersectPlanes();
+    void testChainSegments();
+    void testFaceIndexAfterMove();
+    void testRebuildIntersections();
+    void benchmarkLinesPlan_data();
+    void benchmarkLinesPlan();
+    void testParallelRebuild();
+    void benchmarkRebuildIntersections_data();
+    void benchmarkRebuildIntersections();
 };
 
 IntersectionTest::IntersectionTest()
@@ -181,6 +197,39 @@ void IntersectionTest::testArea()
     QVERIFY(FuzzyCompare(cog.z(),.25,1E-2));
 }
 
+void IntersectionTest::testAreaHeeled()
+{
+    Plane xhalfcube(1,0,0,-.5);
+    float heel = DegToRad(10.0f);
+    float t = tan(heel);
+    // deeper on the positive side
+    Plane wl(0, -sin(heel), cos(heel), -0.5f * cos(heel));
+
+    float area;
+    QVector3D cog;
+    QVector2D moi;
+
+    Intersection i(_model, fiStation, xhalfcube, true);
+    i.calculateArea(wl, &area, &cog, &moi);
+    QVERIFY(FuzzyCompare(area, 0.5, 1E-4));
+    QVERIFY(FuzzyCompare(cog.x(), .5, 1E-4));
+    QVERIFY(FuzzyCompare(cog.y(), t / 6, 1E-4));
+    QVERIFY(FuzzyCompare(cog.z(), .25 + t * t / 12, 1E-4));
+
+    // level, along the splines comes close
+    Plane level(0,0,1,-0.5);
+    float spline_area;
+    QVector3D spline_cog;
+    Intersection i1(_model, fiStation, xhalfcube, true);
+    i1.calculateArea(level, &area, &cog, &moi);
+    Intersection i2(_model, fiStation, xhalfcube, true);
+    i2.calculateSplineArea(level, &spline_area, &spline_cog, &moi);
+    QVERIFY(FuzzyCompare(area, 0.5, 1E-4));
+    QVERIFY(FuzzyCompare(cog.z(), .25, 1E-4));
+    QVERIFY(FuzzyCompare(spline_area, area, 1E-2));
+    QVERIFY(FuzzyCompare(spline_cog.z(), cog.z(), 1E-2));
+}
+
 void IntersectionTest::testDXF()
 {
     Plane wlhalfcube(0,0,1,-0.5);
@@ -240,6 +289,466 @@ void IntersectionTest::testWriteRead()
     }
 }
 
+// planes evenly spaced through the surface along one axis
+static void linesPlanPlanes(SubdivisionSurface* surface, int axis, size_t n, vector<Plane>& planes)
+{
+    QVector3D min, max;
+    surface->extents(min, max);
+    planes.clear();
+    for (size_t i=0; i<n; ++i) {
+        QVector3D normal(0, 0, 0);
+        normal[axis] = 1;
+        float pos = min[axis] + (i + 0.5f) * (max[axis] - min[axis]) / n;
+        planes.push_back(Plane(normal.x(), normal.y(), normal.z(), -pos));
+    }
+}
+
+// station areas against the steps along the splines
+void IntersectionTest::testAreaDemoHull()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    model.rebuildModel(true);
+    SubdivisionSurface* surface = model.getSurface();
+    float draft = model.getProjectSettings().getDraft();
+    Plane wl(0, 0, 1, -(model.findLowestHydrostaticsPoint() + draft));
+    vector<Plane> planes;
+    linesPlanPlanes(surface, 0, 20, planes);
+    vector<float> areas, spline_areas;
+    vector<float> heights, spline_heights;
+    float largest = 0;
+    for (size_t i=0; i<planes.size(); ++i) {
+        float area;
+        QVector3D cog;
+        QVector2D moi;
+        Intersection exact(&model, fiStation, planes[i], true);
+        exact.calculateArea(wl, &area, &cog, &moi);
+        areas.push_back(area);
+        heights.push_back(cog.z());
+        Intersection stepped(&model, fiStation, planes[i], true);
+        stepped.calculateSplineArea(wl, &area, &cog, &moi);
+        spline_areas.push_back(area);
+        spline_heights.push_back(cog.z());
+        largest = max(largest, area);
+    }
+    QVERIFY(largest > 0);
+    for (size_t i=0; i<areas.size(); ++i) {
+        QVERIFY(FuzzyCompare(areas[i], spline_areas[i], 0.02 * largest));
+        if (areas[i] > 0.1 * largest)
+            QVERIFY(FuzzyCompare(heights[i], spline_heights[i], 0.02 * draft));
+    }
+}
+
+void IntersectionTest::benchmarkStationAreas_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("along_splines");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 splines").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+        QTest::newRow(QString("%1 polygons").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+    }
+}
+
+// the areas of 20 stations, as for the sectional area curve
+void IntersectionTest::benchmarkStationAreas()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, along_splines);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    model.rebuildModel(true);
+    SubdivisionSurface* surface = model.getSurface();
+    float draft = model.getProjectSettings().getDraft();
+    Plane wl(0, 0, 1, -(model.findLowestHydrostaticsPoint() + draft));
+    vector<Plane> planes;
+    linesPlanPlanes(surface, 0, 20, planes);
+    float total = 0;
+    QBENCHMARK {
+        total = 0;
+        for (size_t i=0; i<planes.size(); ++i) {
+            float area;
+            QVector3D cog;
+            QVector2D moi;
+            Intersection station(&model, fiStation, planes[i], true);
+            if (along_splines)
+                station.calculateSplineArea(wl, &area, &cog, &moi);
+            else
+                station.calculateArea(wl, &area, &cog, &moi);
+            total += area;
+        }
+    }
+    QVERIFY(total > 0);
+}
+
+void IntersectionTest::testIntersectPlanes()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    size_t cut = 0;
+    for (int axis=0; axis<3; ++axis) {
+        vector<Plane> planes;
+        linesPlanPlanes(surface, axis, 40, planes);
+        // a plane outside the hull and one twice
+        planes.push_back(Plane(axis == 0, axis == 1, axis == 2, 1000.0f));
+        Plane twice = planes[3];
+        planes.push_back(twice);
+        for (int hydrostatics=0; hydrostatics<2; ++hydrostatics) {
+            vector<SplineVector*> batched;
+            for (size_t i=0; i<planes.size(); ++i)
+                batched.push_back(new SplineVector(true));
+            surface->intersectPlanes(planes, hydrostatics != 0, batched);
+            for (size_t i=0; i<planes.size(); ++i) {
+                SplineVector single(true);
+                surface->intersectPlane(planes[i], hydrostatics != 0, single);
+                QVERIFY2(sameSplines(single, *batched[i]),
+                         "batched intersection sb same as one plane at a time");
+                if (single.size() > 0)
+                    ++cut;
+                delete batched[i];
+            }
+        }
+    }
+    QVERIFY(cut > 150);
+
+    vector<Plane> skew;
+    skew.push_back(Plane(1, 0, 0, 0));
+    skew.push_back(Plane(0, 1, 0, 0));
+    vector<SplineVector*> dest(2, static_cast<SplineVector*>(0));
+    QVERIFY_EXCEPTION_THROWN(surface->intersectPlanes(skew, false, dest), invalid_argument);
+}
+
+// the chaining from before the end point grid, which tried all the
+// segments left after every join
+static void oldChainSegments(IntersectionSegments& segments, SplineVector& destination)
+{
+    bool addedge = false;
+    Spline* spline = 0;
+    SurfIntersectionData startp, endp;
+    pair<SurfIntersectionData, SurfIntersectionData> segment;
+    while (segments.size() > 0) {
+        if (spline == 0) {
+            spline = new Spline();
+            destination.add(spline);
+            segment = segments.back();
+            spline->add(segment.first.point);
+            spline->setKnuckle(0, segment.first.knuckle);
+            spline->add(segment.second.point);
+            spline->setKnuckle(1, segment.second.knuckle);
+            startp = segment.first;
+            endp = segment.second;
+            segments.pop_back();
+        }
+        addedge = false;
+        size_t j = 0;
+        while (j < segments.size()) {
+            segment = segments[j];
+            bool append = false;
+            bool reverse = false;
+            if (endp.edge == segment.first.edge) {
+                addedge = endp.point.distanceToPoint(segment.first.point) < 1E-4;
+                append = true;
+            }
+            else if (endp.edge == segment.second.edge) {
+                addedge = endp.point.distanceToPoint(segment.second.point) < 1E-4;
+                append = reverse = true;
+            }
+            else if (startp.edge == segment.first.edge) {
+                addedge = startp.point.distanceToPoint(segment.first.point) < 1E-4;
+            }
+            else if (startp.edge == segment.second.edge) {
+                addedge = startp.point.distanceToPoint(segment.second.point) < 1E-4;
+                reverse = true;
+            }
+            else if (segment.first.edge == segment.second.edge) {
+                // edge lies entirely in the plane
+                if (startp.edge->startPoint()->hasEdge(segment.first.edge)
+                        || startp.edge->endPoint()->hasEdge(segment.first.edge)
+                        || endp.edge->startPoint()->hasEdge(segment.first.edge)
+                        || endp.edge->endPoint()->hasEdge(segment.first.edge)) {
+                    if (endp.point.distanceToPoint(segment.first.point) < 1E-4)
+                        addedge = append = true;
+                    else if (endp.point.distanceToPoint(segment.second.point) < 1E-4)
+                        addedge = append = reverse = true;
+                    else if (startp.point.distanceToPoint(segment.first.point) < 1E-4)
+                        addedge = true;
+                    else if (startp.point.distanceToPoint(segment.second.point) < 1E-4)
+                        addedge = reverse = true;
+                }
+            }
+            if (addedge) {
+                const SurfIntersectionData& near = reverse ? segment.second : segment.first;
+                const SurfIntersectionData& far = reverse ? segment.first : segment.second;
+                if (append) {
+                    size_t last = spline->numberOfPoints() - 1;
+                    spline->setKnuckle(last, near.knuckle || spline->isKnuckle(last));
+                    spline->add(far.point);
+                    spline->setKnuckle(last + 1, far.knuckle);
+                    endp = far;
+                }
+                else {
+                    spline->setKnuckle(0, near.knuckle || spline->isKnuckle(0));
+                    spline->insert(0, far.point);
+                    spline->setKnuckle(0, far.knuckle);
+                    startp = far;
+                }
+                segments.erase(segments.begin() + j);
+                j = 0;
+                addedge = false;
+            }
+            else
+                ++j;
+        }
+        spline = 0;
+    }
+    if (destination.size() > 1) {
+        JoinSplineSegments(0.01f, false, destination);
+        for (size_t i=destination.size(); i>=1; --i) {
+            // remove tiny fragments of very small length
+            spline = destination.get(i-1);
+            if (spline->numberOfPoints() > 1
+                    && SquaredDistPP(spline->getMin(), spline->getMax()) < 1E-3)
+                destination.del(spline);
+        }
+    }
+}
+
+// the polylines chained through the end point grid against the old chaining
+void IntersectionTest::testChainSegments()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    vector<SubdivisionControlFace*> faces;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i)
+        faces.push_back(surface->getControlFace(i));
+    size_t chained = 0;
+    for (int axis=0; axis<3; ++axis) {
+        vector<Plane> planes;
+        linesPlanPlanes(surface, axis, 40, planes);
+        for (size_t i=0; i<planes.size(); ++i) {
+            IntersectionSegments segments;
+            surface->intersectionSegments(planes[i], faces, segments);
+            IntersectionSegments copy(segments);
+            SplineVector grid(true);
+            SubdivisionSurface::chainSegments(segments, grid);
+            QVERIFY(segments.empty());
+            SplineVector old(true);
+            oldChainSegments(copy, old);
+            QVERIFY2(sameSplines(grid, old), "chained sb same as the old chaining");
+            chained += grid.size();
+        }
+    }
+    QVERIFY(chained > 100);
+}
+
+void IntersectionTest::testFaceIndexAfterMove()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+    surface->setBuild(false);
+    surface->rebuild();
+    vector<Plane> planes;
+    linesPlanPlanes(surface, 0, 40, planes);
+    // makes the face index
+    SplineVector first(true);
+    surface->intersectPlane(planes[planes.size() / 2], false, first);
+
+    // a local rebuild changes the extents of the faces around the point
+    SubdivisionControlPoint* pt = surface->getControlPoint(surface->numberOfControlPoints() / 2);
+    pt->setCoordinate(pt->getCoordinate() + QVector3D(0.5f, 0, 0.2f));
+    vector<SplineVector*> local;
+    for (size_t i=0; i<planes.size(); ++i) {
+        local.push_back(new SplineVector(true));
+        surface->intersectPlane(planes[i], false, *local.back());
+        if (i == 0)
+            QVERIFY(surface->isLocalRebuild());
+    }
+    surface->setBuild(false);
+    surface->rebuild();
+    for (size_t i=0; i<planes.size(); ++i) {
+        SplineVector full(true);
+        surface->intersectPlane(planes[i], false, full);
+        QVERIFY2(sameSplines(full, *local[i]), "cut after a local rebuild sb same as after a full one");
+        delete local[i];
+    }
+}
+
+void IntersectionTest::testRebuildIntersections()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    model.rebuildModel(true);
+    IntersectionVector* lists[] = {
+        &model.getStations(), &model.getButtocks(), &model.getWaterlines(), &model.getDiagonals()
+    };
+    size_t n = 0;
+    for (size_t i=0; i<4; ++i) {
+        for (size_t j=0; j<lists[i]->size(); ++j) {
+            Intersection* intersection = lists[i]->get(j);
+            QVERIFY(intersection->isBuild());
+            SplineVector batched(true);
+            for (size_t k=0; k<intersection->getSplines().size(); ++k)
+                batched.add(new Spline(*intersection->getSplines().get(k)));
+            intersection->rebuild();
+            QVERIFY2(sameSplines(batched, intersection->getSplines()),
+                     "batched rebuild sb same as rebuilding one intersection");
+            ++n;
+        }
+    }
+    QVERIFY(n > 0);
+}
+
+void IntersectionTest::benchmarkLinesPlan_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("batched");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 per plane").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 batched").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+// 60 stations, 20 waterlines and 15 buttocks
+void IntersectionTest::benchmarkLinesPlan()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, batched);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    vector<vector<Plane> > families(3);
+    linesPlanPlanes(surface, 0, 60, families[0]);
+    linesPlanPlanes(surface, 2, 20, families[1]);
+    linesPlanPlanes(surface, 1, 15, families[2]);
+    size_t curves = 0;
+    QBENCHMARK {
+        curves = 0;
+        for (size_t f=0; f<families.size(); ++f) {
+            vector<SplineVector*> dest;
+            for (size_t i=0; i<families[f].size(); ++i)
+                dest.push_back(new SplineVector(true));
+            if (batched)
+                surface->intersectPlanes(families[f], false, dest);
+            else
+                for (size_t i=0; i<families[f].size(); ++i)
+                    surface->intersectPlane(families[f][i], false, *dest[i]);
+            for (size_t i=0; i<dest.size(); ++i) {
+                curves += dest[i]->size();
+                delete dest[i];
+            }
+        }
+    }
+    QVERIFY(curves > 0);
+}
+
+// 60 stations, 20 waterlines and 15 buttocks
+static void addLinesPlan(ShipCADModel& model)
+{
+    QVector3D min, max;
+    model.getSurface()->extents(min, max);
+    for (size_t i=0; i<60; ++i)
+        model.createIntersection(fiStation, min.x() + (i + 0.5f) * (max.x() - min.x()) / 60);
+    for (size_t i=0; i<20; ++i)
+        model.createIntersection(fiWaterline, min.z() + (i + 0.5f) * (max.z() - min.z()) / 20);
+    for (size_t i=0; i<15; ++i)
+        model.createIntersection(fiButtock, (i + 0.5f) * max.y() / 15);
+}
+
+// copies of the curves of all intersections
+static void copyIntersections(ShipCADModel& model, vector<SplineVector*>& copies)
+{
+    IntersectionVector* lists[] = {
+        &model.getStations(), &model.getButtocks(), &model.getWaterlines(), &model.getDiagonals()
+    };
+    for (size_t i=0; i<4; ++i) {
+        for (size_t j=0; j<lists[i]->size(); ++j) {
+            SplineVector& splines = lists[i]->get(j)->getSplines();
+            copies.push_back(new SplineVector(true));
+            for (size_t k=0; k<splines.size(); ++k)
+                copies.back()->add(new Spline(*splines.get(k)));
+        }
+    }
+}
+
+void IntersectionTest::testParallelRebuild()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    addLinesPlan(model);
+    SubdivisionSurface* surface = model.getSurface();
+
+    surface->setParallelSubdivision(false);
+    model.rebuildModel(true);
+    vector<SplineVector*> serial;
+    copyIntersections(model, serial);
+    QVERIFY(serial.size() > 50);
+
+    surface->setParallelSubdivision(true);
+    model.rebuildModel(true);
+    vector<SplineVector*> parallel;
+    copyIntersections(model, parallel);
+    QCOMPARE(parallel.size(), serial.size());
+    for (size_t i=0; i<serial.size(); ++i) {
+        QVERIFY2(sameSplines(*serial[i], *parallel[i]),
+                 "parallel rebuild sb same as serial");
+        delete serial[i];
+        delete parallel[i];
+    }
+}
+
+void IntersectionTest::benchmarkRebuildIntersections_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("parallel");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 serial").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 parallel").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+void IntersectionTest::benchmarkRebuildIntersections()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, parallel);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    addLinesPlan(model);
+    model.getSurface()->setParallelSubdivision(parallel);
+    model.rebuildModel(false);
+    QBENCHMARK {
+        model.controlPointsMoved();
+        model.rebuildIntersections();
+    }
+    QVERIFY(model.getStations().size() > 0);
+}
+
 QTEST_APPLESS_MAIN(IntersectionTest)
 
 #include "tst_intersectiontest.moc"
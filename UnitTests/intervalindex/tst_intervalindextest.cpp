@@ -0,0 +1,227 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <QString>
+#include <QFile>
+#include <QtTest>
+#include <vector>
+#include <random>
+#include <stdexcept>
+
+#include "intervalindex.h"
+#include "subdivsurface.h"
+#include "subdivface.h"
+#include "subdivlayer.h"
+#include "shipcadmodel.h"
+#include "filebuffer.h"
+#include "plane.h"
+#include "../testutil.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+class IntervalIndexTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    IntervalIndexTest();
+
+private Q_SLOTS:
+    void testCaseEmpty();
+    void testCaseQuery();
+    void testCaseSurfacePlanes();
+    void testCaseFaceMoved();
+    void benchmarkQuery_data();
+    void benchmarkQuery();
+};
+
+IntervalIndexTest::IntervalIndexTest()
+{
+}
+
+static void randomIntervals(mt19937& gen, size_t n, vector<float>& lo, vector<float>& hi)
+{
+    uniform_real_distribution<float> start(-10.0f, 10.0f);
+    uniform_real_distribution<float> length(0.0f, 2.0f);
+    lo.resize(n);
+    hi.resize(n);
+    for (size_t i=0; i<n; ++i) {
+        lo[i] = start(gen);
+        hi[i] = lo[i] + length(gen);
+    }
+}
+
+static void scanIntervals(const vector<float>& lo, const vector<float>& hi,
+                          float qlo, float qhi, vector<size_t>& items)
+{
+    items.clear();
+    for (size_t i=0; i<lo.size(); ++i)
+        if (lo[i] <= qhi && hi[i] >= qlo)
+            items.push_back(i);
+}
+
+void IntervalIndexTest::testCaseEmpty()
+{
+    IntervalIndex index;
+    vector<float> none;
+    index.build(none, none);
+    vector<size_t> items;
+    index.query(-1, 1, items);
+    QVERIFY(items.empty());
+    vector<float> one(1, 0.0f);
+    QVERIFY_EXCEPTION_THROWN(index.build(one, none), invalid_argument);
+    index.build(one, one);
+    index.query(0, 0, items);
+    QCOMPARE(items.size(), static_cast<size_t>(1));
+}
+
+void IntervalIndexTest::testCaseQuery()
+{
+    mt19937 gen(5);
+    uniform_real_distribution<float> where(-12.0f, 12.0f);
+    // sizes either side of a power of 2
+    const size_t sizes[] = { 2, 3, 63, 64, 65, 1000 };
+    for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        vector<float> lo, hi;
+        randomIntervals(gen, sizes[s], lo, hi);
+        IntervalIndex index;
+        index.build(lo, hi);
+        QCOMPARE(index.numberOfItems(), sizes[s]);
+        vector<size_t> found, expected;
+        for (size_t i=0; i<200; ++i) {
+            float q = where(gen);
+            float width = (i % 2 == 0) ? 0 : 0.5f;
+            index.query(q, q + width, found);
+            scanIntervals(lo, hi, q, q + width, expected);
+            QVERIFY2(found == expected, "index sb same as scanning all intervals");
+        }
+        // the ends of an interval are inside it
+        index.query(hi[0], hi[0], found);
+        QVERIFY(find(found.begin(), found.end(), 0) != found.end());
+        index.query(lo[0], lo[0], found);
+        QVERIFY(find(found.begin(), found.end(), 0) != found.end());
+    }
+}
+
+// intersectPlane through the index against intersectPlanes, which goes
+// through all the control faces
+static bool sameAsAllFaces(SubdivisionSurface* surface, const Plane& plane)
+{
+    SplineVector indexed(true);
+    surface->intersectPlane(plane, false, indexed);
+    vector<Plane> planes(1, plane);
+    vector<SplineVector*> dest(1, new SplineVector(true));
+    surface->intersectPlanes(planes, false, dest);
+    bool same = sameSplines(indexed, *dest[0]);
+    delete dest[0];
+    return same;
+}
+
+void IntervalIndexTest::testCaseSurfacePlanes()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    QVector3D min = surface->getMin();
+    QVector3D max = surface->getMax();
+    for (int axis=0; axis<3; ++axis) {
+        for (size_t i=0; i<=20; ++i) {
+            float pos = min[axis] + i * (max[axis] - min[axis]) / 20;
+            QVector3D n(0, 0, 0);
+            n[axis] = 1;
+            QVERIFY(sameAsAllFaces(surface, Plane(n.x(), n.y(), n.z(), -pos)));
+            QVERIFY(sameAsAllFaces(surface, Plane(-n.x(), -n.y(), -n.z(), pos)));
+        }
+    }
+    // at a control point, on the edge of the face extents
+    QVector3D p = surface->getControlFace(0)->getMin();
+    QVERIFY(sameAsAllFaces(surface, Plane(1, 0, 0, -p.x())));
+    QVERIFY(sameAsAllFaces(surface, Plane(0, 0, 2, -2 * p.z())));
+}
+
+void IntervalIndexTest::testCaseFaceMoved()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    // moving a face to a new layer changes the order the faces are cut in
+    SubdivisionLayer* layer = surface->addNewLayer();
+    SubdivisionControlFace* face = surface->getLayer(0)->getFace(0);
+    face->setLayer(layer);
+    QVERIFY(surface->isBuild());
+    QVector3D centre = 0.5 * (face->getMin() + face->getMax());
+    QVERIFY(sameAsAllFaces(surface, Plane(1, 0, 0, -centre.x())));
+    QVERIFY(sameAsAllFaces(surface, Plane(0, 0, 1, -centre.z())));
+}
+
+void IntervalIndexTest::benchmarkQuery_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("indexed");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 scan").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 index").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+// the faces cut by 100 stations
+void IntervalIndexTest::benchmarkQuery()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, indexed);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->rebuild();
+    vector<float> lo, hi;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        lo.push_back(surface->getControlFace(i)->getMin().x());
+        hi.push_back(surface->getControlFace(i)->getMax().x());
+    }
+    IntervalIndex index;
+    index.build(lo, hi);
+    vector<size_t> items;
+    size_t found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (size_t i=0; i<100; ++i) {
+            float x = surface->getMin().x() + (i + 0.5f) * (surface->getMax().x() - surface->getMin().x()) / 100;
+            if (indexed)
+                index.query(x, x, items);
+            else
+                scanIntervals(lo, hi, x, x, items);
+            found += items.size();
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+QTEST_APPLESS_MAIN(IntervalIndexTest)
+
+#include "tst_intervalindextest.moc"
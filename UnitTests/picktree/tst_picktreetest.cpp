@@ -0,0 +1,357 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <QString>
+#include <QFile>
+#include <QtTest>
+#include <vector>
+#include <limits>
+#include <random>
+#include <cmath>
+
+#include "picktree.h"
+#include "subdivsurface.h"
+#include "subdivpoint.h"
+#include "subdivedge.h"
+#include "subdivface.h"
+#include "shipcadmodel.h"
+#include "filebuffer.h"
+#include "../testutil.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+class PickTreeTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    PickTreeTest();
+
+private Q_SLOTS:
+    void testCaseEmpty();
+    void testCaseQuery();
+    void testCaseRefit();
+    void testCaseNearestPick();
+    void benchmarkPick_data();
+    void benchmarkPick();
+};
+
+PickTreeTest::PickTreeTest()
+{
+}
+
+static void randomPoints(mt19937& gen, size_t n, vector<QVector3D>& points)
+{
+    uniform_real_distribution<float> coord(-10.0f, 10.0f);
+    points.resize(n);
+    for (size_t i=0; i<n; ++i)
+        points[i] = QVector3D(coord(gen), coord(gen), coord(gen));
+}
+
+// every point within the radius of the line is a candidate, in order
+static bool findsAllNear(const PickTree& tree, const vector<QVector3D>& points,
+                         const QVector3D& pt, const QVector3D& dir, float radius)
+{
+    vector<PickTree::Candidate> hits;
+    tree.query(pt, dir, radius, hits);
+    vector<bool> found(points.size(), false);
+    for (size_t i=0; i<hits.size(); ++i) {
+        if (i > 0 && hits[i].first < hits[i-1].first)
+            return false;
+        found[hits[i].second] = true;
+    }
+    for (size_t i=0; i<points.size(); ++i)
+        if (!found[i] && points[i].distanceToLine(pt, dir) < radius)
+            return false;
+    return true;
+}
+
+void PickTreeTest::testCaseEmpty()
+{
+    PickTree tree;
+    vector<QVector3D> none;
+    tree.build(none, none);
+    vector<PickTree::Candidate> hits;
+    tree.query(QVector3D(0, 0, 0), QVector3D(1, 0, 0), 1.0f, hits);
+    QVERIFY(hits.empty());
+    vector<QVector3D> one(1);
+    QVERIFY_EXCEPTION_THROWN(tree.build(one, none), invalid_argument);
+    QVERIFY_EXCEPTION_THROWN(tree.refit(one, one), invalid_argument);
+}
+
+void PickTreeTest::testCaseQuery()
+{
+    mt19937 gen(17);
+    vector<QVector3D> points;
+    randomPoints(gen, 1000, points);
+    PickTree tree;
+    tree.build(points, points);
+    QCOMPARE(tree.numberOfItems(), points.size());
+    QVERIFY(tree.numberOfNodes() < points.size());
+
+    vector<QVector3D> targets;
+    randomPoints(gen, 200, targets);
+    for (size_t i=0; i<targets.size(); ++i) {
+        QVector3D pt(-20, targets[i].y(), 15);
+        QVector3D dir = (targets[i] - pt).normalized();
+        QVERIFY(findsAllNear(tree, points, pt, dir, 0.5f));
+    }
+    // lines along an axis
+    QVERIFY(findsAllNear(tree, points, QVector3D(1, 2, -20), QVector3D(0, 0, 1), 0.5f));
+    QVERIFY(findsAllNear(tree, points, QVector3D(-20, 0, 0), QVector3D(1, 0, 0), 0.5f));
+}
+
+void PickTreeTest::testCaseRefit()
+{
+    mt19937 gen(3);
+    vector<QVector3D> points;
+    randomPoints(gen, 500, points);
+    PickTree tree;
+    tree.build(points, points);
+    size_t nodes = tree.numberOfNodes();
+
+    // move the points, the tree keeps its shape but still finds them
+    vector<QVector3D> moved;
+    randomPoints(gen, 500, moved);
+    for (size_t i=0; i<points.size(); ++i)
+        points[i] = 0.5f * points[i] + moved[i];
+    tree.refit(points, points);
+    QCOMPARE(tree.numberOfNodes(), nodes);
+    for (size_t i=0; i<points.size(); i+=10) {
+        QVector3D pt(points[i].x(), -20, points[i].z());
+        QVERIFY(findsAllNear(tree, points, pt, QVector3D(0, 1, 0), 0.25f));
+    }
+}
+
+// what a pick ray hits, nearest control point, else nearest edge,
+// else nearest face
+struct PickResult
+{
+    SubdivisionBase* pick;
+    float depth;
+};
+
+static void elementBoxes(SubdivisionSurface* surface,
+                         vector<QVector3D>& pmin, vector<QVector3D>& pmax,
+                         vector<QVector3D>& emin, vector<QVector3D>& emax,
+                         vector<QVector3D>& fmin, vector<QVector3D>& fmax)
+{
+    for (size_t i=0; i<surface->numberOfControlPoints(); ++i) {
+        pmin.push_back(surface->getControlPoint(i)->getCoordinate());
+        pmax.push_back(pmin.back());
+    }
+    for (size_t i=0; i<surface->numberOfControlEdges(); ++i) {
+        QVector3D p1 = surface->getControlEdge(i)->startPoint()->getCoordinate();
+        QVector3D p2 = surface->getControlEdge(i)->endPoint()->getCoordinate();
+        emin.push_back(QVector3D(min(p1.x(), p2.x()), min(p1.y(), p2.y()), min(p1.z(), p2.z())));
+        emax.push_back(QVector3D(max(p1.x(), p2.x()), max(p1.y(), p2.y()), max(p1.z(), p2.z())));
+    }
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        QVector3D lo = face->getPoint(0)->getCoordinate();
+        QVector3D hi = lo;
+        for (size_t j=1; j<face->numberOfPoints(); ++j) {
+            QVector3D p = face->getPoint(j)->getCoordinate();
+            lo = QVector3D(min(lo.x(), p.x()), min(lo.y(), p.y()), min(lo.z(), p.z()));
+            hi = QVector3D(max(hi.x(), p.x()), max(hi.y(), p.y()), max(hi.z(), p.z()));
+        }
+        fmin.push_back(lo);
+        fmax.push_back(hi);
+    }
+}
+
+static PickResult scanPick(SubdivisionSurface* surface, const PickRay& ray)
+{
+    PickResult result = { nullptr, numeric_limits<float>::max() };
+    float depth;
+    for (size_t i=0; i<surface->numberOfControlPoints(); ++i) {
+        QVector3D p = surface->getControlPoint(i)->getCoordinate();
+        depth = QVector3D::dotProduct(p - ray.pt, ray.dir);
+        if (p.distanceToLine(ray.pt, ray.dir) < ray.pickDist && depth < result.depth) {
+            result.pick = surface->getControlPoint(i);
+            result.depth = depth;
+        }
+    }
+    if (result.pick != nullptr)
+        return result;
+    for (size_t i=0; i<surface->numberOfControlEdges(); ++i) {
+        SubdivisionControlEdge* edge = surface->getControlEdge(i);
+        if (edge->distanceToEdge(ray.pt, ray.dir, depth) < ray.pickDist && depth < result.depth) {
+            result.pick = edge;
+            result.depth = depth;
+        }
+    }
+    if (result.pick != nullptr)
+        return result;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        if (face->intersectWithRay(ray, depth) && depth < result.depth) {
+            result.pick = face;
+            result.depth = depth;
+        }
+    }
+    return result;
+}
+
+static PickResult treePick(SubdivisionSurface* surface, const PickTree& points,
+                           const PickTree& edges, const PickTree& faces, const PickRay& ray)
+{
+    PickResult result = { nullptr, numeric_limits<float>::max() };
+    vector<PickTree::Candidate> hits;
+    float depth;
+    points.query(ray.pt, ray.dir, ray.pickDist, hits);
+    for (size_t i=0; i<hits.size() && hits[i].first <= result.depth; ++i) {
+        QVector3D p = surface->getControlPoint(hits[i].second)->getCoordinate();
+        depth = QVector3D::dotProduct(p - ray.pt, ray.dir);
+        if (p.distanceToLine(ray.pt, ray.dir) < ray.pickDist && depth < result.depth) {
+            result.pick = surface->getControlPoint(hits[i].second);
+            result.depth = depth;
+        }
+    }
+    if (result.pick != nullptr)
+        return result;
+    edges.query(ray.pt, ray.dir, ray.pickDist, hits);
+    for (size_t i=0; i<hits.size() && hits[i].first <= result.depth; ++i) {
+        SubdivisionControlEdge* edge = surface->getControlEdge(hits[i].second);
+        if (edge->distanceToEdge(ray.pt, ray.dir, depth) < ray.pickDist && depth < result.depth) {
+            result.pick = edge;
+            result.depth = depth;
+        }
+    }
+    if (result.pick != nullptr)
+        return result;
+    faces.query(ray.pt, ray.dir, ray.pickDist, hits);
+    for (size_t i=0; i<hits.size() && hits[i].first <= result.depth; ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(hits[i].second);
+        if (face->intersectWithRay(ray, depth) && depth < result.depth) {
+            result.pick = face;
+            result.depth = depth;
+        }
+    }
+    return result;
+}
+
+// rays from outside the hull aimed close to its control points
+static void pickRays(SubdivisionSurface* surface, size_t n, vector<PickRay>& rays)
+{
+    mt19937 gen(11);
+    uniform_int_distribution<size_t> index(0, surface->numberOfControlPoints() - 1);
+    uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+    uniform_int_distribution<int> side(0, 2);
+    QVector3D size = surface->getMax() - surface->getMin();
+    float distance = 2 * size.length();
+    for (size_t i=0; i<n; ++i) {
+        PickRay ray(false, true, true, true);
+        QVector3D target = surface->getControlPoint(index(gen))->getCoordinate()
+                + QVector3D(jitter(gen), jitter(gen), jitter(gen)) * size.length();
+        // looking along one of the axes, as the 2D views do
+        QVector3D dir(0, 0, 0);
+        dir[side(gen)] = -1;
+        ray.pt = target - distance * dir;
+        ray.dir = dir;
+        ray.pickDist = 0.005f * size.length();
+        rays.push_back(ray);
+    }
+}
+
+void PickTreeTest::testCaseNearestPick()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(1);
+    surface->setBuild(false);
+    surface->rebuild();
+
+    vector<QVector3D> pmin, pmax, emin, emax, fmin, fmax;
+    elementBoxes(surface, pmin, pmax, emin, emax, fmin, fmax);
+    PickTree points, edges, faces;
+    points.build(pmin, pmax);
+    edges.build(emin, emax);
+    faces.build(fmin, fmax);
+    vector<PickRay> rays;
+    pickRays(surface, 500, rays);
+    size_t picked = 0;
+    for (size_t i=0; i<rays.size(); ++i) {
+        PickResult scan = scanPick(surface, rays[i]);
+        PickResult tree = treePick(surface, points, edges, faces, rays[i]);
+        // elements at the same depth may be picked in another order
+        QVERIFY2((scan.pick == nullptr) == (tree.pick == nullptr),
+                 "tree sb same pick as scanning all elements");
+        if (scan.pick != nullptr)
+            QVERIFY2(fabs(scan.depth - tree.depth) < 1e-4,
+                     "tree sb same pick as scanning all elements");
+        if (scan.pick != nullptr)
+            ++picked;
+    }
+    QVERIFY(picked > rays.size() / 2);
+}
+
+void PickTreeTest::benchmarkPick_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<bool>("tree");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo 4.fbm", "FREE!ship demo tug.fbm", "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        QTest::newRow(QString("%1 scan").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << false;
+        QTest::newRow(QString("%1 tree").arg(hulls[i]).toLatin1().data()) << QString(hulls[i]) << true;
+    }
+}
+
+void PickTreeTest::benchmarkPick()
+{
+    QFETCH(QString, filename);
+    QFETCH(bool, tree);
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(1);
+    surface->setBuild(false);
+    surface->rebuild();
+
+    vector<QVector3D> pmin, pmax, emin, emax, fmin, fmax;
+    elementBoxes(surface, pmin, pmax, emin, emax, fmin, fmax);
+    PickTree points, edges, faces;
+    points.build(pmin, pmax);
+    edges.build(emin, emax);
+    faces.build(fmin, fmax);
+    vector<PickRay> rays;
+    pickRays(surface, 5000, rays);
+    size_t picked = 0;
+    QBENCHMARK {
+        picked = 0;
+        for (size_t i=0; i<rays.size(); ++i) {
+            PickResult result = tree ? treePick(surface, points, edges, faces, rays[i])
+                : scanPick(surface, rays[i]);
+            if (result.pick != nullptr)
+                ++picked;
+        }
+    }
+    QVERIFY(picked > 0);
+}
+
+QTEST_APPLESS_MAIN(PickTreeTest)
+
+#include "tst_picktreetest.moc"
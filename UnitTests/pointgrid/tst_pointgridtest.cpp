@@ -0,0 +1,191 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <QString>
+#include <QtTest>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "pointgrid.h"
+#include "spline.h"
+#include "utility.h"
+#include "../testutil.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+class PointGridTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    PointGridTest();
+
+private Q_SLOTS:
+    void testCaseCellSize();
+    void testCaseFind();
+    void testCaseJoinSegments();
+    void testCaseJoinNearest();
+    void benchmarkJoinSegments_data();
+    void benchmarkJoinSegments();
+};
+
+PointGridTest::PointGridTest()
+{
+}
+
+// lines of a lines plan, each broken into 2 point splines, reversed
+// and shuffled as they come out of cutting faces
+static void brokenLines(mt19937& gen, size_t lines, size_t points, SplineVector& list)
+{
+    vector<Spline*> segments;
+    for (size_t i=0; i<lines; ++i) {
+        for (size_t j=0; j<points; ++j) {
+            QVector3D p1(j * 0.2f, i * 1.0f, 0.2f * sin(0.1f * j));
+            QVector3D p2((j + 1) * 0.2f, i * 1.0f, 0.2f * sin(0.1f * (j + 1)));
+            Spline* spline = new Spline();
+            if (gen() % 2 == 0) {
+                spline->add(p1);
+                spline->add(p2);
+            }
+            else {
+                spline->add(p2);
+                spline->add(p1);
+            }
+            segments.push_back(spline);
+        }
+    }
+    shuffle(segments.begin(), segments.end(), gen);
+    for (size_t i=0; i<segments.size(); ++i)
+        list.add(segments[i]);
+}
+
+void PointGridTest::testCaseCellSize()
+{
+    QVERIFY_EXCEPTION_THROWN(PointGrid grid(0), invalid_argument);
+    QVERIFY_EXCEPTION_THROWN(PointGrid grid(-1), invalid_argument);
+}
+
+void PointGridTest::testCaseFind()
+{
+    mt19937 gen(3);
+    uniform_real_distribution<float> where(-5.0f, 5.0f);
+    const float cellsize = 0.25f;
+    PointGrid grid(cellsize);
+    vector<QVector3D> points;
+    for (size_t i=0; i<2000; ++i) {
+        points.push_back(QVector3D(where(gen), where(gen), where(gen)));
+        grid.insert(points.back(), i);
+    }
+    vector<size_t> found;
+    for (size_t i=0; i<500; ++i) {
+        QVector3D q(where(gen), where(gen), where(gen));
+        found.clear();
+        grid.find(q, found);
+        for (size_t j=0; j<points.size(); ++j)
+            if (points[j].distanceToPoint(q) < cellsize)
+                QVERIFY2(find(found.begin(), found.end(), j) != found.end(),
+                         "point closer than the cell size sb found");
+    }
+    // found once for each time added
+    grid.insert(points[0], 0);
+    found.clear();
+    grid.find(points[0], found);
+    QCOMPARE(count(found.begin(), found.end(), 0), static_cast<ptrdiff_t>(2));
+    grid.clear();
+    found.clear();
+    grid.find(points[0], found);
+    QVERIFY(found.empty());
+}
+
+void PointGridTest::testCaseJoinSegments()
+{
+    // the ends which join touch, the rest are well outside the join
+    // distance, so comparing all splines joins the same ones
+    const size_t sizes[] = { 1, 2, 3, 10, 40 };
+    for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); ++s) {
+        mt19937 gen1(static_cast<unsigned>(s));
+        mt19937 gen2(static_cast<unsigned>(s));
+        SplineVector hashed(true);
+        SplineVector scanned(true);
+        brokenLines(gen1, 4, sizes[s], hashed);
+        brokenLines(gen2, 4, sizes[s], scanned);
+        JoinSplineSegments(0.01f, false, hashed);
+        JoinSplineSegments(1E-6f, false, scanned);
+        QVERIFY(hashed.size() < 4 * sizes[s] || sizes[s] == 1);
+        QVERIFY2(sameSplines(hashed, scanned), "hashed join sb same as comparing all splines");
+    }
+}
+
+void PointGridTest::testCaseJoinNearest()
+{
+    // ends just inside and just outside the join distance
+    SplineVector list(true);
+    Spline* a = new Spline();
+    a->add(QVector3D(0, 0, 0));
+    a->add(QVector3D(1, 0, 0));
+    Spline* b = new Spline();
+    b->add(QVector3D(2, 0, 0));
+    b->add(QVector3D(1.09f, 0, 0));
+    Spline* c = new Spline();
+    c->add(QVector3D(2.11f, 0, 0));
+    c->add(QVector3D(3, 0, 0));
+    list.add(a);
+    list.add(b);
+    list.add(c);
+    JoinSplineSegments(0.01f, false, list);
+    QCOMPARE(list.size(), static_cast<size_t>(2));
+    QCOMPARE(list.get(0)->numberOfPoints(), static_cast<size_t>(3));
+    QCOMPARE(list.get(0)->getLastPoint(), QVector3D(2, 0, 0));
+    // joined whatever the distance
+    JoinSplineSegments(0.01f, true, list);
+    QCOMPARE(list.size(), static_cast<size_t>(1));
+}
+
+void PointGridTest::benchmarkJoinSegments_data()
+{
+    QTest::addColumn<int>("lines");
+    QTest::addColumn<int>("points");
+
+    QTest::newRow("10x50") << 10 << 50;
+    QTest::newRow("20x100") << 20 << 100;
+    QTest::newRow("40x200") << 40 << 200;
+}
+
+void PointGridTest::benchmarkJoinSegments()
+{
+    QFETCH(int, lines);
+    QFETCH(int, points);
+    size_t joined = 0;
+    QBENCHMARK {
+        mt19937 gen(11);
+        SplineVector list(true);
+        brokenLines(gen, lines, points, list);
+        JoinSplineSegments(0.01f, false, list);
+        joined = list.size();
+    }
+    QVERIFY(joined < static_cast<size_t>(lines * points));
+}
+
+QTEST_APPLESS_MAIN(PointGridTest)
+
+#include "tst_pointgridtest.moc"
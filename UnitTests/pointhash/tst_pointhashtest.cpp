@@ -0,0 +1,189 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+#include <QString>
+#include <QtTest>
+#include <vector>
+#include <stdexcept>
+#include <cmath>
+
+#include "pointhash.h"
+#include "subdivsurface.h"
+#include "subdivpoint.h"
+#include "shipcadmodel.h"
+
+using namespace std;
+using namespace ShipCAD;
+
+class PointHashTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    PointHashTest();
+
+private Q_SLOTS:
+    void testCaseHash();
+    void testCaseWeld();
+    void testCaseWeldMoved();
+    void testCaseWeldDeleted();
+    void benchmarkImport_data();
+    void benchmarkImport();
+};
+
+PointHashTest::PointHashTest()
+{
+}
+
+static QVector3D gridPoint(size_t u, size_t v)
+{
+    const float step = 0.1f;
+    return QVector3D(u * step, v * step, 0.5f * sin(0.3f * u) * cos(0.2f * v));
+}
+
+// a wavy sheet of n by n quads, added face by face as an import does
+static void importGrid(SubdivisionSurface* surface, size_t n)
+{
+    vector<QVector3D> quad(4);
+    for (size_t i=0; i<n; ++i) {
+        for (size_t j=0; j<n; ++j) {
+            quad[0] = gridPoint(i, j);
+            quad[1] = gridPoint(i + 1, j);
+            quad[2] = gridPoint(i + 1, j + 1);
+            quad[3] = gridPoint(i, j + 1);
+            surface->addControlFace(quad);
+        }
+    }
+}
+
+void PointHashTest::testCaseHash()
+{
+    QVERIFY_EXCEPTION_THROWN(PointHash(0), invalid_argument);
+
+    ShipCADModel model;
+    SubdivisionSurface* surface = model.getSurface();
+    surface->clear();
+    PointHash hash(0.01f);
+    vector<SubdivisionControlPoint*> points;
+    for (size_t i=0; i<100; ++i) {
+        SubdivisionControlPoint* pt = surface->addControlPoint();
+        pt->setCoordinate(QVector3D(i * 0.004f, 1, -1));
+        hash.insert(pt);
+        points.push_back(pt);
+    }
+    QCOMPARE(hash.size(), points.size());
+
+    // nearest first, and nothing beyond the distance
+    vector<SubdivisionControlPoint*> found;
+    hash.find(QVector3D(0.2005f, 1, -1), 0.005f, found);
+    QCOMPARE(found.size(), static_cast<size_t>(3));
+    QVERIFY(found[0] == points[50]);
+    QVERIFY(found[1] == points[51] && found[2] == points[49]);
+
+    // moved points are found at their new place only
+    QVector3D from = points[50]->getCoordinate();
+    points[50]->setCoordinate(QVector3D(5, 5, 5));
+    hash.move(points[50], from);
+    hash.find(QVector3D(5, 5, 5), 0.001f, found);
+    QCOMPARE(found.size(), static_cast<size_t>(1));
+    QVERIFY(found[0] == points[50]);
+    hash.find(from, 0.001f, found);
+    QVERIFY(found.empty());
+
+    QVERIFY(hash.remove(points[50], points[50]->getCoordinate()));
+    QVERIFY(!hash.remove(points[50], points[50]->getCoordinate()));
+    QCOMPARE(hash.size(), points.size() - 1);
+    hash.clear();
+    QCOMPARE(hash.size(), static_cast<size_t>(0));
+}
+
+void PointHashTest::testCaseWeld()
+{
+    ShipCADModel model;
+    SubdivisionSurface* surface = model.getSurface();
+    surface->clear();
+    importGrid(surface, 10);
+    QCOMPARE(surface->numberOfControlPoints(), static_cast<size_t>(11 * 11));
+    QCOMPARE(surface->numberOfControlFaces(), static_cast<size_t>(10 * 10));
+
+    // boundary points weld within the tolerance
+    SubdivisionControlPoint* corner = surface->getControlPoint(0);
+    QVERIFY(surface->addControlPoint(gridPoint(0, 0) + QVector3D(0.001f, 0, 0.001f)) == corner);
+    size_t n = surface->numberOfControlPoints();
+    surface->addControlPoint(gridPoint(0, 0) + QVector3D(0.005f, 0, 0));
+    QCOMPARE(surface->numberOfControlPoints(), n + 1);
+
+    // points inside the sheet are never welded to
+    surface->addControlPoint(gridPoint(5, 5));
+    QCOMPARE(surface->numberOfControlPoints(), n + 2);
+}
+
+void PointHashTest::testCaseWeldMoved()
+{
+    ShipCADModel model;
+    SubdivisionSurface* surface = model.getSurface();
+    surface->clear();
+    importGrid(surface, 4);
+    SubdivisionControlPoint* corner = surface->getControlPoint(0);
+    corner->setCoordinate(QVector3D(-1, -1, 0));
+    size_t n = surface->numberOfControlPoints();
+    QVERIFY(surface->addControlPoint(QVector3D(-1, -1, 0)) == corner);
+    QVERIFY(surface->addControlPoint(gridPoint(0, 0)) != corner);
+    QCOMPARE(surface->numberOfControlPoints(), n + 1);
+}
+
+void PointHashTest::testCaseWeldDeleted()
+{
+    ShipCADModel model;
+    SubdivisionSurface* surface = model.getSurface();
+    surface->clear();
+    SubdivisionControlPoint* pt = surface->addControlPoint(QVector3D(1, 2, 3));
+    QVERIFY(surface->addControlPoint(QVector3D(1, 2, 3)) == pt);
+    surface->deleteControlPoint(pt);
+    QCOMPARE(surface->numberOfControlPoints(), static_cast<size_t>(0));
+    SubdivisionControlPoint* again = surface->addControlPoint(QVector3D(1, 2, 3));
+    QCOMPARE(surface->numberOfControlPoints(), static_cast<size_t>(1));
+    QVERIFY(surface->addControlPoint(QVector3D(1, 2, 3)) == again);
+}
+
+void PointHashTest::benchmarkImport_data()
+{
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("25x25") << 25;
+    QTest::newRow("50x50") << 50;
+    QTest::newRow("100x100") << 100;
+    QTest::newRow("200x200") << 200;
+}
+
+void PointHashTest::benchmarkImport()
+{
+    QFETCH(int, size);
+    ShipCADModel model;
+    SubdivisionSurface* surface = model.getSurface();
+    QBENCHMARK {
+        surface->clear();
+        importGrid(surface, size);
+    }
+    QCOMPARE(surface->numberOfControlPoints(), static_cast<size_t>((size + 1) * (size + 1)));
+}
+
+QTEST_APPLESS_MAIN(PointHashTest)
+
+#include "tst_pointhashtest.moc"
@@ -28,11 +28,25 @@
  *##############################################################################################*/
 
 #include <QString>
+#include <QFile>
 #include <QtTest>
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <cmath>
 
 #include "subdivsurface.h"
+#include "subdivpoint.h"
+#include "subdivface.h"
+#include "subdivedge.h"
+#include "subdivlayer.h"
+#include "shipcadmodel.h"
+#include "filebuffer.h"
 #include "grid.h"
+#include "plane.h"
+#include "spline.h"
+#include "../testutil.h"
 
 using namespace std;
 using namespace ShipCAD;
@@ -47,6 +61,30 @@ public:
 private Q_SLOTS:
     void testCaseConstruct();
     void testCaseAssemblePatches();
+    void testCaseParallelSubdivide();
+    void testCaseMovePointRebuild();
+    void benchmarkMovePoint();
+    void testCaseStencilRebuild();
+    void benchmarkStencilRebuild();
+    void testCaseRebuildMemory();
+    void testCaseCurvatureLookup();
+    void benchmarkCurvatureLookup();
+    void testCaseExportObj();
+    void testCaseCachedNormals();
+    void testCaseAdaptiveFaces();
+    void testCaseLocalNormals();
+    void benchmarkAdaptiveIntersect_data();
+    void benchmarkAdaptiveIntersect();
+    void testCaseLevelCache();
+    void testCaseLevelAdjacency();
+    void benchmarkLevelSwitch();
+    void testCaseEdgeLookup();
+    void benchmarkEdgeLookup_data();
+    void benchmarkEdgeLookup();
+    void benchmarkSubdivide_data();
+    void benchmarkSubdivide();
+    void benchmarkLevelMemory_data();
+    void benchmarkLevelMemory();
 };
 
 SubdivsurfaceTest::SubdivsurfaceTest()
@@ -69,6 +107,883 @@ void SubdivsurfaceTest::testCaseAssemblePatches()
     QVERIFY2(true, "Failure");
 }
 
+void SubdivsurfaceTest::testCaseParallelSubdivide()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+
+    surface->setParallelSubdivision(false);
+    surface->setBuild(false);
+    surface->rebuild();
+    vector<QVector3D> serial;
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        serial.push_back(surface->getPoint(i)->getCoordinate());
+    size_t serialedges = surface->numberOfEdges();
+    size_t serialfaces = surface->numberOfFaces();
+
+    surface->setParallelSubdivision(true);
+    surface->setBuild(false);
+    surface->rebuild();
+    QCOMPARE(surface->numberOfPoints(), serial.size());
+    QCOMPARE(surface->numberOfEdges(), serialedges);
+    QCOMPARE(surface->numberOfFaces(), serialfaces);
+    for (size_t i=0; i<serial.size(); ++i)
+        QVERIFY2(surface->getPoint(i)->getCoordinate() == serial[i],
+                 "parallel subdivision sb same as serial");
+}
+
+void SubdivsurfaceTest::testCaseMovePointRebuild()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+    surface->setBuild(false);
+    surface->rebuild();
+
+    // move one point, only the faces around it get subdivided again
+    SubdivisionControlPoint* pt = surface->getControlPoint(surface->numberOfControlPoints() / 2);
+    QVERIFY(pt->numberOfFaces() > 0);
+    pt->setCoordinate(pt->getCoordinate() + QVector3D(0.1f, 0.2f, -0.1f));
+    QVERIFY(!surface->isBuild());
+    surface->rebuild();
+    QVERIFY(surface->isLocalRebuild());
+    const vector<SubdivisionControlFace*>& rebuilt = surface->getRebuiltFaces();
+    QVERIFY(!rebuilt.empty());
+    QVERIFY(rebuilt.size() < surface->numberOfControlFaces());
+    for (size_t i=0; i<pt->numberOfFaces(); ++i)
+        QVERIFY(find(rebuilt.begin(), rebuilt.end(), pt->getFace(i)) != rebuilt.end());
+    vector<QVector3D> local;
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        local.push_back(surface->getPoint(i)->getCoordinate());
+    QVector3D localmin = surface->getMin();
+    QVector3D localmax = surface->getMax();
+
+    // compare with subdividing all of it
+    surface->setBuild(false);
+    surface->rebuild();
+    QVERIFY(!surface->isLocalRebuild());
+    QCOMPARE(surface->numberOfPoints(), local.size());
+    for (size_t i=0; i<local.size(); ++i)
+        QVERIFY2((surface->getPoint(i)->getCoordinate() - local[i]).length() < 1e-4,
+                 "local rebuild sb same as full rebuild");
+    QVERIFY((surface->getMin() - localmin).length() < 1e-4);
+    QVERIFY((surface->getMax() - localmax).length() < 1e-4);
+}
+
+void SubdivsurfaceTest::benchmarkMovePoint()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    SubdivisionControlPoint* pt = surface->getControlPoint(surface->numberOfControlPoints() / 2);
+    QVector3D start = pt->getCoordinate();
+    float dz = 0.01f;
+
+    QBENCHMARK {
+        dz = -dz;
+        pt->setCoordinate(start + QVector3D(0, 0, dz));
+        surface->rebuild();
+    }
+}
+
+void SubdivsurfaceTest::testCaseStencilRebuild()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+    surface->setBuild(false);
+    surface->rebuild();
+    QVERIFY(!surface->getStencils().isValid());
+
+    // moving all points can't be done locally, so the stencil table is made
+    QVector3D scale(1.1f, 0.9f, 1.05f);
+    for (size_t i=0; i<surface->numberOfControlPoints(); ++i) {
+        SubdivisionControlPoint* pt = surface->getControlPoint(i);
+        pt->setCoordinate(pt->getCoordinate() * scale);
+    }
+    surface->rebuild();
+    QVERIFY(surface->getStencils().isValid());
+    QCOMPARE(surface->getStencils().numberOfRows(), surface->numberOfPoints());
+    QCOMPARE(surface->getStencils().numberOfColumns(), surface->numberOfControlPoints());
+
+    // the next move uses it
+    for (size_t i=0; i<surface->numberOfControlPoints(); ++i) {
+        SubdivisionControlPoint* pt = surface->getControlPoint(i);
+        pt->setCoordinate(pt->getCoordinate() + QVector3D(0.5f, -0.2f, 0.3f));
+    }
+    surface->rebuild();
+    QVERIFY(surface->getStencils().isValid());
+    vector<QVector3D> stencilled;
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        stencilled.push_back(surface->getPoint(i)->getCoordinate());
+
+    // a topology change throws the table away
+    surface->setBuild(false);
+    QVERIFY(!surface->getStencils().isValid());
+    surface->rebuild();
+    QCOMPARE(surface->numberOfPoints(), stencilled.size());
+    for (size_t i=0; i<stencilled.size(); ++i)
+        QVERIFY2((surface->getPoint(i)->getCoordinate() - stencilled[i]).length() < 1e-3,
+                 "stencil points sb same as subdivided points");
+}
+
+void SubdivsurfaceTest::benchmarkStencilRebuild()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    float dz = 0.01f;
+
+    QBENCHMARK {
+        dz = -dz;
+        for (size_t i=0; i<surface->numberOfControlPoints(); ++i) {
+            SubdivisionControlPoint* pt = surface->getControlPoint(i);
+            pt->setCoordinate(pt->getCoordinate() + QVector3D(0, 0, dz));
+        }
+        surface->rebuild();
+    }
+    // the rebuilds went through the stencils
+    QVERIFY(surface->getStencils().numberOfWeights() > 0);
+}
+
+// memory of the subdivided elements handed out by the pools, and of
+// the adjacency lists of the current level
+static size_t subdividedBytes(SubdivisionSurface* surface)
+{
+    return surface->getPointPool().used() * sizeof(SubdivisionPoint)
+        + surface->getEdgePool().used() * sizeof(SubdivisionEdge)
+        + surface->getFacePool().used() * sizeof(SubdivisionFace)
+        + surface->getAdjacencyBytes();
+}
+
+void SubdivsurfaceTest::testCaseRebuildMemory()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+
+    // the subdivided elements of a rebuild must be freed by the next one
+    size_t before = subdividedBytes(surface);
+    surface->setBuild(false);
+    surface->rebuild();
+    size_t points = surface->getPointPool().used();
+    size_t edges = surface->getEdgePool().used();
+    size_t faces = surface->getFacePool().used();
+    size_t first = subdividedBytes(surface);
+    QVERIFY(first > before);
+    QVERIFY(surface->getAdjacencyBytes() > 0);
+    for (int i=0; i<10; ++i) {
+        surface->setBuild(false);
+        surface->rebuild();
+    }
+    QCOMPARE(surface->getPointPool().used(), points);
+    QCOMPARE(surface->getEdgePool().used(), edges);
+    QCOMPARE(surface->getFacePool().used(), faces);
+    QCOMPARE(subdividedBytes(surface), first);
+}
+
+void SubdivsurfaceTest::testCaseCurvatureLookup()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    surface->calculateGaussCurvature();
+    for (size_t i=0; i<surface->numberOfPoints(); ++i) {
+        QCOMPARE(surface->getPoint(i)->getListIndex(), i);
+        QCOMPARE(surface->getPoint(i)->getIndex(), i);
+    }
+    for (size_t i=0; i<surface->numberOfControlPoints(); ++i) {
+        QCOMPARE(surface->getControlPoint(i)->getListIndex(), i);
+        QCOMPARE(surface->getControlPoint(i)->getIndex(), i);
+    }
+
+    // every point of the faces must find itself through its index
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            SubdivisionFace* child = face->getChild(j);
+            for (size_t k=0; k<child->numberOfPoints(); ++k) {
+                SubdivisionPoint* p = child->getPoint(k);
+                QCOMPARE(surface->getPoint(surface->indexOfPoint(p)), p);
+            }
+        }
+    }
+
+    // removing a control point moves the ones after it down
+    SubdivisionControlPoint* pt1 = surface->addControlPoint();
+    SubdivisionControlPoint* pt2 = surface->addControlPoint();
+    QCOMPARE(pt2->getIndex(), surface->numberOfControlPoints() - 1);
+    surface->removeControlPoint(pt1);
+    QVERIFY(!surface->hasControlPoint(pt1));
+    QCOMPARE(pt2->getIndex(), surface->numberOfControlPoints() - 1);
+    QCOMPARE(surface->getControlPoint(pt2->getIndex()), pt2);
+}
+
+// the lookups of the curvature display
+void SubdivsurfaceTest::benchmarkCurvatureLookup()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    surface->calculateGaussCurvature();
+
+    float sum = 0;
+    QBENCHMARK {
+        for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+            SubdivisionControlFace* face = surface->getControlFace(i);
+            for (size_t j=0; j<face->numberOfChildren(); ++j) {
+                SubdivisionFace* child = face->getChild(j);
+                for (size_t k=0; k<child->numberOfPoints(); ++k)
+                    sum += surface->getGaussCurvature(surface->indexOfPoint(child->getPoint(k)));
+            }
+        }
+    }
+    QVERIFY(sum != 0);
+}
+
+void SubdivsurfaceTest::testCaseExportObj()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setBuild(false);
+    surface->rebuild();
+
+    QStringList strings;
+    surface->exportObjFile(false, strings);
+    // exporting must not disturb the point indices
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        QCOMPARE(surface->getPoint(i)->getListIndex(), i);
+    vector<QVector3D> vertices;
+    size_t faces = 0;
+    for (int i=0; i<strings.size(); ++i) {
+        QStringList fields = strings[i].split(" ");
+        if (fields[0] == "v") {
+            QCOMPARE(fields.size(), 4);
+            vertices.push_back(QVector3D(fields[3].toFloat(), fields[1].toFloat(),
+                                         fields[2].toFloat()));
+        }
+        else if (fields[0] == "f") {
+            QVERIFY(fields.size() >= 4);
+            for (int j=1; j<fields.size(); ++j) {
+                int index = fields[j].toInt();
+                QVERIFY(index >= 1 && static_cast<size_t>(index) <= vertices.size());
+            }
+            faces++;
+        }
+    }
+    // portside vertices come first, in the order of the point list
+    QVERIFY(vertices.size() >= surface->numberOfPoints());
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        QVERIFY((vertices[i] - surface->getPoint(i)->getCoordinate()).length() < 1E-2f);
+    size_t visible = 0;
+    size_t children = 0;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        if (face->getLayer()->isVisible()) {
+            visible++;
+            children += face->numberOfChildren();
+        }
+    }
+    QVERIFY(children > 0);
+    QVERIFY(faces >= children);
+
+    // the control net refers to the control points
+    strings.clear();
+    surface->exportObjFile(true, strings);
+    vertices.clear();
+    faces = 0;
+    for (int i=0; i<strings.size(); ++i) {
+        QStringList fields = strings[i].split(" ");
+        if (fields[0] == "v") {
+            vertices.push_back(QVector3D(fields[3].toFloat(), fields[1].toFloat(),
+                                         fields[2].toFloat()));
+        }
+        else if (fields[0] == "f") {
+            for (int j=1; j<fields.size(); ++j) {
+                int index = fields[j].toInt();
+                QVERIFY(index >= 1 && static_cast<size_t>(index) <= vertices.size());
+            }
+            faces++;
+        }
+    }
+    QVERIFY(vertices.size() >= surface->numberOfControlPoints());
+    for (size_t i=0; i<surface->numberOfControlPoints(); ++i)
+        QVERIFY((vertices[i] - surface->getControlPoint(i)->getCoordinate()).length() < 1E-2f);
+    QVERIFY(faces >= visible);
+}
+
+// the kept normals must match the ones calculated from the mesh
+static bool normalsMatch(SubdivisionSurface* surface)
+{
+    for (size_t i=0; i<surface->numberOfPoints(); ++i) {
+        SubdivisionPoint* pt = surface->getPoint(i);
+        QVector3D n;
+        if (!surface->cachedPointNormal(pt, n) || (n - pt->calculateNormal()).length() > 1e-6)
+            return false;
+    }
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            SubdivisionFace* child = face->getChild(j);
+            QVector3D n;
+            if (!surface->cachedFaceNormal(child, n)
+                    || (n - child->calculateFaceNormal()).length() > 1e-6)
+                return false;
+        }
+    }
+    return true;
+}
+
+void SubdivsurfaceTest::testCaseCachedNormals()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+    surface->setBuild(false);
+    surface->rebuild();
+    QVERIFY(normalsMatch(surface));
+
+    // moving a point hides the normals until the next rebuild
+    SubdivisionControlPoint* pt = surface->getControlPoint(surface->numberOfControlPoints() / 2);
+    pt->setCoordinate(pt->getCoordinate() + QVector3D(0, 0.1f, 0.2f));
+    QVector3D n;
+    QVERIFY(!surface->cachedPointNormal(surface->getPoint(0), n));
+    surface->rebuild();
+    QVERIFY(normalsMatch(surface));
+
+    // control faces are not kept
+    QVERIFY(!surface->cachedFaceNormal(surface->getControlFace(0), n));
+}
+
+// chord tolerance for the adaptive tests, relative to the size of the hull
+static float adaptiveTolerance(SubdivisionSurface* surface)
+{
+    return 5e-4f * (surface->getMax() - surface->getMin()).length();
+}
+
+void SubdivsurfaceTest::testCaseAdaptiveFaces()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    size_t full = surface->numberOfFaces();
+    QCOMPARE(surface->numberOfAdaptiveFaces(), full);
+    float fullarea = 0;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfChildren(); ++j)
+            fullarea += face->getChild(j)->getArea();
+    }
+
+    surface->setAdaptiveTolerance(adaptiveTolerance(surface));
+    surface->rebuild();
+    size_t adaptive = surface->numberOfAdaptiveFaces();
+    QVERIFY(adaptive < full);
+    QCOMPARE(surface->numberOfFaces(), full);
+
+    // the boundary of the children, including the edges on the centreplane
+    map<pair<SubdivisionPoint*, SubdivisionPoint*>, size_t> childedges;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            SubdivisionFace* child = face->getChild(j);
+            for (size_t k=0; k<child->numberOfPoints(); ++k) {
+                SubdivisionPoint* p1 = child->getPoint(k);
+                SubdivisionPoint* p2 = child->getPoint((k + 1) % child->numberOfPoints());
+                childedges[p1 < p2 ? make_pair(p1, p2) : make_pair(p2, p1)]++;
+            }
+        }
+    }
+    set<SubdivisionPoint*> boundary;
+    map<pair<SubdivisionPoint*, SubdivisionPoint*>, size_t>::iterator i = childedges.begin();
+    for ( ; i!=childedges.end(); ++i) {
+        if (i->second == 1) {
+            boundary.insert(i->first.first);
+            boundary.insert(i->first.second);
+        }
+    }
+
+    // no cracks, an edge used by one face only must be on the boundary
+    map<pair<SubdivisionPoint*, SubdivisionPoint*>, size_t> edges;
+    float area = 0;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfAdaptiveFaces(); ++j) {
+            SubdivisionFace* child = face->getAdaptiveFace(j);
+            area += child->getArea();
+            for (size_t k=0; k<child->numberOfPoints(); ++k) {
+                SubdivisionPoint* p1 = child->getPoint(k);
+                SubdivisionPoint* p2 = child->getPoint((k + 1) % child->numberOfPoints());
+                edges[p1 < p2 ? make_pair(p1, p2) : make_pair(p2, p1)]++;
+            }
+        }
+    }
+    for (i=edges.begin(); i!=edges.end(); ++i)
+        if (i->second == 1)
+            QVERIFY2(boundary.find(i->first.first) != boundary.end()
+                     && boundary.find(i->first.second) != boundary.end(),
+                     "adaptive mesh sb closed");
+    QVERIFY(fabs(area - fullarea) < 0.01 * fullarea);
+
+    // turning it off gives the children back
+    surface->setAdaptiveTolerance(0);
+    surface->rebuild();
+    QCOMPARE(surface->numberOfAdaptiveFaces(), full);
+}
+
+// the points of the adaptive faces of each control face, by list index
+static void adaptiveFacePoints(SubdivisionSurface* surface, vector<vector<size_t> >& points)
+{
+    points.clear();
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfAdaptiveFaces(); ++j) {
+            SubdivisionFace* child = face->getAdaptiveFace(j);
+            points.push_back(vector<size_t>());
+            for (size_t k=0; k<child->numberOfPoints(); ++k)
+                points.back().push_back(child->getPoint(k)->getListIndex());
+        }
+    }
+}
+
+void SubdivsurfaceTest::testCaseLocalNormals()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+    surface->setBuild(false);
+    surface->rebuild();
+    surface->setAdaptiveTolerance(adaptiveTolerance(surface));
+    surface->rebuild();
+    QVERIFY(surface->numberOfAdaptiveFaces() < surface->numberOfFaces());
+    map<SubdivisionFace*, QVector3D> facenormals;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            QVector3D n;
+            QVERIFY(surface->cachedFaceNormal(face->getChild(j), n));
+            facenormals[face->getChild(j)] = n;
+        }
+    }
+    vector<QVector3D> pointnormals(surface->numberOfPoints());
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        QVERIFY(surface->cachedPointNormal(surface->getPoint(i), pointnormals[i]));
+    vector<vector<SubdivisionFace*> > adaptive;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i)
+        adaptive.push_back(surface->getControlFace(i)->getAdaptiveFaces());
+
+    SubdivisionControlPoint* pt = surface->getControlPoint(surface->numberOfControlPoints() / 2);
+    pt->setCoordinate(pt->getCoordinate() + QVector3D(0.1f, 0.2f, -0.1f));
+    surface->rebuild();
+    QVERIFY(surface->isLocalRebuild());
+    const vector<SubdivisionControlFace*>& rebuilt = surface->getRebuiltFaces();
+    vector<char> changed(surface->numberOfPoints(), 0);
+    for (size_t i=0; i<rebuilt.size(); ++i)
+        for (size_t j=0; j<rebuilt[i]->numberOfChildren(); ++j)
+            for (size_t k=0; k<rebuilt[i]->getChild(j)->numberOfPoints(); ++k)
+                changed[rebuilt[i]->getChild(j)->getPoint(k)->getListIndex()] = 1;
+    // the faces around the rebuilt ones may have to follow a new grid
+    set<SubdivisionFace*> around;
+    for (size_t i=0; i<rebuilt.size(); ++i)
+        for (size_t j=0; j<rebuilt[i]->numberOfPoints(); ++j)
+            for (size_t k=0; k<rebuilt[i]->getPoint(j)->numberOfFaces(); ++k)
+                around.insert(rebuilt[i]->getPoint(j)->getFace(k));
+    size_t kept = 0;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        if (find(rebuilt.begin(), rebuilt.end(), face) != rebuilt.end())
+            continue;
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            QVector3D n;
+            QVERIFY(surface->cachedFaceNormal(face->getChild(j), n));
+            QVERIFY2(n == facenormals[face->getChild(j)], "face normal sb untouched");
+        }
+        if (around.find(face) == around.end()) {
+            QVERIFY2(face->getAdaptiveFaces() == adaptive[i], "adaptive faces sb kept");
+            ++kept;
+        }
+    }
+    QVERIFY(kept > 0);
+    for (size_t i=0; i<surface->numberOfPoints(); ++i) {
+        if (changed[i])
+            continue;
+        QVector3D n;
+        QVERIFY(surface->cachedPointNormal(surface->getPoint(i), n));
+        QVERIFY2(n == pointnormals[i], "point normal sb untouched");
+    }
+    QVERIFY(normalsMatch(surface));
+
+    // same adaptive faces as building all of them
+    vector<vector<size_t> > local;
+    adaptiveFacePoints(surface, local);
+    surface->setBuild(false);
+    surface->rebuild();
+    QVERIFY(!surface->isLocalRebuild());
+    vector<vector<size_t> > full;
+    adaptiveFacePoints(surface, full);
+    QVERIFY2(local == full, "local adaptive faces sb same as a full build");
+}
+
+void SubdivsurfaceTest::benchmarkAdaptiveIntersect_data()
+{
+    QTest::addColumn<bool>("adaptive");
+    QTest::newRow("children") << false;
+    QTest::newRow("adaptive") << true;
+}
+
+void SubdivsurfaceTest::benchmarkAdaptiveIntersect()
+{
+    QFETCH(bool, adaptive);
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    if (adaptive) {
+        surface->setAdaptiveTolerance(adaptiveTolerance(surface));
+        surface->rebuild();
+    }
+    QVector3D min = surface->getMin();
+    QVector3D max = surface->getMax();
+
+    // stations along the hull
+    QBENCHMARK {
+        for (size_t i=1; i<20; ++i) {
+            SplineVector stations(true);
+            float x = min.x() + (max.x() - min.x()) * i / 20;
+            surface->intersectPlane(Plane(1, 0, 0, -x), false, stations);
+        }
+    }
+}
+
+static vector<QVector3D> subdividedPoints(SubdivisionSurface* surface)
+{
+    vector<QVector3D> result;
+    for (size_t i=0; i<surface->numberOfPoints(); ++i)
+        result.push_back(surface->getPoint(i)->getCoordinate());
+    return result;
+}
+
+static bool samePoints(SubdivisionSurface* surface, const vector<QVector3D>& points)
+{
+    if (surface->numberOfPoints() != points.size())
+        return false;
+    for (size_t i=0; i<points.size(); ++i)
+        if ((surface->getPoint(i)->getCoordinate() - points[i]).length() > 1e-5)
+            return false;
+    return true;
+}
+
+void SubdivsurfaceTest::testCaseLevelCache()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    vector<vector<QVector3D> > levels(5);
+    for (int level=2; level<=4; ++level) {
+        surface->setDesiredSubdivisionLevel(level);
+        surface->setBuild(false);
+        surface->rebuild();
+        levels[level] = subdividedPoints(surface);
+    }
+    QCOMPARE(surface->numberOfCachedLevels(), size_t(3));
+
+    // going down selects a kept level
+    surface->setDesiredSubdivisionLevel(2);
+    QVERIFY(!surface->isBuild());
+    surface->rebuild();
+    QCOMPARE(surface->getCurrentSubdivisionLevel(), 2);
+    QVERIFY2(samePoints(surface, levels[2]), "kept level sb same as subdivided level");
+    QVERIFY(surface->numberOfCachedLevels() > 0);
+
+    // going up again doesn't subdivide
+    surface->setDesiredSubdivisionLevel(4);
+    surface->rebuild();
+    QVERIFY2(samePoints(surface, levels[4]), "kept level sb same as subdivided level");
+    surface->setDesiredSubdivisionLevel(3);
+    surface->rebuild();
+    QVERIFY2(samePoints(surface, levels[3]), "kept level sb same as subdivided level");
+
+    // without a budget only the current level is there
+    surface->setLevelCacheBudget(0);
+    QCOMPARE(surface->numberOfCachedLevels(), size_t(0));
+    surface->setDesiredSubdivisionLevel(2);
+    surface->rebuild();
+    QVERIFY2(samePoints(surface, levels[2]), "level sb same when subdivided again");
+    surface->setLevelCacheBudget(128 * 1024 * 1024);
+
+    // moving a control point drops the kept levels
+    surface->setDesiredSubdivisionLevel(3);
+    surface->rebuild();
+    QVERIFY(surface->numberOfCachedLevels() > 0);
+    SubdivisionControlPoint* pt = surface->getControlPoint(surface->numberOfControlPoints() / 2);
+    pt->setCoordinate(pt->getCoordinate() + QVector3D(0, 0.1f, 0.2f));
+    QCOMPARE(surface->numberOfCachedLevels(), size_t(0));
+    surface->rebuild();
+    vector<QVector3D> moved = subdividedPoints(surface);
+    surface->setBuild(false);
+    surface->rebuild();
+    QVERIFY2(samePoints(surface, moved), "moved level sb same as full rebuild");
+    QVERIFY(normalsMatch(surface));
+}
+
+// the subdivided points have exactly the room laid out for their edges,
+// and the points, faces and edges know each other
+static bool adjacencyMatches(SubdivisionSurface* surface)
+{
+    for (size_t i=0; i<surface->numberOfPoints(); ++i) {
+        SubdivisionPoint* pt = surface->getPoint(i);
+        if (pt->getEdges().capacity() != pt->numberOfEdges())
+            return false;
+        for (size_t j=0; j<pt->numberOfFaces(); ++j) {
+            SubdivisionFace* face = pt->getFace(j);
+            if (face->indexOfPoint(pt) >= face->numberOfPoints())
+                return false;
+        }
+        for (size_t j=0; j<pt->numberOfEdges(); ++j) {
+            SubdivisionEdge* edge = pt->getEdge(j);
+            if (edge->startPoint() != pt && edge->endPoint() != pt)
+                return false;
+        }
+    }
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* face = surface->getControlFace(i);
+        for (size_t j=0; j<face->numberOfChildren(); ++j) {
+            SubdivisionFace* child = face->getChild(j);
+            for (size_t k=0; k<child->numberOfPoints(); ++k)
+                if (child->getPoint(k)->indexOfFace(child) >= child->getPoint(k)->numberOfFaces())
+                    return false;
+        }
+    }
+    return true;
+}
+
+void SubdivsurfaceTest::testCaseLevelAdjacency()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    for (int level=1; level<=3; ++level) {
+        surface->setDesiredSubdivisionLevel(level);
+        surface->setBuild(false);
+        surface->rebuild();
+        QVERIFY2(adjacencyMatches(surface), "lists sb laid out for the subdivided level");
+    }
+    // the lists of a kept level come back with it
+    surface->setDesiredSubdivisionLevel(2);
+    surface->rebuild();
+    QVERIFY(surface->numberOfCachedLevels() > 0);
+    QVERIFY2(adjacencyMatches(surface), "lists of a kept level sb unchanged");
+    vector<QVector3D> points = subdividedPoints(surface);
+    surface->setLevelCacheBudget(0);
+    surface->setBuild(false);
+    surface->rebuild();
+    QVERIFY2(samePoints(surface, points), "level sb same when subdivided again");
+}
+
+void SubdivsurfaceTest::benchmarkLevelSwitch()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+    int level = 4;
+
+    QBENCHMARK {
+        level = level == 4 ? 3 : 4;
+        surface->setDesiredSubdivisionLevel(level);
+        surface->rebuild();
+    }
+}
+
+void SubdivsurfaceTest::testCaseEdgeLookup()
+{
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(3);
+    surface->setBuild(false);
+    surface->rebuild();
+
+    // control edges are found either way round and keep their type
+    for (size_t i=0; i<surface->numberOfControlEdges(); ++i) {
+        SubdivisionControlEdge* edge = surface->getControlEdge(i);
+        QCOMPARE(surface->controlEdgeExists(edge->startPoint(), edge->endPoint()), edge);
+        QCOMPARE(surface->controlEdgeExists(edge->endPoint(), edge->startPoint()), edge);
+        QCOMPARE(edge->asControlEdge(), edge);
+    }
+    // subdivided edges are not control edges, even when they lie on one
+    for (size_t i=0; i<surface->numberOfEdges(); ++i) {
+        SubdivisionEdge* edge = surface->getEdge(i);
+        QCOMPARE(surface->edgeExists(edge->endPoint(), edge->startPoint()), edge);
+        QVERIFY(edge->asControlEdge() == 0);
+        QVERIFY(surface->controlEdgeExists(edge->startPoint(), edge->endPoint()) == 0);
+    }
+    // points of a face that aren't neighbours have no edge
+    SubdivisionFace* face = surface->getControlFace(0)->getChild(0);
+    if (face->numberOfPoints() == 4)
+        QVERIFY(surface->edgeExists(face->getPoint(0), face->getPoint(2)) == 0);
+}
+
+void SubdivsurfaceTest::benchmarkEdgeLookup_data()
+{
+    QTest::addColumn<bool>("control");
+
+    QTest::newRow("subdivided faces") << false;
+    QTest::newRow("control faces") << true;
+}
+
+void SubdivsurfaceTest::benchmarkEdgeLookup()
+{
+    QFETCH(bool, control);
+    ShipCADModel model;
+    if (!loadDemoHull(model, "FREE!ship demo 1.fbm"))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(4);
+    surface->setBuild(false);
+    surface->rebuild();
+
+    // the edges around every face, as the intersection and spline code looks them up
+    vector<SubdivisionFace*> faces;
+    for (size_t i=0; i<surface->numberOfControlFaces(); ++i) {
+        SubdivisionControlFace* ctrlface = surface->getControlFace(i);
+        if (control)
+            faces.push_back(ctrlface);
+        else
+            for (size_t j=0; j<ctrlface->numberOfChildren(); ++j)
+                faces.push_back(ctrlface->getChild(j));
+    }
+    size_t found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (size_t i=0; i<faces.size(); ++i) {
+            SubdivisionFace* face = faces[i];
+            SubdivisionPoint* p1 = face->getLastPoint();
+            for (size_t j=0; j<face->numberOfPoints(); ++j) {
+                SubdivisionPoint* p2 = face->getPoint(j);
+                if (control) {
+                    if (surface->controlEdgeExists(p1, p2) != 0)
+                        ++found;
+                }
+                else if (surface->edgeExists(p1, p2) != 0)
+                    ++found;
+                p1 = p2;
+            }
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+void SubdivsurfaceTest::benchmarkSubdivide_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<int>("level");
+
+    const char* hulls[] = {
+        "FREE!ship demo 1.fbm", "FREE!ship demo 2.fbm", "FREE!ship demo 3.fbm",
+        "FREE!ship demo 4.fbm", "FREE!ship demo 5.fbm", "FREE!ship demo 6.fbm",
+        "FREE!ship demo 7.fbm", "FREE!ship demo 8.fbm", "FREE!ship demo tug.fbm",
+        "lynx.fbm"
+    };
+    for (size_t i=0; i<sizeof(hulls)/sizeof(hulls[0]); ++i) {
+        for (int level=1; level<=5; ++level) {
+            QString name = QString("%1 level %2").arg(hulls[i]).arg(level);
+            QTest::newRow(name.toLatin1().constData()) << QString(hulls[i]) << level;
+        }
+    }
+}
+
+// time to refine the demo hulls, each level has 4 times the faces of
+// the previous level, so the time should grow by the same factor
+void SubdivsurfaceTest::benchmarkSubdivide()
+{
+    QFETCH(QString, filename);
+    QFETCH(int, level);
+
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    // the surface is limited to 4 levels, go one further by hand
+    surface->setDesiredSubdivisionLevel(level > 4 ? 4 : level);
+
+    QBENCHMARK {
+        surface->setBuild(false);
+        surface->rebuild();
+        if (level > 4)
+            surface->subdivide();
+    }
+}
+
+void SubdivsurfaceTest::benchmarkLevelMemory_data()
+{
+    benchmarkSubdivide_data();
+}
+
+// memory of the subdivided elements and their lists at each level of
+// the demo hulls, each level should take about 4 times the previous one
+void SubdivsurfaceTest::benchmarkLevelMemory()
+{
+    QFETCH(QString, filename);
+    QFETCH(int, level);
+
+    if (level > 4)
+        QSKIP("surface is limited to 4 levels");
+    ShipCADModel model;
+    if (!loadDemoHull(model, filename))
+        QSKIP("demo hull not found");
+    SubdivisionSurface* surface = model.getSurface();
+    surface->setDesiredSubdivisionLevel(level);
+    surface->setLevelCacheBudget(0);
+    surface->setBuild(false);
+    surface->rebuild();
+    QTest::setBenchmarkResult(subdividedBytes(surface), QTest::BytesAllocated);
+}
+
 QTEST_APPLESS_MAIN(SubdivsurfaceTest)
 
 #include "tst_subdivsurfacetest.moc"
@@ -0,0 +1,87 @@
+/*##############################################################################################
+ *    ShipCAD										       *
+ *    Copyright 2018, by Greg Green <ggreen@bit-builder.com>				       *
+ *                                                                                             *
+ *    This program is free software; you can redistribute it and/or modify it under            *
+ *    the terms of the GNU General Public License as published by the                          *
+ *    Free Software Foundation; either version 2 of the License, or (at your option)           *
+ *    any later version.                                                                       *
+ *                                                                                             *
+ *    This program is distributed in the hope that it will be useful, but WITHOUT ANY          *
+ *    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A          *
+ *    PARTICULAR PURPOSE. See the GNU General Public License for more details.                 *
+ *                                                                                             *
+ *    You should have received a copy of the GNU General Public License along with             *
+ *    this program; if not, write to the Free Software Foundation, Inc.,                       *
+ *    59 Temple Place, Suite 330, Boston, MA 02111-1307 USA                                    *
+ *                                                                                             *
+ *#############################################################################################*/
+
+// helpers shared by the unit tests, the including test defines SRCDIR
+
+#ifndef TESTUTIL_H_
+#define TESTUTIL_H_
+
+#include <QString>
+#include <QFile>
+#include <QVector3D>
+#include <vector>
+
+#include "shipcadmodel.h"
+#include "filebuffer.h"
+#include "spline.h"
+#include "subdivsurface.h"
+#include "subdivedge.h"
+
+// load one of the hulls in the Ships/Database directory
+inline bool loadDemoHull(ShipCAD::ShipCADModel& model, const QString& filename)
+{
+    QFile file(QString(SRCDIR "../../Ships/Database/") + filename);
+    if (!file.exists())
+        return false;
+    ShipCAD::FileBuffer source;
+    source.loadFromFile(file);
+    model.loadBinary(source);
+    return true;
+}
+
+// the same splines, point for point, with the same knuckles
+inline bool sameSplines(ShipCAD::SplineVector& a, ShipCAD::SplineVector& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i=0; i<a.size(); ++i) {
+        ShipCAD::Spline* sa = a.get(i);
+        ShipCAD::Spline* sb = b.get(i);
+        if (sa->numberOfPoints() != sb->numberOfPoints())
+            return false;
+        for (size_t j=0; j<sa->numberOfPoints(); ++j)
+            if (sa->getPoint(j) != sb->getPoint(j) || sa->isKnuckle(j) != sb->isKnuckle(j))
+                return false;
+    }
+    return true;
+}
+
+// the port half of a 1m box with an open top, all its edges creases
+inline void makeBox(ShipCAD::ShipCADModel& model)
+{
+    ShipCAD::SubdivisionSurface* s = model.getSurface();
+    QVector3D p[8] = {
+        QVector3D(0,0,0), QVector3D(1,0,0), QVector3D(1,.5,0), QVector3D(0,.5,0),
+        QVector3D(0,0,1), QVector3D(1,0,1), QVector3D(1,.5,1), QVector3D(0,.5,1)
+    };
+    const size_t faces[5][4] = {
+        {0, 3, 2, 1}, {0, 1, 5, 4}, {1, 2, 6, 5}, {2, 3, 7, 6}, {3, 0, 4, 7}
+    };
+    for (size_t i=0; i<5; i++) {
+        std::vector<QVector3D> face_points;
+        for (size_t j=0; j<4; j++)
+            face_points.push_back(p[faces[i][j]]);
+        s->addControlFace(face_points);
+    }
+    for (size_t i=0; i<s->numberOfControlEdges(); i++)
+        s->getControlEdge(i)->setCrease(true);
+    model.setPrecision(ShipCAD::fpMedium);
+}
+
+#endif